@@ -122,6 +122,10 @@ class Execution {
     static forceUpdateUI(_timestamp) {
         let status = Module.getStatus();
         Execution.processStatus(status);
+
+        // the PC comes from the status block, so this does not wait on the simulator
+        InstructionUtils.highlightCurrentInstruction(Execution.readStatusBlock().pc);
+
         if (status != 0 && Module.lockSimulator(100)) { // make this magic number related to the refresh rate of the monitor
             // original update()
             // RegisterUtils.update();
@@ -133,12 +137,28 @@ class Execution {
             // RegisterUtils.init(Execution.ctx);
             // MemoryUtils.init(Execution.ctx);
             // InstructionUtils.update(Execution.ctx);
-            InstructionUtils.highlightCurrentInstruction();
 
             Module.unlockSimulator();
         }
     }
 
+    /**
+     * Read the simulator status block without locking the simulator. The layout mirrors worker.h:
+     * [run state, cycles (low), cycles (high)] followed by [pc, finished, exit status] for each context.
+     * @param ctx the context whose pc and exit status to read
+     */
+    static readStatusBlock(ctx = Execution.ctx) {
+        const block = Module.getStatusBlock();
+        const base = 3 + 3 * ctx;
+        return {
+            runState: Atomics.load(block, 0), // 0 stopped, 1 running, 2 breakpoint, 3 finished
+            cycles: (Atomics.load(block, 2) >>> 0) * 2 ** 32 + (Atomics.load(block, 1) >>> 0),
+            pc: Atomics.load(block, base) >>> 0,
+            finished: Atomics.load(block, base + 1) !== 0,
+            exitStatus: Atomics.load(block, base + 2)
+        };
+    }
+
     static processStatus(status) {
         switch (status) {
             case 1: // Not running
@@ -234,6 +254,17 @@ function writeStdOut(ctx, msg) {
     }
 }
 
+// Called by the simulator when a read syscall in ctx finds no input queued. The context stays
+// parked at the syscall, while the others keep running, until Module.provideInput is called.
+function requestInput(ctx) {
+    const text = window.prompt("Program in context " + ctx + " is waiting for input:");
+    if (text === null) {
+        Module.closeInput(ctx);
+    } else {
+        Module.provideInput(ctx, text + "\n");
+    }
+}
+
 function writeStdErr(ctx, msg) {
     stderr[ctx] += msg;
     console.log("Got message for ctx " + ctx + " stderr");
@@ -27,10 +27,10 @@ class InstructionUtils {
         Elements.kernelTextContent.innerHTML = '';
 
         this.ctx = ctx;
-        this.userText = Module.getUserText(this.ctx).split("\n").slice(0, -1).map(e => new Instruction(e, this.ctx));
+        this.userText = Module.getTextRecords(this.ctx, 0x00400000, 0x80000000).map(e => new Instruction(e, this.ctx));
         this.userText.forEach(e => Elements.userTextContent.appendChild(e.element));
 
-        this.kernelText = Module.getKernelText(this.ctx).split("\n").slice(0, -1).map(e => new Instruction(e, this.ctx));
+        this.kernelText = Module.getTextRecords(this.ctx, 0x80000000, 0x90000000).map(e => new Instruction(e, this.ctx));
         this.kernelText.forEach(e => Elements.kernelTextContent.appendChild(e.element));
 
         InstructionUtils.instructionList = [...this.userText, ...this.kernelText];
@@ -50,10 +50,10 @@ class InstructionUtils {
 
         this.ctx = ctx;
 
-        this.userText = Module.getUserText(this.ctx).split("\n").slice(0, -1).map(e => new Instruction(e, this.ctx));
+        this.userText = Module.getTextRecords(this.ctx, 0x00400000, 0x80000000).map(e => new Instruction(e, this.ctx));
         this.userText.forEach(e => Elements.userTextContent.appendChild(e.element));
 
-        this.kernelText = Module.getKernelText(this.ctx).split("\n").slice(0, -1).map(e => new Instruction(e, this.ctx));
+        this.kernelText = Module.getTextRecords(this.ctx, 0x80000000, 0x90000000).map(e => new Instruction(e, this.ctx));
         this.kernelText.forEach(e => Elements.kernelTextContent.appendChild(e.element));
 
         InstructionUtils.instructionList = [...this.userText, ...this.kernelText];
@@ -79,12 +79,14 @@ class InstructionUtils {
         this.breakpointAddr = [[],[]];
     }
 
-    static highlightCurrentInstruction() {
+    static highlightCurrentInstruction(pc = RegisterUtils.getPC()) {
+        const instruction = InstructionUtils.instructionDict[pc];
+        if (instruction && InstructionUtils.highlighted === instruction.element) return;
+
         if (InstructionUtils.highlighted)
             InstructionUtils.highlighted.style.backgroundColor = null;
+        InstructionUtils.highlighted = undefined;
 
-        const pc = RegisterUtils.getPC();
-        const instruction = InstructionUtils.instructionDict[pc];
         if (!instruction) return;
 
         InstructionUtils.highlighted = instruction.element;
@@ -119,16 +121,20 @@ class InstructionUtils {
 }
 
 class Instruction {
-    constructor(text, ctx) {
-        this.text = text;
+    /**
+     * @param record a disassembled instruction {address, encoding, mnemonic, operands, source, label} from getTextRecords
+     * @param ctx the context the instruction belongs to
+     */
+    constructor(record, ctx) {
+        this.record = record;
         this.ctx = ctx;
 
         this.isBreakpoint = false;
         this.showBinary = false;
         this.showSourceCode = true;
 
-        this.addressString = this.text.substring(3, 11);
-        this.address = Number.parseInt(this.addressString, 16);
+        this.address = record.address;
+        this.addressString = this.address.toString(16).padStart(8, '0');
 
         this.initElement()
     }
@@ -136,8 +142,6 @@ class Instruction {
     initElement() {
         this.element = document.createElement("div");
 
-        this.indexOfComma = this.text.indexOf(';');
-
         // address
         this.element.innerHTML = `[<span class="hljs-attr">${this.addressString}</span>] `;
 
@@ -164,15 +168,17 @@ class Instruction {
     }
 
     getBinaryInnerText() {
-        return this.showBinary ? this.text.substring(15, 24) : "";
+        return this.showBinary ? this.record.encoding.toString(16).padStart(8, '0') + " " : "";
     }
 
     getSourceCodeInnerText() {
-        return (this.showSourceCode && this.indexOfComma > 0) ? this.text.substring(this.indexOfComma) : "";
+        return (this.showSourceCode && this.record.source) ? "; " + this.record.source : "";
     }
 
     getInstructionInnerText() {
-        return this.indexOfComma > 0 ? this.text.substring(25, this.indexOfComma) : this.text.substring(25);
+        const text = this.record.operands ? `${this.record.mnemonic} ${this.record.operands}` : this.record.mnemonic;
+        // keep the source comments lined up in one column
+        return this.record.source ? text.padEnd(32) : text;
     }
 
     toggleBreakpoint() {
@@ -7,12 +7,18 @@ class MemoryUtils {
         this.userData.initialize(ctx);
         this.kernelData.initialize(ctx);
         this.stack.initialize(ctx);
+
+        // everything is on screen now, so start tracking writes from here
+        Module.acknowledgeDirtyRanges(ctx);
     }
 
     static update(ctx) {
-        this.userData.update(ctx);
-        this.kernelData.update(ctx);
-        this.stack.update(ctx);
+        // [version, data lo, data hi, kdata lo, kdata hi, stack lo, stack hi]
+        const ranges = Module.getDirtyRanges(ctx);
+        this.userData.update(ctx, ranges[1], ranges[2]);
+        this.kernelData.update(ctx, ranges[3], ranges[4]);
+        this.stack.update(ctx, ranges[5], ranges[6]);
+        Module.acknowledgeDirtyRanges(ctx);
     }
 
     static changeStackRadix(radixStr) {
@@ -38,6 +44,8 @@ class Memory {
     constructor() {
         this.radix = 16;
         this.lines = [];
+        this.lineMap = new Map();
+        this.refreshedLines = new Set();
         this.content = undefined;
         this.element = undefined;
     }
@@ -73,6 +81,28 @@ class Memory {
         return true;
     }
 
+    /**
+     * Update the lines overlapping the given [lo, hi) address ranges, plus the lines updated last time so that
+     * their highlight is cleared. Empty ranges (lo >= hi) are skipped.
+     * @param ranges a list of [lo, hi] pairs
+     */
+    refreshRanges(ranges) {
+        const refreshed = new Set();
+        for (const [lo, hi] of ranges) {
+            if (lo >= hi) continue;
+            for (let addr = lo - lo % 0x10; addr < hi; addr += 0x10) {
+                const line = this.lineMap.get(addr);
+                if (line === undefined || refreshed.has(line)) continue;
+                line.updateValues();
+                refreshed.add(line);
+            }
+        }
+
+        for (const line of this.refreshedLines)
+            if (!refreshed.has(line)) line.updateValues();
+        this.refreshedLines = refreshed;
+    }
+
     /**
      * Adding new lines to `this.lines`
      */
@@ -98,7 +128,6 @@ class Memory {
 class DataSegment extends Memory {
     constructor() {
         super();
-        this.lineAddresses = new Set();
     }
 
     addNewLines() {
@@ -114,12 +143,24 @@ class DataSegment extends Memory {
         newLine.updateValues();
         this.element.append(newLine.element);
         this.lines.push(newLine);
-        this.lineAddresses.add(addr);
+        this.lineMap.set(addr, newLine);
     }
 
     getContent(addr) {
         return this.content[(addr - this.startAddress) >> 2];
     }
+
+    /**
+     * Refresh only the lines in the [lo, hi) range written since the last update
+     */
+    updateRange(lo, hi) {
+        for (let addr = lo - lo % 0x10; addr < hi; addr += 0x10) {
+            if (!this.lineMap.has(addr) && !this.isLineEmpty(addr))
+                this.addLine(addr);
+        }
+
+        this.refreshRanges([[lo, hi]]);
+    }
 }
 
 class UserData extends DataSegment {
@@ -132,17 +173,10 @@ class UserData extends DataSegment {
         
     }
 
-    update(ctx) {
+    update(ctx, lo, hi) {
         this.ctx = ctx;
         this.content = Module.getUserData(ctx);
-
-        for (let i = 0; i < this.content.length / 16; i++) {
-            const addr = this.startAddress + i * 0x10;
-            if (!this.isLineEmpty(addr) && !this.lineAddresses.has(addr))
-                this.addLine(addr);
-        }
-
-        this.lines.forEach(e => e.updateValues());
+        this.updateRange(lo, hi);
     }
 }
 
@@ -155,17 +189,10 @@ class KernelData extends DataSegment {
         this.startAddress = 0x90000000;
     }
 
-    update(ctx) {
+    update(ctx, lo, hi) {
         this.ctx = ctx;
         this.content = Module.getKernelData(ctx);
-
-        for (let i = 0; i < this.content.length / 16; i++) {
-            const addr = this.startAddress + i * 0x10;
-            if (!this.isLineEmpty(addr) && !this.lineAddresses.has(addr))
-                this.addLine(addr);
-        }
-
-        this.lines.forEach(e => e.updateValues());
+        this.updateRange(lo, hi);
     }
 }
 
@@ -173,22 +200,27 @@ class Stack extends Memory {
     constructor(ctx) {
         super();
         this.ctx = ctx;
-        this.content = Module.getStack(this.ctx);
+        this.content = Module.getStackWindow(this.ctx);
         this.element = Elements.stack;
+        this.lastSP = RegisterUtils.getSP();
     }
 
-    update(ctx) {
-        if (RegisterUtils.getSP() < this.minLineAddress)
-            this.addNewLines(this.minLineAddress);
+    update(ctx, lo, hi) {
         this.ctx = ctx;
-        this.content = Module.getStack(ctx);
-        this.lines.forEach(e => e.updateValues());
+        this.content = Module.getStackWindow(ctx);
+        const sp = RegisterUtils.getSP();
+        if (sp < this.minLineAddress)
+            this.addNewLines(this.minLineAddress);
+
+        // words between the old and new $sp changed between used and unused
+        this.refreshRanges([[lo, hi], [Math.min(sp, this.lastSP), Math.max(sp, this.lastSP)]]);
+        this.lastSP = sp;
     }
 
     getContent(addr) {
         if (RegisterUtils.getSP() > addr) return undefined;
         const index = this.content.length - (0x80000000 - addr) / 4;
-        return this.content[index];
+        return index < 0 ? undefined : this.content[index];
     }
 
     addNewLines(endAddr = 0x80000000) {
@@ -196,6 +228,7 @@ class Stack extends Memory {
             const newLine = new MemoryLine(endAddr - 0x10, this);
             Elements.stack.prepend(newLine.element);
             this.lines.push(newLine);
+            this.lineMap.set(endAddr - 0x10, newLine);
         }
         this.minLineAddress = RegisterUtils.getSP() & 0xfffffff0;
     }
@@ -0,0 +1,110 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "spim.h"
+#include "spim-utils.h"
+#include "image.h"
+#include "arena.h"
+
+
+/* Header is padded so the blocks that follow it stay aligned. */
+#define CHUNK_HEADER_SIZE ARENA_ROUND ((int) sizeof (arena_chunk))
+
+
+static inline int
+free_class (int size)
+{
+  return (size / ARENA_ALIGN) - 1;
+}
+
+
+/* Return SIZE bytes from IMG's arena.  The contents are undefined. */
+
+void *
+arena_alloc (MIPSImage &img, int size)
+{
+  arena_t &a = img.arena();
+  int cls;
+  char *p;
+
+  size = ARENA_ROUND (size);
+  cls = free_class (size);
+  if (cls < ARENA_FREE_CLASSES && a.free_blocks[cls] != NULL)
+    {
+      p = (char *) a.free_blocks[cls];
+      a.free_blocks[cls] = *(void **) p;
+      return (p);
+    }
+
+  if (a.limit - a.next < size)
+    {
+      /* Large requests get a chunk of their own, so the current chunk
+	 keeps its free space. */
+      int chunk_size = MAX (ARENA_CHUNK_SIZE, CHUNK_HEADER_SIZE + size);
+      arena_chunk *c = (arena_chunk *) malloc (chunk_size);
+
+      if (c == NULL)
+	fatal_error (img, "Out of memory at request for %d bytes.\n", size);
+      c->next = a.chunks;
+      a.chunks = c;
+      if (chunk_size > ARENA_CHUNK_SIZE)
+	return ((char *) c + CHUNK_HEADER_SIZE);
+      a.next = (char *) c + CHUNK_HEADER_SIZE;
+      a.limit = (char *) c + chunk_size;
+    }
+
+  p = a.next;
+  a.next += size;
+  return (p);
+}
+
+
+void *
+arena_zalloc (MIPSImage &img, int size)
+{
+  void *p = arena_alloc (img, size);
+
+  memclr (p, size);
+  return (p);
+}
+
+
+/* Give back a block of SIZE bytes before the arena is released.  Only
+   small blocks are kept for reuse; the rest wait for arena_release. */
+
+void
+arena_free (MIPSImage &img, void *p, int size)
+{
+  arena_t &a = img.arena();
+  int cls = free_class (ARENA_ROUND (size));
+
+  if (p == NULL || cls >= ARENA_FREE_CLASSES)
+    return;
+  *(void **) p = a.free_blocks[cls];
+  a.free_blocks[cls] = p;
+}
+
+
+char *
+arena_str_copy (MIPSImage &img, const char *str)
+{
+  int len = (int) strlen (str) + 1;
+
+  return ((char *) memcpy (arena_alloc (img, len), str, len));
+}
+
+
+/* Free every block in ARENA at once. */
+
+void
+arena_release (arena_t &arena)
+{
+  arena_chunk *c, *n;
+
+  for (c = arena.chunks; c != NULL; c = n)
+    {
+      n = c->next;
+      free (c);
+    }
+  arena = arena_t ();
+}
@@ -0,0 +1,43 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+class MIPSImage;
+
+/* Bump allocator for the objects that live as long as a program image:
+   instructions, immediate expressions, labels and their uses, and
+   source lines.  Small blocks that are freed early go on a free list
+   for their size and are reused; everything else is given back at once
+   when the image is destroyed or reinitialized. */
+
+#define ARENA_CHUNK_SIZE	(64 * 1024)
+#define ARENA_ALIGN		8
+#define ARENA_FREE_CLASSES	8	/* Free lists for blocks of 8 .. 64 bytes */
+
+/* Bytes a block of SIZE takes: every block can hold a free-list link.
+   N blocks taken in one piece of N * ARENA_ROUND (SIZE) bytes can still
+   be freed one at a time. */
+#define ARENA_ROUND(SIZE) \
+  ((MAX ((SIZE), ARENA_ALIGN) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+
+typedef struct arena_chunk
+{
+  struct arena_chunk *next;
+} arena_chunk;
+
+typedef struct arena {
+	arena_chunk *chunks = NULL;	/* Every block obtained from malloc */
+	char *next = NULL;		/* First free byte of the current chunk */
+	char *limit = NULL;		/* End of the current chunk */
+	void *free_blocks[ARENA_FREE_CLASSES] = {};
+} arena_t;
+
+
+void *arena_alloc (MIPSImage &img, int size);
+void *arena_zalloc (MIPSImage &img, int size);
+void arena_free (MIPSImage &img, void *p, int size);
+char *arena_str_copy (MIPSImage &img, const char *str);
+void arena_release (arena_t &arena);
+
+#endif
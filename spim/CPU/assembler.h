@@ -0,0 +1,64 @@
+#ifndef ASSEMBLER_H
+#define ASSEMBLER_H
+
+#include <memory>
+
+#include "label.h"
+
+class MIPSImage;
+
+#ifndef YY_TYPEDEF_YY_SCANNER_T
+#define YY_TYPEDEF_YY_SCANNER_T
+typedef void *yyscan_t;		/* Reentrant flex scanner */
+#endif
+
+/* List of labels defined on the current source line. */
+
+typedef struct ll
+{
+  label *head;
+  struct ll *tail;
+} label_list;
+
+
+/* State of the scanner and parser while assembling a file.  Each
+   MIPSImage owns one, so several contexts can be assembled at the same
+   time on different threads. */
+
+typedef struct assembler {
+	yyscan_t scanner = NULL;	/* Live only inside read_assembly_file */
+
+	/* Scanner: */
+
+	/* This flag tells the scanner to treat the next sequence of letters
+	   etc as an identifier and not look it up as an opcode. It permits us
+	   to use opcodes as symbols in most places.  However, because of the
+	   LALR(1) lookahead, it does not work for labels. */
+	int only_id = 0;
+	int line_no = 0;		/* Line number in input file */
+	std::shared_ptr<char> file_name; /* The name of the current file */
+	int current_line_no = 0;	/* Line we are reading ... */
+	char *current_line = NULL;	/* ... and where it began in the buffer */
+	double scan_float = 0.0;	/* Where FP values are kept */
+	int line_returned = 0;		/* Returned current line yet? */
+	int eof_returned = 0;		/* Return EOF token yet? */
+
+	/* Parser: */
+	bool data_dir = false;		/* => item in data segment */
+	bool text_dir = true;		/* => item in text segment */
+	bool parse_error_occurred = false; /* => parse resulted in error */
+	int diagnostic_count = 0;	/* Messages assembler_error() printed since initialize_parser */
+	bool null_term = false;		/* => string terminate by \0 */
+	void (*store_op) (MIPSImage&, int) = NULL; /* Function to store items in an EXPR_LST */
+	void (*store_fp_op) (MIPSImage&, double*) = NULL; /* Ditto FP_EXPR_LST */
+	label_list *this_line_labels = NULL; /* List of label for curent line */
+	bool noat_flag = false;		/* => program can use $1 */
+	const char *input_file_name = NULL; /* Name of file being parsed */
+
+	/* Machine the file is assembled for (copied from the globals of the
+	   same name, but changed locally while reading the exception handler). */
+	bool bare_machine = false;
+	bool accept_pseudo_insts = true;
+} assembler_t;
+
+#endif
@@ -0,0 +1,238 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "spim.h"
+#include "image.h"
+#include "sym-tbl.h"
+#include "branch_predictor.h"
+
+
+static const struct
+{
+  const char *name;
+  bp_kind kind;
+} bp_kinds[] = {
+  {"not-taken", BP_NOT_TAKEN},
+  {"taken", BP_TAKEN},
+  {"btfn", BP_BTFN},
+  {"1bit", BP_ONE_BIT},
+  {"2bit", BP_TWO_BIT},
+  {"gshare", BP_GSHARE},
+  {"tournament", BP_TOURNAMENT},
+};
+
+
+const char *
+bp_kind_name (bp_kind kind)
+{
+  for (const auto &k : bp_kinds)
+    if (k.kind == kind)
+      return k.name;
+  return "?";
+}
+
+
+static bool
+parse_bits (const std::string &value, int max, int &n)
+{
+  char *end;
+  long v = strtol (value.c_str (), &end, 10);
+
+  if (end == value.c_str () || *end != '\0' || v < 0 || v > max)
+    return false;
+  n = (int) v;
+  return true;
+}
+
+
+/* Parse a description of a predictor such as "gshare:bits=12,history=8".
+   The kind is one of not-taken, taken, btfn, 1bit, 2bit, gshare, or
+   tournament, optionally followed by bits (log2 of the number of
+   entries in each table) and history (the number of outcomes gshare
+   and tournament hash in). */
+
+bool
+bp_parse_config (const char *spec, bp_config_t &config, std::string &problem)
+{
+  std::string s (spec);
+  size_t colon = s.find (':');
+  std::string name = s.substr (0, colon);
+  bool known = false;
+
+  config = bp_config_t ();
+  for (const auto &k : bp_kinds)
+    if (name == k.name)
+      {
+	config.kind = k.kind;
+	known = true;
+      }
+  if (!known)
+    {
+      problem = "unknown predictor `" + name + "'";
+      return false;
+    }
+
+  std::string settings = colon == std::string::npos ? "" : s.substr (colon + 1);
+  size_t pos = 0;
+  while (pos < settings.size ())
+    {
+      size_t comma = settings.find (',', pos);
+      std::string setting = settings.substr (pos, comma == std::string::npos ? std::string::npos : comma - pos);
+      size_t eq = setting.find ('=');
+      pos = (comma == std::string::npos) ? settings.size () : comma + 1;
+
+      bool ok = false;
+
+      if (eq != std::string::npos && setting.substr (0, eq) == "bits")
+	ok = parse_bits (setting.substr (eq + 1), 20, config.table_bits) && config.table_bits > 0;
+      else if (eq != std::string::npos && setting.substr (0, eq) == "history")
+	ok = parse_bits (setting.substr (eq + 1), 30, config.history_bits);
+      if (!ok)
+	{
+	  problem = name + ": bad setting `" + setting + "'";
+	  return false;
+	}
+    }
+  return true;
+}
+
+
+/* Give IMG a predictor built to CONFIG, with every counter weakly not
+   taken, in place of any it had. */
+
+void
+bp_attach (MIPSImage &img, const bp_config_t &config)
+{
+  std::unique_ptr<branch_predictor_t> bp (new branch_predictor_t ());
+  size_t entries = (size_t) 1 << config.table_bits;
+
+  bp->config = config;
+  if (config.kind == BP_ONE_BIT)
+    bp->local.assign (entries, 0);
+  else if (config.kind == BP_TWO_BIT || config.kind == BP_TOURNAMENT)
+    bp->local.assign (entries, 1);
+  if (config.kind == BP_GSHARE || config.kind == BP_TOURNAMENT)
+    bp->global.assign (entries, 1);
+  if (config.kind == BP_TOURNAMENT)
+    bp->chooser.assign (entries, 1);
+  img.set_branch_predictor (std::move (bp));
+}
+
+
+void
+bp_detach (MIPSImage &img)
+{
+  img.set_branch_predictor (nullptr);
+}
+
+
+static inline void
+train (uint8_t &counter, bool taken)
+{
+  if (taken && counter < 3)
+    counter += 1;
+  else if (!taken && counter > 0)
+    counter -= 1;
+}
+
+
+/* The conditional branch at PC to TARGET was resolved as TAKEN (or not).
+   Predict it as if we did not know, then learn the outcome. */
+
+void
+predict_branch (MIPSImage &img, mem_addr pc, mem_addr target, bool taken)
+{
+  branch_predictor_t &bp = *img.branch_predictor();
+  uint32 mask = (1u << bp.config.table_bits) - 1;
+  uint32 history_mask = (1u << bp.config.history_bits) - 1;
+  uint32 local_i = (pc >> 2) & mask;
+  uint32 global_i = ((pc >> 2) ^ (bp.history & history_mask)) & mask;
+  bool prediction = false;
+
+  switch (bp.config.kind)
+    {
+    case BP_NOT_TAKEN:
+      prediction = false;
+      break;
+
+    case BP_TAKEN:
+      prediction = true;
+      break;
+
+    case BP_BTFN:
+      prediction = (target <= pc);
+      break;
+
+    case BP_ONE_BIT:
+      prediction = bp.local[local_i];
+      bp.local[local_i] = taken;
+      break;
+
+    case BP_TWO_BIT:
+      prediction = (bp.local[local_i] >= 2);
+      train (bp.local[local_i], taken);
+      break;
+
+    case BP_GSHARE:
+      prediction = (bp.global[global_i] >= 2);
+      train (bp.global[global_i], taken);
+      break;
+
+    case BP_TOURNAMENT:
+      {
+	bool local_p = (bp.local[local_i] >= 2);
+	bool global_p = (bp.global[global_i] >= 2);
+
+	prediction = (bp.chooser[local_i] >= 2) ? global_p : local_p;
+	if (local_p != global_p)
+	  train (bp.chooser[local_i], global_p == taken);
+	train (bp.local[local_i], taken);
+	train (bp.global[global_i], taken);
+	break;
+      }
+    }
+  bp.history = (bp.history << 1) | taken;
+
+  bp_site_t &site = bp.sites[pc];
+  site.executed += 1;
+  site.taken += taken;
+  bp.predictions += 1;
+  if (prediction == taken)
+    {
+      site.correct += 1;
+      bp.correct += 1;
+    }
+}
+
+
+/* The counts for each branch, in order of address, named by the label
+   before it. */
+
+std::vector<bp_site_stats_t>
+bp_site_stats (MIPSImage &img)
+{
+  std::map<mem_addr, bp_site_t> by_addr;
+  std::vector<bp_site_stats_t> result;
+
+  if (img.branch_predictor() == NULL)
+    return result;
+
+  by_addr.insert (img.branch_predictor()->sites.begin (), img.branch_predictor()->sites.end ());
+  for (const auto &[pc, site] : by_addr)
+    {
+      label *l = find_label_before (img, pc);
+      char buf[64];
+
+      if (l != NULL)
+	snprintf (buf, sizeof (buf), "+0x%x", (unsigned) (pc - l->addr));
+      else
+	snprintf (buf, sizeof (buf), "0x%08x", pc);
+      result.push_back (bp_site_stats_t {(l != NULL ? std::string (l->name) : "") + buf, pc, site});
+    }
+  return result;
+}
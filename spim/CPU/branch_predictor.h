@@ -0,0 +1,73 @@
+#ifndef BRANCH_PREDICTOR_H
+#define BRANCH_PREDICTOR_H
+
+#include <stdint.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "spim.h"
+
+class MIPSImage;
+
+/* A branch predictor that watches the conditional branches a context
+   resolves.  It predicts each branch from its address (and, for the
+   history-based ones, the outcomes of recent branches) before learning
+   the outcome, and counts how often it was right.  It never steers
+   execution.
+
+   A context has no predictor until bp_attach gives it one; until then
+   PREDICT_BRANCH costs a null check. */
+
+enum bp_kind {
+	BP_NOT_TAKEN,			/* Static: never taken */
+	BP_TAKEN,			/* Static: always taken */
+	BP_BTFN,			/* Static: backward taken, forward not */
+	BP_ONE_BIT,			/* Last outcome, per entry */
+	BP_TWO_BIT,			/* Saturating counter, per entry */
+	BP_GSHARE,			/* 2-bit counters, indexed by PC ^ history */
+	BP_TOURNAMENT			/* 2-bit chooser between 2-bit and gshare */
+};
+
+typedef struct bp_config {
+	bp_kind kind = BP_TWO_BIT;
+	int table_bits = 10;		/* log2 (entries) in each table */
+	int history_bits = 10;		/* Global history length */
+} bp_config_t;
+
+typedef struct bp_site {
+	uint64_t executed;
+	uint64_t taken;
+	uint64_t correct;
+} bp_site_t;
+
+typedef struct branch_predictor {
+	bp_config_t config;
+	std::vector<uint8_t> local;	/* 1- or 2-bit counters, by PC */
+	std::vector<uint8_t> global;	/* gshare's 2-bit counters */
+	std::vector<uint8_t> chooser;	/* >= 2 => trust gshare */
+	uint32 history;
+	uint64_t predictions;
+	uint64_t correct;
+	std::unordered_map<mem_addr, bp_site_t> sites;
+} branch_predictor_t;
+
+typedef struct bp_site_stats {
+	std::string name;		/* Label+offset of the branch */
+	mem_addr addr;
+	bp_site_t counts;
+} bp_site_stats_t;
+
+#define PREDICT_BRANCH(img, PC, TARGET, TAKEN)				\
+		if (img.branch_predictor() != NULL)			\
+		  predict_branch (img, PC, TARGET, TAKEN)
+
+bool bp_parse_config (const char *spec, bp_config_t &config, std::string &problem);
+void bp_attach (MIPSImage &img, const bp_config_t &config);
+void bp_detach (MIPSImage &img);
+void predict_branch (MIPSImage &img, mem_addr pc, mem_addr target, bool taken);
+const char *bp_kind_name (bp_kind kind);
+std::vector<bp_site_stats_t> bp_site_stats (MIPSImage &img);
+
+#endif
@@ -0,0 +1,391 @@
+#include <ctype.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "spim.h"
+#include "image.h"
+#include "reg.h"
+#include "sym-tbl.h"
+#include "cache_model.h"
+#include "text_counts.h"
+
+
+static bool
+is_power_of_2 (uint32 x)
+{
+  return x != 0 && (x & (x - 1)) == 0;
+}
+
+
+/* Check CONFIG, naming the level NAME in PROBLEM if it is not a cache
+   that can be built. */
+
+static bool
+check_config (const char *name, const cache_config_t &config, std::string &problem)
+{
+  uint32 n_lines, ways;
+
+  if (config.size == 0)
+    return true;
+  if (!is_power_of_2 (config.line_size) || config.line_size < BYTES_PER_WORD)
+    {
+      problem = std::string (name) + ": the line size must be a power of 2, at least 4";
+      return false;
+    }
+  if (!is_power_of_2 (config.size) || config.size < config.line_size)
+    {
+      problem = std::string (name) + ": the size must be a power of 2, at least a line";
+      return false;
+    }
+  n_lines = config.size / config.line_size;
+  ways = config.assoc == 0 ? n_lines : config.assoc;
+  if (!is_power_of_2 (ways) || ways > n_lines)
+    {
+      problem = std::string (name) + ": the associativity must be a power of 2, at most the number of lines";
+      return false;
+    }
+  return true;
+}
+
+
+/* Parse the number in VALUE, which may end in K or M.  Zero, and
+   numbers that do not fit in 32 bits, are not sizes. */
+
+static bool
+parse_size (const std::string &value, uint32 &n)
+{
+  char *end;
+  unsigned long long v;
+
+  if (!isdigit ((unsigned char) value[0]))
+    return false;
+  errno = 0;
+  v = strtoull (value.c_str (), &end, 10);
+  if (errno == ERANGE || v > UINT32_MAX)
+    return false;
+  if (*end == 'K' || *end == 'k')
+    v *= K, end ++;
+  else if (*end == 'M' || *end == 'm')
+    v *= K * K, end ++;
+  if (*end == 'B' || *end == 'b')
+    end ++;
+  if (*end != '\0' || v == 0 || v > UINT32_MAX)
+    return false;
+  n = (uint32) v;
+  return true;
+}
+
+
+static bool
+parse_setting (cache_config_t &config, const std::string &key, const std::string &value)
+{
+  if (key == "size")
+    return parse_size (value, config.size);
+  else if (key == "line")
+    return parse_size (value, config.line_size);
+  else if (key == "assoc" && value == "full")
+    config.assoc = 0;
+  else if (key == "assoc")
+    return parse_size (value, config.assoc);
+  else if (key == "repl" && value == "lru")
+    config.replacement = CACHE_LRU;
+  else if (key == "repl" && value == "fifo")
+    config.replacement = CACHE_FIFO;
+  else if (key == "repl" && value == "random")
+    config.replacement = CACHE_RANDOM;
+  else if (key == "write" && (value == "back" || value == "through"))
+    config.write_back = (value == "back");
+  else if (key == "alloc" && (value == "yes" || value == "no"))
+    config.write_allocate = (value == "yes");
+  else
+    return false;
+  return true;
+}
+
+
+/* Parse a description of a hierarchy such as
+
+     l1i:size=8K,assoc=2,line=32; l1d:size=8K,assoc=4,write=through,alloc=no; l2:size=64K,assoc=full
+
+   Each level is "l1i", "l1d", or "l2", followed by any of size, line
+   (in bytes, with an optional K or M), assoc (a number of ways, or
+   "full"), repl (lru, fifo, or random), write (back or through), and
+   alloc (yes or no, whether write misses are brought in).  A level
+   that is not mentioned is not modeled; an L1 cache that is not
+   modeled always misses. */
+
+bool
+cache_parse_config (const char *spec, cache_hierarchy_config_t &config, std::string &problem)
+{
+  std::string s (spec);
+  size_t start = 0;
+
+  config = cache_hierarchy_config_t ();
+  while (start < s.size ())
+    {
+      size_t end = s.find (';', start);
+      std::string level = s.substr (start, end == std::string::npos ? std::string::npos : end - start);
+      start = (end == std::string::npos) ? s.size () : end + 1;
+
+      level.erase (0, level.find_first_not_of (" \t\n"));
+      level.erase (level.find_last_not_of (" \t\n") + 1);
+      if (level.empty ())
+	continue;
+
+      size_t colon = level.find (':');
+      std::string name = level.substr (0, colon);
+      cache_config_t *c = (name == "l1i" ? &config.l1i
+			   : name == "l1d" ? &config.l1d
+			   : name == "l2" ? &config.l2
+			   : NULL);
+      if (c == NULL)
+	{
+	  problem = "unknown cache `" + name + "'";
+	  return false;
+	}
+      *c = cache_config_t ();
+      c->size = 4 * K;
+
+      std::string settings = colon == std::string::npos ? "" : level.substr (colon + 1);
+      size_t pos = 0;
+      while (pos < settings.size ())
+	{
+	  size_t comma = settings.find (',', pos);
+	  std::string setting = settings.substr (pos, comma == std::string::npos ? std::string::npos : comma - pos);
+	  size_t eq;
+	  pos = (comma == std::string::npos) ? settings.size () : comma + 1;
+
+	  setting.erase (0, setting.find_first_not_of (" \t\n"));
+	  setting.erase (setting.find_last_not_of (" \t\n") + 1);
+	  eq = setting.find ('=');
+	  if (eq == std::string::npos
+	      || !parse_setting (*c, setting.substr (0, eq), setting.substr (eq + 1)))
+	    {
+	      problem = name + ": bad setting `" + setting + "'";
+	      return false;
+	    }
+	}
+    }
+
+  return (check_config ("l1i", config.l1i, problem)
+	  && check_config ("l1d", config.l1d, problem)
+	  && check_config ("l2", config.l2, problem));
+}
+
+
+static void
+init_level (cache_level_t &c, const cache_config_t &config)
+{
+  c.config = config;
+  c.lines.clear ();
+  c.stats = cache_stats_t ();
+  c.clock = 0;
+  c.random_state = 0x2545f491;
+  if (config.size == 0)
+    {
+      c.n_sets = c.ways = 0;
+      c.line_bits = 0;
+      return;
+    }
+
+  c.ways = config.assoc == 0 ? config.size / config.line_size : config.assoc;
+  c.n_sets = config.size / config.line_size / c.ways;
+  for (c.line_bits = 0; (1u << c.line_bits) < config.line_size; c.line_bits ++)
+    ;
+  c.lines.assign ((size_t) c.n_sets * c.ways, cache_line_t {0, false, false, 0});
+}
+
+
+/* Give IMG an empty (cold) hierarchy built to CONFIG, in place of any
+   it had. */
+
+void
+cache_attach (MIPSImage &img, const cache_hierarchy_config_t &config)
+{
+  std::unique_ptr<cache_model_t> model (new cache_model_t ());
+
+  init_level (model->l1i, config.l1i);
+  init_level (model->l1d, config.l1d);
+  init_level (model->l2, config.l2);
+  img.set_caches (std::move (model));
+}
+
+
+void
+cache_detach (MIPSImage &img)
+{
+  img.set_caches (nullptr);
+}
+
+
+/* The way to replace in the set starting at SET: an invalid one if
+   there is one, else the policy's choice. */
+
+static cache_line_t *
+victim (cache_level_t &c, cache_line_t *set)
+{
+  cache_line_t *v = set;
+  uint32 w;
+
+  for (w = 0; w < c.ways; w ++)
+    if (!set[w].valid)
+      return &set[w];
+
+  if (c.config.replacement == CACHE_RANDOM)
+    {
+      c.random_state ^= c.random_state << 13; /* xorshift32 */
+      c.random_state ^= c.random_state >> 17;
+      c.random_state ^= c.random_state << 5;
+      return &set[c.random_state & (c.ways - 1)];
+    }
+
+  for (w = 1; w < c.ways; w ++)
+    if (set[w].stamp < v->stamp)
+      v = &set[w];
+  return v;
+}
+
+
+/* Read or write the line holding ADDR in C, passing misses, write-
+   throughs, and write-backs on to NEXT (memory if it is NULL).  Return
+   true on a hit. */
+
+static bool
+access (cache_level_t &c, cache_level_t *next, mem_addr addr, bool write)
+{
+  if (c.n_sets == 0)
+    {
+      if (next != NULL)
+	access (*next, NULL, addr, write);
+      return false;
+    }
+
+  mem_addr line = addr >> c.line_bits;
+  cache_line_t *set = &c.lines[(size_t) (line & (c.n_sets - 1)) * c.ways];
+  cache_line_t *l = NULL;
+  uint32 w;
+
+  c.clock += 1;
+  if (write)
+    c.stats.writes += 1;
+  else
+    c.stats.reads += 1;
+
+  for (w = 0; w < c.ways; w ++)
+    if (set[w].valid && set[w].tag == line)
+      {
+	l = &set[w];
+	break;
+      }
+  bool hit = (l != NULL);
+
+  if (!hit)
+    {
+      if (write)
+	c.stats.write_misses += 1;
+      else
+	c.stats.read_misses += 1;
+
+      if (write && !c.config.write_allocate)
+	{
+	  if (next != NULL)
+	    access (*next, NULL, addr, true);
+	  return false;
+	}
+
+      l = victim (c, set);
+      if (l->valid && l->dirty)
+	{
+	  c.stats.writebacks += 1;
+	  if (next != NULL)
+	    access (*next, NULL, l->tag << c.line_bits, true);
+	}
+      if (next != NULL)
+	access (*next, NULL, addr, false);
+      *l = cache_line_t {line, true, false, c.clock};
+    }
+  else if (c.config.replacement == CACHE_LRU)
+    l->stamp = c.clock;
+
+  if (write)
+    {
+      if (c.config.write_back)
+	l->dirty = true;
+      else if (next != NULL)
+	access (*next, NULL, addr, true);
+    }
+  return hit;
+}
+
+
+static cache_level_t *
+l2_of (cache_model_t &m)
+{
+  return m.l2.n_sets != 0 ? &m.l2 : NULL;
+}
+
+
+/* The instruction at ADDR is fetched. */
+
+void
+cache_fetch (MIPSImage &img, mem_addr addr)
+{
+  cache_model_t &m = *img.caches();
+
+  cache_site_t *site = text_counts_at (img, m, addr);
+  bool hit = access (m.l1i, l2_of (m), addr, false);
+
+  if (site != NULL)
+    {
+      site->fetches += 1;
+      if (!hit)
+	site->fetch_misses += 1;
+    }
+}
+
+
+/* The instruction at PC loads (or stores to) ADDR. */
+
+void
+cache_data_access (MIPSImage &img, mem_addr addr, bool write)
+{
+  cache_model_t &m = *img.caches();
+  cache_site_t *site = text_counts_at (img, m, img.reg_image().PC);
+  bool hit = access (m.l1d, l2_of (m), addr, write);
+
+  if (site != NULL)
+    {
+      site->data_accesses += 1;
+      if (!hit)
+	site->data_misses += 1;
+    }
+}
+
+
+/* The L1 counts summed over each labeled part of the program, in order
+   of address.  Code before the first label is counted by address. */
+
+std::vector<cache_label_stats_t>
+cache_label_stats (MIPSImage &img)
+{
+  if (img.caches() == NULL)
+    return std::vector<cache_label_stats_t> ();
+
+  return text_counts_by_label<cache_label_stats_t>
+    (img, *img.caches(),
+     [] (const cache_site_t &site) {
+       return site.fetches != 0 || site.data_accesses != 0;
+     },
+     [] (cache_label_stats_t &sum, const cache_site_t &site) {
+       sum.counts.fetches += site.fetches;
+       sum.counts.fetch_misses += site.fetch_misses;
+       sum.counts.data_accesses += site.data_accesses;
+       sum.counts.data_misses += site.data_misses;
+     });
+}
@@ -0,0 +1,104 @@
+#ifndef CACHE_MODEL_H
+#define CACHE_MODEL_H
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "spim.h"
+
+class MIPSImage;
+
+/* A model of a cache hierarchy: split L1 instruction and data caches
+   and an optional unified L2 behind them.  It only watches the
+   addresses that the program fetches, loads, and stores; memory itself
+   is never changed, so a program runs exactly as it does without it.
+
+   A context has no model until cache_attach gives it one.  Until then
+   the CACHE_* hooks in mem.cpp cost a null check. */
+
+enum cache_replacement {
+	CACHE_LRU,
+	CACHE_FIFO,
+	CACHE_RANDOM
+};
+
+typedef struct cache_config {
+	uint32 size = 0;		/* Bytes; 0 => no such cache */
+	uint32 assoc = 1;		/* Ways; 0 => fully associative */
+	uint32 line_size = 32;		/* Bytes */
+	cache_replacement replacement = CACHE_LRU;
+	bool write_back = true;		/* Else write-through */
+	bool write_allocate = true;
+} cache_config_t;
+
+typedef struct cache_hierarchy_config {
+	cache_config_t l1i;
+	cache_config_t l1d;
+	cache_config_t l2;
+} cache_hierarchy_config_t;
+
+typedef struct cache_stats {
+	uint64_t reads = 0;
+	uint64_t read_misses = 0;
+	uint64_t writes = 0;
+	uint64_t write_misses = 0;
+	uint64_t writebacks = 0;	/* Dirty lines evicted */
+} cache_stats_t;
+
+typedef struct cache_line {
+	mem_addr tag;
+	bool valid;
+	bool dirty;
+	uint64_t stamp;			/* Last use (LRU) or fill (FIFO) */
+} cache_line_t;
+
+typedef struct cache_level {
+	cache_config_t config;
+	uint32 n_sets;
+	uint32 ways;
+	int line_bits;			/* log2 (line_size) */
+	std::vector<cache_line_t> lines; /* n_sets * ways, set by set */
+	uint64_t clock;
+	uint32 random_state;
+	cache_stats_t stats;
+} cache_level_t;
+
+/* L1 accesses made by the instruction at one address. */
+
+typedef struct cache_site {
+	uint64_t fetches;
+	uint64_t fetch_misses;
+	uint64_t data_accesses;
+	uint64_t data_misses;
+} cache_site_t;
+
+typedef struct cache_model {
+	cache_level_t l1i;
+	cache_level_t l1d;
+	cache_level_t l2;		/* Unused if its size is 0 */
+	std::vector<cache_site_t> text;	/* By word of text segment */
+	std::vector<cache_site_t> k_text;
+} cache_model_t;
+
+typedef struct cache_label_stats {
+	std::string name;
+	mem_addr addr;
+	cache_site_t counts;
+} cache_label_stats_t;
+
+#define CACHE_FETCH(img, ADDR)						\
+		if (img.caches() != NULL) cache_fetch (img, ADDR)
+#define CACHE_DATA_ACCESS(img, ADDR, WRITE)				\
+		if (img.caches() != NULL) cache_data_access (img, ADDR, WRITE)
+
+bool cache_parse_config (const char *spec, cache_hierarchy_config_t &config,
+			 std::string &problem);
+void cache_attach (MIPSImage &img, const cache_hierarchy_config_t &config);
+void cache_detach (MIPSImage &img);
+void cache_fetch (MIPSImage &img, mem_addr addr);
+void cache_data_access (MIPSImage &img, mem_addr addr, bool write);
+std::vector<cache_label_stats_t> cache_label_stats (MIPSImage &img);
+
+#endif
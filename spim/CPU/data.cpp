@@ -65,7 +65,7 @@ end_of_assembly_file (MIPSImage &img)
 void
 data_begins_at_point (MIPSImage &img, mem_addr addr)
 {
-  if (bare_machine)
+  if (img.assembler().bare_machine)
     img.reg_image().next_data_pc = addr;
   else
     {
@@ -174,7 +174,7 @@ extern_directive (MIPSImage &img, char *name, int size)
 {
   label *sym = make_label_global (img, name);
 
-  if (!bare_machine
+  if (!img.assembler().bare_machine
       && !sym->gp_flag   // Not already a global symbol
       && size > 0 && size <= SMALL_DATA_SEG_MAX_SIZE
       && img.reg_image().next_gp_item_addr + size < img.mem_image().gp_midpoint + 32*K)
@@ -191,7 +191,7 @@ extern_directive (MIPSImage &img, char *name, int size)
 void
 lcomm_directive (MIPSImage &img, char *name, int size)
 {
-  if (!bare_machine
+  if (!img.assembler().bare_machine
       && size > 0 && size <= SMALL_DATA_SEG_MAX_SIZE
       && img.reg_image().next_gp_item_addr + size < img.mem_image().gp_midpoint + 32*K)
     {
@@ -0,0 +1,29 @@
+#ifndef DISASM_H
+#define DISASM_H
+
+#include <string>
+#include <vector>
+
+#include "mem_image.h"
+
+/* One instruction of the text segment, disassembled for display. */
+
+typedef struct disasm_line {
+	mem_addr addr = 0;
+	uint32 encoding = 0;
+	std::string mnemonic;
+	std::string operands;		/* Includes the "[label]" suffix, if any */
+	std::string source;		/* Source line it was assembled from */
+} disasm_line_t;
+
+/* Disassembly of the user and kernel text segments, sorted by address
+   and rebuilt lazily after set_mem_inst() changes a segment. */
+
+typedef struct disasm_cache {
+	std::vector<disasm_line_t> user;
+	std::vector<disasm_line_t> kernel;
+	bool user_valid = false;
+	bool kernel_valid = false;
+} disasm_cache_t;
+
+#endif
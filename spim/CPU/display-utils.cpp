@@ -39,6 +39,9 @@
 #include "mem.h"
 #include "run.h"
 #include "sym-tbl.h"
+#include "inst.h"
+
+#include <algorithm>
 
 
 char* int_reg_names[32] =
@@ -191,6 +194,68 @@ format_insts (MIPSImage &img, str_stream *ss, mem_addr from, mem_addr to)
 }
 
 
+/* Return the cached disassembly of the kernel (if KERNEL) or user text
+   segment, rebuilding it if an instruction was stored since it was last
+   built.  Reads the segment directly so that building the cache does not
+   count as executing the instructions in the profile. */
+
+const std::vector<disasm_line_t> &
+disassembled_segment (MIPSImage &img, bool kernel)
+{
+  disasm_cache_t &cache = img.disassembly ();
+  std::vector<disasm_line_t> &lines = kernel ? cache.kernel : cache.user;
+  bool &valid = kernel ? cache.kernel_valid : cache.user_valid;
+
+  if (!valid)
+    {
+      instruction **seg = kernel ? img.mem_image().k_text_seg : img.mem_image().text_seg;
+      mem_addr bot = kernel ? K_TEXT_BOT : TEXT_BOT;
+      mem_addr top = kernel ? img.mem_image().k_text_top : img.mem_image().text_top;
+
+      lines.clear ();
+      for (mem_addr addr = bot; seg != NULL && addr < top; addr += BYTES_PER_WORD)
+	{
+	  instruction *inst = seg[(addr - bot) >> 2];
+	  if (inst != NULL)
+	    {
+	      lines.emplace_back ();
+	      disassemble_inst (img, inst, addr, &lines.back ());
+	    }
+	}
+      valid = true;
+    }
+
+  return lines;
+}
+
+
+/* Return the records of the disassembled instructions in addresses
+   FROM...TO, as [first, last) indices into disassembled_segment(). */
+
+std::pair<size_t, size_t>
+disassembled_range (MIPSImage &img, mem_addr from, mem_addr to)
+{
+  const std::vector<disasm_line_t> &lines = disassembled_segment (img, from >= K_TEXT_BOT);
+  auto by_addr = [] (const disasm_line_t &line, mem_addr addr) { return line.addr < addr; };
+
+  size_t first = std::lower_bound (lines.begin (), lines.end (), from, by_addr) - lines.begin ();
+  size_t last = std::lower_bound (lines.begin (), lines.end (), to, by_addr) - lines.begin ();
+  return std::make_pair (first, std::max (first, last));
+}
+
+
+/* Drop the cached disassembly of the text segment holding ADDR. */
+
+void
+invalidate_disassembly (MIPSImage &img, mem_addr addr)
+{
+  if (addr >= K_TEXT_BOT)
+    img.disassembly ().kernel_valid = false;
+  else
+    img.disassembly ().user_valid = false;
+}
+
+
 /* Write to the stream a printable representation of the data and stack
    segments. */
 
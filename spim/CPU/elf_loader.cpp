@@ -0,0 +1,345 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "spim.h"
+#include "string-stream.h"
+#include "spim-utils.h"
+#include "inst.h"
+#include "image.h"
+#include "mem.h"
+#include "reg.h"
+#include "sym-tbl.h"
+#include "arena.h"
+#include "elf_loader.h"
+
+
+/* The parts of the ELF32 format that the loader reads.  Fields are read
+   a byte at a time, so the file's layout never has to match the host's. */
+
+#define EI_CLASS	4
+#define EI_DATA		5
+#define ELFCLASS32	1
+#define ELFDATA2LSB	1
+#define ET_EXEC		2
+#define EM_MIPS		8
+
+#define E_TYPE		16	/* Offsets in the file header */
+#define E_MACHINE	18
+#define E_ENTRY		24
+#define E_PHOFF		28
+#define E_SHOFF		32
+#define E_PHENTSIZE	42
+#define E_PHNUM		44
+#define E_SHENTSIZE	46
+#define E_SHNUM		48
+#define ELF_HEADER_SIZE	52
+
+#define PT_LOAD		1
+#define PF_X		1
+
+#define SHT_SYMTAB	2
+#define SHN_UNDEF	0
+#define SHN_ABS		0xfff1
+
+#define STB_LOCAL	0
+#define STT_SECTION	3
+#define STT_FILE	4
+
+#define SYM_SIZE	16
+
+
+static inline uint32
+get16 (const std::string &f, uint32 off)
+{
+  return (unsigned char) f[off] | ((unsigned char) f[off + 1] << 8);
+}
+
+
+static inline uint32
+get32 (const std::string &f, uint32 off)
+{
+  return (get16 (f, off) | (get16 (f, off + 2) << 16));
+}
+
+
+/* Whether the SIZE bytes at OFF are all in the file.  Offsets and sizes
+   come from the file, so the sum is not trusted to fit in 32 bits. */
+
+static inline bool
+in_file (const std::string &f, uint64_t off, uint64_t size)
+{
+  return off <= f.size () && size <= f.size () - off;
+}
+
+
+/* Whether [VADDR, END) lies in the segment that starts at BOT and may
+   grow to LIMIT bytes. */
+
+static inline bool
+in_segment (mem_addr vaddr, uint64_t end, mem_addr bot, uint64_t limit)
+{
+  return vaddr >= bot && end <= bot + limit;
+}
+
+
+/* Decode the words of an executable segment into the text segment.  The
+   segment must be whole words and fit in the text or kernel text segment
+   as far as they may grow. */
+
+static bool
+load_text (MIPSImage &img, const std::string &f, uint32 off, mem_addr vaddr, uint32 size)
+{
+  mem_image_t &mem = img.mem_image();
+  uint64_t end = (uint64_t) vaddr + size;
+  mem_addr limit;
+  uint32 i;
+
+  if ((vaddr & 0x3) != 0 || (size & 0x3) != 0)
+    {
+      error (img, "Executable segment at 0x%08x..0x%08llx is not whole words\n",
+	     vaddr, (unsigned long long) end);
+      return false;
+    }
+  if (in_segment (vaddr, end, TEXT_BOT, mem.text_size_limit))
+    {
+      limit = TEXT_BOT + mem.text_size_limit;
+      if (end > mem.text_top)
+	expand_text (img, MIN (ROUND_UP (end - mem.text_top, 64*K), limit - mem.text_top));
+    }
+  else if (in_segment (vaddr, end, K_TEXT_BOT, mem.k_text_size_limit))
+    {
+      limit = K_TEXT_BOT + mem.k_text_size_limit;
+      if (end > mem.k_text_top)
+	expand_k_text (img, MIN (ROUND_UP (end - mem.k_text_top, 64*K), limit - mem.k_text_top));
+    }
+  else
+    {
+      error (img, "Executable segment at 0x%08x..0x%08llx is not in a text segment\n",
+	     vaddr, (unsigned long long) end);
+      return false;
+    }
+
+  std::vector<int32> words (size / BYTES_PER_WORD);
+  std::vector<instruction *> insts (words.size ());
+  for (i = 0; i < words.size (); i ++)
+    words[i] = get32 (f, off + BYTES_PER_WORD * i);
+  inst_decode_words (img, words.data (), (int) words.size (), insts.data ());
+  for (i = 0; i < words.size (); i ++)
+    set_mem_inst (img, vaddr + BYTES_PER_WORD * i, insts[i]);
+
+  if (vaddr < K_TEXT_BOT)
+    img.reg_image().next_text_pc = MAX (img.reg_image().next_text_pc, (mem_addr) end);
+  else
+    img.reg_image().next_k_text_pc = MAX (img.reg_image().next_k_text_pc, (mem_addr) end);
+  return true;
+}
+
+
+/* Copy the FILE_SIZE bytes of a segment into data memory.  The rest of
+   its MEM_SIZE bytes are zero, which memory already is.  The segment must
+   fit in the data or kernel data segment as far as they may grow. */
+
+static bool
+load_data (MIPSImage &img, const std::string &f, uint32 off, mem_addr vaddr,
+	   uint32 file_size, uint32 mem_size)
+{
+  mem_image_t &mem = img.mem_image();
+  uint64_t end = (uint64_t) vaddr + mem_size;
+  mem_addr limit;
+  uint32 i;
+
+  if (in_segment (vaddr, end, K_DATA_BOT, mem.k_data_size_limit))
+    {
+      limit = K_DATA_BOT + mem.k_data_size_limit;
+      if (end > mem.k_data_top)
+	expand_k_data (img, MIN (ROUND_UP (end - mem.k_data_top, 64*K), limit - mem.k_data_top));
+      img.reg_image().next_k_data_pc = MAX (img.reg_image().next_k_data_pc, (mem_addr) end);
+    }
+  else if (in_segment (vaddr, end, DATA_BOT, mem.data_size_limit))
+    {
+      limit = DATA_BOT + mem.data_size_limit;
+      if (end > mem.data_top)
+	expand_data (img, MIN (ROUND_UP (end - mem.data_top, 64*K), limit - mem.data_top));
+      img.reg_image().next_data_pc = MAX (img.reg_image().next_data_pc, (mem_addr) end);
+    }
+  else
+    {
+      error (img, "Data segment at 0x%08x..0x%08llx is not in a data segment\n",
+	     vaddr, (unsigned long long) end);
+      return false;
+    }
+
+  for (i = 0; i < file_size; )
+    if (((vaddr + i) & 0x3) == 0 && i + BYTES_PER_WORD <= file_size)
+      {
+	set_mem_word (img, vaddr + i, get32 (f, off + i));
+	i += BYTES_PER_WORD;
+      }
+    else
+      {
+	set_mem_byte (img, vaddr + i, (unsigned char) f[off + i]);
+	i += 1;
+      }
+  return true;
+}
+
+
+/* Turn the symbols in the section at SH into labels. */
+
+static void
+load_symbols (MIPSImage &img, const std::string &f, uint32 sh, uint32 shentsize)
+{
+  uint32 off = get32 (f, sh + 16);
+  uint32 size = get32 (f, sh + 20);
+  uint64_t strtab_sh = get32 (f, E_SHOFF) + (uint64_t) get32 (f, sh + 24) * shentsize;
+  uint32 str_off, str_size;
+  uint32 i;
+
+  if (!in_file (f, strtab_sh, 40))
+    return;
+  str_off = get32 (f, strtab_sh + 16);
+  str_size = get32 (f, strtab_sh + 20);
+  if (!in_file (f, off, size) || !in_file (f, str_off, str_size))
+    return;
+
+  for (i = SYM_SIZE; i + SYM_SIZE <= size; i += SYM_SIZE) /* Entry 0 is null */
+    {
+      uint32 s = off + i;
+      uint32 name = get32 (f, s);
+      mem_addr value = get32 (f, s + 4);
+      int info = (unsigned char) f[s + 12];
+      uint32 shndx = get16 (f, s + 14);
+      std::string sym_name;
+      label *l;
+
+      if (name == 0 || name >= str_size || shndx == SHN_UNDEF
+	  || (info & 0xf) == STT_SECTION || (info & 0xf) == STT_FILE)
+	continue;
+      sym_name = f.c_str () + str_off + name;
+
+      if ((info >> 4) == STB_LOCAL)
+	{
+	  /* Static symbols of different objects may share a name, so keep
+	     them out of the table; they still name their addresses. */
+	  l = (label *) arena_zalloc (img, sizeof (label));
+	  l->name = intern_name (img, sym_name.c_str ());
+	  l->addr = value;
+	  l->const_flag = (shndx == SHN_ABS);
+	  if (!l->const_flag && value != 0)
+	    index_label_address (img, l);
+	  continue;
+	}
+
+      l = label_is_defined (img, (char *) sym_name.c_str ());
+      if (l != NULL && SYMBOL_IS_DEFINED (l))
+	{
+	  assembler_error (img, "Warning: ignoring symbol %s, which is already defined\n",
+			   sym_name.c_str ());
+	  continue;
+	}
+
+      make_label_global (img, (char *) sym_name.c_str ());
+      l = record_label (img, (char *) sym_name.c_str (), value, 1);
+      if (shndx == SHN_ABS)
+	l->const_flag = 1;
+    }
+}
+
+
+/* Load the ELF executable in FPATH into IMG.  Return false (after
+   reporting why) if it cannot be read or is not a MIPS executable that
+   fits the simulator's memory. */
+
+bool
+read_elf_file (MIPSImage &img, const char *fpath)
+{
+  FILE *file = fopen (fpath, "rb");
+  std::string f;
+  char buf[4096];
+  size_t n;
+  uint32 phoff, phentsize, phnum, shoff, shentsize, shnum;
+  std::vector<std::pair<uint64_t, uint64_t>> loaded; /* [start, end) of each segment */
+  uint32 i, j;
+
+  if (file == NULL)
+    {
+      error (img, "Cannot open file: `%s'\n", fpath);
+      return false;
+    }
+  while ((n = fread (buf, 1, sizeof (buf), file)) > 0)
+    f.append (buf, n);
+  fclose (file);
+
+  if (f.size () < ELF_HEADER_SIZE || memcmp (f.data (), "\177ELF", 4) != 0
+      || f[EI_CLASS] != ELFCLASS32 || f[EI_DATA] != ELFDATA2LSB
+      || get16 (f, E_TYPE) != ET_EXEC || get16 (f, E_MACHINE) != EM_MIPS)
+    {
+      error (img, "%s is not a little-endian ELF32 MIPS executable\n", fpath);
+      return false;
+    }
+
+  phoff = get32 (f, E_PHOFF);
+  phentsize = get16 (f, E_PHENTSIZE);
+  phnum = get16 (f, E_PHNUM);
+  shoff = get32 (f, E_SHOFF);
+  shentsize = get16 (f, E_SHENTSIZE);
+  shnum = get16 (f, E_SHNUM);
+
+  for (i = 0; i < phnum; i ++)
+    {
+      uint64_t ph = phoff + (uint64_t) i * phentsize;
+      uint32 off, vaddr, file_size, mem_size, flags;
+
+      if (!in_file (f, ph, 32))
+	{
+	  error (img, "%s: program header %d is truncated\n", fpath, i);
+	  return false;
+	}
+      if (get32 (f, ph) != PT_LOAD)
+	continue;
+      off = get32 (f, ph + 4);
+      vaddr = get32 (f, ph + 8);
+      file_size = get32 (f, ph + 16);
+      mem_size = get32 (f, ph + 20);
+      flags = get32 (f, ph + 24);
+      if (!in_file (f, off, file_size) || file_size > mem_size)
+	{
+	  error (img, "%s: segment %d is truncated\n", fpath, i);
+	  return false;
+	}
+
+      for (j = 0; j < loaded.size (); j ++)
+	if (vaddr < loaded[j].second && loaded[j].first < (uint64_t) vaddr + mem_size)
+	  {
+	    error (img, "%s: segment %d overlaps an earlier segment\n", fpath, i);
+	    return false;
+	  }
+      loaded.push_back (std::make_pair ((uint64_t) vaddr, (uint64_t) vaddr + mem_size));
+
+      if ((flags & PF_X)
+	  ? !load_text (img, f, off, vaddr, file_size)
+	  : !load_data (img, f, off, vaddr, file_size, mem_size))
+	return false;
+    }
+
+  for (i = 0; i < shnum; i ++)
+    {
+      uint64_t sh = shoff + (uint64_t) i * shentsize;
+
+      if (in_file (f, sh, 40) && get32 (f, sh + 4) == SHT_SYMTAB)
+	load_symbols (img, f, sh, shentsize);
+    }
+
+  /* Without an exception handler to call main, start at the entry point. */
+  label *start = label_is_defined (img, DEFAULT_RUN_LOCATION);
+  if (start == NULL || !SYMBOL_IS_DEFINED (start))
+    {
+      make_label_global (img, DEFAULT_RUN_LOCATION);
+      record_label (img, DEFAULT_RUN_LOCATION, get32 (f, E_ENTRY), 1);
+    }
+
+  return true;
+}
@@ -0,0 +1,13 @@
+#ifndef ELF_LOADER_H
+#define ELF_LOADER_H
+
+class MIPSImage;
+
+/* Load little-endian ELF32 MIPS executables straight into an image,
+   without the assembler: executable segments are decoded into the text
+   segments, other segments are copied into data, and the symbol table
+   becomes labels. */
+
+bool read_elf_file (MIPSImage &img, const char *fpath);
+
+#endif
@@ -0,0 +1,357 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "spim.h"
+#include "image.h"
+#include "reg.h"
+#include "exec_trace.h"
+
+
+#define TRACE_FLUSH_SIZE (64 * K)	/* Write a file trace in pieces this big */
+
+
+static void
+put_varint (std::string &out, uint64_t v)
+{
+  while (v >= 0x80)
+    {
+      out += (char) (v | 0x80);
+      v >>= 7;
+    }
+  out += (char) v;
+}
+
+
+static inline uint32
+zigzag (int32 v)
+{
+  return ((uint32) v << 1) ^ (uint32) (v >> 31);
+}
+
+
+static inline int32
+unzigzag (uint32 v)
+{
+  return (int32) (v >> 1) ^ -(int32) (v & 1);
+}
+
+
+static void
+snapshot_regs (MIPSImage &img, reg_word *regs)
+{
+  reg_image_t &reg = img.reg_image();
+  int i;
+
+  memcpy (regs, reg.R, R_LENGTH * sizeof (reg_word));
+  regs[TRACE_HI] = reg.HI;
+  regs[TRACE_LO] = reg.LO;
+  for (i = 0; i < 32; i ++)
+    regs[TRACE_FPR + i] = reg.FWR != NULL ? reg.FWR[i] : 0;
+  regs[TRACE_EPC] = reg.CP0_EPC;
+  regs[TRACE_CAUSE] = reg.CP0_Cause;
+  regs[TRACE_STATUS] = reg.CP0_Status;
+  regs[TRACE_BADVADDR] = reg.CP0_BadVAddr;
+  regs[TRACE_FCSR] = reg.FCSR;
+}
+
+
+/* Start recording IMG's execution from where it is now, into the file
+   PATH or, if PATH is empty, into memory.  Return false (after
+   reporting why) if the file cannot be written. */
+
+bool
+trace_start (MIPSImage &img, const char *path)
+{
+  std::unique_ptr<exec_trace_t> t (new exec_trace_t ());
+  int i;
+
+  if (path != NULL && *path != '\0')
+    {
+      t->file = fopen (path, "wb");
+      if (t->file == NULL)
+	{
+	  error (img, "Cannot open trace file: `%s'\n", path);
+	  return false;
+	}
+    }
+
+  snapshot_regs (img, t->regs);
+  t->next_pc = img.reg_image().PC;
+  t->data = TRACE_MAGIC;
+  put_varint (t->data, (uint64_t) img.get_ctx());
+  put_varint (t->data, t->next_pc);
+  for (i = 0; i < TRACE_N_REGS; i ++)
+    put_varint (t->data, zigzag (t->regs[i]));
+  img.set_tracer (std::move (t));
+  return true;
+}
+
+
+/* Stop recording.  Return the trace if it was kept in memory. */
+
+std::string
+trace_stop (MIPSImage &img)
+{
+  std::string data;
+
+  if (img.tracer() == NULL)
+    return data;
+  img.tracer()->data += (char) TRACE_END;
+  if (img.tracer()->file == NULL)
+    data = std::move (img.tracer()->data);
+  img.set_tracer (nullptr);	/* Writes the rest of a file */
+  return data;
+}
+
+
+/* The instruction at PC has executed. */
+
+void
+trace_step (MIPSImage &img, mem_addr pc)
+{
+  exec_trace_t &t = *img.tracer();
+  reg_word now[TRACE_N_REGS];
+  int changed[TRACE_N_REGS];
+  int n_changed = 0, i;
+
+  if (img.reg_image().exception_occurred)
+    t.stores.clear ();		/* The access that raised it did not happen */
+
+  snapshot_regs (img, now);
+  for (i = 0; i < TRACE_N_REGS; i ++)
+    if (now[i] != t.regs[i])
+      changed[n_changed++] = i;
+
+  int n_stores = (int) t.stores.size ();
+  t.data += (char) ((pc != t.next_pc ? 1 : 0)
+		    | (MIN (n_changed, 7) << 1)
+		    | (MIN (n_stores, 7) << 4));
+  if (pc != t.next_pc)
+    put_varint (t.data, zigzag ((int32) (pc - t.next_pc)));
+
+  if (n_changed >= 7)
+    put_varint (t.data, n_changed);
+  for (i = 0; i < n_changed; i ++)
+    {
+      int r = changed[i];
+
+      t.data += (char) r;
+      put_varint (t.data, zigzag ((int32) ((uint32) now[r] - (uint32) t.regs[r])));
+      t.regs[r] = now[r];
+    }
+
+  if (n_stores >= 7)
+    put_varint (t.data, n_stores);
+  for (const trace_store_t &s : t.stores)
+    {
+      put_varint (t.data, zigzag ((int32) (s.addr - t.last_addr)));
+      put_varint (t.data, s.bytes.size ());
+      t.data += s.bytes;
+      t.last_addr = s.addr + (mem_addr) s.bytes.size ();
+    }
+  t.stores.clear ();
+
+  t.next_pc = pc + BYTES_PER_WORD;
+  t.steps += 1;
+  if (t.file != NULL && t.data.size () >= TRACE_FLUSH_SIZE)
+    {
+      fwrite (t.data.data (), 1, t.data.size (), t.file);
+      t.data.clear ();
+    }
+}
+
+
+/* The low SIZE bytes of VALUE were stored at ADDR. */
+
+void
+trace_store (MIPSImage &img, mem_addr addr, int size, reg_word value)
+{
+  char bytes[4];
+  int i;
+
+  for (i = 0; i < size; i ++)
+    bytes[i] = (char) ((uint32) value >> (8 * i)); /* Little-endian */
+  img.tracer()->stores.push_back (trace_store_t {addr, std::string (bytes, size)});
+}
+
+
+/* The N bytes at ADDR were written behind the set_mem_* functions' back;
+   they are now BYTES. */
+
+void
+trace_store_bytes (MIPSImage &img, mem_addr addr, int n, const void *bytes)
+{
+  img.tracer()->stores.push_back (trace_store_t {addr, std::string ((const char *) bytes, n)});
+}
+
+
+static bool
+get_varint (trace_reader_t &r, uint64_t &v)
+{
+  int shift;
+
+  v = 0;
+  for (shift = 0; shift < 64; shift += 7)
+    {
+      if (r.pos >= r.data->size ())
+	return false;
+      unsigned char b = (unsigned char) (*r.data)[r.pos++];
+      v |= (uint64_t) (b & 0x7f) << shift;
+      if (!(b & 0x80))
+	return true;
+    }
+  return false;
+}
+
+
+static bool
+get_signed (trace_reader_t &r, int32 &v)
+{
+  uint64_t u;
+
+  if (!get_varint (r, u))
+    return false;
+  v = unzigzag ((uint32) u);
+  return true;
+}
+
+
+/* Start reading the trace in DATA, which must outlive R.  Return false
+   if it is not a trace. */
+
+bool
+trace_open (trace_reader_t &r, const std::string &data)
+{
+  uint64_t v;
+  int32 reg;
+  int i;
+
+  memset (&r, 0, sizeof (r));
+  r.data = &data;
+  r.pos = strlen (TRACE_MAGIC);
+  r.error = true;
+  if (data.compare (0, r.pos, TRACE_MAGIC) != 0)
+    return false;
+
+  if (!get_varint (r, v))
+    return false;
+  r.ctx = (int) v;
+  if (!get_varint (r, v))
+    return false;
+  r.next_pc = (mem_addr) v;
+  for (i = 0; i < TRACE_N_REGS; i ++)
+    {
+      if (!get_signed (r, reg))
+	return false;
+      r.regs[i] = reg;
+    }
+  r.error = false;
+  return true;
+}
+
+
+/* Read the next step into STEP and apply its register changes to R.
+   Return false at the end of the trace, or if it is malformed (which
+   sets R.error).  A trace that stops between steps, e.g. one still
+   being recorded, simply ends. */
+
+bool
+trace_next (trace_reader_t &r, trace_step_t &step)
+{
+  uint64_t n, len;
+  int32 delta;
+  int tag;
+
+  step.regs.clear ();
+  step.stores.clear ();
+  if (r.error || r.pos >= r.data->size ())
+    return false;
+  tag = (unsigned char) (*r.data)[r.pos++];
+  if (tag == TRACE_END)
+    return false;
+  r.error = true;
+  if (tag & 0x80)
+    return false;
+
+  step.pc = r.next_pc;
+  if (tag & 1)
+    {
+      if (!get_signed (r, delta))
+	return false;
+      step.pc += delta;
+    }
+
+  n = (tag >> 1) & 7;
+  if (n == 7 && !get_varint (r, n))
+    return false;
+  for (; n > 0; n --)
+    {
+      if (r.pos >= r.data->size ())
+	return false;
+      int reg = (unsigned char) (*r.data)[r.pos++];
+      if (reg >= TRACE_N_REGS || !get_signed (r, delta))
+	return false;
+      r.regs[reg] = (reg_word) ((uint32) r.regs[reg] + (uint32) delta);
+      step.regs.push_back ({reg, r.regs[reg]});
+    }
+
+  n = (tag >> 4) & 7;
+  if (n == 7 && !get_varint (r, n))
+    return false;
+  for (; n > 0; n --)
+    {
+      if (!get_signed (r, delta) || !get_varint (r, len)
+	  || len > r.data->size () - r.pos)
+	return false;
+      mem_addr addr = r.last_addr + delta;
+      step.stores.push_back (trace_store_t {addr, r.data->substr (r.pos, len)});
+      r.pos += len;
+      r.last_addr = addr + (mem_addr) len;
+    }
+
+  r.pc = step.pc;
+  r.next_pc = step.pc + BYTES_PER_WORD;
+  r.steps += 1;
+  r.error = false;
+  return true;
+}
+
+
+/* The name of traced register REG. */
+
+const char *
+trace_reg_name (int reg)
+{
+  static const char *gpr[32] = {
+    "$0", "$at", "$v0", "$v1", "$a0", "$a1", "$a2", "$a3",
+    "$t0", "$t1", "$t2", "$t3", "$t4", "$t5", "$t6", "$t7",
+    "$s0", "$s1", "$s2", "$s3", "$s4", "$s5", "$s6", "$s7",
+    "$t8", "$t9", "$k0", "$k1", "$gp", "$sp", "$fp", "$ra"
+  };
+  static const char *fpr[32] = {
+    "$f0", "$f1", "$f2", "$f3", "$f4", "$f5", "$f6", "$f7",
+    "$f8", "$f9", "$f10", "$f11", "$f12", "$f13", "$f14", "$f15",
+    "$f16", "$f17", "$f18", "$f19", "$f20", "$f21", "$f22", "$f23",
+    "$f24", "$f25", "$f26", "$f27", "$f28", "$f29", "$f30", "$f31"
+  };
+
+  if (reg >= 0 && reg < 32)
+    return gpr[reg];
+  if (reg >= TRACE_FPR && reg < TRACE_FPR + 32)
+    return fpr[reg - TRACE_FPR];
+  switch (reg)
+    {
+    case TRACE_HI: return "hi";
+    case TRACE_LO: return "lo";
+    case TRACE_EPC: return "epc";
+    case TRACE_CAUSE: return "cause";
+    case TRACE_STATUS: return "status";
+    case TRACE_BADVADDR: return "badvaddr";
+    case TRACE_FCSR: return "fcsr";
+    default: return "?";
+    }
+}
@@ -0,0 +1,111 @@
+#ifndef EXEC_TRACE_H
+#define EXEC_TRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "spim.h"
+#include "reg_image.h"
+
+class MIPSImage;
+
+/* An execution trace: every instruction a context executes, with the
+   registers it changed and the memory it wrote, in a compact binary
+   form that can be inspected or replayed without simulating again.
+
+   The trace starts with the magic "SPIMTRC1", the context, the PC, and
+   the value of every traced register.  Each step is then a tag byte
+   followed by what it announces:
+
+     bit 0     the PC is not the last PC + 4: zigzag varint difference
+     bits 1-3  registers changed (7 => a varint count follows); each is
+	       a byte naming it and the zigzag varint of new - old
+     bits 4-6  memory writes (7 => a varint count follows); each is the
+	       zigzag varint of its address less the end of the last
+	       write, a varint length, and the bytes written
+
+   A tag of TRACE_END ends the trace.  Registers are numbered as in
+   trace_reg_name.
+
+   With delayed branches, a branch is recorded after the instruction in
+   its delay slot, and an exception's changes to CP0 are recorded with
+   the first instruction of the handler. */
+
+#define TRACE_MAGIC "SPIMTRC1"
+#define TRACE_END 0x80
+
+#define TRACE_HI 32
+#define TRACE_LO 33
+#define TRACE_FPR 34			/* 32 single-precision registers */
+#define TRACE_EPC 66
+#define TRACE_CAUSE 67
+#define TRACE_STATUS 68
+#define TRACE_BADVADDR 69
+#define TRACE_FCSR 70
+#define TRACE_N_REGS 71
+
+typedef struct trace_store {
+	mem_addr addr;
+	std::string bytes;
+} trace_store_t;
+
+typedef struct exec_trace {
+	FILE *file = NULL;		/* NULL => kept in data */
+	std::string data;		/* Encoded but not yet in file */
+	uint64_t steps = 0;
+	mem_addr next_pc = 0;		/* Of a step that does not branch */
+	mem_addr last_addr = 0;		/* End of the last write */
+	reg_word regs[TRACE_N_REGS] = {}; /* As of the last step */
+	std::vector<trace_store_t> stores; /* Since the last step */
+
+	~exec_trace() {
+		if (file) {
+			fwrite(data.data(), 1, data.size(), file);
+			fclose(file);
+		}
+	}
+} exec_trace_t;
+
+/* A trace being read back.  REGS holds every register's value after
+   the step last read. */
+
+typedef struct trace_reader {
+	const std::string *data;
+	size_t pos;
+	int ctx;
+	mem_addr pc;
+	mem_addr next_pc;
+	mem_addr last_addr;
+	reg_word regs[TRACE_N_REGS];
+	uint64_t steps;
+	bool error;			/* => The trace is malformed */
+} trace_reader_t;
+
+typedef struct trace_step {
+	mem_addr pc;
+	std::vector<std::pair<int, reg_word>> regs; /* New values */
+	std::vector<trace_store_t> stores;
+} trace_step_t;
+
+#define TRACE_STEP(img, PC)						\
+		if (img.tracer() != NULL) trace_step (img, PC)
+#define TRACE_STORE(img, ADDR, SIZE, VALUE)				\
+		if (img.tracer() != NULL) trace_store (img, ADDR, SIZE, VALUE)
+#define TRACE_STORE_BYTES(img, ADDR, N, BYTES)				\
+		if (img.tracer() != NULL) trace_store_bytes (img, ADDR, N, BYTES)
+
+bool trace_start (MIPSImage &img, const char *path);
+std::string trace_stop (MIPSImage &img);
+void trace_step (MIPSImage &img, mem_addr pc);
+void trace_store (MIPSImage &img, mem_addr addr, int size, reg_word value);
+void trace_store_bytes (MIPSImage &img, mem_addr addr, int n, const void *bytes);
+
+bool trace_open (trace_reader_t &r, const std::string &data);
+bool trace_next (trace_reader_t &r, trace_step_t &step);
+const char *trace_reg_name (int reg);
+
+#endif
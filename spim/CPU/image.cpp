@@ -11,7 +11,8 @@ MIPSImage::MIPSImage(int ctx) :
     std_out(ctx, std::cout),
     std_err(ctx, std::cerr)
 {
-    label_hash_table = (label **) zmalloc(*this, LABEL_HASH_TABLE_SIZE * sizeof(label *));
+    asm_state.bare_machine = bare_machine;
+    asm_state.accept_pseudo_insts = accept_pseudo_insts;
 }
 
 MIPSImage::~MIPSImage() {
@@ -24,8 +25,20 @@ MIPSImage::MIPSImage(MIPSImage &&other) :
     reg_img(std::move(other.reg_img)),
     bkpt_map(std::move(other.bkpt_map)),
     local_labels(other.local_labels),
-    label_hash_table(other.label_hash_table),
-    labels_to_free(std::move(other.labels_to_free)),
+    sym_table(std::move(other.sym_table)),
+    arena_mem(other.arena_mem),
+    source_tbl(std::move(other.source_tbl)),
+    input_q(std::move(other.input_q)),
+    vfs_state(std::move(other.vfs_state)),
+    prof(std::move(other.prof)),
+    mix(std::move(other.mix)),
+    cache(std::move(other.cache)),
+    bpred(std::move(other.bpred)),
+    pipe(std::move(other.pipe)),
+    trace(std::move(other.trace)),
+    heat(std::move(other.heat)),
+    disasm_cache(std::move(other.disasm_cache)),
+    asm_state(std::move(other.asm_state)),
     std_out(std::move(other.std_out)),
     std_err(std::move(other.std_err))
 {
@@ -33,8 +46,15 @@ MIPSImage::MIPSImage(MIPSImage &&other) :
     other.reg_img = {};
     other.bkpt_map.clear();
     other.local_labels = NULL;
-    other.label_hash_table = NULL;
-    other.labels_to_free.clear();
+    other.sym_table = {};
+    other.arena_mem = {};
+    other.source_tbl = {};
+    other.input_q = {};
+    other.vfs_state = {};
+    other.prof = {};
+    other.mix = {};
+    other.disasm_cache = {};
+    other.asm_state = {};
 }
 
 MIPSImage &MIPSImage::operator=(MIPSImage &&other) {
@@ -44,28 +64,45 @@ MIPSImage &MIPSImage::operator=(MIPSImage &&other) {
     reg_img = std::move(other.reg_img);
     bkpt_map = std::move(other.bkpt_map);
     local_labels = other.local_labels;
-    label_hash_table = other.label_hash_table;
-    labels_to_free = std::move(other.labels_to_free);
+    sym_table = std::move(other.sym_table);
+    arena_mem = other.arena_mem;
+    source_tbl = std::move(other.source_tbl);
+    input_q = std::move(other.input_q);
+    vfs_state = std::move(other.vfs_state);
+    prof = std::move(other.prof);
+    mix = std::move(other.mix);
+    cache = std::move(other.cache);
+    bpred = std::move(other.bpred);
+    pipe = std::move(other.pipe);
+    trace = std::move(other.trace);
+    heat = std::move(other.heat);
+    disasm_cache = std::move(other.disasm_cache);
+    asm_state = std::move(other.asm_state);
     std_out = std::move(other.std_out);
     std_err = std::move(other.std_err);
 
     other.mem_img = {};
     other.reg_img = {};
     other.local_labels = NULL;
-    other.label_hash_table = NULL;
-    other.labels_to_free.clear();
+    other.sym_table = {};
+    other.arena_mem = {};
+    other.source_tbl = {};
+    other.input_q = {};
+    other.vfs_state = {};
+    other.prof = {};
+    other.mix = {};
+    other.disasm_cache = {};
+    other.asm_state = {};
 
     return *this;
 }
 
 void MIPSImage::free_internals() {
     initialize_symbol_table(*this);
-    for (auto it = labels_to_free.begin(); it != labels_to_free.end(); it ++) {
-        free((*it)->name);
-        free(*it);
-    }
-    if (label_hash_table)
-        free(label_hash_table);
+    if (sym_table.slots)
+        free(sym_table.slots);
+    sym_table = {};
+    arena_release(arena_mem);
 }
 
 int MIPSImage::get_ctx() const {
@@ -80,12 +117,8 @@ reg_image_t &MIPSImage::reg_image() {
     return reg_img;
 }
 
-label **MIPSImage::get_label_hash_table() {
-    return label_hash_table;
-}
-
-void MIPSImage::push_label_to_free_vector(label *label) {
-    labels_to_free.push_back(label);
+sym_table_t &MIPSImage::symbol_table() {
+    return sym_table;
 }
 
 label *MIPSImage::get_local_labels() {
@@ -108,10 +141,81 @@ std::unordered_map<mem_addr, breakpoint> &MIPSImage::breakpoints() {
     return bkpt_map;
 }
 
-std::streambuf *MIPSImage::get_std_out_buf() {
+disasm_cache_t &MIPSImage::disassembly() {
+    return disasm_cache;
+}
+
+assembler_t &MIPSImage::assembler() {
+    return asm_state;
+}
+
+arena_t &MIPSImage::arena() {
+    return arena_mem;
+}
+
+source_table_t &MIPSImage::source_table() {
+    return source_tbl;
+}
+
+input_queue_t &MIPSImage::input_queue() {
+    return input_q;
+}
+
+vfs_t &MIPSImage::vfs() {
+    return vfs_state;
+}
+
+profile_t &MIPSImage::profile() {
+    return prof;
+}
+
+inst_mix_t &MIPSImage::inst_mix() {
+    return mix;
+}
+
+void MIPSImage::set_caches(std::unique_ptr<cache_model_t> model) {
+    cache = std::move(model);
+}
+
+void MIPSImage::set_branch_predictor(std::unique_ptr<branch_predictor_t> bp) {
+    bpred = std::move(bp);
+}
+
+void MIPSImage::set_pipeline(std::unique_ptr<pipeline_t> pl) {
+    pipe = std::move(pl);
+}
+
+void MIPSImage::set_tracer(std::unique_ptr<exec_trace_t> t) {
+    trace = std::move(t);
+}
+
+void MIPSImage::set_heatmap(std::unique_ptr<mem_heatmap_t> h) {
+    heat = std::move(h);
+}
+
+MIPSImagePrintStream *MIPSImage::get_std_out_buf() {
     return &std_out;
 }
 
-std::streambuf *MIPSImage::get_std_err_buf() {
+MIPSImagePrintStream *MIPSImage::get_std_err_buf() {
     return &std_err;
 }
+
+void MIPSImage::flush_output() {
+    std_out.pubsync();
+    std_err.pubsync();
+}
+
+void MIPSImage::flush_output_if_due() {
+    std_out.flush_if_due();
+    std_err.flush_if_due();
+}
+
+void MIPSImage::capture_output(std::size_t capacity, bool stop_when_full) {
+    std_out.capture_to(std::make_unique<OutputCapture>(capacity, stop_when_full));
+    std_err.capture_to(std::make_unique<OutputCapture>(capacity, stop_when_full));
+}
+
+bool MIPSImage::output_limit_exceeded() const {
+    return std_out.capture_overrun() || std_err.capture_overrun();
+}
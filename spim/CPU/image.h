@@ -3,13 +3,25 @@
 
 #include <unordered_map>
 #include <optional>
+#include <memory>
 
 #include "image_print_stream.h"
 #include "mem_image.h"
 #include "reg_image.h"
 #include "label.h"
-
-#define LABEL_HASH_TABLE_SIZE 8191
+#include "disasm.h"
+#include "assembler.h"
+#include "arena.h"
+#include "source_table.h"
+#include "input_queue.h"
+#include "vfs.h"
+#include "profiler.h"
+#include "inst_mix.h"
+#include "cache_model.h"
+#include "branch_predictor.h"
+#include "pipeline_model.h"
+#include "exec_trace.h"
+#include "mem_heatmap.h"
 
 #define NUM_CONTEXTS 2
 
@@ -31,8 +43,22 @@ class MIPSImage {
     std::unordered_map<mem_addr, breakpoint> bkpt_map;
     // std::unordered_map<mem_addr, label> labels;
     label *local_labels = NULL; // No allocs occur here
-    label **label_hash_table = NULL; // Points to an array of size LABEL_HASH_TABLE_SIZE
-    std::vector<label *> labels_to_free;
+    sym_table_t sym_table;
+
+    arena_t arena_mem; // Instructions, expressions and labels
+    source_table_t source_tbl;
+    input_queue_t input_q;
+    vfs_t vfs_state;
+    profile_t prof;
+    inst_mix_t mix;
+    std::unique_ptr<cache_model_t> cache; // Null unless a cache model is attached
+    std::unique_ptr<branch_predictor_t> bpred; // Null unless a predictor is attached
+    std::unique_ptr<pipeline_t> pipe; // Null unless a timing model is attached
+    std::unique_ptr<exec_trace_t> trace; // Null unless execution is being recorded
+    std::unique_ptr<mem_heatmap_t> heat; // Null unless memory accesses are being counted
+
+    disasm_cache_t disasm_cache;
+    assembler_t asm_state;
 
     MIPSImagePrintStream std_out;
     MIPSImagePrintStream std_err;
@@ -51,13 +77,31 @@ class MIPSImage {
 
     mem_image_t &mem_image();
     reg_image_t &reg_image();
-    label **get_label_hash_table();
+    sym_table_t &symbol_table();
     label *get_local_labels();
-    void push_label_to_free_vector(label *);
     void set_local_labels(label *);
     const mem_image_t &memview_image() const;
     const reg_image_t &regview_image() const;
     std::unordered_map<mem_addr, breakpoint> &breakpoints();
+    disasm_cache_t &disassembly();
+    assembler_t &assembler();
+    arena_t &arena();
+    source_table_t &source_table();
+    input_queue_t &input_queue();
+    vfs_t &vfs();
+    profile_t &profile();
+    inst_mix_t &inst_mix();
+    // Inline, since every instruction, memory access, or branch checks them
+    cache_model_t *caches() { return cache.get(); }
+    void set_caches(std::unique_ptr<cache_model_t> model);
+    branch_predictor_t *branch_predictor() { return bpred.get(); }
+    void set_branch_predictor(std::unique_ptr<branch_predictor_t> bp);
+    pipeline_t *pipeline() { return pipe.get(); }
+    void set_pipeline(std::unique_ptr<pipeline_t> pl);
+    exec_trace_t *tracer() { return trace.get(); }
+    void set_tracer(std::unique_ptr<exec_trace_t> t);
+    mem_heatmap_t *heatmap() { return heat.get(); }
+    void set_heatmap(std::unique_ptr<mem_heatmap_t> h);
 
     /**
      * @brief Override this method to implement custom memory read word behavior
@@ -105,8 +149,16 @@ class MIPSImage {
     virtual bool custom_memory_write_byte(mem_addr, mem_word) { return false; }
 
 
-    std::streambuf *get_std_out_buf();
-    std::streambuf *get_std_err_buf();
+    MIPSImagePrintStream *get_std_out_buf();
+    MIPSImagePrintStream *get_std_err_buf();
+
+    // Post buffered stdout/stderr now, or only if it has waited a frame
+    void flush_output();
+    void flush_output_if_due();
+
+    // Keep stdout/stderr in bounded captures instead of printing them (see OutputCapture)
+    void capture_output(std::size_t capacity, bool stop_when_full);
+    bool output_limit_exceeded() const;
 };
 
 #define DATA_PC(img) (img.reg_image().in_kernel ? img.reg_image().next_k_data_pc : img.reg_image().next_data_pc)
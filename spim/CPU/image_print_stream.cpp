@@ -1,8 +1,9 @@
 #include "image_print_stream.h"
 
+#include <stdlib.h>
 #include <string.h>
-#include <cassert>
-#include <functional>
+#include <algorithm>
+#include <memory>
 
 #ifdef WASM
 #include "emscripten.h"
@@ -11,7 +12,8 @@
 MIPSImagePrintStream::MIPSImagePrintStream(unsigned int ctx, std::ostream &sink, std::size_t buffer_size) :
     ctx(ctx),
     sink(&sink),
-    buf(buffer_size + 1)
+    buf(buffer_size + 1),
+    last_post()
 {
     char *base = &buf.front();
     setp(base, base + buf.size() - 1);
@@ -24,7 +26,9 @@ MIPSImagePrintStream::~MIPSImagePrintStream() {
 MIPSImagePrintStream::MIPSImagePrintStream(MIPSImagePrintStream &&other) :
     ctx(other.ctx),
     sink(other.sink),
-    buf(std::move(other.buf))
+    buf(std::move(other.buf)),
+    last_post(other.last_post),
+    capture(std::move(other.capture))
 {
     char *base = &buf.front();
     setp(base, base + buf.size() - 1);
@@ -36,6 +40,8 @@ MIPSImagePrintStream& MIPSImagePrintStream::operator=(MIPSImagePrintStream &&oth
     ctx = other.ctx;
     sink = other.sink;
     buf = std::move(other.buf);
+    last_post = other.last_post;
+    capture = std::move(other.capture);
 
     char *base = &buf.front();
     setp(base, base + buf.size() - 1);
@@ -51,55 +57,142 @@ inline void MIPSImagePrintStream::move_buffer_pointers(MIPSImagePrintStream &&ot
 }
 
 std::streamsize MIPSImagePrintStream::xsputn(const char *s, std::streamsize n) {
-    std::streamsize char_pos = 0;
-    while (char_pos < n) {
-        if (overflow(MIPSImagePrintStream::traits_type::to_int_type(*s)) == MIPSImagePrintStream::traits_type::eof()) {
-            break;
+    if (capture) {
+        post();
+        capture->write(s, n);
+        return n;
+    }
+
+    std::streamsize written = 0;
+    bool ends_line = false;
+    while (written < n) {
+        std::streamsize room = epptr() - pptr();
+        if (room == 0) {
+            if (post() != 0) {
+                break;
+            }
+            continue;
+        }
+        std::streamsize chunk = std::min(room, n - written);
+        memcpy(pptr(), s + written, chunk);
+        ends_line = ends_line || memchr(s + written, '\n', chunk) != nullptr;
+        pbump((int) chunk);
+        written += chunk;
+    }
+
+    maybe_post(ends_line);
+    return written;
+}
+
+std::streamsize MIPSImagePrintStream::vprintf(const char *fmt, va_list args) {
+    va_list retry;
+    va_copy(retry, args);
+    std::streamsize room = epptr() - pptr();
+    // The spare byte past epptr() takes vsnprintf's '\0'
+    int n = vsnprintf(pptr(), room + 1, fmt, args);
+    if (n > room) {
+        if (n <= epptr() - pbase() && post() == 0) {
+            n = vsnprintf(pptr(), n + 1, fmt, retry);
+        } else {
+            std::unique_ptr<char[]> s(new char[n + 1]);
+            vsnprintf(s.get(), n + 1, fmt, retry);
+            n = (int) xsputn(s.get(), n);
+            va_end(retry);
+            return n;
         }
-        char_pos++;
-        s++;
     }
-    return char_pos;
+    va_end(retry);
+    if (n <= 0) {
+        return 0;
+    }
+
+    bool ends_line = memchr(pptr(), '\n', n) != nullptr;
+    pbump(n);
+    maybe_post(ends_line);
+    return n;
+}
+
+// A full buffer goes out now; a finished line waits for the next frame
+void MIPSImagePrintStream::maybe_post(bool ends_line) {
+    if (pptr() == epptr() || (ends_line && post_is_due())) {
+        post();
+    }
 }
 
 MIPSImagePrintStream::int_type MIPSImagePrintStream::overflow(MIPSImagePrintStream::int_type ch) {
-    if (ch != traits_type::eof()) {
-        assert(std::less_equal<char *>()(pptr(), epptr()));
-        *pptr() = ch;
+    // Only called when the buffer is full; the extra byte past epptr() holds ch
+    if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(ch);
         pbump(1);
+    }
+    if (post() != 0) {
+        return traits_type::eof();
+    }
+    return traits_type::not_eof(ch);
+}
 
-        // If ch is newline ('\n') or buffer is now full, flush
-        if ((ch != '\n' && pptr() < epptr()) || !sync()) {
-            return ch;
-        }
+int MIPSImagePrintStream::sync() {
+    return post();
+}
+
+void MIPSImagePrintStream::flush_if_due() {
+    if (pptr() != pbase() && post_is_due()) {
+        post();
     }
+}
 
-    return traits_type::eof();
+void MIPSImagePrintStream::capture_to(std::unique_ptr<OutputCapture> capture) {
+    post();
+    this->capture = std::move(capture);
 }
 
-int MIPSImagePrintStream::sync() {
+OutputCapture *MIPSImagePrintStream::captured() {
+    if (capture) {
+        post();
+    }
+    return capture.get();
+}
+
+bool MIPSImagePrintStream::capture_overrun() const {
+    return capture && capture->stops_when_full()
+        && capture->total() + (pptr() - pbase()) > capture->capacity();
+}
+
+bool MIPSImagePrintStream::post_is_due() const {
+    return std::chrono::steady_clock::now() - last_post >= FRAME_INTERVAL;
+}
+
+int MIPSImagePrintStream::post() {
     std::ptrdiff_t n = pptr() - pbase();
     pbump(-n);
     if (!n) {
         return 0;
     }
+    if (capture) {
+        capture->write(pbase(), n);
+        return 0;
+    }
+    last_post = std::chrono::steady_clock::now();
 #ifdef WASM
-    char *s = new char[n + 1];
-    strncpy(s, pbase(), n);
+    // Freed by the main thread once it has copied the message
+    char *s = (char *) malloc(n + 1);
+    memcpy(s, pbase(), n);
     s[n] = 0;
     if (sink == &std::cout) {
         MAIN_THREAD_ASYNC_EM_ASM({
             writeStdOut($0, UTF8ToString($1));
+            _free($1);
         }, ctx, s);
         return 0;
     }
     if (sink == &std::cerr) {
         MAIN_THREAD_ASYNC_EM_ASM({
             writeStdErr($0, UTF8ToString($1));
+            _free($1);
         }, ctx, s);
         return 0;
     }
-    delete[] s;
+    free(s);
     return -1;
 #else
     return !((bool) sink->write(pbase(), n));
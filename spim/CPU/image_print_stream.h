@@ -3,10 +3,15 @@
 #define IMAGE_PRINT_STREAM_H
 
 #include <streambuf>
+#include <chrono>
+#include <cstdarg>
 #include <cstdlib>
 #include <iostream>
+#include <memory>
 #include <vector>
 
+#include "output_capture.h"
+
 /**
  * This is a custom stream to allow each context to have their own stdout and stderr.
  *
@@ -14,21 +19,48 @@
  * will append it to the frontend div and append it to an array for the ctx's stdout or stderr.
  *
  * If compiled for unix, it will simply forward it to std::cout/std::cerr.
+ *
+ * Output is coalesced: a full buffer is posted at once, but a finished line is only posted if
+ * nothing was posted in the last frame, so print-heavy programs send the UI at most one message
+ * per frame. Whatever is left over is posted by `flush_if_due` or an explicit flush (the worker
+ * does one on exit and on breakpoints, and `read_input` before it waits for input).
+ *
+ * With a capture attached, output goes to it instead of the sink or UI: writes are copied straight
+ * into the capture, and what printf and sputc leave in the buffer follows at the next flush.
  */
 class MIPSImagePrintStream : public std::streambuf {
     public:
-        explicit MIPSImagePrintStream(unsigned int ctx, std::ostream &sink, std::size_t buffer_size = 256); 
+        explicit MIPSImagePrintStream(unsigned int ctx, std::ostream &sink, std::size_t buffer_size = 4096);
         MIPSImagePrintStream(const MIPSImagePrintStream&) = delete;
         MIPSImagePrintStream(MIPSImagePrintStream&&);
         MIPSImagePrintStream& operator=(const MIPSImagePrintStream&) = delete;
         MIPSImagePrintStream& operator=(MIPSImagePrintStream&&);
         ~MIPSImagePrintStream();
 
+        // Post anything that has been buffered for at least a frame.
+        void flush_if_due();
+
+        // printf straight into the buffer. Only output longer than the whole buffer is
+        // formatted on the heap first.
+        std::streamsize vprintf(const char *fmt, va_list args);
+
+        // Send output to `capture` from now on
+        void capture_to(std::unique_ptr<OutputCapture> capture);
+        // The capture, brought up to date, or nullptr
+        OutputCapture *captured();
+        // Whether a capture made with `stop_when_full` has been overrun. Cheap enough for every cycle
+        bool capture_overrun() const;
+
     private:
         inline void move_buffer_pointers(MIPSImagePrintStream &&other);
         std::streamsize xsputn(const char *s, std::streamsize n);
         int_type overflow(int_type ch);
         int sync();
+        void maybe_post(bool ends_line);
+        bool post_is_due() const;
+        int post();
+
+        static constexpr std::chrono::milliseconds FRAME_INTERVAL{16};
 
         unsigned int ctx;
         // Note that this cannot be a reference type as std::ostream doesn't implement a public
@@ -39,6 +71,8 @@ class MIPSImagePrintStream : public std::streambuf {
         // ostream goes out of scope and gets destroyed.
         std::ostream *sink;
         std::vector<char> buf;
+        std::chrono::steady_clock::time_point last_post;
+        std::unique_ptr<OutputCapture> capture;
 };
 
 #endif
@@ -0,0 +1,109 @@
+#include <string.h>
+
+#include "spim.h"
+#include "image.h"
+#include "input_queue.h"
+
+
+/* Append the LEN bytes at TEXT to IMG's input. */
+
+void
+push_input (MIPSImage &img, const char *text, size_t len)
+{
+  input_queue_t &q = img.input_queue();
+
+  /* Drop what has been read before growing the buffer. */
+  if (q.head != 0 && q.head == q.data.size ())
+    {
+      q.data.clear ();
+      q.head = 0;
+    }
+  else if (q.head > 4096 && q.head > q.data.size () / 2)
+    {
+      q.data.erase (0, q.head);
+      q.head = 0;
+    }
+  q.data.append (text, len);
+}
+
+
+/* No more input will be pushed, so reads return what is left. */
+
+void
+close_input (MIPSImage &img)
+{
+  img.input_queue().eof = true;
+}
+
+
+/* Simulate the semantics of fgets (not gets) on Unix file: copy up to
+   STR_SIZE - 1 bytes, through the first newline, into STR.  Return
+   false, without reading anything, if the queue does not hold a whole
+   line yet; the caller parks the context and tries again later. */
+
+bool
+read_input (MIPSImage &img, char *str, int str_size)
+{
+  input_queue_t &q = img.input_queue();
+  size_t avail = q.data.size () - q.head;
+  size_t want = str_size > 1 ? (size_t) str_size - 1 : 0; /* Reserve space for null */
+  size_t n = MIN (avail, want);
+  const char *nl = (const char *) memchr (q.data.data () + q.head, '\n', n);
+
+  if (nl != NULL)
+    n = nl - (q.data.data () + q.head) + 1;
+  else if (n < want && !q.eof)
+    {
+      if (!q.waiting)
+	{
+	  q.waiting = true;
+	  img.flush_output ();	/* Show the prompt */
+	}
+      return false;
+    }
+
+  memcpy (str, q.data.data () + q.head, n);
+  q.head += n;
+  if (0 < str_size)
+    str[n] = '\0';		/* Null terminate input */
+  q.waiting = false;
+  return true;
+}
+
+
+/* Simulate read(2) on the console: copy up to N bytes that are already
+   queued into BUF and return how many, 0 at end of input.  Return -1 if
+   nothing is queued yet, so the caller parks the context. */
+
+int
+read_input_bytes (MIPSImage &img, char *buf, int n)
+{
+  input_queue_t &q = img.input_queue();
+  size_t count = MIN (q.data.size () - q.head, (size_t) n);
+
+  if (count == 0 && !q.eof)
+    {
+      if (!q.waiting)
+	{
+	  q.waiting = true;
+	  img.flush_output ();
+	}
+      return -1;
+    }
+
+  memcpy (buf, q.data.data () + q.head, count);
+  q.head += count;
+  q.waiting = false;
+  return (int) count;
+}
+
+
+/* Hold IMG at the syscall it is executing, so that it runs again next
+   cycle.  Like JUMP_INST, this relies on spim_step advancing the PC
+   after every instruction. */
+
+void
+park_for_input (MIPSImage &img)
+{
+  img.reg_image().PC -= BYTES_PER_WORD;
+}
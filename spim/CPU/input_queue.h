@@ -0,0 +1,28 @@
+#ifndef INPUT_QUEUE_H
+#define INPUT_QUEUE_H
+
+#include <stddef.h>
+
+#include <string>
+
+class MIPSImage;
+
+/* Console input of a context.  The UI (or a test harness) pushes text
+   into the queue; a READ syscall that the queue cannot satisfy yet
+   parks its context at the syscall, and the other contexts keep
+   running until more text arrives. */
+
+typedef struct input_queue {
+	std::string data;
+	size_t head = 0;		/* First unread byte of DATA */
+	bool eof = false;		/* No more input will arrive */
+	bool waiting = false;		/* A read is parked on the queue */
+} input_queue_t;
+
+void push_input (MIPSImage &img, const char *text, size_t len);
+void close_input (MIPSImage &img);
+bool read_input (MIPSImage &img, char *str, int str_size);
+int read_input_bytes (MIPSImage &img, char *buf, int n);
+void park_for_input (MIPSImage &img);
+
+#endif
@@ -34,6 +34,8 @@
 #include <stdio.h>
 #include <string.h>
 
+#include <array>
+
 #include "spim.h"
 #include "string-stream.h"
 #include "spim-utils.h"
@@ -46,29 +48,36 @@
 #include "scanner.h"
 #include "parser_yacc.h"
 #include "data.h"
+#include "op_tables.h"
 
 
 /* Local functions: */
 
-static int compare_pair_value (name_val_val *p1, name_val_val *p2);
 static void format_imm_expr (MIPSImage &img, str_stream *ss, imm_expr *expr, int base_reg);
+static void format_inst_body (MIPSImage &img, str_stream *ss, instruction *inst, const op_entry_t *entry);
 static void i_type_inst_full_word (MIPSImage &img, int opcode, int rt, int rs, imm_expr *expr,
 				   int value_known, int32 value);
 static void inst_cmp (MIPSImage &img, instruction *inst1, instruction *inst2);
 static instruction *make_r_type_inst (MIPSImage &img, int opcode, int rd, int rs, int rt);
-static instruction *mk_i_inst (MIPSImage &img, int32 value, int opcode, int rs, int rt, int offset);
-static instruction *mk_j_inst (MIPSImage &img, int32 value, int opcode, int target);
-static instruction *mk_r_inst (MIPSImage &img, int32 value, int opcode, int rs, int rt, int rd, int shamt);
-static instruction *mk_co_r_inst (MIPSImage &img, int32 value, int opcode, int fd, int fs, int ft);
 static void produce_immediate (MIPSImage &img, imm_expr *expr, int rt, int value_known, int32 value);
-static void sort_a_opcode_table ();
-static void sort_i_opcode_table ();
-static void sort_name_table ();
 
 
-/* Instruction used as breakpoint by SPIM: */
+/* Instruction used as breakpoint by SPIM.  It is shared by every image,
+   so it cannot come from an image's arena. */
+
+static instruction *
+breakpoint_inst ()
+{
+  static instruction break_inst = [] {
+    instruction inst = {};
+
+    SET_OPCODE (&inst, Y_BREAK_OP);
+    SET_RD (&inst, 1);
+    return inst;
+  } ();
 
-static instruction *break_inst = NULL;
+  return (&break_inst);
+}
 
 
 /* Set ADDRESS at which the next instruction is stored. */
@@ -143,17 +152,17 @@ user_kernel_text_segment (MIPSImage &img, bool to_kernel)
 void
 store_instruction (MIPSImage &img, instruction *inst)
 {
-  if (data_dir)
+  if (img.assembler().data_dir)
     {
       store_word (img, inst_encode (img, inst));
-      free_inst (inst);
+      free_inst (img, inst);
     }
-  else if (text_dir)
+  else if (img.assembler().text_dir)
     {
       img.reg_image().exception_occurred = 0;
       set_mem_inst (img, INST_PC(img), inst);
       if (img.reg_image().exception_occurred)
-	error (img, "Invalid address (0x%08x) for instruction\n", INST_PC(img));
+	assembler_error (img, "Invalid address (0x%08x) for instruction\n", INST_PC(img));
       else
 	increment_text_pc (img, BYTES_PER_WORD);
       if (inst != NULL)
@@ -171,7 +180,7 @@ void
 i_type_inst_free (MIPSImage &img, int opcode, int rt, int rs, imm_expr *expr)
 {
   i_type_inst (img, opcode, rt, rs, expr);
-  free (expr);
+  free_imm_expr (img, expr);
 }
 
 
@@ -184,7 +193,7 @@ i_type_inst_free (MIPSImage &img, int opcode, int rt, int rs, imm_expr *expr)
 void
 i_type_inst (MIPSImage &img, int opcode, int rt, int rs, imm_expr *expr)
 {
-  instruction *inst = (instruction *) zmalloc (img, sizeof (instruction));
+  instruction *inst = (instruction *) arena_zalloc (img, sizeof (instruction));
 
   SET_OPCODE (inst, opcode);
   SET_RS (inst, rs);
@@ -195,7 +204,7 @@ i_type_inst (MIPSImage &img, int opcode, int rt, int rs, imm_expr *expr)
       /* Evaluate the instruction's expression. */
       int32 value = eval_imm_expr (img, expr);
 
-      if (!bare_machine
+      if (!img.assembler().bare_machine
 	  && (((opcode == Y_ADDI_OP
 		|| opcode == Y_ADDIU_OP
 		|| opcode == Y_SLTI_OP
@@ -213,14 +222,14 @@ i_type_inst (MIPSImage &img, int opcode, int rt, int rs, imm_expr *expr)
 	       : (value & 0xffff0000) != 0)))
 	{
          // Non-immediate value
-	  free_inst (inst);
+	  free_inst (img, inst);
 	  i_type_inst_full_word (img, opcode, rt, rs, expr, 1, value);
 	  return;
 	}
       else
 	resolve_a_label (img, expr->symbol, inst);
     }
-  else if (bare_machine || expr->bits != 0)
+  else if (img.assembler().bare_machine || expr->bits != 0)
     /* Don't know expression's value, but only needed upper/lower 16-bits
        anyways. */
     record_inst_uses_symbol (img, inst, expr->symbol);
@@ -229,7 +238,7 @@ i_type_inst (MIPSImage &img, int opcode, int rt, int rs, imm_expr *expr)
       /* Don't know the expressions's value and want all of its bits,
 	 so assume that it will not produce a small result and generate
 	 sequence for 32 bit value. */
-      free_inst (inst);
+      free_inst (img, inst);
 
       i_type_inst_full_word (img, opcode, rt, rs, expr, 0, 0);
       return;
@@ -282,7 +291,7 @@ i_type_inst_full_word (MIPSImage &img, int opcode, int rt, int rs, imm_expr *exp
 		}
           imm_expr *const_expr = const_imm_expr (img, low);
 	      i_type_inst_free (img, opcode, rt, 1, lower_bits_of_expr (img, const_expr));
-          free(const_expr);
+          free_imm_expr (img, const_expr);
 	    }
 	  else
 	    {
@@ -367,7 +376,7 @@ produce_immediate (MIPSImage &img, imm_expr *expr, int rt, int value_known, int3
 void
 j_type_inst (MIPSImage &img, int opcode, imm_expr *target)
 {
-  instruction *inst = (instruction *) zmalloc (img, sizeof (instruction));
+  instruction *inst = (instruction *) arena_zalloc (img, sizeof (instruction));
 
   SET_OPCODE(inst, opcode);
   target->offset = 0;		/* Not PC relative */
@@ -387,7 +396,7 @@ j_type_inst (MIPSImage &img, int opcode, imm_expr *target)
 static instruction *
 make_r_type_inst (MIPSImage &img, int opcode, int rd, int rs, int rt)
 {
-  instruction *inst = (instruction *) zmalloc (img, sizeof (instruction));
+  instruction *inst = (instruction *) arena_zalloc (img, sizeof (instruction));
 
   SET_OPCODE(inst, opcode);
   SET_RS(inst, rs);
@@ -563,7 +572,7 @@ r_cond_type_inst (MIPSImage &img, int opcode, int fs, int ft, int cc)
 instruction *
 copy_inst (MIPSImage &img, instruction *inst)
 {
-  instruction *new_inst = (instruction *) xmalloc (img, sizeof (instruction));
+  instruction *new_inst = (instruction *) arena_alloc (img, sizeof (instruction));
 
   *new_inst = *inst;
   /*memcpy ((void*)new_inst, (void*)inst , sizeof (instruction));*/
@@ -572,76 +581,23 @@ copy_inst (MIPSImage &img, instruction *inst)
 }
 
 
+/* Return INST and its expression to the arena's free lists.  Its
+   source line is reclaimed with the rest of the arena. */
+
 void
-free_inst (instruction *inst)
+free_inst (MIPSImage &img, instruction *inst)
 {
-  if (inst != break_inst)
+  if (inst != breakpoint_inst ())
     /* Don't free the breakpoint insructions since we only have one. */
     {
       if (EXPR (inst))
-	    free (EXPR (inst));
-      if (SOURCE(inst))
-        free (SOURCE(inst));
-      free (inst);
+	free_imm_expr (img, EXPR (inst));
+      arena_free (img, inst, sizeof (instruction));
     }
 }
 
 
 
-/* Maintain a table mapping from opcode to instruction name and
-   instruction type.
-
-   Table must be sorted before first use since its entries are
-   alphabetical on name, not ordered by opcode. */
-
-
-/* Sort all instruction table before first use. */
-
-void
-initialize_inst_tables ()
-{
-	sort_name_table ();
-	sort_i_opcode_table ();
-	sort_a_opcode_table ();
-}
-
-
-/* Map from opcode -> name/type. */
-
-static name_val_val name_tbl [] = {
-#undef OP
-#define OP(NAME, OPCODE, TYPE, R_OPCODE) {NAME, OPCODE, TYPE},
-#include "op.h"
-};
-
-
-/* Sort the opcode table on their key (the opcode value). */
-
-static void
-sort_name_table ()
-{
-  qsort (name_tbl,
-	 sizeof (name_tbl) / sizeof (name_val_val),
-	 sizeof (name_val_val),
-	 (QSORT_FUNC) compare_pair_value);
-}
-
-
-/* Compare the VALUE1 field of two NAME_VAL_VAL entries in the format
-   required by qsort. */
-
-static int
-compare_pair_value (name_val_val *p1, name_val_val *p2)
-{
-  if (p1->value1 < p2->value1)
-    return (-1);
-  else if (p1->value1 > p2->value1)
-    return (1);
-  else
-    return (0);
-}
-
-
 /* Print the instruction stored at the memory ADDRESS. */
 
 void
@@ -673,39 +629,14 @@ inst_to_string(MIPSImage &img, mem_addr addr)
 }
 
 
-void
-format_an_inst (MIPSImage &img, str_stream *ss, instruction *inst, mem_addr addr)
-{
-  name_val_val *entry;
-  int line_start = ss_length (ss);
-
-  if (inst_is_breakpoint (img, addr))
-    {
-      delete_breakpoint (img, addr);
-      ss_printf (img, ss, "*");
-      format_an_inst (img, ss, read_mem_inst (img, addr), addr);
-      add_breakpoint (img, addr);
-      return;
-    }
+/* Write to the stream the mnemonic and operands of INST (without its
+   address, encoding, or source line). */
 
-  ss_printf (img, ss, "[0x%08x]\t", addr);
-  if (inst == NULL)
-    {
-      ss_printf (img, ss, "<none>\n");
-      return;
-    }
-
-  entry = map_int_to_name_val_val (name_tbl,
-				   sizeof (name_tbl) / sizeof (name_val_val),
-				   OPCODE (inst));
-  if (entry == NULL)
-    {
-      ss_printf (img, ss, "<unknown instruction %d>\n", OPCODE (inst));
-      return;
-    }
-
-  ss_printf (img, ss, "0x%08x  %s", (uint32)ENCODING (inst), entry->name);
-  switch (entry->value2)
+static void
+format_inst_body (MIPSImage &img, str_stream *ss, instruction *inst, const op_entry_t *entry)
+{
+  ss_printf (img, ss, "%s", entry->name);
+  switch (entry->type)
     {
     case BC_TYPE_INST:
       ss_printf (img, ss, "%d %d", CC (inst), IDISP (inst));
@@ -824,8 +755,79 @@ format_an_inst (MIPSImage &img, str_stream *ss, instruction *inst, mem_addr addr
 	format_imm_expr (img, ss, EXPR (inst), -1);
       ss_printf (img, ss, "]");
     }
+}
+
+
+/* Fill LINE with a structured disassembly of the instruction INST at ADDR,
+   for the text panes.  INST must not be NULL. */
+
+void
+disassemble_inst (MIPSImage &img, instruction *inst, mem_addr addr, disasm_line_t *line)
+{
+  str_stream ss;
+  const op_entry_t *entry;
+
+  line->addr = addr;
+  line->encoding = (uint32)ENCODING (inst);
+  line->operands.clear ();
+  line->source = source_line_string (img, SOURCE (inst));
+
+  entry = op_by_opcode (OPCODE (inst));
+  if (entry == NULL)
+    {
+      ss_printf (img, &ss, "<unknown instruction %d>", OPCODE (inst));
+      line->mnemonic.assign (ss.buf, ss_length (&ss));
+      return;
+    }
+
+  format_inst_body (img, &ss, inst, entry);
+
+  /* Mnemonics never contain blanks, so the first one ends it. */
+  std::string body (ss.buf, ss_length (&ss));
+  size_t blank = body.find (' ');
+  if (blank == std::string::npos)
+    line->mnemonic = body;
+  else
+    {
+      line->mnemonic = body.substr (0, blank);
+      line->operands = body.substr (blank + 1);
+    }
+}
+
+
+void
+format_an_inst (MIPSImage &img, str_stream *ss, instruction *inst, mem_addr addr)
+{
+  const op_entry_t *entry;
+  int line_start = ss_length (ss);
+
+  if (inst_is_breakpoint (img, addr))
+    {
+      delete_breakpoint (img, addr);
+      ss_printf (img, ss, "*");
+      format_an_inst (img, ss, read_mem_inst (img, addr), addr);
+      add_breakpoint (img, addr);
+      return;
+    }
 
-  if (SOURCE (inst) != NULL)
+  ss_printf (img, ss, "[0x%08x]\t", addr);
+  if (inst == NULL)
+    {
+      ss_printf (img, ss, "<none>\n");
+      return;
+    }
+
+  entry = op_by_opcode (OPCODE (inst));
+  if (entry == NULL)
+    {
+      ss_printf (img, ss, "<unknown instruction %d>\n", OPCODE (inst));
+      return;
+    }
+
+  ss_printf (img, ss, "0x%08x  ", (uint32)ENCODING (inst));
+  format_inst_body (img, ss, inst, entry);
+
+  if (SOURCE (inst) != 0)
     {
       /* Comment is source line text of current line. */
       int gap_length = 57 - (ss_length (ss) - line_start);
@@ -835,7 +837,7 @@ format_an_inst (MIPSImage &img, str_stream *ss, instruction *inst, mem_addr addr
 	}
 
       ss_printf (img, ss, "; ");
-      ss_printf (img, ss, "%s", SOURCE (inst));
+      format_source_line (img, ss, SOURCE (inst));
     }
 
   ss_printf (img, ss, "\n");
@@ -1000,10 +1002,7 @@ opcode_is_load_store (int opcode)
 bool
 inst_is_breakpoint (MIPSImage &img, mem_addr addr)
 {
-  if (break_inst == NULL)
-    break_inst = make_r_type_inst (img, Y_BREAK_OP, 1, 0, 0);
-
-  return (read_mem_inst (img, addr) == break_inst);
+  return (read_mem_inst (img, addr) == breakpoint_inst ());
 }
 
 
@@ -1015,15 +1014,12 @@ set_breakpoint (MIPSImage &img, mem_addr addr)
 {
   instruction *old_inst;
 
-  if (break_inst == NULL)
-    break_inst = make_r_type_inst (img, Y_BREAK_OP, 1, 0, 0);
-
   img.reg_image().exception_occurred = 0;
   old_inst = read_mem_inst (img, addr);
-  if (old_inst == break_inst)
+  if (old_inst == breakpoint_inst ())
     return (NULL);
 
-  set_mem_inst (img, addr, break_inst);
+  set_mem_inst (img, addr, breakpoint_inst ());
   if (img.reg_image().exception_occurred)
     return (NULL);
   else
@@ -1040,7 +1036,7 @@ set_breakpoint (MIPSImage &img, mem_addr addr)
 imm_expr *
 make_imm_expr (MIPSImage &img, int offs, char *sym, bool is_pc_relative)
 {
-  imm_expr *expr = (imm_expr *) xmalloc (img, sizeof (imm_expr));
+  imm_expr *expr = (imm_expr *) arena_alloc (img, sizeof (imm_expr));
 
   expr->offset = offs;
   expr->bits = 0;
@@ -1058,7 +1054,7 @@ make_imm_expr (MIPSImage &img, int offs, char *sym, bool is_pc_relative)
 imm_expr *
 copy_imm_expr (MIPSImage &img, imm_expr *old_expr)
 {
-  imm_expr *expr = (imm_expr *) xmalloc (img, sizeof (imm_expr));
+  imm_expr *expr = (imm_expr *) arena_alloc (img, sizeof (imm_expr));
 
   *expr = *old_expr;
   /*memcpy ((void*)expr, (void*)old_expr, sizeof (imm_expr));*/
@@ -1186,7 +1182,7 @@ is_zero_imm (imm_expr *expr)
 addr_expr *
 make_addr_expr (MIPSImage &img, int offs, char *sym, int reg_no)
 {
-  addr_expr *expr = (addr_expr *) xmalloc (img, sizeof (addr_expr));
+  addr_expr *expr = (addr_expr *) arena_alloc (img, sizeof (addr_expr));
   label *lab;
 
   if (reg_no == 0 && sym != NULL && (lab = lookup_label (img, sym))->gp_flag)
@@ -1203,6 +1199,21 @@ make_addr_expr (MIPSImage &img, int offs, char *sym, int reg_no)
 }
 
 
+void
+free_imm_expr (MIPSImage &img, imm_expr *expr)
+{
+  arena_free (img, expr, sizeof (imm_expr));
+}
+
+
+void
+free_addr_expr (MIPSImage &img, addr_expr *expr)
+{
+  free_imm_expr (img, expr->imm);
+  arena_free (img, expr, sizeof (addr_expr));
+}
+
+
 imm_expr *
 addr_expr_imm (addr_expr *expr)
 {
@@ -1222,32 +1233,6 @@ addr_expr_reg (addr_expr *expr)
    instruction. */
 
 
-/* Maintain a table mapping from internal opcode (i_opcode) to actual
-   opcode (a_opcode).  Table must be sorted before first use since its
-   entries are alphabetical on name, not ordered by opcode. */
-
-
-/* Map from internal opcode -> real opcode */
-
-static name_val_val i_opcode_tbl [] = {
-#undef OP
-#define OP(NAME, I_OPCODE, TYPE, A_OPCODE) {NAME, I_OPCODE, (int)A_OPCODE},
-#include "op.h"
-};
-
-
-/* Sort the opcode table on their key (the interal opcode value). */
-
-static void
-sort_i_opcode_table ()
-{
-  qsort (i_opcode_tbl,
-	 sizeof (i_opcode_tbl) / sizeof (name_val_val),
-	 sizeof (name_val_val),
-	 (QSORT_FUNC) compare_pair_value);
-}
-
-
 #define REGS(R,O) (((R) & 0x1f) << O)
 
 
@@ -1255,23 +1240,17 @@ int32
 inst_encode (MIPSImage &img, instruction *inst)
 {
   int32 a_opcode = 0;
-  name_val_val *entry;
+  const op_entry_t *entry;
 
   if (inst == NULL)
     return (0);
 
-  entry = map_int_to_name_val_val (i_opcode_tbl,
-				sizeof (i_opcode_tbl) / sizeof (name_val_val),
-				OPCODE (inst));
+  entry = op_by_opcode (OPCODE (inst));
   if (entry == NULL)
     return 0;
 
-  a_opcode = entry->value2;
-  entry = map_int_to_name_val_val (name_tbl,
-				sizeof (name_tbl) / sizeof (name_val_val),
-				OPCODE (inst));
-
-  switch (entry->value2)
+  a_opcode = entry->a_opcode;
+  switch (entry->type)
     {
     case BC_TYPE_INST:
       return (a_opcode
@@ -1403,213 +1382,132 @@ inst_encode (MIPSImage &img, instruction *inst)
 }
 
 
-/* Maintain a table mapping from actual opcode to interal opcode.
-   Table must be sorted before first use since its entries are
-   alphabetical on name, not ordered by opcode. */
+/* How the fields of a machine instruction of each type fill in an
+   instruction: the position of the 5-bit field that goes in RS, RT, RD
+   and SHAMT (-1 for none), and what, if anything, goes in the rest. */
 
+#define DECODE_NONE	0
+#define DECODE_IMM	1	/* Low 16 bits in IOFFSET */
+#define DECODE_TARGET	2	/* Jump target */
+#define DECODE_COND	3	/* Low 4 bits in COND (over RS) */
 
-/* Map from internal opcode -> real opcode */
-
-static name_val_val a_opcode_tbl [] = {
-#undef OP
-#define OP(NAME, I_OPCODE, TYPE, A_OPCODE) {NAME, (int)A_OPCODE, (int)I_OPCODE},
-#include "op.h"
-};
-
+typedef struct decode_layout
+{
+  bool valid;
+  signed char rs, rt, rd, shamt;
+  unsigned char rest;
+} decode_layout_t;
 
-/* Sort the opcode table on their key (the interal opcode value). */
+#define N_INST_TYPES	(NOARG_TYPE_INST + 1)
 
-static void
-sort_a_opcode_table ()
+static constexpr std::array<decode_layout_t, N_INST_TYPES>
+make_decode_layouts ()
 {
-  qsort (a_opcode_tbl,
-	 sizeof (a_opcode_tbl) / sizeof (name_val_val),
-	 sizeof (name_val_val),
-	 (QSORT_FUNC) compare_pair_value);
+  std::array<decode_layout_t, N_INST_TYPES> l {};
+
+  l[BC_TYPE_INST] =	 {true, 21, 16, -1, -1, DECODE_IMM};
+  l[B1_TYPE_INST] =	 {true, 21, -1, -1, -1, DECODE_IMM};
+  l[I1s_TYPE_INST] =	 {true, 21, -1, -1, -1, DECODE_IMM};
+  l[I1t_TYPE_INST] =	 {true, 21, 16, -1, -1, DECODE_IMM};
+  l[I2_TYPE_INST] =	 {true, 21, 16, -1, -1, DECODE_IMM};
+  l[B2_TYPE_INST] =	 {true, 21, 16, -1, -1, DECODE_IMM};
+  l[I2a_TYPE_INST] =	 {true, 21, 16, -1, -1, DECODE_IMM};
+  l[R1s_TYPE_INST] =	 {true, 21, -1, -1, -1, DECODE_NONE};
+  l[R1d_TYPE_INST] =	 {true, -1, -1, 11, -1, DECODE_NONE};
+  l[R2td_TYPE_INST] =	 {true, -1, 16, 11, -1, DECODE_NONE};
+  l[R2st_TYPE_INST] =	 {true, 21, 16, -1, -1, DECODE_NONE};
+  l[R2ds_TYPE_INST] =	 {true, 21, -1, 11, -1, DECODE_NONE};
+  l[R2sh_TYPE_INST] =	 {true, -1, 16, 11, 6, DECODE_NONE};
+  l[R3_TYPE_INST] =	 {true, 21, 16, 11, -1, DECODE_NONE};
+  l[R3sh_TYPE_INST] =	 {true, 21, 16, 11, -1, DECODE_NONE};
+  l[FP_I2a_TYPE_INST] =	 {true, 21, 16, -1, -1, DECODE_IMM};	/* base, ft */
+  l[FP_R2ds_TYPE_INST] = {true, -1, -1, 11, 6, DECODE_NONE};	/* fs, fd */
+  l[FP_R2ts_TYPE_INST] = {true, -1, 16, 11, -1, DECODE_NONE};	/* rt, fs */
+  l[FP_CMP_TYPE_INST] =	 {true, -1, 16, 6, -1, DECODE_COND};	/* ft, fd */
+  l[FP_R3_TYPE_INST] =	 {true, -1, 16, 11, 6, DECODE_NONE};	/* ft, fs, fd */
+  l[MOVC_TYPE_INST] =	 {true, 21, 16, 11, -1, DECODE_NONE};
+  l[FP_MOVC_TYPE_INST] = {true, 11, 16, 6, -1, DECODE_NONE};	/* fs, rt, fd */
+  l[J_TYPE_INST] =	 {true, -1, -1, -1, -1, DECODE_TARGET};
+  l[NOARG_TYPE_INST] =	 {true, -1, -1, -1, -1, DECODE_NONE};
+  return l;
 }
 
+static constexpr std::array<decode_layout_t, N_INST_TYPES> decode_layouts = make_decode_layouts ();
 
 
-instruction *
-inst_decode (MIPSImage &img, int32 val)
-{
-  int32 a_opcode = val & 0xfc000000;
-  name_val_val *entry;
-  int32 i_opcode;
-
-  /* Field classes: (opcode is continued in other part of instruction): */
-  if (a_opcode == 0 || a_opcode == 0x70000000) /* SPECIAL or SPECIAL2 */
-    a_opcode |= (val & 0x3f);
-  else if (a_opcode == 0x04000000)		/* REGIMM */
-    a_opcode |= (val & 0x001f0000);
-  else if (a_opcode == 0x40000000)		/* COP0 */
-    a_opcode |= (val & 0x03e00000) | (val & 0x1f);
-  else if (a_opcode == 0x44000000)		/* COP1 */
-    {
-      a_opcode |= (val & 0x03e00000);
-      if ((val & 0xff000000) == 0x45000000)
-	a_opcode |= (val & 0x00010000);		/* BC1f/t */
-      else
-	a_opcode |= (val & 0x3f);
-    }
-  else if (a_opcode == 0x48000000		/* COPz */
-	   || a_opcode == 0x4c000000)
-    a_opcode |= (val & 0x03e00000);
-
-
-  entry = map_int_to_name_val_val (a_opcode_tbl,
-				sizeof (a_opcode_tbl) / sizeof (name_val_val),
-				a_opcode);
-  if (entry == NULL)
-    return (mk_r_inst (img, val, 0, 0, 0, 0, 0)); /* Invalid inst */
+/* Decode the machine instruction VAL into INST, which the caller
+   provides.  Nothing is allocated.  An invalid instruction has opcode 0. */
 
-  i_opcode = entry->value2;
+void
+inst_decode_into (int32 val, instruction *inst)
+{
+  const op_entry_t *entry = op_decode (val);
+  const decode_layout_t *layout;
 
-  switch (map_int_to_name_val_val (name_tbl,
-				sizeof (name_tbl) / sizeof (name_val_val),
-				i_opcode)->value2)
+  *inst = instruction ();
+  SET_ENCODING (inst, val);
+  if (entry == NULL || entry->type >= N_INST_TYPES || !decode_layouts[entry->type].valid)
+    return;
+
+  layout = &decode_layouts[entry->type];
+  SET_OPCODE (inst, entry->opcode);
+  if (layout->rs >= 0)
+    SET_RS (inst, BIN_REG (val, layout->rs));
+  if (layout->rt >= 0)
+    SET_RT (inst, BIN_REG (val, layout->rt));
+  if (layout->rd >= 0)
+    SET_RD (inst, BIN_REG (val, layout->rd));
+  if (layout->shamt >= 0)
+    SET_SHAMT (inst, BIN_REG (val, layout->shamt));
+
+  switch (layout->rest)
     {
-    case BC_TYPE_INST:
-      return (mk_i_inst (img, val, i_opcode, BIN_RS(val), BIN_RT(val),
-			 val & 0xffff));
-
-    case B1_TYPE_INST:
-      return (mk_i_inst (img, val, i_opcode, BIN_RS(val), 0, val & 0xffff));
-
-    case I1s_TYPE_INST:
-      return (mk_i_inst (img, val, i_opcode, BIN_RS(val), 0, val & 0xffff));
-
-    case I1t_TYPE_INST:
-      return (mk_i_inst (img, val, i_opcode, BIN_RS(val), BIN_RT(val),
-			 val & 0xffff));
-
-    case I2_TYPE_INST:
-    case B2_TYPE_INST:
-      return (mk_i_inst (img, val, i_opcode, BIN_RS(val), BIN_RT(val),
-			 val & 0xffff));
-
-    case I2a_TYPE_INST:
-      return (mk_i_inst (img, val, i_opcode, BIN_RS(val), BIN_RT(val),
-			 val & 0xffff));
-
-    case R1s_TYPE_INST:
-      return (mk_r_inst (img, val, i_opcode, BIN_RS(val), 0, 0, 0));
-
-    case R1d_TYPE_INST:
-      return (mk_r_inst (img, val, i_opcode, 0, 0, BIN_RD(val), 0));
-
-    case R2td_TYPE_INST:
-      return (mk_r_inst (img, val, i_opcode, 0, BIN_RT(val), BIN_RD(val), 0));
-
-    case R2st_TYPE_INST:
-      return (mk_r_inst (img, val, i_opcode, BIN_RS(val), BIN_RT(val), 0, 0));
-
-    case R2ds_TYPE_INST:
-      return (mk_r_inst (img, val, i_opcode, BIN_RS(val), 0, BIN_RD(val), 0));
-
-    case R2sh_TYPE_INST:
-      return (mk_r_inst (img, val, i_opcode, 0, BIN_RT(val), BIN_RD(val), BIN_SA(val)));
-
-    case R3_TYPE_INST:
-      return (mk_r_inst (img, val, i_opcode, BIN_RS(val), BIN_RT(val), BIN_RD(val), 0));
-
-    case R3sh_TYPE_INST:
-      return(mk_r_inst (img, val, i_opcode, BIN_RS(val), BIN_RT(val), BIN_RD(val), 0));
-
-    case FP_I2a_TYPE_INST:
-      return (mk_i_inst (img, val, i_opcode, BIN_BASE(val), BIN_FT(val), val & 0xffff));
-
-    case FP_R2ds_TYPE_INST:
-      return (mk_co_r_inst (img, val, i_opcode, BIN_FS(val), 0, BIN_FD(val)));
-
-    case FP_R2ts_TYPE_INST:
-      return (mk_r_inst (img, val, i_opcode, 0, BIN_RT(val), BIN_FS(val), 0));
-
-    case FP_CMP_TYPE_INST:
-      {
-	instruction *inst = mk_r_inst (img, val, i_opcode, BIN_FS (val), BIN_FT (val), BIN_FD(val), 0);
-	SET_COND (inst, val & 0xf);
-	return (inst);
-      }
-
-    case FP_R3_TYPE_INST:
-      return (mk_co_r_inst (img, val, i_opcode, BIN_FS(val), BIN_FT(val), BIN_FD(val)));
-
-    case MOVC_TYPE_INST:
-      return (mk_r_inst (img, val, i_opcode, BIN_RS(val), BIN_RT(val), BIN_RD(val), 0));
-
-    case FP_MOVC_TYPE_INST:
-      return (mk_r_inst (img, val, i_opcode, BIN_FS(val), BIN_RT(val), BIN_FD(val), 0));
-
-    case J_TYPE_INST:
-      return (mk_j_inst (img, val, i_opcode, val & 0x2ffffff));
-
+    case DECODE_IMM:
+      SET_IOFFSET (inst, val & 0xffff);
+      break;
 
-    case NOARG_TYPE_INST:
-      return (mk_r_inst (img, val, i_opcode, 0, 0, 0, 0));
+    case DECODE_TARGET:
+      SET_TARGET (inst, val & 0x2ffffff);
+      break;
 
-    default:
-      return (mk_r_inst (img, val, 0, 0, 0, 0, 0)); /* Invalid inst */
+    case DECODE_COND:
+      SET_COND (inst, val & 0xf);
+      break;
     }
 }
 
 
-static instruction *
-mk_r_inst (MIPSImage &img, int32 val, int opcode, int rs, int rt, int rd, int shamt)
+instruction *
+inst_decode (MIPSImage &img, int32 val)
 {
-  instruction *inst = (instruction *) zmalloc (img, sizeof (instruction));
+  instruction *inst = (instruction *) arena_alloc (img, sizeof (instruction));
 
-  SET_OPCODE (inst, opcode);
-  SET_RS (inst, rs);
-  SET_RT (inst, rt);
-  SET_RD (inst, rd);
-  SET_SHAMT (inst, shamt);
-  SET_ENCODING (inst, val);
-  SET_EXPR (inst, NULL);
+  inst_decode_into (val, inst);
   return (inst);
 }
 
-static instruction *
-mk_co_r_inst (MIPSImage &img, int32 val, int opcode, int fs, int ft, int fd)
-{
-  instruction *inst = (instruction *) zmalloc (img, sizeof (instruction));
 
-  SET_OPCODE (inst, opcode);
-  SET_FS (inst, fs);
-  SET_FT (inst, ft);
-  SET_FD (inst, fd);
-  SET_ENCODING (inst, val);
-  SET_EXPR (inst, NULL);
-  return (inst);
-}
+/* Decode the N machine instructions in WORDS into new instructions,
+   stored in INSTS.  They are allocated together, in one arena block. */
 
-static instruction *
-mk_i_inst (MIPSImage &img, int32 val, int opcode, int rs, int rt, int offset)
+void
+inst_decode_words (MIPSImage &img, const int32 *words, int n, instruction **insts)
 {
-  instruction *inst = (instruction *) zmalloc (img, sizeof (instruction));
-
-  SET_OPCODE (inst, opcode);
-  SET_RS (inst, rs);
-  SET_RT (inst, rt);
-  SET_IOFFSET (inst, offset);
-  SET_ENCODING (inst, val);
-  SET_EXPR (inst, NULL);
-  return (inst);
+  const int size = ARENA_ROUND ((int) sizeof (instruction));
+  char *block;
+  int i;
+
+  if (n <= 0)
+    return;
+  block = (char *) arena_alloc (img, n * size);
+  for (i = 0; i < n; i ++)
+    {
+      insts[i] = (instruction *) (block + i * size);
+      inst_decode_into (words[i], insts[i]);
+    }
 }
 
-static instruction *
-mk_j_inst (MIPSImage &img, int32 val, int opcode, int target)
-{
-  instruction *inst = (instruction *) zmalloc (img, sizeof (instruction));
-
-  SET_OPCODE (inst, opcode);
-  SET_TARGET (inst, target);
-  SET_ENCODING (inst, val);
-  SET_EXPR (inst, NULL);
-  return (inst);
-}
 
-
 
 /* Code to test encode/decode of instructions. */
 
@@ -1619,16 +1517,15 @@ test_assembly (MIPSImage &img, instruction *inst)
   instruction *new_inst = inst_decode (img, inst_encode (img, inst));
 
   inst_cmp (img, inst, new_inst);
-  free_inst (new_inst);
+  free_inst (img, new_inst);
 }
 
 
 static void
 inst_cmp (MIPSImage &img, instruction *inst1, instruction *inst2)
 {
-  static str_stream ss;
+  str_stream ss;
 
-  ss_clear (&ss);
   if (memcmp (inst1, inst2, sizeof (instruction) - 4) != 0)
     {
       ss_printf (img, &ss, "=================== Not Equal ===================\n");
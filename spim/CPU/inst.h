@@ -38,6 +38,7 @@
 #include "string-stream.h"
 
 #include "instruction.h"
+#include "disasm.h"
 
 /* Representation of the expression that produce an address for an
    instruction.  Address have the form: label +/- offset (register). */
@@ -109,7 +110,7 @@ typedef struct addrexpr
 #define SET_EXPR(INST, VAL)	(INST)->expr = (imm_expr*)(VAL)
 
 #define SOURCE(INST)		(INST)->source_line
-#define SET_SOURCE(INST, VAL)	(INST)->source_line = (char *)(VAL)
+#define SET_SOURCE(INST, VAL)	(INST)->source_line = (unsigned int)(VAL)
 
 
 #define COND_UN		0x1
@@ -193,15 +194,19 @@ imm_expr *const_imm_expr (MIPSImage &img, int32 value);
 imm_expr *copy_imm_expr (MIPSImage &img, imm_expr *old_expr);
 instruction *copy_inst (MIPSImage &img, instruction *inst);
 mem_addr current_text_pc (MIPSImage &img);
+void disassemble_inst (MIPSImage &img, instruction *inst, mem_addr addr, disasm_line_t *line);
 int32 eval_imm_expr (MIPSImage &img, imm_expr *expr);
 void format_an_inst (MIPSImage &img, str_stream *ss, instruction *inst, mem_addr addr);
-void free_inst (instruction *inst);
+void free_addr_expr (MIPSImage &img, addr_expr *expr);
+void free_imm_expr (MIPSImage &img, imm_expr *expr);
+void free_inst (MIPSImage &img, instruction *inst);
 void i_type_inst (MIPSImage &img, int opcode, int rt, int rs, imm_expr *expr);
 void i_type_inst_free (MIPSImage &img, int opcode, int rt, int rs, imm_expr *expr);
 void increment_text_pc (MIPSImage &img, int delta);
 imm_expr *incr_expr_offset (MIPSImage &img, imm_expr *expr, int32 value);
-void initialize_inst_tables ();
 instruction *inst_decode (MIPSImage &img, int32 value);
+void inst_decode_into (int32 value, instruction *inst);
+void inst_decode_words (MIPSImage &img, const int32 *words, int n, instruction **insts);
 int32 inst_encode (MIPSImage &img, instruction *inst);
 bool inst_is_breakpoint (MIPSImage &img, mem_addr addr);
 void j_type_inst (MIPSImage &img, int opcode, imm_expr *target);
@@ -0,0 +1,154 @@
+#include "spim.h"
+#include "inst.h"
+#include "image.h"
+#include "reg.h"
+#include "op_tables.h"
+#include "parser_yacc.h"
+#include "inst_mix.h"
+
+
+/* Whether the engine was built to count (see COUNT_INST). */
+
+bool
+inst_mix_available ()
+{
+#ifdef INSTRUCTION_MIX
+  return true;
+#else
+  return false;
+#endif
+}
+
+
+/* Start counting IMG's instructions from zero, or stop. */
+
+void
+inst_mix_enable (MIPSImage &img, bool on)
+{
+  img.inst_mix() = inst_mix_t ();
+  img.inst_mix().enabled = on;
+}
+
+
+/* The class of instructions with internal opcode OPCODE, apart from
+   whether a branch is taken. */
+
+static int
+classify (int opcode)
+{
+  const op_entry_t *op = op_by_opcode (opcode);
+
+  switch (opcode)
+    {
+    case Y_LB_OP: case Y_LBU_OP: case Y_LH_OP: case Y_LHU_OP:
+    case Y_LW_OP: case Y_LWL_OP: case Y_LWR_OP: case Y_LL_OP:
+    case Y_LWC1_OP: case Y_LDC1_OP: case Y_LWC2_OP: case Y_LDC2_OP:
+      return CLASS_LOAD;
+
+    case Y_SB_OP: case Y_SH_OP: case Y_SW_OP: case Y_SWL_OP:
+    case Y_SWR_OP: case Y_SC_OP:
+    case Y_SWC1_OP: case Y_SDC1_OP: case Y_SWC2_OP: case Y_SDC2_OP:
+      return CLASS_STORE;
+
+    case Y_J_OP: case Y_JAL_OP: case Y_JALR_OP: case Y_JR_OP:
+    case Y_ERET_OP:
+      return CLASS_JUMP;
+
+    case Y_SYSCALL_OP:
+      return CLASS_SYSCALL;
+    }
+
+  if (op == NULL)
+    return CLASS_ALU;
+  switch (op->type)
+    {
+    case B1_TYPE_INST:
+    case B2_TYPE_INST:
+    case BC_TYPE_INST:
+      return CLASS_BRANCH_TAKEN;
+
+    case FP_I2a_TYPE_INST:
+    case FP_R2ds_TYPE_INST:
+    case FP_R2ts_TYPE_INST:
+    case FP_CMP_TYPE_INST:
+    case FP_R3_TYPE_INST:
+    case FP_R4_TYPE_INST:
+    case FP_MOVC_TYPE_INST:
+      return CLASS_FP;
+
+    default:
+      return CLASS_ALU;
+    }
+}
+
+
+/* Called after the instruction INST at PC has executed. */
+
+void
+count_inst (MIPSImage &img, instruction *inst, mem_addr pc)
+{
+  inst_mix_t &mix = img.inst_mix();
+  size_t op = (size_t) OPCODE (inst);
+  int cls;
+
+  if (op >= mix.by_opcode.size ())
+    {
+      mix.by_opcode.resize (op + 1, 0);
+      mix.class_of.resize (op + 1, -1);
+    }
+  mix.by_opcode[op] += 1;
+
+  if (mix.class_of[op] < 0)
+    mix.class_of[op] = (signed char) classify ((int) op);
+  cls = mix.class_of[op];
+
+  if (cls == CLASS_BRANCH_TAKEN)
+    {
+      mem_addr next_pc = img.reg_image().PC;
+
+      /* Falling through goes to the next instruction, or past the
+	 delay slot if the branch nullified it. */
+      if (next_pc == pc + BYTES_PER_WORD
+	  || (delayed_branches && next_pc == pc + 2 * BYTES_PER_WORD))
+	cls = CLASS_BRANCH_NOT_TAKEN;
+    }
+  mix.by_class[cls] += 1;
+}
+
+
+void
+count_exception (MIPSImage &img, int excode)
+{
+  img.inst_mix().by_exception[excode & (N_EXC_CODES - 1)] += 1;
+}
+
+
+const char *
+inst_class_name (int cls)
+{
+  static const char *names[N_INST_CLASSES] = {
+    "alu", "load", "store", "branch_taken", "branch_not_taken", "jump",
+    "syscall", "fp"
+  };
+
+  return (0 <= cls && cls < N_INST_CLASSES) ? names[cls] : NULL;
+}
+
+
+/* Mnemonics and counts of the opcodes that IMG executed. */
+
+std::vector<std::pair<const char *, uint64_t>>
+inst_mix_by_opcode (MIPSImage &img)
+{
+  inst_mix_t &mix = img.inst_mix();
+  std::vector<std::pair<const char *, uint64_t>> counts;
+  size_t op;
+
+  for (op = 0; op < mix.by_opcode.size (); op ++)
+    if (mix.by_opcode[op] != 0)
+      {
+	const op_entry_t *entry = op_by_opcode ((int) op);
+	counts.emplace_back (entry != NULL ? entry->name : "?", mix.by_opcode[op]);
+      }
+  return counts;
+}
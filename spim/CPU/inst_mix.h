@@ -0,0 +1,63 @@
+#ifndef INST_MIX_H
+#define INST_MIX_H
+
+#include <stdint.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "spim.h"
+#include "instruction.h"
+
+class MIPSImage;
+
+/* Dynamic instruction mix: counts of the instructions a context
+   executes, by opcode and by class, and of the exceptions it raises,
+   by ExcCode.
+
+   Counting is only compiled in when INSTRUCTION_MIX is defined (cmake
+   -DINSTRUCTION_MIX=ON); otherwise COUNT_INST and COUNT_EXCEPTION are
+   empty and the engine runs exactly as it did without them.  Even when
+   compiled in, a context only counts after inst_mix_enable. */
+
+enum inst_class {
+	CLASS_ALU,			/* And every other integer instruction */
+	CLASS_LOAD,
+	CLASS_STORE,
+	CLASS_BRANCH_TAKEN,
+	CLASS_BRANCH_NOT_TAKEN,
+	CLASS_JUMP,
+	CLASS_SYSCALL,
+	CLASS_FP,
+	N_INST_CLASSES
+};
+
+#define N_EXC_CODES 32
+
+typedef struct inst_mix {
+	bool enabled = false;
+	uint64_t by_class[N_INST_CLASSES] = {};
+	uint64_t by_exception[N_EXC_CODES] = {};
+	std::vector<uint64_t> by_opcode;	/* Indexed by Y_..._OP */
+	std::vector<signed char> class_of;	/* Cache of opcode's class, or -1 */
+} inst_mix_t;
+
+#ifdef INSTRUCTION_MIX
+#define COUNT_INST(img, INST, PC)					\
+		if (img.inst_mix().enabled) count_inst (img, INST, PC)
+#define COUNT_EXCEPTION(img, EXCODE)					\
+		if (img.inst_mix().enabled) count_exception (img, EXCODE)
+#else
+#define COUNT_INST(img, INST, PC)
+#define COUNT_EXCEPTION(img, EXCODE)
+#endif
+
+bool inst_mix_available ();
+void inst_mix_enable (MIPSImage &img, bool on);
+void count_inst (MIPSImage &img, instruction *inst, mem_addr pc);
+void count_exception (MIPSImage &img, int excode);
+const char *inst_class_name (int cls);
+std::vector<std::pair<const char *, uint64_t>> inst_mix_by_opcode (MIPSImage &img);
+
+#endif
@@ -52,7 +52,7 @@ typedef struct inst_s
 
   int32 encoding;
   imm_expr *expr = 0;
-  char *source_line = 0;
+  unsigned int source_line = 0;	/* Id in the image's source table, or 0 */
 } instruction;
 
 #endif
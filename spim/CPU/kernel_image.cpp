@@ -0,0 +1,486 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "spim.h"
+#include "string-stream.h"
+#include "spim-utils.h"
+#include "inst.h"
+#include "image.h"
+#include "mem.h"
+#include "reg.h"
+#include "data.h"
+#include "sym-tbl.h"
+#include "arena.h"
+#include "kernel_image.h"
+
+
+/* Install KERNEL into IMG, which must have just been reset.  This leaves
+   IMG in the same state as assembling the program would have. */
+
+void
+install_kernel_image (MIPSImage &img, const kernel_image_t *kernel)
+{
+  std::vector<label *> labels (kernel->n_symbols);
+  std::vector<unsigned> source_ids (kernel->n_sources);
+  int i, j;
+
+  for (i = 0; i < kernel->n_sources; i ++)
+    {
+      const kernel_source_t *s = &kernel->sources[i];
+
+      source_ids[i] = intern_source_line (img, s->file, s->line_no, s->text, (int) strlen (s->text));
+    }
+
+  for (i = 0; i < kernel->n_symbols; i ++)
+    {
+      const kernel_symbol_t *sym = &kernel->symbols[i];
+      label *l;
+
+      if (sym->in_table)
+	l = lookup_label (img, (char *) sym->name);
+      else
+	{
+	  /* Local label that was flushed from the table. */
+	  l = (label *) arena_zalloc (img, sizeof (label));
+	  l->name = arena_str_copy (img, sym->name);
+	}
+      l->addr = sym->addr;
+      l->global_flag = sym->global_flag;
+      l->const_flag = sym->const_flag;
+      l->gp_flag = sym->gp_flag;
+      if (l->addr != 0 && !l->const_flag)
+	index_label_address (img, l);
+      labels[i] = l;
+    }
+
+  std::vector<instruction *> insts;
+  for (i = 0; i < kernel->n_text; i ++)
+    {
+      const kernel_run_t *run = &kernel->text[i];
+      mem_addr top = run->base + BYTES_PER_WORD * run->n_words;
+
+      /* A loaded executable may have grown the text segments. */
+      if (run->base >= K_TEXT_BOT && top > img.mem_image().k_text_top)
+	expand_k_text (img, ROUND_UP (top - img.mem_image().k_text_top, 64*K));
+      else if (run->base < K_TEXT_BOT && top > img.mem_image().text_top)
+	expand_text (img, ROUND_UP (top - img.mem_image().text_top, 64*K));
+
+      insts.resize (run->n_words);
+      inst_decode_words (img, run->words, run->n_words, insts.data ());
+      for (j = 0; j < run->n_words; j ++)
+	{
+	  if (run->source[j] != 0)
+	    SET_SOURCE (insts[j], source_ids[run->source[j] - 1]);
+	  set_mem_inst (img, run->base + BYTES_PER_WORD * j, insts[j]);
+	}
+    }
+
+  for (i = 0; i < kernel->n_data; i ++)
+    {
+      const kernel_run_t *run = &kernel->data[i];
+      mem_addr top = run->base + BYTES_PER_WORD * run->n_words;
+
+      /* The program may have grown the segments past their initial size. */
+      if (run->base >= K_DATA_BOT && top > img.mem_image().k_data_top)
+	expand_k_data (img, ROUND_UP (top - img.mem_image().k_data_top, 64*K));
+      else if (run->base < K_TEXT_BOT && top > img.mem_image().data_top)
+	expand_data (img, ROUND_UP (top - img.mem_image().data_top, 64*K));
+
+      for (j = 0; j < run->n_words; j ++)
+	set_mem_word (img, run->base + BYTES_PER_WORD * j, run->words[j]);
+    }
+
+  for (i = 0; i < kernel->n_exprs; i ++)
+    {
+      const kernel_expr_t *e = &kernel->exprs[i];
+      instruction *inst = read_mem_inst (img, e->addr);
+      imm_expr *expr = make_imm_expr (img, e->offset, NULL, e->pc_relative);
+      label *sym = labels[e->symbol];
+
+      expr->symbol = sym;
+      expr->bits = e->bits;
+      SET_EXPR (inst, expr);
+
+      if (sym->addr == 0 && !sym->const_flag)
+	{
+	  label_use *u = (label_use *) arena_alloc (img, sizeof (label_use));
+
+	  u->inst = inst;
+	  u->addr = e->addr;
+	  u->next = sym->uses;
+	  sym->uses = u;
+	}
+    }
+
+  for (i = 0; i < kernel->n_data_uses; i ++)
+    record_data_uses_symbol (img, kernel->data_uses[i].addr,
+			     labels[kernel->data_uses[i].symbol]);
+
+  img.reg_image().next_text_pc = kernel->next_text_pc;
+  img.reg_image().next_k_text_pc = kernel->next_k_text_pc;
+  img.reg_image().next_data_pc = kernel->next_data_pc;
+  img.reg_image().next_k_data_pc = kernel->next_k_data_pc;
+  img.reg_image().next_gp_item_addr = kernel->next_gp_item_addr;
+  end_of_assembly_file (img);
+}
+
+
+
+/* Write S as a C string literal. */
+
+static void
+write_c_string (FILE *out, const char *s)
+{
+  if (s == NULL)
+    {
+      fputs ("NULL", out);
+      return;
+    }
+
+  putc ('"', out);
+  for (; *s != '\0'; s ++)
+    switch (*s)
+      {
+      case '"': fputs ("\\\"", out); break;
+      case '\\': fputs ("\\\\", out); break;
+      case '\n': fputs ("\\n", out); break;
+      case '\t': fputs ("\\t", out); break;
+      default:
+	if ((unsigned char) *s < ' ')
+	  fprintf (out, "\\%03o", (unsigned char) *s);
+	else
+	  putc (*s, out);
+      }
+  putc ('"', out);
+}
+
+
+/* Index of SYM in SNAP's symbols, adding it if necessary. */
+
+static int
+symbol_index (kernel_snapshot_t &snap, std::map<label *, int> &index,
+	      label *sym, bool in_table)
+{
+  std::map<label *, int>::iterator it = index.find (sym);
+  kernel_symbol_t s;
+
+  if (it != index.end ())
+    return it->second;
+
+  snap.strings.push_back (sym->name);
+  s.name = snap.strings.back ().c_str ();
+  s.addr = (mem_addr) sym->addr;
+  s.in_table = in_table;
+  s.global_flag = sym->global_flag;
+  s.const_flag = sym->const_flag;
+  s.gp_flag = sym->gp_flag;
+  index[sym] = (int) snap.symbols.size ();
+  snap.symbols.push_back (s);
+  return (int) snap.symbols.size () - 1;
+}
+
+
+/* Return 1 + the index in SNAP's sources of IMG's source line ID, adding
+   it if need be.  INDEX maps line ids to the result, FILES file indexes
+   to their names in SNAP. */
+
+static int
+source_index (MIPSImage &img, kernel_snapshot_t &snap, std::vector<int> &index,
+	      std::vector<const char *> &files, unsigned id)
+{
+  const source_line_t *line = find_source_line (img, id);
+  const source_file_t *file;
+  kernel_source_t s;
+
+  if (line == NULL)
+    return 0;
+  if (index[id] != 0)
+    return index[id];
+
+  file = &img.source_table().files[line->file];
+  if (files[line->file] == NULL)
+    {
+      snap.strings.push_back (file->name);
+      files[line->file] = snap.strings.back ().c_str ();
+    }
+  snap.strings.push_back (file->text.c_str () + line->offset);
+  s.file = files[line->file];
+  s.line_no = line->line_no;
+  s.text = snap.strings.back ().c_str ();
+  snap.source_lines.push_back (s);
+  index[id] = (int) snap.source_lines.size ();
+  return index[id];
+}
+
+
+/* Capture the instructions in SEG, which starts at BOT, as runs of
+   non-empty words.  Append each instruction to INSTS. */
+
+static void
+capture_text (MIPSImage &img, kernel_snapshot_t &snap, instruction **seg,
+	      mem_addr bot, mem_addr top, std::vector<std::pair<mem_addr, instruction *> > &insts)
+{
+  std::vector<int> line_index (img.source_table().lines.size () + 1);
+  std::vector<const char *> files (img.source_table().files.size ());
+  int n = (int) (top - bot) / BYTES_PER_WORD;
+  int i = 0;
+
+  while (i < n)
+    {
+      kernel_run_t run;
+
+      for (; i < n && seg[i] == NULL; i ++)
+	;
+      if (i >= n)
+	break;
+
+      run.base = bot + BYTES_PER_WORD * i;
+      snap.words.push_back (std::vector<mem_word> ());
+      snap.sources.push_back (std::vector<int> ());
+      for (; i < n && seg[i] != NULL; i ++)
+	{
+	  mem_addr addr = bot + BYTES_PER_WORD * i;
+
+	  snap.words.back ().push_back (inst_encode (img, seg[i]));
+	  snap.sources.back ().push_back (source_index (img, snap, line_index, files,
+							SOURCE (seg[i])));
+	  insts.push_back (std::make_pair (addr, seg[i]));
+	}
+      run.n_words = (int) snap.words.back ().size ();
+      run.words = snap.words.back ().data ();
+      run.source = snap.sources.back ().data ();
+      snap.text.push_back (run);
+    }
+}
+
+
+/* Capture the words in SEG, which starts at BOT, as runs of words that
+   are not in a long stretch of zeros. */
+
+#define ZERO_GAP 8
+
+static void
+capture_data (kernel_snapshot_t &snap, mem_word *seg, mem_addr bot, mem_addr top)
+{
+  int n = (int) (top - bot) / BYTES_PER_WORD;
+  int i = 0;
+
+  while (i < n)
+    {
+      kernel_run_t run;
+      int zeros = 0;
+      int end;
+
+      for (; i < n && seg[i] == 0; i ++)
+	;
+      if (i >= n)
+	break;
+
+      for (end = i; end < n && zeros < ZERO_GAP; end ++)
+	zeros = (seg[end] == 0) ? zeros + 1 : 0;
+      end -= zeros;
+
+      run.base = bot + BYTES_PER_WORD * i;
+      snap.words.push_back (std::vector<mem_word> (seg + i, seg + end));
+      run.n_words = end - i;
+      run.words = snap.words.back ().data ();
+      run.source = NULL;
+      snap.data.push_back (run);
+      i = end;
+    }
+}
+
+
+/* Capture the program and data in IMG, and the symbols and unresolved
+   references they need, into SNAP.  Return false if IMG holds something
+   that cannot be captured. */
+
+bool
+capture_kernel_image (MIPSImage &img, kernel_snapshot_t &snap)
+{
+  mem_image_t &mem = img.mem_image();
+  reg_image_t &reg = img.reg_image();
+  std::vector<std::pair<mem_addr, instruction *> > insts;
+  std::map<label *, int> index;
+  size_t i;
+
+  capture_text (img, snap, mem.text_seg, TEXT_BOT, mem.text_top, insts);
+  capture_text (img, snap, mem.k_text_seg, K_TEXT_BOT, mem.k_text_top, insts);
+  capture_data (snap, mem.data_seg, DATA_BOT, mem.data_top);
+  capture_data (snap, mem.k_data_seg, K_DATA_BOT, mem.k_data_top);
+
+  for (i = 0; i < (size_t) img.symbol_table().size; i ++)
+    if (label *l = img.symbol_table().slots[i].lab)
+      {
+	int sym = symbol_index (snap, index, l, true);
+
+	for (label_use *u = l->uses; u != NULL; u = u->next)
+	  if (u->inst == NULL)
+	    {
+	      kernel_data_use_t use = {u->addr, sym};
+
+	      snap.data_uses.push_back (use);
+	    }
+	  else if (u->addr < TEXT_BOT || (u->addr >= DATA_BOT && u->addr < K_TEXT_BOT)
+		   || u->addr >= K_DATA_BOT)
+	    /* An instruction assembled into data keeps a private copy
+	       that the text of the image cannot reproduce. */
+	    return false;
+      }
+
+  /* Local labels are out of the table but still name addresses. */
+  for (i = 0; i < img.symbol_table().by_addr.size (); i ++)
+    symbol_index (snap, index, img.symbol_table().by_addr[i], false);
+
+  for (i = 0; i < insts.size (); i ++)
+    {
+      imm_expr *expr = EXPR (insts[i].second);
+      kernel_expr_t e;
+
+      if (expr == NULL || expr->symbol == NULL)
+	continue;
+      e.addr = insts[i].first;
+      e.symbol = symbol_index (snap, index, expr->symbol, false);
+      e.offset = expr->offset;
+      e.bits = expr->bits;
+      e.pc_relative = expr->pc_relative;
+      snap.exprs.push_back (e);
+    }
+
+  snap.image.text = snap.text.data ();
+  snap.image.n_text = (int) snap.text.size ();
+  snap.image.data = snap.data.data ();
+  snap.image.n_data = (int) snap.data.size ();
+  snap.image.symbols = snap.symbols.data ();
+  snap.image.n_symbols = (int) snap.symbols.size ();
+  snap.image.exprs = snap.exprs.data ();
+  snap.image.n_exprs = (int) snap.exprs.size ();
+  snap.image.data_uses = snap.data_uses.data ();
+  snap.image.n_data_uses = (int) snap.data_uses.size ();
+  snap.image.sources = snap.source_lines.data ();
+  snap.image.n_sources = (int) snap.source_lines.size ();
+  snap.image.next_text_pc = reg.next_text_pc;
+  snap.image.next_k_text_pc = reg.next_k_text_pc;
+  snap.image.next_data_pc = reg.next_data_pc;
+  snap.image.next_k_data_pc = reg.next_k_data_pc;
+  snap.image.next_gp_item_addr = reg.next_gp_item_addr;
+  return true;
+}
+
+
+static const char *
+bool_string (bool b)
+{
+  return b ? "true" : "false";
+}
+
+
+/* Write KERNEL as a C++ definition of a kernel_image_t named VAR_NAME.
+   Return false if the write fails. */
+
+bool
+write_kernel_image (const kernel_image_t *kernel, FILE *out, const char *var_name)
+{
+  int i, j;
+
+  fprintf (out, "/* Generated by mkkernel.  Do not edit. */\n\n");
+  fprintf (out, "#include \"kernel_image.h\"\n\n\n");
+
+  for (i = 0; i < kernel->n_text; i ++)
+    {
+      const kernel_run_t *run = &kernel->text[i];
+
+      fprintf (out, "static const mem_word text_%d_words[] = {\n", i);
+      for (j = 0; j < run->n_words; j ++)
+	fprintf (out, "  (mem_word) 0x%08x,\n", (unsigned) run->words[j]);
+      fprintf (out, "};\n\n");
+
+      fprintf (out, "static const int text_%d_source[] = {\n", i);
+      for (j = 0; j < run->n_words; j ++)
+	fprintf (out, "  %d,\n", run->source[j]);
+      fprintf (out, "};\n\n");
+    }
+
+  for (i = 0; i < kernel->n_data; i ++)
+    {
+      const kernel_run_t *run = &kernel->data[i];
+
+      fprintf (out, "static const mem_word data_%d_words[] = {\n", i);
+      for (j = 0; j < run->n_words; j ++)
+	fprintf (out, "  (mem_word) 0x%08x,\n", (unsigned) run->words[j]);
+      fprintf (out, "};\n\n");
+    }
+
+  /* Each table ends with a dummy entry, so none is empty. */
+  fprintf (out, "static const kernel_run_t text_runs[] = {\n");
+  for (i = 0; i < kernel->n_text; i ++)
+    fprintf (out, "  { 0x%08x, %d, text_%d_words, text_%d_source },\n",
+	     kernel->text[i].base, kernel->text[i].n_words, i, i);
+  fprintf (out, "  { 0, 0, NULL, NULL }\n};\n\n");
+
+  fprintf (out, "static const kernel_run_t data_runs[] = {\n");
+  for (i = 0; i < kernel->n_data; i ++)
+    fprintf (out, "  { 0x%08x, %d, data_%d_words, NULL },\n",
+	     kernel->data[i].base, kernel->data[i].n_words, i);
+  fprintf (out, "  { 0, 0, NULL, NULL }\n};\n\n");
+
+  fprintf (out, "static const kernel_symbol_t symbols[] = {\n");
+  for (i = 0; i < kernel->n_symbols; i ++)
+    {
+      const kernel_symbol_t *s = &kernel->symbols[i];
+
+      fputs ("  { ", out);
+      write_c_string (out, s->name);
+      fprintf (out, ", 0x%08x, %s, %s, %s, %s },\n", s->addr,
+	       bool_string (s->in_table), bool_string (s->global_flag),
+	       bool_string (s->const_flag), bool_string (s->gp_flag));
+    }
+  fprintf (out, "  { NULL, 0, false, false, false, false }\n};\n\n");
+
+  fprintf (out, "static const kernel_expr_t exprs[] = {\n");
+  for (i = 0; i < kernel->n_exprs; i ++)
+    {
+      const kernel_expr_t *e = &kernel->exprs[i];
+
+      fprintf (out, "  { 0x%08x, %d, %d, %d, %s },\n", e->addr, e->symbol,
+	       e->offset, (int) e->bits, bool_string (e->pc_relative));
+    }
+  fprintf (out, "  { 0, 0, 0, 0, false }\n};\n\n");
+
+  fprintf (out, "static const kernel_data_use_t data_uses[] = {\n");
+  for (i = 0; i < kernel->n_data_uses; i ++)
+    fprintf (out, "  { 0x%08x, %d },\n", kernel->data_uses[i].addr,
+	     kernel->data_uses[i].symbol);
+  fprintf (out, "  { 0, 0 }\n};\n\n");
+
+  fprintf (out, "static const kernel_source_t sources[] = {\n");
+  for (i = 0; i < kernel->n_sources; i ++)
+    {
+      const kernel_source_t *s = &kernel->sources[i];
+
+      fputs ("  { ", out);
+      write_c_string (out, s->file);
+      fprintf (out, ", %d, ", s->line_no);
+      write_c_string (out, s->text);
+      fputs (" },\n", out);
+    }
+  fprintf (out, "  { NULL, 0, NULL }\n};\n\n\n");
+
+  fprintf (out, "const kernel_image_t %s = {\n", var_name);
+  fprintf (out, "  text_runs, %d,\n", kernel->n_text);
+  fprintf (out, "  data_runs, %d,\n", kernel->n_data);
+  fprintf (out, "  symbols, %d,\n", kernel->n_symbols);
+  fprintf (out, "  exprs, %d,\n", kernel->n_exprs);
+  fprintf (out, "  data_uses, %d,\n", kernel->n_data_uses);
+  fprintf (out, "  sources, %d,\n", kernel->n_sources);
+  fprintf (out, "  0x%08x, 0x%08x, 0x%08x, 0x%08x, 0x%08x\n",
+	   kernel->next_text_pc, kernel->next_k_text_pc, kernel->next_data_pc,
+	   kernel->next_k_data_pc, kernel->next_gp_item_addr);
+  fprintf (out, "};\n");
+
+  return !ferror (out);
+}
@@ -0,0 +1,114 @@
+#ifndef KERNEL_IMAGE_H
+#define KERNEL_IMAGE_H
+
+#include <stdio.h>
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "mem_image.h"
+
+class MIPSImage;
+
+/* The state that assembling a program leaves in an image, captured so
+   other images can install it without running the assembler.  mkkernel
+   captures the default exception handler at build time; the program
+   cache captures user programs at run time. */
+
+/* A run of consecutive instructions (or data words) starting at BASE. */
+
+typedef struct kernel_run {
+	mem_addr base;
+	int n_words;
+	const mem_word *words;
+	const int *source;		/* Per instruction, 1 + index in SOURCES or 0;
+					   NULL for data */
+} kernel_run_t;
+
+/* A line that instructions were assembled from. */
+
+typedef struct kernel_source {
+	const char *file;
+	int line_no;
+	const char *text;
+} kernel_source_t;
+
+/* A label.  IN_TABLE labels are in the symbol table; the rest are local
+   labels that only instructions' expressions still point to. */
+
+typedef struct kernel_symbol {
+	const char *name;
+	mem_addr addr;
+	bool in_table;
+	bool global_flag;
+	bool const_flag;
+	bool gp_flag;
+} kernel_symbol_t;
+
+/* The symbolic immediate of the instruction at ADDR.  Uses of labels
+   that are still undefined (like main) are rebuilt from these. */
+
+typedef struct kernel_expr {
+	mem_addr addr;
+	int symbol;			/* Index in SYMBOLS */
+	int offset;
+	short bits;
+	bool pc_relative;
+} kernel_expr_t;
+
+/* A data word at ADDR waiting for an undefined label. */
+
+typedef struct kernel_data_use {
+	mem_addr addr;
+	int symbol;
+} kernel_data_use_t;
+
+typedef struct kernel_image {
+	const kernel_run_t *text;	/* User and kernel text */
+	int n_text;
+	const kernel_run_t *data;	/* User and kernel data */
+	int n_data;
+	const kernel_symbol_t *symbols;
+	int n_symbols;
+	const kernel_expr_t *exprs;
+	int n_exprs;
+	const kernel_data_use_t *data_uses;
+	int n_data_uses;
+	const kernel_source_t *sources;
+	int n_sources;
+
+	mem_addr next_text_pc;
+	mem_addr next_k_text_pc;
+	mem_addr next_data_pc;
+	mem_addr next_k_data_pc;
+	mem_addr next_gp_item_addr;
+} kernel_image_t;
+
+
+/* A kernel_image_t captured at run time, and the storage its tables
+   point into. */
+
+typedef struct kernel_snapshot {
+	kernel_image_t image;
+	std::vector<kernel_run_t> text;
+	std::vector<kernel_run_t> data;
+	std::deque<std::vector<mem_word> > words;
+	std::deque<std::vector<int> > sources;
+	std::deque<std::string> strings;
+	std::vector<kernel_source_t> source_lines;
+	std::vector<kernel_symbol_t> symbols;
+	std::vector<kernel_expr_t> exprs;
+	std::vector<kernel_data_use_t> data_uses;
+} kernel_snapshot_t;
+
+
+/* The default exception handler (exceptions.s), generated by mkkernel. */
+
+extern const kernel_image_t default_kernel_image;
+
+void install_kernel_image (MIPSImage &img, const kernel_image_t *kernel);
+bool capture_kernel_image (MIPSImage &img, kernel_snapshot_t &snap);
+bool write_kernel_image (const kernel_image_t *kernel, FILE *out, const char *var_name);
+
+#endif
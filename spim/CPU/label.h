@@ -1,6 +1,8 @@
 #ifndef LABEL_H
 #define LABEL_H
 
+#include <vector>
+
 #include "mem_image.h"
 #include "reg_image.h"
 
@@ -21,9 +23,34 @@ typedef struct lab
   unsigned global_flag : 1;	/* Non-zero => declared global */
   unsigned gp_flag : 1;		/* Non-zero => referenced off gp */
   unsigned const_flag : 1;	/* Non-zero => constant value (in addr) */
-  struct lab *next;		/* Hash table link */
   struct lab *next_local;	/* Link in list of local labels */
   label_use *uses;		/* List of instructions that reference */
 } label;			/* label that has not yet been defined */
 
+
+/* Symbol table: an open-addressed set of interned names, each with the
+   label of that name (if any) in the current scope.  Names stay interned
+   after their label is flushed, so slots are never deleted. */
+
+#define SYM_TABLE_INITIAL_SIZE	256	/* Power of 2 */
+
+typedef struct sym_entry
+{
+  const char *name;		/* Interned in the image's arena; NULL => empty */
+  unsigned hash;
+  label *lab;			/* NULL => name has no label in the table */
+} sym_entry;
+
+typedef struct sym_table {
+	sym_entry *slots = NULL;
+	int size = 0;			/* Number of slots, a power of 2 */
+	int n_names = 0;
+	int n_labels = 0;
+
+	/* Every label given an address, local or global, sorted by address
+	   when a lookup needs it. */
+	std::vector<label *> by_addr;
+	bool by_addr_sorted = true;
+} sym_table_t;
+
 #endif
@@ -37,6 +37,9 @@
 #include "image.h"
 #include "reg.h"
 #include "mem.h"
+#include "cache_model.h"
+#include "exec_trace.h"
+#include "mem_heatmap.h"
 
 #include <optional>
 
@@ -48,11 +51,7 @@ static instruction *bad_text_read (MIPSImage &img, mem_addr addr);
 static void bad_text_write (MIPSImage &img, mem_addr addr, instruction *inst);
 static mem_word read_memory_mapped_IO (MIPSImage &img, mem_addr addr);
 static void write_memory_mapped_IO (MIPSImage &img, mem_addr addr, mem_word value);
-
-
-/* Local variables: */
-
-static int32 data_size_limit, stack_size_limit, k_data_size_limit;
+static inline void extend_dirty (mem_dirty_t &range, mem_addr addr, int n);
 
 
 
@@ -87,8 +86,10 @@ static int32 data_size_limit, stack_size_limit, k_data_size_limit;
 
 
 void
-make_memory (MIPSImage &img, int text_size, int data_size, int data_limit,
-	     int stack_size, int stack_limit, int k_text_size,
+make_memory (MIPSImage &img, int text_size, int text_limit,
+	     int data_size, int data_limit,
+	     int stack_size, int stack_limit,
+	     int k_text_size, int k_text_limit,
 	     int k_data_size, int k_data_limit)
 {
   if (data_size <= 65536)
@@ -100,13 +101,15 @@ make_memory (MIPSImage &img, int text_size, int data_size, int data_limit,
     img.mem_image().text_prof = (unsigned *) xmalloc(img, text_size);
   } else
     {
-      free_instructions (img.mem_image().text_seg, (img.mem_image().text_top - TEXT_BOT) / BYTES_PER_WORD);
+      /* The old instructions are in the image's arena and are freed
+	 with it. */
       img.mem_image().text_seg = (instruction **) realloc (img.mem_image().text_seg, BYTES_TO_INST(text_size));
       img.mem_image().text_prof = (unsigned *)realloc(img.mem_image().text_prof,text_size);
     }
   memclr (img.mem_image().text_seg, BYTES_TO_INST(text_size));
   memclr(img.mem_image().text_prof,text_size);
   img.mem_image().text_top = TEXT_BOT + text_size;
+  img.mem_image().text_size_limit = text_limit;
 
   data_size = ROUND_UP(data_size, BYTES_PER_WORD); /* Keep word aligned */
   if (img.mem_image().data_seg == NULL)
@@ -117,7 +120,7 @@ make_memory (MIPSImage &img, int text_size, int data_size, int data_limit,
   img.mem_image().data_seg_b = (BYTE_TYPE *) img.mem_image().data_seg;
   img.mem_image().data_seg_h = (short *) img.mem_image().data_seg;
   img.mem_image().data_top = DATA_BOT + data_size;
-  data_size_limit = data_limit;
+  img.mem_image().data_size_limit = data_limit;
 
   stack_size = ROUND_UP(stack_size, BYTES_PER_WORD); /* Keep word aligned */
   if (img.mem_image().stack_seg == NULL)
@@ -128,7 +131,7 @@ make_memory (MIPSImage &img, int text_size, int data_size, int data_limit,
   img.mem_image().stack_seg_b = (BYTE_TYPE *) img.mem_image().stack_seg;
   img.mem_image().stack_seg_h = (short *) img.mem_image().stack_seg;
   img.mem_image().stack_bot = STACK_TOP - stack_size;
-  stack_size_limit = stack_limit;
+  img.mem_image().stack_size_limit = stack_limit;
 
   if (img.mem_image().special_seg == NULL) {
     img.mem_image().special_seg = (mem_word *) xmalloc (img, SPECIAL_TOP - SPECIAL_BOT);
@@ -142,8 +145,6 @@ make_memory (MIPSImage &img, int text_size, int data_size, int data_limit,
     img.mem_image().k_text_prof = (unsigned *) xmalloc(img, k_text_size);
   } else
     {
-      free_instructions (img.mem_image().k_text_seg,
-			 (img.mem_image().k_text_top - K_TEXT_BOT) / BYTES_PER_WORD);
       img.mem_image().k_text_seg = (instruction **) realloc(img.mem_image().k_text_seg,
 					    BYTES_TO_INST(k_text_size));
       img.mem_image().k_text_prof = (unsigned *) realloc(img.mem_image().k_text_prof, k_text_size);
@@ -151,6 +152,7 @@ make_memory (MIPSImage &img, int text_size, int data_size, int data_limit,
   memclr (img.mem_image().k_text_seg, BYTES_TO_INST(k_text_size));
   memclr (img.mem_image().k_text_prof, k_text_size);
   img.mem_image().k_text_top = K_TEXT_BOT + k_text_size;
+  img.mem_image().k_text_size_limit = k_text_limit;
 
   k_data_size = ROUND_UP(k_data_size, BYTES_PER_WORD); /* Keep word aligned */
   if (img.mem_image().k_data_seg == NULL)
@@ -161,10 +163,13 @@ make_memory (MIPSImage &img, int text_size, int data_size, int data_limit,
   img.mem_image().k_data_seg_b = (BYTE_TYPE *) img.mem_image().k_data_seg;
   img.mem_image().k_data_seg_h = (short *) img.mem_image().k_data_seg;
   img.mem_image().k_data_top = K_DATA_BOT + k_data_size;
-  k_data_size_limit = k_data_limit;
+  img.mem_image().k_data_size_limit = k_data_limit;
 
   img.mem_image().text_modified = true;
   img.mem_image().data_modified = true;
+  clear_mem_dirty (img);
+  invalidate_disassembly (img, TEXT_BOT);
+  invalidate_disassembly (img, K_TEXT_BOT);
 }
 
 
@@ -222,19 +227,6 @@ void mem_dump_profile(MIPSImage &img) {
 }
 
 
-/* Free the storage used by the old instructions in memory. */
-
-void
-free_instructions (instruction **inst, int n)
-{
-  if (!inst)
-    return;
-  for ( ; n > 0; n --, inst ++)
-    if (*inst)
-      free_inst (*inst);
-}
-
-
 /* Expand the data segment by adding N bytes. */
 
 void
@@ -245,7 +237,7 @@ expand_data (MIPSImage &img, int addl_bytes)
   int new_size = old_size + delta;
   BYTE_TYPE *p;
 
-  if ((addl_bytes < 0) || (new_size > data_size_limit))
+  if ((addl_bytes < 0) || (new_size > img.mem_image().data_size_limit))
     {
       error (img, "Can't expand data segment by %d bytes to %d bytes\n",
 	     addl_bytes, new_size);
@@ -262,6 +254,7 @@ expand_data (MIPSImage &img, int addl_bytes)
   /* Zero new memory */
   for (p = img.mem_image().data_seg_b + old_size; p < img.mem_image().data_seg_b + new_size; )
     *p ++ = 0;
+  HEAT_RESIZE (img);
 }
 
 
@@ -278,7 +271,7 @@ expand_stack (MIPSImage &img, int addl_bytes)
   mem_word *new_seg;
   mem_word *po, *pn;
 
-  if ((addl_bytes < 0) || (new_size > stack_size_limit))
+  if ((addl_bytes < 0) || (new_size > img.mem_image().stack_size_limit))
     {
       run_error (img, "Can't expand stack segment by %d bytes to %d bytes.\nUse -lstack # with # > %d\n",
                  addl_bytes, new_size, new_size);
@@ -296,6 +289,7 @@ expand_stack (MIPSImage &img, int addl_bytes)
   img.mem_image().stack_seg_b = (BYTE_TYPE *) img.mem_image().stack_seg;
   img.mem_image().stack_seg_h = (short *) img.mem_image().stack_seg;
   img.mem_image().stack_bot -= (new_size - old_size);
+  HEAT_RESIZE (img);
 }
 
 
@@ -309,7 +303,7 @@ expand_k_data (MIPSImage &img, int addl_bytes)
   int new_size = old_size + delta;
   BYTE_TYPE *p;
 
-  if ((addl_bytes < 0) || (new_size > k_data_size_limit))
+  if ((addl_bytes < 0) || (new_size > img.mem_image().k_data_size_limit))
     {
       run_error (img, "Can't expand kernel data segment by %d bytes to %d bytes.\nUse -lkdata # with # > %d\n",
                  addl_bytes, new_size, new_size);
@@ -326,6 +320,60 @@ expand_k_data (MIPSImage &img, int addl_bytes)
   for (p = img.mem_image().k_data_seg_b + old_size / BYTES_PER_WORD;
        p < img.mem_image().k_data_seg_b + new_size / BYTES_PER_WORD; )
     *p ++ = 0;
+  HEAT_RESIZE (img);
+}
+
+
+/* Grow the text segment SEG (with its profile PROF) that starts at BOT
+   and ends at *TOP by ADDL_BYTES, up to LIMIT bytes. */
+
+static void
+expand_text_segment (MIPSImage &img, instruction ***seg, unsigned **prof,
+		     mem_addr bot, mem_addr *top, int32 limit, int addl_bytes,
+		     const char *name)
+{
+  int delta = ROUND_UP(addl_bytes, BYTES_PER_WORD); /* Keep word aligned */
+  int old_size = *top - bot;
+  int new_size = old_size + delta;
+
+  if ((addl_bytes < 0) || (new_size > limit))
+    {
+      run_error (img, "Can't expand %s segment by %d bytes to %d bytes\n",
+		 name, addl_bytes, new_size);
+    }
+  *seg = (instruction **) realloc (*seg, BYTES_TO_INST(new_size));
+  *prof = (unsigned *) realloc (*prof, new_size);
+  if (*seg == NULL || *prof == NULL)
+    fatal_error (img, "realloc failed in expand_text_segment\n");
+
+  /* The new words hold no instructions and have not been executed. */
+  memclr (&(*seg)[old_size / BYTES_PER_WORD], BYTES_TO_INST(new_size) - BYTES_TO_INST(old_size));
+  memclr (&(*prof)[old_size / BYTES_PER_WORD], delta);
+  *top += delta;
+}
+
+
+/* Expand the text segment by adding N bytes. */
+
+void
+expand_text (MIPSImage &img, int addl_bytes)
+{
+  mem_image_t &mem = img.mem_image();
+
+  expand_text_segment (img, &mem.text_seg, &mem.text_prof, TEXT_BOT, &mem.text_top,
+		       mem.text_size_limit, addl_bytes, "text");
+}
+
+
+/* Expand the kernel text segment by adding N bytes. */
+
+void
+expand_k_text (MIPSImage &img, int addl_bytes)
+{
+  mem_image_t &mem = img.mem_image();
+
+  expand_text_segment (img, &mem.k_text_seg, &mem.k_text_prof, K_TEXT_BOT, &mem.k_text_top,
+		       mem.k_text_size_limit, addl_bytes, "kernel text");
 }
 
 
@@ -374,15 +422,28 @@ read_mem_byte(MIPSImage &img, mem_addr addr)
   std::optional<reg_word> custom_read = img.custom_memory_read_byte(addr);
   if (custom_read.has_value())
     return custom_read.value();
+  CACHE_DATA_ACCESS (img, addr, false);
 
   if ((addr >= DATA_BOT) && (addr < img.mem_image().data_top))
-    return img.mem_image().data_seg_b [addr - DATA_BOT];
+    {
+      HEAT_READ (img, HEAT_DATA, addr - DATA_BOT);
+      return img.mem_image().data_seg_b [addr - DATA_BOT];
+    }
   else if ((addr >= img.mem_image().stack_bot) && (addr < STACK_TOP))
-    return img.mem_image().stack_seg_b [addr - img.mem_image().stack_bot];
+    {
+      HEAT_READ (img, HEAT_STACK, STACK_TOP - 1 - addr);
+      return img.mem_image().stack_seg_b [addr - img.mem_image().stack_bot];
+    }
   else if ((addr >= K_DATA_BOT) && (addr < img.mem_image().k_data_top))
-    return img.mem_image().k_data_seg_b [addr - K_DATA_BOT];
+    {
+      HEAT_READ (img, HEAT_K_DATA, addr - K_DATA_BOT);
+      return img.mem_image().k_data_seg_b [addr - K_DATA_BOT];
+    }
   else if ((addr >= SPECIAL_BOT) && (addr < SPECIAL_TOP))
-    return img.mem_image().special_seg_b [addr - SPECIAL_BOT];
+    {
+      HEAT_READ (img, HEAT_SPECIAL, addr - SPECIAL_BOT);
+      return img.mem_image().special_seg_b [addr - SPECIAL_BOT];
+    }
   else
     return bad_mem_read (img, addr, 0);
 }
@@ -394,15 +455,28 @@ read_mem_half(MIPSImage &img, mem_addr addr)
   std::optional<reg_word> custom_read = img.custom_memory_read_half(addr);
   if (custom_read.has_value())
     return custom_read.value();
+  CACHE_DATA_ACCESS (img, addr, false);
 
   if ((addr >= DATA_BOT) && (addr < img.mem_image().data_top) && !(addr & 0x1))
-    return img.mem_image().data_seg_h [(addr - DATA_BOT) >> 1];
+    {
+      HEAT_READ (img, HEAT_DATA, addr - DATA_BOT);
+      return img.mem_image().data_seg_h [(addr - DATA_BOT) >> 1];
+    }
   else if ((addr >= img.mem_image().stack_bot) && (addr < STACK_TOP) && !(addr & 0x1))
-    return img.mem_image().stack_seg_h [(addr - img.mem_image().stack_bot) >> 1];
+    {
+      HEAT_READ (img, HEAT_STACK, STACK_TOP - 1 - addr);
+      return img.mem_image().stack_seg_h [(addr - img.mem_image().stack_bot) >> 1];
+    }
   else if ((addr >= K_DATA_BOT) && (addr < img.mem_image().k_data_top) && !(addr & 0x1))
-    return img.mem_image().k_data_seg_h [(addr - K_DATA_BOT) >> 1];
+    {
+      HEAT_READ (img, HEAT_K_DATA, addr - K_DATA_BOT);
+      return img.mem_image().k_data_seg_h [(addr - K_DATA_BOT) >> 1];
+    }
   else if ((addr >= SPECIAL_BOT) && (addr < SPECIAL_TOP) && !(addr & 0x1))
-    return img.mem_image().special_seg_h [(addr - SPECIAL_BOT) >> 1];
+    {
+      HEAT_READ (img, HEAT_SPECIAL, addr - SPECIAL_BOT);
+      return img.mem_image().special_seg_h [(addr - SPECIAL_BOT) >> 1];
+    }
   else
     return bad_mem_read (img, addr, 0x1);
 }
@@ -414,15 +488,28 @@ read_mem_word(MIPSImage &img, mem_addr addr)
   std::optional<reg_word> custom_read = img.custom_memory_read_word(addr);
   if (custom_read.has_value())
     return custom_read.value();
+  CACHE_DATA_ACCESS (img, addr, false);
 
   if ((addr >= DATA_BOT) && (addr < img.mem_image().data_top) && !(addr & 0x3))
-    return img.mem_image().data_seg [(addr - DATA_BOT) >> 2];
+    {
+      HEAT_READ (img, HEAT_DATA, addr - DATA_BOT);
+      return img.mem_image().data_seg [(addr - DATA_BOT) >> 2];
+    }
   else if ((addr >= img.mem_image().stack_bot) && (addr < STACK_TOP) && !(addr & 0x3))
-    return img.mem_image().stack_seg [(addr - img.mem_image().stack_bot) >> 2];
+    {
+      HEAT_READ (img, HEAT_STACK, STACK_TOP - 1 - addr);
+      return img.mem_image().stack_seg [(addr - img.mem_image().stack_bot) >> 2];
+    }
   else if ((addr >= K_DATA_BOT) && (addr < img.mem_image().k_data_top) && !(addr & 0x3))
-    return img.mem_image().k_data_seg [(addr - K_DATA_BOT) >> 2];
+    {
+      HEAT_READ (img, HEAT_K_DATA, addr - K_DATA_BOT);
+      return img.mem_image().k_data_seg [(addr - K_DATA_BOT) >> 2];
+    }
   else if ((addr >= SPECIAL_BOT) && (addr < SPECIAL_TOP) && !(addr & 0x3))
-    return img.mem_image().special_seg [(addr - SPECIAL_BOT) >> 2];
+    {
+      HEAT_READ (img, HEAT_SPECIAL, addr - SPECIAL_BOT);
+      return img.mem_image().special_seg [(addr - SPECIAL_BOT) >> 2];
+    }
   else
     return bad_mem_read (img, addr, 0x3);
 }
@@ -432,14 +519,15 @@ void
 set_mem_inst(MIPSImage &img, mem_addr addr, instruction* inst)
 {
   img.mem_image().text_modified = true;
+  invalidate_disassembly (img, addr);
   if ((addr >= TEXT_BOT) && (addr < img.mem_image().text_top) && !(addr & 0x3)) {
     if (img.mem_image().text_seg [(addr - TEXT_BOT) >> 2]) {
-        free_inst(img.mem_image().text_seg [(addr - TEXT_BOT) >> 2]);
+        free_inst (img, img.mem_image().text_seg [(addr - TEXT_BOT) >> 2]);
     }
     img.mem_image().text_seg [(addr - TEXT_BOT) >> 2] = inst;
   } else if ((addr >= K_TEXT_BOT) && (addr < img.mem_image().k_text_top) && !(addr & 0x3)) {
     if (img.mem_image().k_text_seg [(addr - K_TEXT_BOT) >> 2]) {
-        free_inst(img.mem_image().k_text_seg [(addr - K_TEXT_BOT) >> 2]);
+        free_inst (img, img.mem_image().k_text_seg [(addr - K_TEXT_BOT) >> 2]);
     }
     img.mem_image().k_text_seg [(addr - K_TEXT_BOT) >> 2] = inst;
   }
@@ -454,15 +542,32 @@ set_mem_byte(MIPSImage &img, mem_addr addr, reg_word value)
   img.mem_image().data_modified = true;
   if (img.custom_memory_write_byte(addr, value))
     return;
+  CACHE_DATA_ACCESS (img, addr, true);
+  TRACE_STORE (img, addr, 1, value);
 
   if ((addr >= DATA_BOT) && (addr < img.mem_image().data_top))
-    img.mem_image().data_seg_b [addr - DATA_BOT] = (BYTE_TYPE) value;
+    {
+      img.mem_image().data_seg_b [addr - DATA_BOT] = (BYTE_TYPE) value;
+      HEAT_WRITE (img, HEAT_DATA, addr - DATA_BOT);
+      extend_dirty (img.mem_image().data_dirty, addr, 1);
+    }
   else if ((addr >= img.mem_image().stack_bot) && (addr < STACK_TOP))
-    img.mem_image().stack_seg_b [addr - img.mem_image().stack_bot] = (BYTE_TYPE) value;
+    {
+      img.mem_image().stack_seg_b [addr - img.mem_image().stack_bot] = (BYTE_TYPE) value;
+      HEAT_WRITE (img, HEAT_STACK, STACK_TOP - 1 - addr);
+      extend_dirty (img.mem_image().stack_dirty, addr, 1);
+    }
   else if ((addr >= K_DATA_BOT) && (addr < img.mem_image().k_data_top))
-    img.mem_image().k_data_seg_b [addr - K_DATA_BOT] = (BYTE_TYPE) value;
+    {
+      img.mem_image().k_data_seg_b [addr - K_DATA_BOT] = (BYTE_TYPE) value;
+      HEAT_WRITE (img, HEAT_K_DATA, addr - K_DATA_BOT);
+      extend_dirty (img.mem_image().k_data_dirty, addr, 1);
+    }
   else if ((addr >= SPECIAL_BOT) && (addr < SPECIAL_TOP))
-    img.mem_image().special_seg [addr - SPECIAL_BOT] = (BYTE_TYPE) value;
+    {
+      HEAT_WRITE (img, HEAT_SPECIAL, addr - SPECIAL_BOT);
+      img.mem_image().special_seg [addr - SPECIAL_BOT] = (BYTE_TYPE) value;
+    }
   else
     bad_mem_write (img, addr, value, 0);
 }
@@ -474,15 +579,32 @@ set_mem_half(MIPSImage &img, mem_addr addr, reg_word value)
   img.mem_image().data_modified = true;
   if (img.custom_memory_write_half(addr, value))
     return;
+  CACHE_DATA_ACCESS (img, addr, true);
+  TRACE_STORE (img, addr, 2, value);
 
   if ((addr >= DATA_BOT) && (addr < img.mem_image().data_top) && !(addr & 0x1))
-    img.mem_image().data_seg_h [(addr - DATA_BOT) >> 1] = (short) value;
+    {
+      img.mem_image().data_seg_h [(addr - DATA_BOT) >> 1] = (short) value;
+      HEAT_WRITE (img, HEAT_DATA, addr - DATA_BOT);
+      extend_dirty (img.mem_image().data_dirty, addr, 2);
+    }
   else if ((addr >= img.mem_image().stack_bot) && (addr < STACK_TOP) && !(addr & 0x1))
-    img.mem_image().stack_seg_h [(addr - img.mem_image().stack_bot) >> 1] = (short) value;
+    {
+      img.mem_image().stack_seg_h [(addr - img.mem_image().stack_bot) >> 1] = (short) value;
+      HEAT_WRITE (img, HEAT_STACK, STACK_TOP - 1 - addr);
+      extend_dirty (img.mem_image().stack_dirty, addr, 2);
+    }
   else if ((addr >= K_DATA_BOT) && (addr < img.mem_image().k_data_top) && !(addr & 0x1))
-    img.mem_image().k_data_seg_h [(addr - K_DATA_BOT) >> 1] = (short) value;
+    {
+      img.mem_image().k_data_seg_h [(addr - K_DATA_BOT) >> 1] = (short) value;
+      HEAT_WRITE (img, HEAT_K_DATA, addr - K_DATA_BOT);
+      extend_dirty (img.mem_image().k_data_dirty, addr, 2);
+    }
   else if ((addr >= SPECIAL_BOT) && (addr < SPECIAL_TOP) && !(addr & 0x1))
-    img.mem_image().special_seg_h [(addr - SPECIAL_BOT) >> 1] = (short) value;
+    {
+      HEAT_WRITE (img, HEAT_SPECIAL, addr - SPECIAL_BOT);
+      img.mem_image().special_seg_h [(addr - SPECIAL_BOT) >> 1] = (short) value;
+    }
   else
     bad_mem_write (img, addr, value, 0x1);
 }
@@ -494,20 +616,106 @@ set_mem_word(MIPSImage &img, mem_addr addr, reg_word value)
   img.mem_image().data_modified = true;
   if (img.custom_memory_write_word(addr, value))
     return;
+  CACHE_DATA_ACCESS (img, addr, true);
+  TRACE_STORE (img, addr, 4, value);
 
   if ((addr >= DATA_BOT) && (addr < img.mem_image().data_top) && !(addr & 0x3))
-    img.mem_image().data_seg [(addr - DATA_BOT) >> 2] = (mem_word) value;
+    {
+      img.mem_image().data_seg [(addr - DATA_BOT) >> 2] = (mem_word) value;
+      HEAT_WRITE (img, HEAT_DATA, addr - DATA_BOT);
+      extend_dirty (img.mem_image().data_dirty, addr, 4);
+    }
   else if ((addr >= img.mem_image().stack_bot) && (addr < STACK_TOP) && !(addr & 0x3))
-    img.mem_image().stack_seg [(addr - img.mem_image().stack_bot) >> 2] = (mem_word) value;
+    {
+      img.mem_image().stack_seg [(addr - img.mem_image().stack_bot) >> 2] = (mem_word) value;
+      HEAT_WRITE (img, HEAT_STACK, STACK_TOP - 1 - addr);
+      extend_dirty (img.mem_image().stack_dirty, addr, 4);
+    }
   else if ((addr >= K_DATA_BOT) && (addr < img.mem_image().k_data_top) && !(addr & 0x3))
-    img.mem_image().k_data_seg [(addr - K_DATA_BOT) >> 2] = (mem_word) value;
+    {
+      img.mem_image().k_data_seg [(addr - K_DATA_BOT) >> 2] = (mem_word) value;
+      HEAT_WRITE (img, HEAT_K_DATA, addr - K_DATA_BOT);
+      extend_dirty (img.mem_image().k_data_dirty, addr, 4);
+    }
   else if ((addr >= SPECIAL_BOT) && (addr < SPECIAL_TOP) && !(addr & 0x3))
-    img.mem_image().special_seg [(addr - SPECIAL_BOT) >> 2] = (mem_word) value;
+    {
+      HEAT_WRITE (img, HEAT_SPECIAL, addr - SPECIAL_BOT);
+      img.mem_image().special_seg [(addr - SPECIAL_BOT) >> 2] = (mem_word) value;
+    }
   else
     bad_mem_write (img, addr, value, 0x3);
 }
 
 
+/* Track the ranges of the data, stack, and kernel data segments that
+   were written, so the display only refreshes what a program touched. */
+
+static inline void
+extend_dirty (mem_dirty_t &range, mem_addr addr, int n)
+{
+  if (range.lo >= range.hi)
+    {
+      range.lo = addr;
+      range.hi = addr + n;
+    }
+  else
+    {
+      if (addr < range.lo)
+	range.lo = addr;
+      if (addr + n > range.hi)
+	range.hi = addr + n;
+    }
+}
+
+
+/* Record that N bytes starting at ADDR were written behind the back of
+   the set_mem_* functions (e.g., by a syscall).  Bytes past the end of
+   ADDR's segment are not memory, so they are left out. */
+
+void
+mark_mem_dirty (MIPSImage &img, mem_addr addr, int n)
+{
+  mem_dirty_t *range;
+  mem_addr top;
+
+  if (n <= 0)
+    return;
+  if ((addr >= DATA_BOT) && (addr < img.mem_image().data_top))
+    {
+      range = &img.mem_image().data_dirty;
+      top = img.mem_image().data_top;
+    }
+  else if ((addr >= img.mem_image().stack_bot) && (addr < STACK_TOP))
+    {
+      range = &img.mem_image().stack_dirty;
+      top = STACK_TOP;
+    }
+  else if ((addr >= K_DATA_BOT) && (addr < img.mem_image().k_data_top))
+    {
+      range = &img.mem_image().k_data_dirty;
+      top = img.mem_image().k_data_top;
+    }
+  else
+    return;
+  n = (int) MIN ((mem_addr) n, top - addr);
+  extend_dirty (*range, addr, n);
+  TRACE_STORE_BYTES (img, addr, n, mem_reference (img, addr));
+  HEAT_WRITE_RANGE (img, addr, n);
+}
+
+
+/* Acknowledge the dirty ranges: the display has caught up with memory. */
+
+void
+clear_mem_dirty (MIPSImage &img)
+{
+  img.mem_image().data_dirty = mem_dirty_t ();
+  img.mem_image().stack_dirty = mem_dirty_t ();
+  img.mem_image().k_data_dirty = mem_dirty_t ();
+  img.mem_image().dirty_version += 1;
+}
+
+
 /* Handle the infrequent and erroneous cases in memory accesses. */
 
 static instruction *
@@ -573,6 +781,8 @@ bad_mem_read (MIPSImage &img, mem_addr addr, int mask)
     {
       /* Grow stack segment */
       expand_stack (img, img.mem_image().stack_bot - addr + 4);
+      if (addr >= img.mem_image().stack_bot)
+	HEAT_READ (img, HEAT_STACK, STACK_TOP - 1 - addr);
       return (0);
     }
   else if (MM_IO_BOT <= addr && addr <= MM_IO_TOP)
@@ -627,11 +837,18 @@ bad_mem_write (MIPSImage &img, mem_addr addr, mem_word value, int mask)
       run_error (img, "Bad mask (0x%x) in bad_mem_read\n", mask);
     }
 
-    if (img.mem_image().text_seg [(addr - TEXT_BOT) >> 2] != NULL)
+    /* Self-modifying code: decode the new word over the old instruction
+       (unless it is the shared breakpoint, which is never freed). */
+    instruction *&inst = img.mem_image().text_seg [(addr - TEXT_BOT) >> 2];
+    if (inst != NULL && !inst_is_breakpoint (img, addr))
     {
-      free_inst (img.mem_image().text_seg[(addr - TEXT_BOT) >> 2]);
+      if (EXPR (inst) != NULL)
+        free_imm_expr (img, EXPR (inst));
+      inst_decode_into (tmp, inst);
     }
-    img.mem_image().text_seg [(addr - TEXT_BOT) >> 2] = inst_decode (img, tmp);
+    else
+      inst = inst_decode (img, tmp);
+    invalidate_disassembly (img, addr);
 
     img.mem_image().text_modified = true;
   }
@@ -650,6 +867,8 @@ bad_mem_write (MIPSImage &img, mem_addr addr, mem_word value, int mask)
 	img.mem_image().stack_seg_h [(addr - img.mem_image().stack_bot) >> 1] = (short)value;
       else
 	img.mem_image().stack_seg [(addr - img.mem_image().stack_bot) >> 2] = value;
+      HEAT_WRITE (img, HEAT_STACK, STACK_TOP - 1 - addr);
+      extend_dirty (img.mem_image().stack_dirty, addr, mask + 1);
     }
     else
       RAISE_EXCEPTION (img, ExcCode_DBE, img.reg_image().CP0_BadVAddr = addr)
@@ -49,10 +49,16 @@
 void check_memory_mapped_IO ();
 void expand_data (MIPSImage &img, int addl_bytes);
 void expand_k_data (MIPSImage &img, int addl_bytes);
+void expand_k_text (MIPSImage &img, int addl_bytes);
 void expand_stack (MIPSImage &img, int addl_bytes);
-void make_memory (MIPSImage &img, int text_size, int data_size, int data_limit,
-		  int stack_size, int stack_limit, int k_text_size,
+void expand_text (MIPSImage &img, int addl_bytes);
+void make_memory (MIPSImage &img, int text_size, int text_limit,
+		  int data_size, int data_limit,
+		  int stack_size, int stack_limit,
+		  int k_text_size, int k_text_limit,
 		  int k_data_size, int k_data_limit);
+void clear_mem_dirty (MIPSImage &img);
+void mark_mem_dirty (MIPSImage &img, mem_addr addr, int n);
 void* mem_reference(MIPSImage &img, mem_addr addr); // TODO: Stopped here
 void print_mem (MIPSImage &img, mem_addr addr);
 instruction* read_mem_inst(MIPSImage &img, mem_addr addr);
@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "spim.h"
+#include "image.h"
+#include "mem_heatmap.h"
+
+
+/* log2 of BUCKET_SIZE, or -1 if that is not a power of two from 4 to
+   64K. */
+
+int
+heatmap_bucket_shift (uint32 bucket_size)
+{
+  int shift;
+
+  for (shift = 2; shift <= 16; shift ++)
+    if (bucket_size == (1u << shift))
+      return shift;
+  return -1;
+}
+
+
+/* Start counting IMG's data accesses in buckets of BUCKET_SIZE bytes,
+   from zero.  Return false if heatmap_bucket_shift does not allow it. */
+
+bool
+heatmap_enable (MIPSImage &img, uint32 bucket_size)
+{
+  std::unique_ptr<mem_heatmap_t> heat (new mem_heatmap_t ());
+  int shift = heatmap_bucket_shift (bucket_size);
+
+  if (shift < 0)
+    return false;
+
+  heat->shift = shift;
+  img.set_heatmap (std::move (heat));
+  heatmap_resize (img);
+  return true;
+}
+
+
+void
+heatmap_disable (MIPSImage &img)
+{
+  img.set_heatmap (nullptr);
+}
+
+
+/* Give IMG's map a bucket for every byte of each segment as it is now.
+   Segments only grow, and so do the vectors. */
+
+void
+heatmap_resize (MIPSImage &img)
+{
+  mem_heatmap_t *heat = img.heatmap();
+  mem_addr sizes[HEAT_N_SEGMENTS];
+  int s;
+
+  sizes[HEAT_DATA] = img.mem_image().data_top - DATA_BOT;
+  sizes[HEAT_STACK] = STACK_TOP - img.mem_image().stack_bot;
+  sizes[HEAT_K_DATA] = img.mem_image().k_data_top - K_DATA_BOT;
+  sizes[HEAT_SPECIAL] = SPECIAL_TOP - SPECIAL_BOT;
+  for (s = 0; s < HEAT_N_SEGMENTS; s ++)
+    {
+      size_t buckets = ((size_t) sizes[s] + (1u << heat->shift) - 1) >> heat->shift;
+
+      if (buckets > heat->reads[s].size ())
+	{
+	  heat->reads[s].resize (buckets);
+	  heat->writes[s].resize (buckets);
+	}
+    }
+}
+
+
+/* N bytes starting at ADDR were written behind the set_mem_* functions'
+   back.  Count one write in each bucket they touch, up to the end of
+   ADDR's segment. */
+
+void
+heatmap_write_range (MIPSImage &img, mem_addr addr, int n)
+{
+  mem_heatmap_t *heat = img.heatmap();
+  heat_segment seg;
+  mem_addr first, last, b;
+
+  if (n <= 0)
+    return;
+  if ((addr >= DATA_BOT) && (addr < img.mem_image().data_top))
+    {
+      seg = HEAT_DATA;
+      first = addr - DATA_BOT;
+      last = first + MIN ((mem_addr) n, img.mem_image().data_top - addr) - 1;
+    }
+  else if ((addr >= img.mem_image().stack_bot) && (addr < STACK_TOP))
+    {
+      seg = HEAT_STACK;
+      first = STACK_TOP - addr - MIN ((mem_addr) n, STACK_TOP - addr);
+      last = STACK_TOP - 1 - addr;
+    }
+  else if ((addr >= K_DATA_BOT) && (addr < img.mem_image().k_data_top))
+    {
+      seg = HEAT_K_DATA;
+      first = addr - K_DATA_BOT;
+      last = first + MIN ((mem_addr) n, img.mem_image().k_data_top - addr) - 1;
+    }
+  else
+    return;
+
+  for (b = first >> heat->shift; b <= last >> heat->shift; b ++)
+    heat_count (heat->writes[seg], b);
+}
+
+
+/* The lowest address in bucket BUCKET of segment SEG. */
+
+mem_addr
+heatmap_bucket_addr (const mem_heatmap_t &heat, heat_segment seg, mem_addr bucket)
+{
+  switch (seg)
+    {
+    case HEAT_DATA: return DATA_BOT + (bucket << heat.shift);
+    case HEAT_STACK: return STACK_TOP - ((bucket + 1) << heat.shift);
+    case HEAT_K_DATA: return K_DATA_BOT + (bucket << heat.shift);
+    case HEAT_SPECIAL: return SPECIAL_BOT + (bucket << heat.shift);
+    default: return 0;
+    }
+}
+
+
+const char *
+heat_segment_name (heat_segment seg)
+{
+  switch (seg)
+    {
+    case HEAT_DATA: return "data";
+    case HEAT_STACK: return "stack";
+    case HEAT_K_DATA: return "kdata";
+    case HEAT_SPECIAL: return "special";
+    default: return "?";
+    }
+}
+
+
+/* The N buckets with the most accesses, most first.  Buckets that were
+   never touched are left out. */
+
+std::vector<heat_bucket_t>
+heatmap_hottest (MIPSImage &img, size_t n)
+{
+  std::vector<heat_bucket_t> result;
+  mem_heatmap_t *heat = img.heatmap();
+  int s;
+
+  if (heat == NULL)
+    return result;
+
+  for (s = 0; s < HEAT_N_SEGMENTS; s ++)
+    {
+      heat_segment seg = (heat_segment) s;
+      mem_addr b;
+
+      for (b = 0; b < heat->reads[s].size (); b ++)
+	{
+	  uint32_t reads = heat->reads[s][b];
+	  uint32_t writes = heat->writes[s][b];
+
+	  if (reads != 0 || writes != 0)
+	    result.push_back (heat_bucket_t {seg, heatmap_bucket_addr (*heat, seg, b), reads, writes});
+	}
+    }
+
+  auto hotter = [] (const heat_bucket_t &a, const heat_bucket_t &b)
+    {
+      return (uint64_t) a.reads + a.writes > (uint64_t) b.reads + b.writes;
+    };
+  if (result.size () > n)
+    {
+      std::partial_sort (result.begin (), result.begin () + n, result.end (), hotter);
+      result.resize (n);
+    }
+  else
+    std::sort (result.begin (), result.end (), hotter);
+  return result;
+}
@@ -0,0 +1,77 @@
+#ifndef MEM_HEATMAP_H
+#define MEM_HEATMAP_H
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "spim.h"
+
+class MIPSImage;
+
+/* Counts of the loads and stores that hit each bucket (a page, a cache
+   line, or any power of two from 4 bytes to 64K) of the data, stack,
+   kernel data, and special segments, for drawing a heatmap of where a
+   program works.
+
+   Bucket I of a segment starts I buckets above the segment's base
+   address, except in the stack, which grows down: there bucket I ends
+   I buckets below STACK_TOP.  heatmap_enable sizes the vectors to the
+   segments, and heatmap_resize extends them whenever expand_data,
+   expand_stack, or expand_k_data grows one, so every access lands in a
+   bucket that is already there.  Counts are 32 bits and wrap.
+
+   A context counts nothing until heatmap_enable gives it a map; until
+   then the HEAT_* hooks in mem.cpp cost a null check, and afterwards an
+   increment on the offset the access computes anyway. */
+
+enum heat_segment {
+	HEAT_DATA,
+	HEAT_STACK,
+	HEAT_K_DATA,
+	HEAT_SPECIAL,
+	HEAT_N_SEGMENTS
+};
+
+typedef struct mem_heatmap {
+	int shift;			/* log2 of bytes per bucket */
+	std::vector<uint32_t> reads[HEAT_N_SEGMENTS];
+	std::vector<uint32_t> writes[HEAT_N_SEGMENTS];
+} mem_heatmap_t;
+
+typedef struct heat_bucket {
+	heat_segment segment;
+	mem_addr addr;			/* Lowest address in the bucket */
+	uint32_t reads;
+	uint32_t writes;
+} heat_bucket_t;
+
+static inline void
+heat_count (std::vector<uint32_t> &counts, mem_addr bucket)
+{
+  counts[bucket] += 1;
+}
+
+/* OFFSET is the access's distance from the segment's base; for the
+   stack, use STACK_TOP - 1 - addr. */
+#define HEAT_READ(img, SEG, OFFSET)					\
+		if (img.heatmap() != NULL)				\
+		  heat_count (img.heatmap()->reads[SEG], (OFFSET) >> img.heatmap()->shift)
+#define HEAT_WRITE(img, SEG, OFFSET)					\
+		if (img.heatmap() != NULL)				\
+		  heat_count (img.heatmap()->writes[SEG], (OFFSET) >> img.heatmap()->shift)
+#define HEAT_WRITE_RANGE(img, ADDR, N)					\
+		if (img.heatmap() != NULL) heatmap_write_range (img, ADDR, N)
+#define HEAT_RESIZE(img)						\
+		if (img.heatmap() != NULL) heatmap_resize (img)
+
+int heatmap_bucket_shift (uint32 bucket_size);
+bool heatmap_enable (MIPSImage &img, uint32 bucket_size);
+void heatmap_disable (MIPSImage &img);
+void heatmap_resize (MIPSImage &img);
+void heatmap_write_range (MIPSImage &img, mem_addr addr, int n);
+mem_addr heatmap_bucket_addr (const mem_heatmap_t &heat, heat_segment seg, mem_addr bucket);
+const char *heat_segment_name (heat_segment seg);
+std::vector<heat_bucket_t> heatmap_hottest (MIPSImage &img, size_t n);
+
+#endif
@@ -38,7 +38,12 @@ typedef int32 /*@alt unsigned int @*/ mem_word;
 #define SPECIAL_BOT		((mem_addr) 0xfffe0000)
 #define SPECIAL_TOP		((mem_addr) 0xffff0000)
 
-void free_instructions (instruction **inst, int n);
+/* Addresses [LO, HI) written since the display last acknowledged them.
+   An empty range has LO >= HI. */
+typedef struct memdirty {
+	mem_addr lo = 0;
+	mem_addr hi = 0;
+} mem_dirty_t;
 
 typedef struct memimage {
 	/* The text segment. */
@@ -77,11 +82,23 @@ typedef struct memimage {
 	BYTE_TYPE *k_data_seg_b = 0;
 	mem_addr k_data_top = 0;
 
+	/* Largest size each segment may grow to. */
+	int32 text_size_limit = 0;
+	int32 k_text_size_limit = 0;
+	int32 data_size_limit = 0;
+	int32 stack_size_limit = 0;
+	int32 k_data_size_limit = 0;
+
 	char* prof_file_name = 0;
 
+	/* Ranges written since the last acknowledgement, so the display
+	   can refresh only what the program touched. */
+	mem_dirty_t data_dirty;
+	mem_dirty_t stack_dirty;
+	mem_dirty_t k_data_dirty;
+	unsigned dirty_version = 0;	/* Bumped on every acknowledgement */
+
     ~memimage() {
-        free_instructions(text_seg, (text_top - TEXT_BOT) / BYTES_PER_WORD);
-        free_instructions(k_text_seg, (k_text_top - K_TEXT_BOT) / BYTES_PER_WORD);
         if (text_seg)
             free(text_seg);
         if (text_prof)
@@ -0,0 +1,59 @@
+/* Build-time tool: assemble an exception handler and write the result
+   as a kernel_image_t, so the simulator can install the default handler
+   without running the assembler in every context.
+
+   Usage: mkkernel exceptions.s out.cpp */
+
+#include <stdio.h>
+
+#include "spim.h"
+#include "string-stream.h"
+#include "spim-utils.h"
+#include "image.h"
+#include "kernel_image.h"
+
+
+int
+main (int argc, char **argv)
+{
+  FILE *out;
+  bool ok;
+
+  if (argc != 3)
+    {
+      fprintf (stderr, "usage: %s handler.s out.cpp\n", argv[0]);
+      return 1;
+    }
+
+  MIPSImage img (0);
+  kernel_snapshot_t snap;
+
+  initialize_world (img, argv[1], false);
+  if (img.assembler().parse_error_occurred)
+    {
+      fprintf (stderr, "%s: errors in %s\n", argv[0], argv[1]);
+      return 1;
+    }
+
+  if (!capture_kernel_image (img, snap))
+    {
+      fprintf (stderr, "%s: %s has an instruction in data that uses an undefined label\n",
+	       argv[0], argv[1]);
+      return 1;
+    }
+
+  if ((out = fopen (argv[2], "w")) == NULL)
+    {
+      perror (argv[2]);
+      return 1;
+    }
+  ok = write_kernel_image (&snap.image, out, "default_kernel_image");
+  ok = (fclose (out) == 0) && ok;
+  if (!ok)
+    {
+      fprintf (stderr, "%s: cannot write %s\n", argv[0], argv[2]);
+      remove (argv[2]);
+      return 1;
+    }
+  return 0;
+}
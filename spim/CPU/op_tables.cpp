@@ -0,0 +1,252 @@
+#include <string.h>
+
+#include "spim.h"
+#include "image.h"
+#include "parser_yacc.h"
+#include "perfect_hash.h"
+#include "op_tables.h"
+
+
+/* In the order of op.h.  Two instructions share some encodings there;
+   the first is the one decoded. */
+
+static constexpr op_entry_t op_tbl [] = {
+#undef OP
+#define OP(NAME, OPCODE, TYPE, A_OPCODE) {NAME, OPCODE, TYPE, (int32)A_OPCODE},
+#include "op.h"
+};
+
+#define N_OPS	(sizeof (op_tbl) / sizeof (op_tbl[0]))
+
+
+typedef struct reg_name {
+	const char *name;
+	int number;
+} reg_name_t;
+
+static constexpr reg_name_t register_tbl [] = {
+  {"zero", 0}, {"at", 1}, {"v0", 2}, {"v1", 3},
+  {"a0", 4}, {"a1", 5}, {"a2", 6}, {"a3", 7},
+  {"t0", 8}, {"t1", 9}, {"t2", 10}, {"t3", 11},
+  {"t4", 12}, {"t5", 13}, {"t6", 14}, {"t7", 15},
+  {"s0", 16}, {"s1", 17}, {"s2", 18}, {"s3", 19},
+  {"s4", 20}, {"s5", 21}, {"s6", 22}, {"s7", 23},
+  {"t8", 24}, {"t9", 25}, {"k0", 26}, {"k1", 27},
+  {"kt0", 26}, {"kt1", 27}, {"gp", 28}, {"sp", 29},
+  {"fp", 30}, {"s8", 30}, {"ra", 31},
+};
+
+#define N_REGS	(sizeof (register_tbl) / sizeof (register_tbl[0]))
+
+
+template <size_t N, typename T, typename F>
+static constexpr perfect_hash<N>
+index_on (const T (&tbl)[N], F key_hash, bool (*indexed) (const T &))
+{
+  std::array<uint64_t, N> hash {};
+  std::array<bool, N> use {};
+
+  for (size_t i = 0; i < N; i ++)
+    {
+      hash[i] = key_hash (tbl[i]);
+      use[i] = indexed (tbl[i]);
+    }
+  return make_perfect_hash (hash, use);
+}
+
+
+static constexpr bool
+always (const op_entry_t &)
+{
+  return true;
+}
+
+
+static constexpr bool
+is_register (const reg_name_t &)
+{
+  return true;
+}
+
+
+static constexpr perfect_hash<N_OPS> name_index =
+  index_on (op_tbl, [] (const op_entry_t &e) { return ph_string_hash (e.name); }, always);
+
+static constexpr perfect_hash<N_OPS> opcode_index =
+  index_on (op_tbl, [] (const op_entry_t &e) { return ph_int_hash (e.opcode); }, always);
+
+static constexpr perfect_hash<N_REGS> register_index =
+  index_on (register_tbl, [] (const reg_name_t &r) { return ph_string_hash (r.name); }, is_register);
+
+static_assert (name_index.ok && opcode_index.ok && register_index.ok,
+	       "no perfect hash for the op.h tables");
+
+
+/* Return the entry of op.h named NAME, or NULL. */
+
+const op_entry_t *
+op_by_name (const char *name)
+{
+  int i = name_index.find (ph_string_hash (name));
+
+  return (i >= 0 && strcmp (op_tbl[i].name, name) == 0) ? &op_tbl[i] : NULL;
+}
+
+
+/* Return the entry of op.h for the internal OPCODE, or NULL. */
+
+const op_entry_t *
+op_by_opcode (int opcode)
+{
+  int i = opcode_index.find (ph_int_hash (opcode));
+
+  return (i >= 0 && op_tbl[i].opcode == opcode) ? &op_tbl[i] : NULL;
+}
+
+
+/* Decoding.  The primary opcode (bits 31..26) of a machine instruction
+   either is the whole opcode or selects a second-level table, indexed by
+   the fields that hold the rest of it. */
+
+enum decode_key {KEY_NONE, KEY_FUNCT, KEY_RT, KEY_RS, KEY_COP0, KEY_COP1};
+
+static constexpr int key_size [] = {1, 64, 32, 32, 32 * 32, 32 * 64};
+
+
+static constexpr int
+primary_key (uint32 primary)
+{
+  switch (primary)
+    {
+    case 0x00:			/* SPECIAL */
+    case 0x1c:			/* SPECIAL2 */
+      return KEY_FUNCT;
+    case 0x01:			/* REGIMM */
+      return KEY_RT;
+    case 0x10:
+      return KEY_COP0;
+    case 0x11:
+      return KEY_COP1;
+    case 0x12:			/* COPz */
+    case 0x13:
+      return KEY_RS;
+    default:
+      return KEY_NONE;
+    }
+}
+
+
+/* The bits of WORD, besides the primary opcode, that hold the rest of
+   its opcode. */
+
+static constexpr uint32
+key_mask (int key, uint32 word)
+{
+  switch (key)
+    {
+    case KEY_FUNCT: return 0x0000003f;
+    case KEY_RT: return 0x001f0000;
+    case KEY_RS: return 0x03e00000;
+    case KEY_COP0: return 0x03e0001f;
+    case KEY_COP1:		/* BC1f/t or fmt + funct */
+      return ((word & 0xff000000) == 0x45000000) ? 0x03e10000 : 0x03e0003f;
+    default: return 0;
+    }
+}
+
+
+static constexpr uint32
+key_of (int key, uint32 word)
+{
+  uint32 rs = (word >> 21) & 0x1f;
+
+  switch (key)
+    {
+    case KEY_FUNCT: return word & 0x3f;
+    case KEY_RT: return (word >> 16) & 0x1f;
+    case KEY_RS: return rs;
+    case KEY_COP0: return (rs << 5) | (word & 0x1f);
+    case KEY_COP1:
+      return (rs << 6) | (((word & 0xff000000) == 0x45000000) ? (word >> 16) & 0x1 : word & 0x3f);
+    default: return 0;
+    }
+}
+
+
+static constexpr int
+decode_slots ()
+{
+  int n = 0;
+
+  for (uint32 p = 0; p < 64; p ++)
+    n += key_size[primary_key (p)];
+  return n;
+}
+
+#define DECODE_SLOTS	decode_slots ()
+
+typedef struct decode_table {
+	unsigned char key[64];		/* decode_key of each primary opcode */
+	int16_t base[64];		/* Its first slot in OP */
+	int16_t op[DECODE_SLOTS];	/* Index in op_tbl, or -1 */
+} decode_table_t;
+
+
+static constexpr decode_table_t
+make_decode_table ()
+{
+  decode_table_t t {};
+  int next = 0;
+  size_t i = 0;
+
+  for (uint32 p = 0; p < 64; p ++)
+    {
+      t.key[p] = (unsigned char) primary_key (p);
+      t.base[p] = (int16_t) next;
+      next += key_size[t.key[p]];
+    }
+  for (i = 0; i < (size_t) DECODE_SLOTS; i ++)
+    t.op[i] = -1;
+
+  for (i = 0; i < N_OPS; i ++)
+    {
+      uint32 a = (uint32) op_tbl[i].a_opcode;
+      uint32 p = a >> 26;
+
+      /* Skip entries that are not machine instructions or have fixed
+	 bits the decoder never looks at, which no word can match. */
+      if (op_tbl[i].a_opcode == -1 || (a & ~(0xfc000000 | key_mask (t.key[p], a))) != 0)
+	continue;
+      int16_t &slot = t.op[t.base[p] + key_of (t.key[p], a)];
+      if (slot == -1)
+	slot = (int16_t) i;
+    }
+  return t;
+}
+
+static constexpr decode_table_t decode_tbl = make_decode_table ();
+
+
+/* Return the entry of op.h for the machine instruction WORD, or NULL if
+   it is not a valid instruction. */
+
+const op_entry_t *
+op_decode (int32 word)
+{
+  uint32 w = (uint32) word;
+  uint32 p = w >> 26;
+  int i = decode_tbl.op[decode_tbl.base[p] + key_of (decode_tbl.key[p], w)];
+
+  return (i >= 0) ? &op_tbl[i] : NULL;
+}
+
+
+/* Return the number of the register named NAME (without the $), or -1. */
+
+int
+register_by_name (const char *name)
+{
+  int i = register_index.find (ph_string_hash (name));
+
+  return (i >= 0 && strcmp (register_tbl[i].name, name) == 0) ? register_tbl[i].number : -1;
+}
@@ -0,0 +1,29 @@
+#ifndef OP_TABLES_H
+#define OP_TABLES_H
+
+#include "types.h"
+
+/* Just the entry types (ASM_DIR, PSEUDO_OP, ..._TYPE_INST). */
+#undef OP
+#define OP(NAME, OPCODE, TYPE, A_OPCODE)
+#include "op.h"
+#undef OP
+
+/* The instructions, pseudo-ops and directives of op.h, and the names of
+   the registers, with constant-time lookup by name, by internal opcode
+   (parser token) and by machine instruction.  The tables are built by
+   the compiler, so there is nothing to set up at run time. */
+
+typedef struct op_entry {
+	const char *name;
+	int opcode;			/* Internal opcode (Y_..._OP token) */
+	int type;			/* ..._TYPE_INST, ASM_DIR or PSEUDO_OP */
+	int32 a_opcode;			/* Fixed bits of the encoding, or -1 */
+} op_entry_t;
+
+const op_entry_t *op_by_name (const char *name);
+const op_entry_t *op_by_opcode (int opcode);
+const op_entry_t *op_decode (int32 word);
+int register_by_name (const char *name);
+
+#endif
@@ -0,0 +1,71 @@
+#include "output_capture.h"
+
+#include <string.h>
+#include <algorithm>
+
+OutputCapture::OutputCapture(std::size_t capacity, bool stop_when_full) :
+    ring(std::max<std::size_t>(capacity, 1)),
+    stop_when_full(stop_when_full)
+{
+}
+
+void OutputCapture::write(const char *s, std::size_t n) {
+    std::size_t capacity = ring.size();
+
+    total_bytes += n;
+    if (callback) {
+        callback(s, n);
+    }
+
+    // Only the last `capacity` bytes of this write can survive it
+    if (n >= capacity) {
+        memcpy(ring.data(), s + n - capacity, capacity);
+        start = 0;
+        size = capacity;
+        return;
+    }
+
+    // At most two memcpys: up to the end of the ring, then from its start
+    std::size_t end = (start + size) % capacity;
+    std::size_t first = std::min(n, capacity - end);
+    memcpy(ring.data() + end, s, first);
+    memcpy(ring.data(), s + first, n - first);
+
+    size += n;
+    if (size > capacity) {
+        start = (start + size - capacity) % capacity;
+        size = capacity;
+    }
+}
+
+void OutputCapture::set_callback(callback_t callback) {
+    this->callback = std::move(callback);
+}
+
+std::string OutputCapture::contents(bool mark_truncation) const {
+    std::string out;
+
+    if (mark_truncation && dropped()) {
+        out = "[... " + std::to_string(dropped()) + " bytes dropped ...]\n";
+    }
+    std::size_t first = std::min(size, ring.size() - start);
+    out.append(ring.data() + start, first);
+    out.append(ring.data(), size - first);
+    return out;
+}
+
+std::size_t OutputCapture::capacity() const {
+    return ring.size();
+}
+
+std::size_t OutputCapture::total() const {
+    return total_bytes;
+}
+
+std::size_t OutputCapture::dropped() const {
+    return total_bytes - size;
+}
+
+bool OutputCapture::stops_when_full() const {
+    return stop_when_full;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#ifndef OUTPUT_CAPTURE_H
+#define OUTPUT_CAPTURE_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * Keeps what a context prints, for headless and grading runs, instead of sending it to the UI or
+ * std::cout/std::cerr.
+ *
+ * Memory is bounded: only the last `capacity` bytes are kept, and `contents` can start with a
+ * marker saying how much was dropped. A runaway print loop can also be stopped outright: if the
+ * capture was made with `stop_when_full`, the simulator finishes the context once more than
+ * `capacity` bytes have been printed (see MIPSImage::output_limit_exceeded).
+ *
+ * A callback, if set, sees every write as it happens.
+ */
+class OutputCapture {
+    public:
+        using callback_t = std::function<void(const char *, std::size_t)>;
+
+        explicit OutputCapture(std::size_t capacity, bool stop_when_full = false);
+
+        void write(const char *s, std::size_t n);
+        void set_callback(callback_t callback);
+
+        std::string contents(bool mark_truncation = true) const;
+        std::size_t capacity() const;
+        std::size_t total() const;
+        std::size_t dropped() const;
+        bool stops_when_full() const;
+
+    private:
+        std::vector<char> ring;
+        std::size_t start = 0; // Oldest kept byte
+        std::size_t size = 0;
+        std::size_t total_bytes = 0;
+        bool stop_when_full;
+        callback_t callback;
+};
+
+#endif
@@ -35,16 +35,7 @@
 
 void fix_current_label_address (MIPSImage &img, mem_addr new_addr);
 int imm_op_to_op (MIPSImage &img, int opcode);
-void initialize_parser (const char *file_name);
+void initialize_parser (MIPSImage &img, const char *file_name);
 int op_to_imm_op (MIPSImage &img, int opcode);
 void yyerror (MIPSImage &img, char *s);
 int yyparse (MIPSImage& img);
-
-
-/* Exported Variables: */
-
-extern bool data_dir;		/* => item in data segment */
-
-extern bool text_dir;		/* => item in text segment */
-
-extern bool parse_error_occurred; /* => parse resulted in error */
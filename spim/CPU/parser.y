@@ -36,7 +36,7 @@
 	class MIPSImage;
 }
 
-%locations
+%define api.pure full
 
 %param       { MIPSImage& img }
 
@@ -467,22 +467,6 @@
 /* return (1) */
 #define FILE_PARSE_DONE YYABORT
 
-typedef struct ll
-{
-  label *head;
-  struct ll *tail;
-} label_list;
-
-
-/* Exported Variables: */
-
-bool data_dir;                  /* => item in data segment */
-
-bool text_dir;                  /* => item in text segment */
-
-bool parse_error_occurred;      /* => parse resulted in error */
-
-
 /* Local functions: */
 
 static imm_expr *branch_offset (MIPSImage &img, int n_inst);
@@ -490,7 +474,7 @@ static int cc_to_rt (int cc, int nd, int tf);
 static void check_imm_range (MIPSImage &img, imm_expr*, int32, int32);
 static void check_uimm_range (MIPSImage &img, imm_expr*, uint32, uint32);
 static void clear_labels (MIPSImage &img);
-static label_list *cons_label (label *head, label_list *tail);
+static label_list *cons_label (MIPSImage &img, label *head, label_list *tail);
 static void div_inst (MIPSImage &img, int op, int rd, int rs, int rt, int const_divisor);
 static void mips32_r2_inst (MIPSImage &img);
 static void mult_inst (MIPSImage &img, int op, int rd, int rs, int rt);
@@ -503,27 +487,13 @@ static void store_word_data (MIPSImage &img, int value);
 static void trap_inst (MIPSImage &img);
 static void yywarn (MIPSImage &img, char*);
 
-
-/* Local variables: */
-
-static bool null_term;		/* => string terminate by \0 */
-
-static void (*store_op) (MIPSImage&, int); /* Function to store items in an EXPR_LST */
-static void (*store_fp_op) (MIPSImage&, double*); /* Ditto FP_EXPR_LST */
-
-static label_list *this_line_labels = NULL; /* List of label for curent line */
-
-static bool noat_flag = 0;	/* => program can use $1 */
-
-static const char *input_file_name;	/* Name of file being parsed */
-
 %}
 
 
 
 %%
 
-LINE:		{parse_error_occurred = false; scanner_start_line (); } LBL_CMD ;
+LINE:		{img.assembler().parse_error_occurred = false; scanner_start_line (img); } LBL_CMD ;
 
 LBL_CMD:	OPT_LBL CMD
 	|	CMD
@@ -534,9 +504,9 @@ OPT_LBL: ID ':' {
 		  /* Call outside of cons_label, since an error sets that variable to NULL. */
 		  label* l = record_label (img,
 		  			   $1.s.get(),
-					   text_dir ? current_text_pc (img) : current_data_pc (img),
+					   img.assembler().text_dir ? current_text_pc (img) : current_data_pc (img),
 					   0);
-		  this_line_labels = cons_label (l, this_line_labels);
+		  img.assembler().this_line_labels = cons_label (img, l, img.assembler().this_line_labels);
 		}
 
 	|	ID '=' EXPR
@@ -593,8 +563,7 @@ ASM_CODE:	LOAD_OPS	DEST	ADDRESS
 				      addr_expr_reg ((addr_expr *)$3.p),
 				      incr_expr_offset (img, addr_expr_imm ((addr_expr *)$3.p),
 							4));
-		  free (((addr_expr *)$3.p)->imm);
-		  free ((addr_expr *)$3.p);
+		  free_addr_expr (img, (addr_expr *)$3.p);
 		}
 
 	|	LOADC_OPS	COP_REG	ADDRESS
@@ -604,8 +573,7 @@ ASM_CODE:	LOAD_OPS	DEST	ADDRESS
 			       $2.i,
 			       addr_expr_reg ((addr_expr *)$3.p),
 			       addr_expr_imm ((addr_expr *)$3.p));
-		  free (((addr_expr *)$3.p)->imm);
-		  free ((addr_expr *)$3.p);
+		  free_addr_expr (img, (addr_expr *)$3.p);
 		}
 
 	|	LOADFP_OPS	F_SRC1	ADDRESS
@@ -615,8 +583,7 @@ ASM_CODE:	LOAD_OPS	DEST	ADDRESS
 			       $2.i,
 			       addr_expr_reg ((addr_expr *)$3.p),
 			       addr_expr_imm ((addr_expr *)$3.p));
-		  free (((addr_expr *)$3.p)->imm);
-		  free ((addr_expr *)$3.p);
+		  free_addr_expr (img, (addr_expr *)$3.p);
 		}
 
 	|	LOADI_OPS	DEST	UIMM16
@@ -634,8 +601,7 @@ ASM_CODE:	LOAD_OPS	DEST	ADDRESS
 		  else
 		    i_type_inst (img, Y_ORI_OP, $2.i, 0,
 				 addr_expr_imm ((addr_expr *)$3.p));
-		  free (((addr_expr *)$3.p)->imm);
-		  free ((addr_expr *)$3.p);
+		  free_addr_expr (img, (addr_expr *)$3.p);
 		}
 
 
@@ -651,11 +617,11 @@ ASM_CODE:	LOAD_OPS	DEST	ADDRESS
 
           imm_expr *const_expr = const_imm_expr (img, *x);
 		  i_type_inst (img, Y_ORI_OP, 1, 0, const_expr);
-          free(const_expr);
+          free_imm_expr (img, const_expr);
 		  r_co_type_inst (img, Y_MTC1_OP, 0, $2.i, 1);
           const_expr = const_imm_expr (img, *(x+1));
 		  i_type_inst (img, Y_ORI_OP, 1, 0, const_expr);
-          free(const_expr);
+          free_imm_expr (img, const_expr);
 		  r_co_type_inst (img, Y_MTC1_OP, 0, $2.i + 1, 1);
 		}
 
@@ -667,7 +633,7 @@ ASM_CODE:	LOAD_OPS	DEST	ADDRESS
 
           imm_expr *const_expr = const_imm_expr (img, *y);
 		  i_type_inst (img, Y_ORI_OP, 1, 0,const_expr);
-          free(const_expr);
+          free_imm_expr (img, const_expr);
 		  r_co_type_inst (img, Y_MTC1_OP, 0, $2.i, 1);
 		}
 
@@ -691,8 +657,7 @@ ASM_CODE:	LOAD_OPS	DEST	ADDRESS
 			       addr_expr_reg ((addr_expr *)$3.p),
 			       addr_expr_imm ((addr_expr *)$3.p));
 #endif
-		  free (((addr_expr *)$3.p)->imm);
-		  free ((addr_expr *)$3.p);
+		  free_addr_expr (img, (addr_expr *)$3.p);
 		}
 
 
@@ -721,8 +686,7 @@ ASM_CODE:	LOAD_OPS	DEST	ADDRESS
 #endif
 		  r_sh_type_inst (img, Y_SLL_OP, $2.i, $2.i, 8);
 		  r_type_inst (img, Y_OR_OP, $2.i, $2.i, 1);
-		  free (((addr_expr *)$3.p)->imm);
-		  free ((addr_expr *)$3.p);
+		  free_addr_expr (img, (addr_expr *)$3.p);
 		}
 
 
@@ -743,8 +707,7 @@ ASM_CODE:	LOAD_OPS	DEST	ADDRESS
 				      addr_expr_reg ((addr_expr *)$3.p),
 				      incr_expr_offset (img, addr_expr_imm ((addr_expr *)$3.p),
 							4));
-		  free (((addr_expr *)$3.p)->imm);
-		  free ((addr_expr *)$3.p);
+		  free_addr_expr (img, (addr_expr *)$3.p);
 		}
 
 
@@ -755,8 +718,7 @@ ASM_CODE:	LOAD_OPS	DEST	ADDRESS
 			       $2.i,
 			       addr_expr_reg ((addr_expr *)$3.p),
 			       addr_expr_imm ((addr_expr *)$3.p));
-		  free (((addr_expr *)$3.p)->imm);
-		  free ((addr_expr *)$3.p);
+		  free_addr_expr (img, (addr_expr *)$3.p);
 		}
 
 
@@ -781,8 +743,7 @@ ASM_CODE:	LOAD_OPS	DEST	ADDRESS
 			       addr_expr_reg ((addr_expr *)$3.p),
 			       addr_expr_imm ((addr_expr *)$3.p));
 #endif
-		  free (((addr_expr *)$3.p)->imm);
-		  free ((addr_expr *)$3.p);
+		  free_addr_expr (img, (addr_expr *)$3.p);
 		}
 
 
@@ -807,8 +768,7 @@ ASM_CODE:	LOAD_OPS	DEST	ADDRESS
 		  r_sh_type_inst (img, Y_SLL_OP, $2.i, $2.i, 8);
 		  r_type_inst (img, Y_OR_OP, $2.i, $2.i, 1);
 
-		  free (((addr_expr *)$3.p)->imm);
-		  free ((addr_expr *)$3.p);
+		  free_addr_expr (img, (addr_expr *)$3.p);
 		}
 
 
@@ -819,8 +779,7 @@ ASM_CODE:	LOAD_OPS	DEST	ADDRESS
 			       $2.i,
 			       addr_expr_reg ((addr_expr *)$3.p),
 			       addr_expr_imm ((addr_expr *)$3.p));
-		  free (((addr_expr *)$3.p)->imm);
-		  free ((addr_expr *)$3.p);
+		  free_addr_expr (img, (addr_expr *)$3.p);
 		}
 
 
@@ -1031,7 +990,7 @@ ASM_CODE:	LOAD_OPS	DEST	ADDRESS
 
 	|	BINARY_OPS	DEST	SRC1	IMM32
 		{
-		  if (bare_machine && !accept_pseudo_insts)
+		  if (img.assembler().bare_machine && !img.assembler().accept_pseudo_insts)
 		    yyerror (img, "Immediate form not allowed in bare machine");
 		  else
 		    {
@@ -1044,13 +1003,13 @@ ASM_CODE:	LOAD_OPS	DEST	ADDRESS
 				   $3.i,
 				   (is_zero_imm ((imm_expr *)$4.p) ? 0 : 1));
 		    }
-		  free ((imm_expr *)$4.p);
+		  free_imm_expr (img, (imm_expr *)$4.p);
 		}
 
 	|	BINARY_OPS	DEST	IMM32
 		{
 		  check_uimm_range (img, (imm_expr *)$3.p, UIMM_MIN, UIMM_MAX);
-		  if (bare_machine && !accept_pseudo_insts)
+		  if (img.assembler().bare_machine && !img.assembler().accept_pseudo_insts)
 		    yyerror (img, "Immediate form not allowed in bare machine");
 		  else
 		    {
@@ -1063,7 +1022,7 @@ ASM_CODE:	LOAD_OPS	DEST	ADDRESS
 				   $2.i,
 				   (is_zero_imm ((imm_expr *)$3.p) ? 0 : 1));
 		    }
-		  free ((imm_expr *)$3.p);
+		  free_imm_expr (img, (imm_expr *)$3.p);
 		}
 
 
@@ -1082,7 +1041,7 @@ ASM_CODE:	LOAD_OPS	DEST	ADDRESS
 		{
 		  int val = eval_imm_expr (img, (imm_expr *)$4.p);
 
-		  if (bare_machine && !accept_pseudo_insts)
+		  if (img.assembler().bare_machine && !img.assembler().accept_pseudo_insts)
 		    yyerror (img, "Immediate form not allowed in bare machine");
 		  else {
             imm_expr *expr = make_imm_expr (img, -val, NULL, false);
@@ -1092,16 +1051,16 @@ ASM_CODE:	LOAD_OPS	DEST	ADDRESS
 				 $2.i,
 				 $3.i,
 				 expr);
-            free(expr);
+            free_imm_expr (img, expr);
           }
-		  free ((imm_expr *)$4.p);
+		  free_imm_expr (img, (imm_expr *)$4.p);
 		}
 
 	|	SUB_OPS		DEST	IMM32
 		{
 		  int val = eval_imm_expr (img, (imm_expr *)$3.p);
 
-		  if (bare_machine && !accept_pseudo_insts)
+		  if (img.assembler().bare_machine && !img.assembler().accept_pseudo_insts)
 		    yyerror (img, "Immediate form not allowed in bare machine");
 		  else
 		    i_type_inst_free (img, $1.i == Y_SUB_OP ? Y_ADDI_OP
@@ -1110,7 +1069,7 @@ ASM_CODE:	LOAD_OPS	DEST	ADDRESS
 				 $2.i,
 				 $2.i,
 				 make_imm_expr (img, -val, NULL, false));
-		  free ((imm_expr *)$3.p);
+		  free_imm_expr (img, (imm_expr *)$3.p);
 		}
 
 
@@ -1207,7 +1166,7 @@ ASM_CODE:	LOAD_OPS	DEST	ADDRESS
 		  r_sh_type_inst (img, Y_SLL_OP, 1, $3.i, -dist);
 		  r_sh_type_inst (img, Y_SRL_OP, $2.i, $3.i, dist);
 		  r_type_inst (img, Y_OR_OP, $2.i, $2.i, 1);
-		  free ((imm_expr *)$4.p);
+		  free_imm_expr (img, (imm_expr *)$4.p);
 		}
 
 
@@ -1219,7 +1178,7 @@ ASM_CODE:	LOAD_OPS	DEST	ADDRESS
 		  r_sh_type_inst (img, Y_SRL_OP, 1, $3.i, -dist);
 		  r_sh_type_inst (img, Y_SLL_OP, $2.i, $3.i, dist);
 		  r_type_inst (img, Y_OR_OP, $2.i, $2.i, 1);
-		  free ((imm_expr *)$4.p);
+		  free_imm_expr (img, (imm_expr *)$4.p);
 		}
 
 
@@ -1241,7 +1200,7 @@ ASM_CODE:	LOAD_OPS	DEST	ADDRESS
 		    i_type_inst (img, Y_ORI_OP, 1, 0, (imm_expr *)$4.p);
 		  set_le_inst (img, $1.i, $2.i, $3.i,
 			       (is_zero_imm ((imm_expr *)$4.p) ? 0 : 1));
-		  free ((imm_expr *)$4.p);
+		  free_imm_expr (img, (imm_expr *)$4.p);
 		}
 
 
@@ -1257,7 +1216,7 @@ ASM_CODE:	LOAD_OPS	DEST	ADDRESS
 		    i_type_inst (img, Y_ORI_OP, 1, 0, (imm_expr *)$4.p);
 		  set_gt_inst (img, $1.i, $2.i, $3.i,
 			       (is_zero_imm ((imm_expr *)$4.p) ? 0 : 1));
-		  free ((imm_expr *)$4.p);
+		  free_imm_expr (img, (imm_expr *)$4.p);
 		}
 
 
@@ -1274,7 +1233,7 @@ ASM_CODE:	LOAD_OPS	DEST	ADDRESS
 		    i_type_inst (img, Y_ORI_OP, 1, 0, (imm_expr *)$4.p);
 		  set_ge_inst (img, $1.i, $2.i, $3.i,
 			       (is_zero_imm ((imm_expr *)$4.p) ? 0 : 1));
-		  free ((imm_expr *)$4.p);
+		  free_imm_expr (img, (imm_expr *)$4.p);
 		}
 
 
@@ -1290,7 +1249,7 @@ ASM_CODE:	LOAD_OPS	DEST	ADDRESS
 		    i_type_inst (img, Y_ORI_OP, 1, 0, (imm_expr *)$4.p);
 		  set_eq_inst (img, $1.i, $2.i, $3.i,
 			       (is_zero_imm ((imm_expr *)$4.p) ? 0 : 1));
-		  free ((imm_expr *)$4.p);
+		  free_imm_expr (img, (imm_expr *)$4.p);
 		}
 
 
@@ -1339,7 +1298,7 @@ ASM_CODE:	LOAD_OPS	DEST	ADDRESS
 
 	|	BINARY_BR_OPS	SRC1	BR_IMM32	LABEL
 		{
-		  if (bare_machine && !accept_pseudo_insts)
+		  if (img.assembler().bare_machine && !img.assembler().accept_pseudo_insts)
 		    yyerror (img, "Immediate form not allowed in bare machine");
 		  else
 		    {
@@ -1356,8 +1315,8 @@ ASM_CODE:	LOAD_OPS	DEST	ADDRESS
 				       (imm_expr *)$4.p);
 			}
 		    }
-		  free ((imm_expr *)$3.p);
-		  free ((imm_expr *)$4.p);
+		  free_imm_expr (img, (imm_expr *)$3.p);
+		  free_imm_expr (img, (imm_expr *)$4.p);
 		}
 
 
@@ -1386,8 +1345,8 @@ ASM_CODE:	LOAD_OPS	DEST	ADDRESS
 		      r_type_inst (img, Y_SLTU_OP, 1, $2.i, 1);
 		      i_type_inst (img, Y_BEQ_OP, 0, 1, (imm_expr *)$4.p);
 		    }
-		  free ((imm_expr *)$3.p);
-		  free ((imm_expr *)$4.p);
+		  free_imm_expr (img, (imm_expr *)$3.p);
+		  free_imm_expr (img, (imm_expr *)$4.p);
 		}
 
 
@@ -1403,7 +1362,7 @@ ASM_CODE:	LOAD_OPS	DEST	ADDRESS
 		  i_type_inst (img, $1.i == Y_BGE_POP ? Y_SLTI_OP : Y_SLTIU_OP,
 			       1, $2.i, (imm_expr *)$3.p); /* Use $at */
 		  i_type_inst_free (img, Y_BEQ_OP, 0, 1, (imm_expr *)$4.p);
-		  free ((imm_expr *)$3.p);
+		  free_imm_expr (img, (imm_expr *)$3.p);
 		}
 
 
@@ -1419,7 +1378,7 @@ ASM_CODE:	LOAD_OPS	DEST	ADDRESS
 		  i_type_inst (img, $1.i == Y_BLT_POP ? Y_SLTI_OP : Y_SLTIU_OP,
 			       1, $2.i, (imm_expr *)$3.p); /* Use $at */
 		  i_type_inst_free (img, Y_BNE_OP, 0, 1, (imm_expr *)$4.p);
-		  free ((imm_expr *)$3.p);
+		  free_imm_expr (img, (imm_expr *)$3.p);
 		}
 
 
@@ -1448,8 +1407,8 @@ ASM_CODE:	LOAD_OPS	DEST	ADDRESS
 		      r_type_inst (img, Y_SLTU_OP, 1, $2.i, 1);
 		      i_type_inst (img, Y_BNE_OP, 0, 1, (imm_expr *)$4.p);
 		    }
-		  free ((imm_expr *)$3.p);
-		  free ((imm_expr *)$4.p);
+		  free_imm_expr (img, (imm_expr *)$3.p);
+		  free_imm_expr (img, (imm_expr *)$4.p);
 		}
 
 
@@ -1459,7 +1418,7 @@ ASM_CODE:	LOAD_OPS	DEST	ADDRESS
 		    j_type_inst (img, Y_J_OP, (imm_expr *)$2.p);
 		  else if (($1.i == Y_JAL_OP) || ($1.i == Y_JALR_OP))
 		    j_type_inst (img, Y_JAL_OP, (imm_expr *)$2.p);
-		  free ((imm_expr *)$2.p);
+		  free_imm_expr (img, (imm_expr *)$2.p);
 		}
 
 	|	J_OPS		SRC1
@@ -2141,15 +2100,15 @@ ASM_DIRECTIVE:	Y_ALIAS_DIR	Y_REG	Y_REG
 		  align_data (img, $2.i);
 		}
 
-	|	Y_ASCII_DIR {null_term = false;}	STR_LST
+	|	Y_ASCII_DIR {img.assembler().null_term = false;}	STR_LST
 		{
-		  if (text_dir)
+		  if (img.assembler().text_dir)
 		    yyerror (img, "Can't put data in text segment");
 		}
 
-	|	Y_ASCIIZ_DIR {null_term = true;}	STR_LST
+	|	Y_ASCIIZ_DIR {img.assembler().null_term = true;}	STR_LST
 		{
-		  if (text_dir)
+		  if (img.assembler().text_dir)
 		    yyerror (img, "Can't put data in text segment");
 		}
 
@@ -2160,10 +2119,10 @@ ASM_DIRECTIVE:	Y_ALIAS_DIR	Y_REG	Y_REG
 
 
 	|	Y_BYTE_DIR
-		{store_op = store_byte;}
+		{img.assembler().store_op = store_byte;}
 		EXPR_LST
 		{
-		  if (text_dir)
+		  if (img.assembler().text_dir)
 		    yyerror (img, "Can't put data in text segment");
 		}
 
@@ -2181,14 +2140,14 @@ ASM_DIRECTIVE:	Y_ALIAS_DIR	Y_REG	Y_REG
 
 	|	Y_DATA_DIR
 		{user_kernel_data_segment (img, false);
-		  data_dir = true; text_dir = false;
+		  img.assembler().data_dir = true; img.assembler().text_dir = false;
 		  enable_data_alignment (img);
 		}
 
 	|	Y_DATA_DIR	Y_INT
 		{
 		  user_kernel_data_segment (img, false);
-		  data_dir = true; text_dir = false;
+		  img.assembler().data_dir = true; img.assembler().text_dir = false;
 		  enable_data_alignment (img);
 		  set_data_pc (img, $2.i);
 		}
@@ -2197,14 +2156,14 @@ ASM_DIRECTIVE:	Y_ALIAS_DIR	Y_REG	Y_REG
 	|	Y_K_DATA_DIR
 		{
                     user_kernel_data_segment (img, true);
-		  data_dir = true; text_dir = false;
+		  img.assembler().data_dir = true; img.assembler().text_dir = false;
 		  enable_data_alignment (img);
 		}
 
 	|	Y_K_DATA_DIR	Y_INT
 		{
                     user_kernel_data_segment (img, true);
-		  data_dir = true; text_dir = false;
+		  img.assembler().data_dir = true; img.assembler().text_dir = false;
 		  enable_data_alignment (img);
 		  set_data_pc (img, $2.i);
 		}
@@ -2212,12 +2171,12 @@ ASM_DIRECTIVE:	Y_ALIAS_DIR	Y_REG	Y_REG
 
 	|	Y_DOUBLE_DIR
 		{
-		  store_fp_op = store_double;
-		  if (data_dir) set_data_alignment (img, 3);
+		  img.assembler().store_fp_op = store_double;
+		  if (img.assembler().data_dir) set_data_alignment (img, 3);
 		}
 		FP_EXPR_LST
 		{
-		  if (text_dir)
+		  if (img.assembler().text_dir)
 		    yyerror (img, "Can't put data in text segment");
 		}
 
@@ -2250,12 +2209,12 @@ ASM_DIRECTIVE:	Y_ALIAS_DIR	Y_REG	Y_REG
 
 	|	Y_FLOAT_DIR
 		{
-		  store_fp_op = store_float;
-		  if (data_dir) set_data_alignment (img, 2);
+		  img.assembler().store_fp_op = store_float;
+		  if (img.assembler().data_dir) set_data_alignment (img, 2);
 		}
 		FP_EXPR_LST
 		{
-		  if (text_dir)
+		  if (img.assembler().text_dir)
 		    yyerror (img, "Can't put data in text segment");
 		}
 
@@ -2273,12 +2232,12 @@ ASM_DIRECTIVE:	Y_ALIAS_DIR	Y_REG	Y_REG
 
 	|	Y_HALF_DIR
 		{
-		  store_op = store_half;
-		  if (data_dir) set_data_alignment (img, 1);
+		  img.assembler().store_op = store_half;
+		  if (img.assembler().data_dir) set_data_alignment (img, 1);
 		}
 		EXPR_LST
 		{
-		  if (text_dir)
+		  if (img.assembler().text_dir)
 		    yyerror (img, "Can't put data in text segment");
 		}
 
@@ -2287,7 +2246,7 @@ ASM_DIRECTIVE:	Y_ALIAS_DIR	Y_REG	Y_REG
 		{
 		  (void)record_label (img,
 		  			  $2.s.get(),
-				      text_dir ? current_text_pc (img) : current_data_pc (img),
+				      img.assembler().text_dir ? current_text_pc (img) : current_data_pc (img),
 				      1);
 		}
 
@@ -2320,14 +2279,14 @@ ASM_DIRECTIVE:	Y_ALIAS_DIR	Y_REG	Y_REG
 	|	Y_RDATA_DIR
 		{
 		  user_kernel_data_segment (img, false);
-		  data_dir = true; text_dir = false;
+		  img.assembler().data_dir = true; img.assembler().text_dir = false;
 		  enable_data_alignment (img);
 		}
 
 	|	Y_RDATA_DIR	Y_INT
 		{
 		  user_kernel_data_segment (img, false);
-		  data_dir = true; text_dir = false;
+		  img.assembler().data_dir = true; img.assembler().text_dir = false;
 		  enable_data_alignment (img);
 		  set_data_pc (img, $2.i);
 		}
@@ -2336,14 +2295,14 @@ ASM_DIRECTIVE:	Y_ALIAS_DIR	Y_REG	Y_REG
 	|	Y_SDATA_DIR
 		{
 		  user_kernel_data_segment (img, false);
-		  data_dir = true; text_dir = false;
+		  img.assembler().data_dir = true; img.assembler().text_dir = false;
 		  enable_data_alignment (img);
 		}
 
 	|	Y_SDATA_DIR	Y_INT
 		{
 		  user_kernel_data_segment (img, false);
-		  data_dir = true; text_dir = false;
+		  img.assembler().data_dir = true; img.assembler().text_dir = false;
 		  enable_data_alignment (img);
 		  set_data_pc (img, $2.i);
 		}
@@ -2352,17 +2311,17 @@ ASM_DIRECTIVE:	Y_ALIAS_DIR	Y_REG	Y_REG
 	|	Y_SET_DIR	ID
 		{
 		  if (streq ($2.s.get(), "noat"))
-		    noat_flag = true;
+		    img.assembler().noat_flag = true;
 		  else if (streq ($2.s.get(), "at"))
-		    noat_flag = false;
+		    img.assembler().noat_flag = false;
 		}
 
 
 	|	Y_SPACE_DIR	EXPR
 		{
-		  if (data_dir)
+		  if (img.assembler().data_dir)
 		    increment_data_pc (img, $2.i);
-		  else if (text_dir)
+		  else if (img.assembler().text_dir)
 		    increment_text_pc (img, $2.i);
 		}
 
@@ -2376,14 +2335,14 @@ ASM_DIRECTIVE:	Y_ALIAS_DIR	Y_REG	Y_REG
 	|	Y_TEXT_DIR
 		{
 		  user_kernel_text_segment (img, false);
-		  data_dir = false; text_dir = true;
+		  img.assembler().data_dir = false; img.assembler().text_dir = true;
 		  enable_data_alignment (img);
 		}
 
 	|	Y_TEXT_DIR	Y_INT
 		{
 		  user_kernel_text_segment (img, false);
-		  data_dir = false; text_dir = true;
+		  img.assembler().data_dir = false; img.assembler().text_dir = true;
 		  enable_data_alignment (img);
 		  set_text_pc (img, $2.i);
 		}
@@ -2392,14 +2351,14 @@ ASM_DIRECTIVE:	Y_ALIAS_DIR	Y_REG	Y_REG
 	|	Y_K_TEXT_DIR
 		{
 		  user_kernel_text_segment (img, true);
-		  data_dir = false; text_dir = true;
+		  img.assembler().data_dir = false; img.assembler().text_dir = true;
 		  enable_data_alignment (img);
 		}
 
 	|	Y_K_TEXT_DIR	Y_INT
 		{
 		  user_kernel_text_segment (img, true);
-		  data_dir = false; text_dir = true;
+		  img.assembler().data_dir = false; img.assembler().text_dir = true;
 		  enable_data_alignment (img);
 		  set_text_pc (img, $2.i);
 		}
@@ -2412,8 +2371,8 @@ ASM_DIRECTIVE:	Y_ALIAS_DIR	Y_REG	Y_REG
 
 	|	Y_WORD_DIR
 		{
-		  store_op = store_word_data;
-		  if (data_dir) set_data_alignment (img, 2);
+		  img.assembler().store_op = store_word_data;
+		  if (img.assembler().data_dir) set_data_alignment (img, 2);
 		}
 		EXPR_LST
 
@@ -2421,7 +2380,7 @@ ASM_DIRECTIVE:	Y_ALIAS_DIR	Y_REG	Y_REG
 
 
 
-ADDRESS:	{only_id = 1;} ADDR {only_id = 0; $$ = $2;}
+ADDRESS:	{img.assembler().only_id = 1;} ADDR {img.assembler().only_id = 0; $$ = $2;}
 
 ADDR:		'(' REGISTER ')'
 		{
@@ -2475,7 +2434,7 @@ ADDR:		'(' REGISTER ')'
 	;
 
 
-BR_IMM32:	{only_id = 1;} IMM32 {only_id = 0; $$ = $2;}
+BR_IMM32:	{img.assembler().only_id = 1;} IMM32 {img.assembler().only_id = 0; $$ = $2;}
 
 IMM16:	IMM32
 		{
@@ -2544,7 +2503,7 @@ REGISTER:	Y_REG
 		{
 		  if ($1.i < 0 || $1.i > 31)
 		    yyerror (img, "Register number out of range");
-		  if ($1.i == 1 && !bare_machine && !noat_flag)
+		  if ($1.i == 1 && !img.assembler().bare_machine && !img.assembler().noat_flag)
 		    yyerror (img, "Register 1 is reserved for assembler");
 		  $$ = $1;
 		}
@@ -2591,19 +2550,19 @@ STR_LST:	STR_LST STR
 
 STR:		Y_STR
 		{
-		  store_string (img, $1.s.get(), strlen($1.s.get()), null_term);
+		  store_string (img, $1.s.get(), strlen($1.s.get()), img.assembler().null_term);
 		}
 	|	Y_STR ':' Y_INT
 		{
 		  int i;
 
 		  for (i = 0; i < $3.i; i ++)
-		    store_string (img, $1.s.get(), strlen($1.s.get()), null_term);
+		    store_string (img, $1.s.get(), strlen($1.s.get()), img.assembler().null_term);
 		}
 	;
 
 
-EXPRESSION:	{only_id = 1;} EXPR {only_id = 0; $$ = $2;}
+EXPRESSION:	{img.assembler().only_id = 1;} EXPR {img.assembler().only_id = 0; $$ = $2;}
 
 EXPR:
                 TRM
@@ -2645,41 +2604,41 @@ FACTOR:         Y_INT
 
 EXPR_LST:	EXPR_LST	EXPRESSION
 		{
-		  store_op (img, $2.i);
+		  img.assembler().store_op (img, $2.i);
 		}
 	|	EXPRESSION
 		{
-		  store_op (img, $1.i);
+		  img.assembler().store_op (img, $1.i);
 		}
 	|	EXPRESSION ':' EXPR
 		{
 		  int i;
 
 		  for (i = 0; i < $3.i; i ++)
-		    store_op (img, $1.i);
+		    img.assembler().store_op (img, $1.i);
 		}
 	;
 
 
 FP_EXPR_LST:	FP_EXPR_LST Y_FP
 		{
-		  store_fp_op (img, (double*)$2.p);
+		  img.assembler().store_fp_op (img, (double*)$2.p);
 		}
 	|	Y_FP
 		{
-		  store_fp_op (img, (double*)$1.p);
+		  img.assembler().store_fp_op (img, (double*)$1.p);
 		}
 	;
 
 
-OPTIONAL_ID:	{only_id = 1;} OPT_ID {only_id = 0; $$ = $2;}
+OPTIONAL_ID:	{img.assembler().only_id = 1;} OPT_ID {img.assembler().only_id = 0; $$ = $2;}
 
 OPT_ID:		ID
 	|	{$$.p = (void*)NULL;}
 	;
 
 
-ID:		{only_id = 1;} Y_ID {only_id = 0; $$ = $2;}
+ID:		{img.assembler().only_id = 1;} Y_ID {img.assembler().only_id = 0; $$ = $2;}
 
 
 %%
@@ -2691,7 +2650,7 @@ fix_current_label_address (MIPSImage &img, mem_addr new_addr)
 {
   label_list *l;
 
-  for (l = this_line_labels; l != NULL; l = l->tail)
+  for (l = img.assembler().this_line_labels; l != NULL; l = l->tail)
     {
       l->head->addr = new_addr;
     }
@@ -2700,9 +2659,9 @@ fix_current_label_address (MIPSImage &img, mem_addr new_addr)
 
 
 static label_list *
-cons_label (label *head, label_list *tail)
+cons_label (MIPSImage &img, label *head, label_list *tail)
 {
-  label_list *c = (label_list *) malloc (sizeof (label_list));
+  label_list *c = (label_list *) arena_alloc (img, sizeof (label_list));
 
   c->head = head;
   c->tail = tail;
@@ -2713,15 +2672,16 @@ cons_label (label *head, label_list *tail)
 static void
 clear_labels (MIPSImage &img)
 {
+  label_list *&labels = img.assembler().this_line_labels;
   label_list *n;
 
-  for ( ; this_line_labels != NULL; this_line_labels = n)
+  for ( ; labels != NULL; labels = n)
     {
-      resolve_label_uses (img, this_line_labels->head);
-      n = this_line_labels->tail;
-      free (this_line_labels);
+      resolve_label_uses (img, labels->head);
+      n = labels->tail;
+      arena_free (img, labels, sizeof (label_list));
     }
-    this_line_labels = NULL;
+    labels = NULL;
 }
 
 
@@ -2893,21 +2853,24 @@ set_eq_inst (MIPSImage &img, int op, int rd, int rs, int rt)
 static void
 store_word_data (MIPSImage &img, int value)
 {
-  if (data_dir)
+  if (img.assembler().data_dir)
     store_word (img, value);
-  else if (text_dir)
+  else if (img.assembler().text_dir)
     store_instruction (img, inst_decode (img, value));
 }
 
 
 
 void
-initialize_parser (const char *file_name)
+initialize_parser (MIPSImage &img, const char *file_name)
 {
-  input_file_name = file_name;
-  only_id = 0;
-  data_dir = false;
-  text_dir = true;
+  assembler_t &as = img.assembler();
+
+  as.input_file_name = file_name;
+  as.diagnostic_count = 0;
+  as.only_id = 0;
+  as.data_dir = false;
+  as.text_dir = true;
 }
 
 
@@ -2953,7 +2916,7 @@ check_uimm_range (MIPSImage &img, imm_expr* expr, uint32 min, uint32 max)
 void
 yyerror (MIPSImage &img, char *s)
 {
-  parse_error_occurred = true;
+  img.assembler().parse_error_occurred = true;
   clear_labels (img);
   yywarn (img, s);
 }
@@ -2963,7 +2926,7 @@ void
 yywarn (MIPSImage &img, char *s)
 {
   char *line = erroneous_line(img);
-  error (img, "spim: (parser) %s on line %d of file %s\n%s", s, line_no, input_file_name, line);
+  assembler_error (img, "spim: (parser) %s on line %d of file %s\n%s", s, img.assembler().line_no, img.assembler().input_file_name, line);
   free(line);
 }
 
@@ -0,0 +1,164 @@
+#ifndef PERFECT_HASH_H
+#define PERFECT_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <array>
+
+/* Perfect hashing of a fixed set of keys, computed by the compiler.
+
+   Each key is reduced to a 64-bit hash.  The hash picks a bucket, and
+   the bucket's seed rehashes it to a slot that no other key uses, so a
+   lookup is two hashes and one comparison against the key in that slot.
+   Seeds are found greedily, largest bucket first (the "hash, displace"
+   construction).  Keys with the same hash are the same key; only the
+   first one is indexed. */
+
+constexpr uint64_t
+ph_mix (uint64_t x)		/* Murmur3's 64-bit finalizer */
+{
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  x *= 0xc4ceb3fe1a85ec53ULL;
+  x ^= x >> 33;
+  return x;
+}
+
+
+constexpr uint64_t
+ph_string_hash (const char *s)	/* FNV-1a */
+{
+  uint64_t h = 14695981039346656037ULL;
+
+  for (; *s != '\0'; s ++)
+    h = (h ^ (unsigned char) *s) * 1099511628211ULL;
+  return ph_mix (h);
+}
+
+
+constexpr uint64_t
+ph_int_hash (uint32_t x)
+{
+  return ph_mix (x);
+}
+
+
+/* Number of slots for N keys: a power of 2, at most half full. */
+
+constexpr size_t
+ph_table_size (size_t n)
+{
+  size_t size = 1;
+
+  while (size < 2 * n)
+    size *= 2;
+  return size;
+}
+
+
+template <size_t N>
+struct perfect_hash
+{
+  static constexpr size_t SIZE = ph_table_size (N);
+  static constexpr size_t BUCKETS = N / 2 + 1;
+
+  uint32_t seed[BUCKETS];
+  int16_t slot[SIZE];		/* Index of the key, or -1 */
+  bool ok;			/* => Every distinct key has a slot */
+
+  constexpr size_t bucket_of (uint64_t h) const
+  {
+    return (size_t) ((h >> 32) % BUCKETS);
+  }
+
+  constexpr size_t slot_of (uint64_t h, uint32_t s) const
+  {
+    return (size_t) (ph_mix (h ^ (s * 0x9e3779b97f4a7c15ULL)) & (SIZE - 1));
+  }
+
+  /* Index of the only key that can have hash H, or -1.  The caller
+     compares keys. */
+  constexpr int find (uint64_t h) const
+  {
+    return slot[slot_of (h, seed[bucket_of (h)])];
+  }
+};
+
+
+/* Build the perfect hash of the N keys with hashes HASH.  Keys whose
+   USE is false are left out. */
+
+template <size_t N>
+constexpr perfect_hash<N>
+make_perfect_hash (const std::array<uint64_t, N> &hash, const std::array<bool, N> &use)
+{
+  typedef perfect_hash<N> ph_t;
+  ph_t ph {};
+  size_t start[ph_t::BUCKETS + 1] {};
+  size_t member[N] {};
+  size_t fill[ph_t::BUCKETS] {};
+  size_t max_size = 0;
+
+  for (size_t i = 0; i < ph_t::SIZE; i ++)
+    ph.slot[i] = -1;
+
+  /* Group the keys by bucket, dropping repeats (which share a bucket). */
+  for (size_t i = 0; i < N; i ++)
+    if (use[i])
+      start[ph.bucket_of (hash[i]) + 1] += 1;
+  for (size_t b = 0; b < ph_t::BUCKETS; b ++)
+    start[b + 1] += start[b];
+  for (size_t i = 0; i < N; i ++)
+    if (use[i])
+      {
+	size_t b = ph.bucket_of (hash[i]);
+	bool repeat = false;
+
+	for (size_t k = start[b]; k < start[b] + fill[b]; k ++)
+	  repeat = repeat || (hash[member[k]] == hash[i]);
+	if (!repeat)
+	  {
+	    member[start[b] + fill[b]++] = i;
+	    if (fill[b] > max_size)
+	      max_size = fill[b];
+	  }
+      }
+
+  /* Place the buckets, largest first. */
+  for (size_t size = max_size; size > 0; size --)
+    for (size_t b = 0; b < ph_t::BUCKETS; b ++)
+      {
+	if (fill[b] != size)
+	  continue;
+
+	uint32_t s = 0;
+	for (;; s ++)
+	  {
+	    bool fits = true;
+
+	    if (s == 1u << 20)
+	      return ph;	/* ok is false */
+	    for (size_t k = start[b]; k < start[b] + fill[b] && fits; k ++)
+	      {
+		size_t slot = ph.slot_of (hash[member[k]], s);
+
+		fits = (ph.slot[slot] == -1);
+		for (size_t j = start[b]; j < k && fits; j ++)
+		  fits = (ph.slot_of (hash[member[j]], s) != slot);
+	      }
+	    if (fits)
+	      break;
+	  }
+
+	ph.seed[b] = s;
+	for (size_t k = start[b]; k < start[b] + fill[b]; k ++)
+	  ph.slot[ph.slot_of (hash[member[k]], s)] = (int16_t) member[k];
+      }
+
+  ph.ok = true;
+  return ph;
+}
+
+#endif
@@ -0,0 +1,379 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "spim.h"
+#include "inst.h"
+#include "image.h"
+#include "reg.h"
+#include "sym-tbl.h"
+#include "op_tables.h"
+#include "parser_yacc.h"
+#include "pipeline_model.h"
+#include "text_counts.h"
+
+
+/* What an instruction reads and writes, from its opcode. */
+
+#define OPND_KNOWN	0x0001	/* The entry has been worked out */
+#define OPND_RS		0x0002	/* Reads rs */
+#define OPND_RT		0x0004	/* Reads rt */
+#define OPND_HILO	0x0008	/* Reads HI/LO */
+#define OPND_W_RD	0x0010	/* Writes rd */
+#define OPND_W_RT	0x0020	/* Writes rt */
+#define OPND_W_RA	0x0040	/* Writes $ra */
+#define OPND_W_HILO	0x0080
+#define OPND_LOAD	0x0100	/* Its result comes from MEM */
+#define OPND_MULT	0x0200	/* Its result takes mult_latency */
+#define OPND_DIV	0x0400	/* Its result takes div_latency */
+#define OPND_IN_ID	0x0800	/* Resolved in ID, so it needs its operands there */
+#define OPND_CONTROL	0x1000	/* Can redirect fetch */
+
+
+static int
+operands (int opcode)
+{
+  const op_entry_t *op = op_by_opcode (opcode);
+  int o = OPND_KNOWN;
+
+  switch (opcode)
+    {
+    case Y_LB_OP: case Y_LBU_OP: case Y_LH_OP: case Y_LHU_OP:
+    case Y_LW_OP: case Y_LL_OP: case Y_LWC2_OP: case Y_LDC2_OP:
+      return o | OPND_RS | OPND_W_RT | OPND_LOAD;
+
+    case Y_LWL_OP: case Y_LWR_OP: /* Merge into rt */
+      return o | OPND_RS | OPND_RT | OPND_W_RT | OPND_LOAD;
+
+    case Y_SC_OP:
+      return o | OPND_RS | OPND_RT | OPND_W_RT | OPND_LOAD;
+
+    case Y_MULT_OP: case Y_MULTU_OP:
+      return o | OPND_RS | OPND_RT | OPND_W_HILO | OPND_MULT;
+
+    case Y_MADD_OP: case Y_MADDU_OP: case Y_MSUB_OP: case Y_MSUBU_OP:
+      return o | OPND_RS | OPND_RT | OPND_HILO | OPND_W_HILO | OPND_MULT;
+
+    case Y_DIV_OP: case Y_DIVU_OP:
+      return o | OPND_RS | OPND_RT | OPND_W_HILO | OPND_DIV;
+
+    case Y_MUL_OP:
+      return o | OPND_RS | OPND_RT | OPND_W_RD | OPND_MULT;
+
+    case Y_MFHI_OP: case Y_MFLO_OP:
+      return o | OPND_HILO | OPND_W_RD;
+
+    case Y_MTHI_OP: case Y_MTLO_OP:
+      return o | OPND_RS | OPND_W_HILO;
+
+    case Y_JR_OP: case Y_JR_HB_OP:
+      return o | OPND_RS | OPND_IN_ID | OPND_CONTROL;
+
+    case Y_JALR_OP: case Y_JALR_HB_OP:
+      return o | OPND_RS | OPND_W_RD | OPND_IN_ID | OPND_CONTROL;
+
+    case Y_J_OP:
+      return o | OPND_CONTROL;
+
+    case Y_JAL_OP:
+      return o | OPND_W_RA | OPND_CONTROL;
+
+    case Y_ERET_OP:
+      return o | OPND_CONTROL;
+
+    case Y_BGEZAL_OP: case Y_BGEZALL_OP: case Y_BLTZAL_OP: case Y_BLTZALL_OP:
+      return o | OPND_RS | OPND_W_RA | OPND_IN_ID | OPND_CONTROL;
+    }
+
+  if (op == NULL)
+    return o;
+  switch (op->type)
+    {
+    case R3_TYPE_INST:
+    case R3sh_TYPE_INST:
+      return o | OPND_RS | OPND_RT | OPND_W_RD;
+
+    case R2sh_TYPE_INST:
+      return o | OPND_RT | OPND_W_RD;
+
+    case R2st_TYPE_INST:	/* Traps */
+    case B2_TYPE_INST:
+      return o | OPND_RS | OPND_RT
+	| (op->type == B2_TYPE_INST ? OPND_IN_ID | OPND_CONTROL : 0);
+
+    case R2ds_TYPE_INST:
+      return o | OPND_RS | OPND_W_RD;
+
+    case R2td_TYPE_INST:	/* mfc0 and mtc0, or seb and seh */
+    case FP_R2ts_TYPE_INST:	/* mfc1, mtc1, cfc1 and ctc1 */
+      if (strncmp (op->name, "mf", 2) == 0 || strncmp (op->name, "cf", 2) == 0
+	  || strcmp (op->name, "rdpgpr") == 0)
+	return o | OPND_W_RT;
+      else if (strncmp (op->name, "mt", 2) == 0 || strncmp (op->name, "ct", 2) == 0)
+	return o | OPND_RT;
+      return o | OPND_RT | OPND_W_RD;
+
+    case R1s_TYPE_INST:
+    case I1s_TYPE_INST:
+      return o | OPND_RS;
+
+    case R1d_TYPE_INST:
+      return o | OPND_W_RD;
+
+    case I1t_TYPE_INST:
+      return o | OPND_W_RT;
+
+    case I2_TYPE_INST:
+      return o | OPND_RS | OPND_W_RT;
+
+    case I2a_TYPE_INST:		/* Stores */
+      return o | OPND_RS | OPND_RT;
+
+    case FP_I2a_TYPE_INST:
+      return o | OPND_RS;
+
+    case B1_TYPE_INST:
+      return o | OPND_RS | OPND_IN_ID | OPND_CONTROL;
+
+    case BC_TYPE_INST:
+      return o | OPND_CONTROL;
+
+    default:
+      return o;
+    }
+}
+
+
+static bool
+parse_cycles (const std::string &value, int &n)
+{
+  char *end;
+  long v = strtol (value.c_str (), &end, 10);
+
+  if (end == value.c_str () || *end != '\0' || v < 0 || v > 1000)
+    return false;
+  n = (int) v;
+  return true;
+}
+
+
+/* Parse a description of the pipeline such as
+   "forwarding=no,branch=2,mult=4,div=32".  Any of forwarding (yes or
+   no), branch (cycles lost when a branch or jump is taken), mult, and
+   div (result latencies in cycles) may be given; an empty spec is the
+   default pipeline. */
+
+bool
+pipeline_parse_config (const char *spec, pipeline_config_t &config, std::string &problem)
+{
+  std::string s (spec);
+  size_t pos = 0;
+
+  config = pipeline_config_t ();
+  while (pos < s.size ())
+    {
+      size_t comma = s.find (',', pos);
+      std::string setting = s.substr (pos, comma == std::string::npos ? std::string::npos : comma - pos);
+      size_t eq = setting.find ('=');
+      std::string key = setting.substr (0, eq);
+      std::string value = eq == std::string::npos ? "" : setting.substr (eq + 1);
+      bool ok = false;
+
+      pos = (comma == std::string::npos) ? s.size () : comma + 1;
+      if (key == "forwarding" && (value == "yes" || value == "no"))
+	{
+	  config.forwarding = (value == "yes");
+	  ok = true;
+	}
+      else if (key == "branch")
+	ok = parse_cycles (value, config.branch_penalty);
+      else if (key == "mult")
+	ok = parse_cycles (value, config.mult_latency) && config.mult_latency > 0;
+      else if (key == "div")
+	ok = parse_cycles (value, config.div_latency) && config.div_latency > 0;
+      if (!ok)
+	{
+	  problem = "bad setting `" + setting + "'";
+	  return false;
+	}
+    }
+  return true;
+}
+
+
+/* Give IMG an empty pipeline built to CONFIG, in place of any it had. */
+
+void
+pipeline_attach (MIPSImage &img, const pipeline_config_t &config)
+{
+  std::unique_ptr<pipeline_t> pl (new pipeline_t ());
+
+  pl->config = config;
+  img.set_pipeline (std::move (pl));
+}
+
+
+void
+pipeline_detach (MIPSImage &img)
+{
+  img.set_pipeline (nullptr);
+}
+
+
+/* The instruction INST at PC is about to execute: find the cycle it
+   leaves ID in, and when its results can be forwarded. */
+
+void
+pipeline_issue (MIPSImage &img, instruction *inst, mem_addr pc)
+{
+  pipeline_t &pl = *img.pipeline();
+  size_t op = (size_t) OPCODE (inst);
+  int srcs[3], n_srcs = 0, dst = -1, i;
+  int o;
+
+  if (op >= pl.operands_of.size ())
+    pl.operands_of.resize (op + 1, 0);
+  if (pl.operands_of[op] == 0)
+    pl.operands_of[op] = (uint16_t) operands ((int) op);
+  o = pl.operands_of[op];
+
+  if (o & OPND_RS)
+    srcs[n_srcs++] = RS (inst);
+  if (o & OPND_RT)
+    srcs[n_srcs++] = RT (inst);
+  if (o & OPND_HILO)
+    srcs[n_srcs++] = PIPELINE_HILO;
+
+  /* Without forwarding everything reads the register file in ID. */
+  bool in_id = (o & OPND_IN_ID) || !pl.config.forwarding;
+  uint64_t earliest = pl.cycle + 1;
+  uint64_t id = earliest;
+  int binding = -1;
+
+  for (i = 0; i < n_srcs; i ++)
+    {
+      int r = srcs[i];
+
+      if (r == 0 || pl.ready[r] == 0)
+	continue;
+      uint64_t need = in_id ? pl.ready[r] : pl.ready[r] - 1;
+      if (need > id)
+	{
+	  id = need;
+	  binding = r;
+	}
+    }
+
+  /* The mult/div unit takes one operation at a time, whatever it
+     computes and whether or not its result has been read. */
+  bool unit_busy = false;
+  if ((o & (OPND_MULT | OPND_DIV)) && pl.unit_free > id + 1)
+    {
+      id = pl.unit_free - 1;
+      unit_busy = true;
+    }
+
+  if (unit_busy)
+    pl.muldiv_stalls += id - earliest;
+  else if (binding >= 0 && pl.source[binding] == PIPELINE_LOAD)
+    pl.load_use_stalls += id - earliest;
+  else if (binding >= 0 && pl.source[binding] == PIPELINE_MULDIV)
+    pl.muldiv_stalls += id - earliest;
+  else if (binding >= 0)
+    pl.data_stalls += id - earliest;
+
+  if (o & OPND_W_RD)
+    dst = RD (inst);
+  else if (o & OPND_W_RT)
+    dst = RT (inst);
+  else if (o & OPND_W_RA)
+    dst = 31;
+  else if (o & OPND_W_HILO)
+    dst = PIPELINE_HILO;
+
+  if (o & OPND_MULT)
+    pl.unit_free = id + 1 + pl.config.mult_latency;
+  else if (o & OPND_DIV)
+    pl.unit_free = id + 1 + pl.config.div_latency;
+
+  if (dst > 0)
+    {
+      uint64_t ready = id + 2;	/* EX result, to the next EX */
+
+      if (o & OPND_LOAD)
+	ready = id + 3;		/* MEM result */
+      else if (o & (OPND_MULT | OPND_DIV))
+	ready = pl.unit_free;
+      if (!pl.config.forwarding && ready < id + 3)
+	ready = id + 3;		/* Written in WB, read in the same cycle's ID */
+      pl.ready[dst] = ready;
+      pl.source[dst] = ((o & OPND_LOAD) ? PIPELINE_LOAD
+			: (o & (OPND_MULT | OPND_DIV)) ? PIPELINE_MULDIV
+			: PIPELINE_ALU);
+    }
+
+  pipeline_slot_t *slot = text_counts_at (img, pl, pc);
+  if (slot != NULL)
+    {
+      slot->instructions += 1;
+      slot->cycles += id - pl.cycle;
+    }
+  pl.instructions += 1;
+  pl.cycle = id;
+}
+
+
+/* The instruction INST at PC has executed: if it sent fetch elsewhere,
+   the instruction fetched behind it is discarded. */
+
+void
+pipeline_retire (MIPSImage &img, instruction *inst, mem_addr pc)
+{
+  pipeline_t &pl = *img.pipeline();
+  size_t op = (size_t) OPCODE (inst);
+  mem_addr next_pc = img.reg_image().PC;
+
+  if (delayed_branches || pl.config.branch_penalty == 0
+      || op >= pl.operands_of.size () || !(pl.operands_of[op] & OPND_CONTROL)
+      || next_pc == pc + BYTES_PER_WORD)
+    return;
+
+  pipeline_slot_t *slot = text_counts_at (img, pl, pc);
+  if (slot != NULL)
+    slot->cycles += pl.config.branch_penalty;
+  pl.branch_stalls += pl.config.branch_penalty;
+  pl.cycle += pl.config.branch_penalty;
+}
+
+
+/* Cycles from the first fetch until the last instruction leaves WB. */
+
+uint64_t
+pipeline_cycles (const pipeline_t &pl)
+{
+  return pl.instructions == 0 ? 0 : pl.cycle + 4;
+}
+
+
+/* Instructions and cycles summed over each labeled part of the program,
+   in order of address. */
+
+std::vector<pipeline_function_t>
+pipeline_functions (MIPSImage &img)
+{
+  if (img.pipeline() == NULL)
+    return std::vector<pipeline_function_t> ();
+
+  return text_counts_by_label<pipeline_function_t>
+    (img, *img.pipeline(),
+     [] (const pipeline_slot_t &slot) {
+       return slot.instructions != 0 || slot.cycles != 0;
+     },
+     [] (pipeline_function_t &sum, const pipeline_slot_t &slot) {
+       sum.instructions += slot.instructions;
+       sum.cycles += slot.cycles;
+     });
+}
@@ -0,0 +1,92 @@
+#ifndef PIPELINE_MODEL_H
+#define PIPELINE_MODEL_H
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "spim.h"
+#include "instruction.h"
+
+class MIPSImage;
+
+/* A timing model of the classic five-stage pipeline (IF ID EX MEM WB)
+   that runs beside the functional engine.  It sees each instruction
+   as it issues and again once it has executed, and from the registers
+   the instruction reads and writes it works out the cycle the
+   instruction leaves ID in:
+
+   - With forwarding, a result is usable in EX the cycle after it is
+     computed, so only a load followed by a use stalls (once).
+     Without, every dependent instruction waits for WB.
+   - Branches and jumps are resolved in ID, so they need their operands
+     a stage earlier, and (unless branches are delayed) each one that
+     redirects fetch discards the instruction behind it.
+   - mult and div results reach HI/LO (and mul's reach its register)
+     after a fixed latency, and the unit takes one operation at a time.
+
+   Floating-point instructions issue in a cycle and their registers
+   are not tracked.  The model never changes what the program does.
+
+   A context has no model until pipeline_attach gives it one; until
+   then the PIPELINE_* hooks cost a null check. */
+
+typedef struct pipeline_config {
+	bool forwarding = true;
+	int branch_penalty = 1;		/* Cycles lost per redirect */
+	int mult_latency = 4;		/* mult, multu, madd, msub, mul */
+	int div_latency = 32;		/* div, divu */
+} pipeline_config_t;
+
+typedef struct pipeline_slot {
+	uint64_t instructions;
+	uint64_t cycles;
+} pipeline_slot_t;
+
+#define PIPELINE_HILO 32		/* Register number of HI/LO */
+
+enum pipeline_source {			/* What produced a result */
+	PIPELINE_ALU,
+	PIPELINE_LOAD,
+	PIPELINE_MULDIV
+};
+
+typedef struct pipeline {
+	pipeline_config_t config;
+	uint64_t cycle;			/* Last instruction left ID */
+	uint64_t instructions;
+	uint64_t load_use_stalls;
+	uint64_t data_stalls;		/* Other RAW hazards */
+	uint64_t muldiv_stalls;
+	uint64_t branch_stalls;
+	uint64_t ready[PIPELINE_HILO + 1]; /* When a result reaches EX */
+	uint64_t unit_free;		/* When the mult/div unit can start another */
+	uint8_t source[PIPELINE_HILO + 1]; /* pipeline_source of each result */
+	std::vector<uint16_t> operands_of; /* Cache of opcode's operands */
+	std::vector<pipeline_slot_t> text; /* By word of text segment */
+	std::vector<pipeline_slot_t> k_text;
+} pipeline_t;
+
+typedef struct pipeline_function {
+	std::string name;
+	mem_addr addr;
+	uint64_t instructions;
+	uint64_t cycles;
+} pipeline_function_t;
+
+#define PIPELINE_ISSUE(img, INST, PC)					\
+		if (img.pipeline() != NULL) pipeline_issue (img, INST, PC)
+#define PIPELINE_RETIRE(img, INST, PC)					\
+		if (img.pipeline() != NULL) pipeline_retire (img, INST, PC)
+
+bool pipeline_parse_config (const char *spec, pipeline_config_t &config,
+			    std::string &problem);
+void pipeline_attach (MIPSImage &img, const pipeline_config_t &config);
+void pipeline_detach (MIPSImage &img);
+void pipeline_issue (MIPSImage &img, instruction *inst, mem_addr pc);
+void pipeline_retire (MIPSImage &img, instruction *inst, mem_addr pc);
+uint64_t pipeline_cycles (const pipeline_t &pl);
+std::vector<pipeline_function_t> pipeline_functions (MIPSImage &img);
+
+#endif
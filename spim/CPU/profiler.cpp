@@ -0,0 +1,346 @@
+#include <stdio.h>
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "spim.h"
+#include "inst.h"
+#include "image.h"
+#include "reg.h"
+#include "sym-tbl.h"
+#include "parser_yacc.h"
+#include "profiler.h"
+
+
+static int
+add_node (profile_t &prof, mem_addr func, int parent)
+{
+  profile_node_t node;
+
+  node.func = func;
+  node.parent = parent;
+  node.self = 0;
+  node.calls = 0;
+  prof.nodes.push_back (node);
+  if (parent >= 0)
+    prof.nodes[parent].children.push_back ((int) prof.nodes.size () - 1);
+  return (int) prof.nodes.size () - 1;
+}
+
+
+/* Turn the profiler on (from a clean slate) or off. */
+
+void
+profile_enable (MIPSImage &img, bool on)
+{
+  img.profile() = profile_t ();
+  img.profile().enabled = on;
+}
+
+
+static void
+push_frame (profile_t &prof, mem_addr func, mem_addr ret)
+{
+  if (prof.stack.size () >= PROFILE_MAX_DEPTH)
+    {
+      prof.lost_frames += 1;
+      return;
+    }
+
+  profile_frame_t &caller = prof.stack.back ();
+  int node = -1;
+
+  for (int child : prof.nodes[caller.node].children)
+    if (prof.nodes[child].func == func)
+      {
+	node = child;
+	break;
+      }
+  if (node < 0)
+    node = add_node (prof, func, caller.node);
+  prof.nodes[node].calls += 1;
+  prof.stack.push_back ({node, ret});
+}
+
+
+/* Return to PC: pop the innermost frame that returns there, and every
+   frame above it (which never returned).  A return that no frame
+   expects, e.g. after the callee moved $ra, pops one frame. */
+
+static void
+pop_frame (profile_t &prof, mem_addr pc)
+{
+  size_t i;
+
+  if (prof.lost_frames > 0)
+    {
+      prof.lost_frames -= 1;
+      return;
+    }
+  if (prof.stack.size () <= 1)	/* Never pop the root */
+    return;
+
+  for (i = prof.stack.size () - 1; i > 0; i --)
+    if (prof.stack[i].ret == pc)
+      break;
+  prof.stack.resize (i > 0 ? i : prof.stack.size () - 1);
+}
+
+
+/* Called after the instruction INST at PC has executed, or with a NULL
+   INST after fetching it raised an exception. */
+
+void
+profile_step (MIPSImage &img, instruction *inst, mem_addr pc)
+{
+  profile_t &prof = img.profile();
+  mem_addr next_pc = img.reg_image().PC;
+  mem_addr ret = pc + (delayed_branches ? 2 : 1) * BYTES_PER_WORD;
+
+  if (prof.stack.empty ())
+    prof.stack.push_back ({add_node (prof, pc, -1), 0});
+  if (inst == NULL)
+    {
+      if (next_pc == EXCEPTION_ADDR)
+	push_frame (prof, next_pc, img.reg_image().CP0_EPC);
+      return;
+    }
+  prof.nodes[prof.stack.back ().node].self += 1;
+
+  switch (OPCODE (inst))
+    {
+    case Y_JAL_OP:
+    case Y_JALR_OP:
+      push_frame (prof, next_pc, ret);
+      break;
+
+    case Y_JR_OP:
+      if (RS (inst) == 31)
+	pop_frame (prof, next_pc);
+      break;
+
+    case Y_ERET_OP:
+      pop_frame (prof, next_pc);
+      break;
+
+    default:
+      /* The exception handler runs as if it were called. */
+      if (next_pc == EXCEPTION_ADDR && pc != EXCEPTION_ADDR)
+	push_frame (prof, next_pc, img.reg_image().CP0_EPC);
+      break;
+    }
+}
+
+
+/* The function that ADDR is in, as a label (or the address itself). */
+
+static mem_addr
+function_of (MIPSImage &img, mem_addr addr)
+{
+  label *l = find_label_before (img, addr);
+
+  return l != NULL ? l->addr : addr;
+}
+
+
+static std::string
+function_name (MIPSImage &img, mem_addr addr)
+{
+  label *l = find_label_before (img, addr);
+  char buf[64];
+
+  if (l != NULL && (mem_addr) l->addr == addr)
+    return l->name;
+  if (l != NULL)
+    {
+      snprintf (buf, sizeof (buf), "+0x%x", (unsigned) (addr - l->addr));
+      return std::string (l->name) + buf;
+    }
+  snprintf (buf, sizeof (buf), "0x%08x", addr);
+  return buf;
+}
+
+
+/* Exclusive and inclusive counts and calls per function, in order of
+   address.  A recursive function's inclusive count includes each
+   instruction once. */
+
+std::vector<profile_function_t>
+profile_functions (MIPSImage &img)
+{
+  profile_t &prof = img.profile();
+  std::map<mem_addr, profile_function_t> by_func;
+  std::vector<profile_function_t> result;
+  size_t i;
+
+  for (i = 0; i < prof.nodes.size (); i ++)
+    {
+      const profile_node_t &node = prof.nodes[i];
+      mem_addr func = function_of (img, node.func);
+      auto it = by_func.find (func);
+
+      if (it == by_func.end ())
+	it = by_func.emplace (func, profile_function_t {function_name (img, func), func, 0, 0, 0}).first;
+      it->second.self += node.self;
+      it->second.calls += node.calls;
+
+      std::set<mem_addr> on_path;
+      for (int n = (int) i; n >= 0; n = prof.nodes[n].parent)
+	if (on_path.insert (function_of (img, prof.nodes[n].func)).second)
+	  by_func[function_of (img, prof.nodes[n].func)].total += node.self;
+    }
+
+  for (auto &[func, f] : by_func)
+    result.push_back (f);
+  return result;
+}
+
+
+static void
+node_path (MIPSImage &img, const profile_t &prof, int n, std::vector<std::string> &names)
+{
+  names.clear ();
+  for (; n >= 0; n = prof.nodes[n].parent)
+    names.push_back (function_name (img, function_of (img, prof.nodes[n].func)));
+}
+
+
+/* The counts in the "collapsed stack" format of flamegraph.pl and
+   speedscope: one "root;caller;callee count" line per call path. */
+
+std::string
+profile_collapsed (MIPSImage &img)
+{
+  profile_t &prof = img.profile();
+  std::vector<std::string> names;
+  std::string out;
+  size_t i;
+
+  for (i = 0; i < prof.nodes.size (); i ++)
+    {
+      if (prof.nodes[i].self == 0)
+	continue;
+      node_path (img, prof, (int) i, names);
+      for (auto it = names.rbegin (); it != names.rend (); ++it)
+	{
+	  if (it != names.rbegin ())
+	    out += ';';
+	  out += *it;
+	}
+      out += ' ';
+      out += std::to_string (prof.nodes[i].self);
+      out += '\n';
+    }
+  return out;
+}
+
+
+/* Protocol buffer encoding, just enough for pprof's profile.proto. */
+
+static void
+pb_varint (std::string &out, uint64_t v)
+{
+  while (v >= 0x80)
+    {
+      out += (char) (v | 0x80);
+      v >>= 7;
+    }
+  out += (char) v;
+}
+
+
+static void
+pb_uint (std::string &out, int field, uint64_t v)
+{
+  pb_varint (out, (uint64_t) field << 3);
+  pb_varint (out, v);
+}
+
+
+static void
+pb_bytes (std::string &out, int field, const std::string &bytes)
+{
+  pb_varint (out, ((uint64_t) field << 3) | 2);
+  pb_varint (out, bytes.size ());
+  out += bytes;
+}
+
+
+/* The counts as an (uncompressed) pprof profile: one function and
+   location per function, and a sample per call path. */
+
+std::string
+profile_pprof (MIPSImage &img)
+{
+  profile_t &prof = img.profile();
+  std::vector<std::string> strings = {""};
+  std::map<std::string, uint64_t> string_ids;
+  std::map<mem_addr, uint64_t> function_ids;
+  std::string out, msg;
+  size_t i;
+
+  auto string_id = [&] (const std::string &s) {
+    auto it = string_ids.find (s);
+    if (it != string_ids.end ())
+      return it->second;
+    strings.push_back (s);
+    return string_ids[s] = strings.size () - 1;
+  };
+
+  msg.clear ();			/* sample_type = instructions/count */
+  pb_uint (msg, 1, string_id ("instructions"));
+  pb_uint (msg, 2, string_id ("count"));
+  pb_bytes (out, 1, msg);
+
+  for (i = 0; i < prof.nodes.size (); i ++)
+    {
+      std::string locations, values;
+
+      if (prof.nodes[i].self == 0)
+	continue;
+      for (int n = (int) i; n >= 0; n = prof.nodes[n].parent) /* Leaf first */
+	{
+	  mem_addr func = function_of (img, prof.nodes[n].func);
+	  auto it = function_ids.find (func);
+
+	  if (it == function_ids.end ())
+	    it = function_ids.emplace (func, function_ids.size () + 1).first;
+	  pb_varint (locations, it->second);
+	}
+      pb_varint (values, prof.nodes[i].self);
+
+      msg.clear ();
+      pb_bytes (msg, 1, locations);
+      pb_bytes (msg, 2, values);
+      pb_bytes (out, 2, msg);
+    }
+
+  for (auto &[func, id] : function_ids)
+    {
+      std::string line;
+
+      msg.clear ();		/* location */
+      pb_uint (msg, 1, id);
+      pb_uint (msg, 3, func);
+      pb_uint (line, 1, id);
+      pb_bytes (msg, 4, line);
+      pb_bytes (out, 4, msg);
+
+      msg.clear ();		/* function */
+      pb_uint (msg, 1, id);
+      pb_uint (msg, 2, string_id (function_name (img, func)));
+      pb_bytes (out, 5, msg);
+    }
+
+  for (const std::string &s : strings)
+    pb_bytes (out, 6, s);
+
+  msg.clear ();			/* period_type, period */
+  pb_uint (msg, 1, string_id ("instructions"));
+  pb_uint (msg, 2, string_id ("count"));
+  pb_bytes (out, 11, msg);
+  pb_uint (out, 12, 1);
+  return out;
+}
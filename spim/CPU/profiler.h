@@ -0,0 +1,59 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "spim.h"
+#include "instruction.h"
+
+class MIPSImage;
+
+/* A per-function profiler.  While it is on, the engine tells it about
+   every instruction executed; jal/jalr (and exceptions) push a frame on
+   a shadow call stack and jr $ra (and eret) pop it.  Instruction counts
+   are kept per calling context, in a tree of call paths, and symbolized
+   with the labels only when exported. */
+
+#define PROFILE_MAX_DEPTH 512	/* Deeper calls are counted in the caller */
+
+typedef struct profile_node {
+	mem_addr func;			/* Entry point */
+	int parent;			/* -1 at the root */
+	uint64_t self;			/* Instructions executed in FUNC itself */
+	uint64_t calls;
+	std::vector<int> children;
+} profile_node_t;
+
+typedef struct profile_frame {
+	int node;
+	mem_addr ret;			/* Where its return should go */
+} profile_frame_t;
+
+typedef struct profile {
+	bool enabled = false;
+	std::vector<profile_node_t> nodes; /* 0 is the root */
+	std::vector<profile_frame_t> stack;
+	int lost_frames = 0;		/* Calls past PROFILE_MAX_DEPTH */
+} profile_t;
+
+typedef struct profile_function {
+	std::string name;
+	mem_addr addr;
+	uint64_t self;			/* Exclusive count */
+	uint64_t total;			/* Inclusive count */
+	uint64_t calls;
+} profile_function_t;
+
+#define PROFILE_STEP(img, INST, PC)					\
+		if (img.profile().enabled) profile_step (img, INST, PC)
+
+void profile_enable (MIPSImage &img, bool on);
+void profile_step (MIPSImage &img, instruction *inst, mem_addr pc);
+std::vector<profile_function_t> profile_functions (MIPSImage &img);
+std::string profile_collapsed (MIPSImage &img);
+std::string profile_pprof (MIPSImage &img);
+
+#endif
@@ -0,0 +1,195 @@
+#include <stdio.h>
+#include <stdint.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "spim.h"
+#include "string-stream.h"
+#include "spim-utils.h"
+#include "image.h"
+#include "elf_loader.h"
+#include "reassemble.h"
+#include "program_cache.h"
+
+
+typedef struct program_entry {
+	std::string source;
+	const kernel_image_t *kernel;
+	bool bare_machine;
+	bool accept_pseudo_insts;
+	bool delayed_branches;
+	std::shared_ptr<const kernel_snapshot_t> snap;
+	std::shared_ptr<const program_regions_t> regions; /* NULL for ELF files */
+	unsigned long last_use;
+} program_entry;
+
+static std::mutex cache_mtx;
+static std::unordered_map<uint64_t, program_entry> cache;
+static std::unordered_map<std::string, uint64_t> last_by_path; /* Entry last loaded from a file */
+static unsigned long use_clock;
+
+
+/* FNV-1a over the source, then the flags that change what it assembles
+   to. */
+
+static uint64_t
+program_hash (const std::string &source, const kernel_image_t *kernel,
+	      bool bare, bool accept, bool delayed)
+{
+  uint64_t h = 14695981039346656037ULL;
+  size_t i;
+
+  for (i = 0; i < source.size (); i ++)
+    h = (h ^ (unsigned char) source[i]) * 1099511628211ULL;
+  h = (h ^ (uintptr_t) kernel) * 1099511628211ULL;
+  h = (h ^ ((bare << 2) | (accept << 1) | delayed)) * 1099511628211ULL;
+  return h;
+}
+
+
+static bool
+read_file (const char *fpath, std::string &contents)
+{
+  FILE *file = fopen (fpath, "rb");
+  char buf[4096];
+  size_t n;
+
+  if (file == NULL)
+    return false;
+  while ((n = fread (buf, 1, sizeof (buf), file)) > 0)
+    contents.append (buf, n);
+  fclose (file);
+  return true;
+}
+
+
+/* A program can be replayed from its image only if assembling it printed
+   nothing (errors, warnings, or undefined local labels), since a replay
+   would not print it again. */
+
+static bool
+cacheable (MIPSImage &img)
+{
+  return img.assembler().diagnostic_count == 0;
+}
+
+
+/* Initialize IMG with the exception handler KERNEL and load the program
+   in FPATH, as initialize_world_from_kernel and read_assembly_file would.
+   FPATH may also be an ELF executable.  If the program is not cached but
+   an earlier version of the file is, only the regions that were edited
+   are assembled again.  Return false if the file cannot be loaded. */
+
+bool
+load_program_cached (MIPSImage &img, const kernel_image_t *kernel, const char *fpath)
+{
+  bool bare = img.assembler().bare_machine;
+  bool accept = img.assembler().accept_pseudo_insts;
+  std::shared_ptr<const kernel_snapshot_t> hit, prev;
+  std::shared_ptr<const program_regions_t> prev_regions;
+  std::shared_ptr<kernel_snapshot_t> snap;
+  std::shared_ptr<program_regions_t> regions;
+  bool elf;
+  std::string source;
+  uint64_t key;
+
+  if (!read_file (fpath, source))
+    {
+      /* Let read_assembly_file report it. */
+      initialize_world_from_kernel (img, kernel);
+      return read_assembly_file (img, fpath);
+    }
+
+  key = program_hash (source, kernel, bare, accept, delayed_branches);
+  {
+    std::lock_guard<std::mutex> lock (cache_mtx);
+    auto it = cache.find (key);
+
+    if (it != cache.end ()
+	&& it->second.kernel == kernel
+	&& it->second.bare_machine == bare
+	&& it->second.accept_pseudo_insts == accept
+	&& it->second.delayed_branches == delayed_branches
+	&& it->second.source == source)
+      {
+	it->second.last_use = ++ use_clock;
+	hit = it->second.snap;
+      }
+
+    auto last = last_by_path.find (fpath);
+    if (!hit && last != last_by_path.end ()
+	&& (it = cache.find (last->second)) != cache.end ()
+	&& it->second.regions
+	&& it->second.kernel == kernel
+	&& it->second.bare_machine == bare
+	&& it->second.accept_pseudo_insts == accept
+	&& it->second.delayed_branches == delayed_branches)
+      {
+	prev = it->second.snap;
+	prev_regions = it->second.regions;
+      }
+  }
+
+  if (hit)
+    {
+      initialize_world_from_kernel (img, &hit->image);
+      return true;
+    }
+
+  elf = (source.compare (0, 4, "\177ELF") == 0);
+  if (!elf)
+    regions = std::make_shared<program_regions_t> ();
+
+  reassemble_result result = NEEDS_FULL_ASSEMBLY;
+  if (prev && !elf)
+    {
+      initialize_world_from_kernel (img, &prev->image);
+      result = reassemble_regions (img, fpath, *prev_regions, source, *regions);
+      if (result == REASSEMBLED_WITH_ERRORS)
+	return true;
+    }
+
+  if (result == NEEDS_FULL_ASSEMBLY)
+    {
+      initialize_world_from_kernel (img, kernel);
+      if (elf
+	  ? !read_elf_file (img, fpath)
+	  : !assemble_regions (img, fpath, source, *regions))
+	return false;
+    }
+
+  /* Don't file the image under the old source if the file changed
+     while it was being assembled. */
+  std::string assembled;
+  if (!read_file (fpath, assembled) || assembled != source)
+    return true;
+
+  snap = std::make_shared<kernel_snapshot_t> ();
+  if (!cacheable (img) || !capture_kernel_image (img, *snap))
+    return true;
+
+  std::lock_guard<std::mutex> lock (cache_mtx);
+  if (cache.size () >= PROGRAM_CACHE_SIZE && cache.find (key) == cache.end ())
+    {
+      auto oldest = cache.begin ();
+
+      for (auto it = cache.begin (); it != cache.end (); ++ it)
+	if (it->second.last_use < oldest->second.last_use)
+	  oldest = it;
+      cache.erase (oldest);
+    }
+  program_entry &entry = cache[key];
+  entry.source = source;
+  entry.kernel = kernel;
+  entry.bare_machine = bare;
+  entry.accept_pseudo_insts = accept;
+  entry.delayed_branches = delayed_branches;
+  entry.snap = snap;
+  entry.regions = regions;
+  entry.last_use = ++ use_clock;
+  last_by_path[fpath] = key;
+  return true;
+}
@@ -0,0 +1,16 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include "kernel_image.h"
+
+class MIPSImage;
+
+/* Assembled programs, keyed by a hash of their source and the assembler
+   flags, so loading the same file again (a reset, or several contexts
+   running the same bot) copies an image instead of reassembling it. */
+
+#define PROGRAM_CACHE_SIZE 16	/* Programs kept; least recently used go first */
+
+bool load_program_cached (MIPSImage &img, const kernel_image_t *kernel, const char *fpath);
+
+#endif
@@ -0,0 +1,435 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "spim.h"
+#include "string-stream.h"
+#include "spim-utils.h"
+#include "inst.h"
+#include "data.h"
+#include "image.h"
+#include "mem.h"
+#include "reg.h"
+#include "scanner.h"
+#include "parser.h"
+#include "parser_yacc.h"
+#include "sym-tbl.h"
+#include "reassemble.h"
+
+
+static bool
+is_id_char (char c, bool first)
+{
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c == '.'
+    || (!first && c >= '0' && c <= '9');
+}
+
+
+/* Append to LABELS the labels defined at the start of LINE (as in
+   "loop: add ..." or "a: b:").  Return true if there are any. */
+
+static bool
+line_labels (const std::string &line, std::vector<std::string> *labels)
+{
+  size_t i = 0;
+  bool found = false;
+
+  for (;;)
+    {
+      size_t begin, end;
+
+      while (i < line.size () && (line[i] == ' ' || line[i] == '\t'))
+	i ++;
+      begin = i;
+      if (i >= line.size () || !is_id_char (line[i], true))
+	return found;
+      while (i < line.size () && is_id_char (line[i], false))
+	i ++;
+      end = i;
+      while (i < line.size () && (line[i] == ' ' || line[i] == '\t'))
+	i ++;
+      if (i >= line.size () || line[i] != ':')
+	return found;
+      i ++;
+      if (labels != NULL)
+	labels->push_back (line.substr (begin, end - begin));
+      found = true;
+    }
+}
+
+
+/* Split SOURCE into regions, each beginning at a line that defines a
+   label (the first region may have none). */
+
+static void
+split_regions (const std::string &source, std::vector<source_region_t> &regions)
+{
+  size_t pos = 0;
+  int line_no = 1;
+
+  regions.clear ();
+  while (pos < source.size ())
+    {
+      size_t eol = source.find ('\n', pos);
+      size_t next = (eol == std::string::npos) ? source.size () : eol + 1;
+      std::string line = source.substr (pos, next - pos);
+
+      if (regions.empty () || line_labels (line, NULL))
+	{
+	  source_region_t r = {};
+
+	  r.first_line = line_no;
+	  line_labels (line, &r.labels);
+	  regions.push_back (r);
+	}
+      regions.back ().text += line;
+      regions.back ().n_lines += 1;
+      pos = next;
+      line_no += 1;
+    }
+}
+
+
+/* A region can be reassembled on its own only if it cannot change a
+   label's binding or move a segment: no constant definitions, symbol
+   directives, or segment directives with an address. */
+
+static bool
+region_is_patchable (const std::string &text)
+{
+  static const char *const symbol_dirs[] = {".globl", ".extern", ".lcomm", ".comm"};
+  static const char *const segment_dirs[] = {".text", ".ktext", ".data", ".kdata", ".sdata", ".rdata"};
+  size_t pos = 0;
+
+  while (pos < text.size ())
+    {
+      size_t eol = text.find ('\n', pos);
+      std::string line = text.substr (pos, (eol == std::string::npos ? text.size () : eol) - pos);
+      size_t hash = line.find ('#');
+      size_t i;
+
+      pos = (eol == std::string::npos) ? text.size () : eol + 1;
+      if (hash != std::string::npos && line.find ('"') == std::string::npos)
+	line.erase (hash);
+
+      if (line.find ('=') != std::string::npos)
+	return false;
+      for (i = 0; i < sizeof (symbol_dirs) / sizeof (symbol_dirs[0]); i ++)
+	if (line.find (symbol_dirs[i]) != std::string::npos)
+	  return false;
+      for (i = 0; i < sizeof (segment_dirs) / sizeof (segment_dirs[0]); i ++)
+	{
+	  size_t d = line.find (segment_dirs[i]);
+
+	  if (d != std::string::npos
+	      && line.find_first_not_of (" \t\r", d + strlen (segment_dirs[i])) != std::string::npos)
+	    return false;
+	}
+    }
+  return true;
+}
+
+
+static void
+save_point (MIPSImage &img, asm_point_t &p)
+{
+  reg_image_t &reg = img.reg_image();
+
+  p.text_pc = reg.next_text_pc;
+  p.k_text_pc = reg.next_k_text_pc;
+  p.data_pc = reg.next_data_pc;
+  p.k_data_pc = reg.next_k_data_pc;
+  p.gp_item_addr = reg.next_gp_item_addr;
+  p.in_kernel = reg.in_kernel;
+  p.auto_alignment = reg.auto_alignment;
+  p.text_dir = img.assembler().text_dir;
+  p.data_dir = img.assembler().data_dir;
+  p.noat_flag = img.assembler().noat_flag;
+}
+
+
+/* Put the assembler back where it was at P.  Call after initialize_parser,
+   which resets the directive flags. */
+
+static void
+restore_point (MIPSImage &img, const asm_point_t &p)
+{
+  reg_image_t &reg = img.reg_image();
+
+  reg.next_text_pc = p.text_pc;
+  reg.next_k_text_pc = p.k_text_pc;
+  reg.next_data_pc = p.data_pc;
+  reg.next_k_data_pc = p.k_data_pc;
+  reg.next_gp_item_addr = p.gp_item_addr;
+  reg.in_kernel = p.in_kernel;
+  reg.auto_alignment = p.auto_alignment;
+  img.assembler().text_dir = p.text_dir;
+  img.assembler().data_dir = p.data_dir;
+  img.assembler().noat_flag = p.noat_flag;
+}
+
+
+static bool
+same_point (const asm_point_t &a, const asm_point_t &b)
+{
+  return a.text_pc == b.text_pc && a.k_text_pc == b.k_text_pc
+    && a.data_pc == b.data_pc && a.k_data_pc == b.k_data_pc
+    && a.gp_item_addr == b.gp_item_addr && a.in_kernel == b.in_kernel
+    && a.auto_alignment == b.auto_alignment && a.text_dir == b.text_dir
+    && a.data_dir == b.data_dir && a.noat_flag == b.noat_flag;
+}
+
+
+static bool
+in_region (const source_region_t &r, mem_addr addr)
+{
+  return (addr >= r.start.text_pc && addr < r.end.text_pc)
+    || (addr >= r.start.k_text_pc && addr < r.end.k_text_pc)
+    || (addr >= r.start.data_pc && addr < r.end.data_pc)
+    || (addr >= r.start.k_data_pc && addr < r.end.k_data_pc);
+}
+
+
+/* Forget the pending label uses in R's code and data, which is about to
+   be replaced. */
+
+static void
+drop_region_uses (MIPSImage &img, const source_region_t &r)
+{
+  sym_table_t &tbl = img.symbol_table();
+  int i;
+
+  for (i = 0; i < tbl.size; i ++)
+    {
+      label *l = tbl.slots[i].lab;
+      label_use **u;
+
+      if (l == NULL)
+	continue;
+      for (u = &l->uses; *u != NULL; )
+	if (in_region (r, (*u)->addr))
+	  *u = (*u)->next;	/* Left in the arena */
+	else
+	  u = &(*u)->next;
+    }
+}
+
+
+static void
+clear_region_memory (MIPSImage &img, const source_region_t &r)
+{
+  mem_addr addr;
+
+  for (addr = r.start.text_pc; addr < r.end.text_pc; addr += BYTES_PER_WORD)
+    set_mem_inst (img, addr, NULL);
+  for (addr = r.start.k_text_pc; addr < r.end.k_text_pc; addr += BYTES_PER_WORD)
+    set_mem_inst (img, addr, NULL);
+  for (addr = r.start.data_pc; addr < r.end.data_pc; addr ++)
+    set_mem_byte (img, addr, 0);
+  for (addr = r.start.k_data_pc; addr < r.end.k_data_pc; addr ++)
+    set_mem_byte (img, addr, 0);
+}
+
+
+static const char *
+base_name (const char *fpath)
+{
+  const char *file_name = strrchr (fpath, '/');
+
+  return (file_name == NULL) ? fpath : file_name + 1;
+}
+
+
+/* Assemble SOURCE, read from FPATH, into IMG as read_assembly_file does,
+   recording in PROG where each of its regions started and ended and the
+   file's local labels.  Return false if the file cannot be opened. */
+
+bool
+assemble_regions (MIPSImage &img, const char *fpath, const std::string &source,
+		  program_regions_t &prog)
+{
+  assembler_t &as = img.assembler();
+  std::vector<source_region_t> &regions = prog.regions;
+  FILE *file = fopen (fpath, "rt");
+  asm_point_t last;
+  size_t next = 0;
+  label *l;
+
+  if (file == NULL)
+    {
+      error (img, "Cannot open file: `%s'\n", fpath);
+      return false;
+    }
+
+  split_regions (source, regions);
+  initialize_scanner (img, file, base_name (fpath));
+  initialize_parser (img, fpath);
+
+  /* Each call parses one statement, so the scanner is at the start of a
+     line when a region begins. */
+  do
+    for (; next < regions.size () && regions[next].first_line <= as.line_no; next ++)
+      {
+	save_point (img, regions[next].start);
+	if (next > 0)
+	  regions[next - 1].end = regions[next].start;
+      }
+  while (!yyparse (img));
+
+  save_point (img, last);
+  for (size_t i = (next > 0 ? next - 1 : 0); i < regions.size (); i ++)
+    {
+      if (i >= next)
+	regions[i].start = last;
+      regions[i].end = last;
+    }
+
+  prog.locals.clear ();
+  for (l = img.get_local_labels(); l != NULL; l = l->next_local)
+    {
+      local_symbol_t sym;
+
+      sym.name = l->name;
+      sym.addr = (mem_addr) l->addr;
+      sym.const_flag = l->const_flag;
+      prog.locals.push_back (sym);
+    }
+
+  finish_scanner (img);
+  fclose (file);
+  flush_local_labels (img, !as.parse_error_occurred);
+  end_of_assembly_file (img);
+  return true;
+}
+
+
+/* IMG holds the program that OLD_PROG describes.  Update it to SOURCE,
+   an edit of that program, by parsing just the regions that changed, and
+   describe the result in PROG.  If the edit changes the number, length or
+   labels of regions, or moves anything, leave IMG in an undefined state
+   and return NEEDS_FULL_ASSEMBLY. */
+
+reassemble_result
+reassemble_regions (MIPSImage &img, const char *fpath, const program_regions_t &old_prog,
+		    const std::string &source, program_regions_t &prog)
+{
+  assembler_t &as = img.assembler();
+  std::vector<size_t> changed;
+  std::set<std::string> redefined;
+  bool errors = false;
+  size_t i, j;
+
+  split_regions (source, prog.regions);
+  if (prog.regions.size () != old_prog.regions.size ())
+    return NEEDS_FULL_ASSEMBLY;
+
+  for (i = 0; i < prog.regions.size (); i ++)
+    {
+      source_region_t &r = prog.regions[i];
+      const source_region_t &old_r = old_prog.regions[i];
+
+      if (r.n_lines != old_r.n_lines || r.labels != old_r.labels)
+	return NEEDS_FULL_ASSEMBLY;
+      r.start = old_r.start;
+      r.end = old_r.end;
+      if (r.text != old_r.text)
+	{
+	  if (!region_is_patchable (r.text) || !region_is_patchable (old_r.text))
+	    return NEEDS_FULL_ASSEMBLY;
+	  changed.push_back (i);
+	  redefined.insert (r.labels.begin (), r.labels.end ());
+	}
+    }
+  prog.locals = old_prog.locals;
+
+  /* Bring the file's local labels back into scope.  Those that a changed
+     region defines are put on the local list when it is parsed, so only
+     the others go on it here (a label on it twice would make it loop). */
+  for (i = 0; i < prog.locals.size (); i ++)
+    {
+      char *name = (char *) prog.locals[i].name.c_str ();
+      label *l;
+
+      if (label_is_defined (img, name) != NULL)
+	continue;
+      l = lookup_label (img, name);
+      l->addr = prog.locals[i].addr;
+      l->const_flag = prog.locals[i].const_flag;
+      if (redefined.count (prog.locals[i].name) == 0)
+	{
+	  l->next_local = img.get_local_labels();
+	  img.set_local_labels(l);
+	}
+    }
+
+  for (i = 0; i < changed.size (); i ++)
+    {
+      const source_region_t &r = prog.regions[changed[i]];
+      std::vector<mem_addr> label_addrs;
+      asm_point_t end;
+      FILE *in;
+
+      /* Undefine the region's labels, so parsing it defines them again. */
+      for (j = 0; j < r.labels.size (); j ++)
+	{
+	  label *l = label_is_defined (img, (char *) r.labels[j].c_str ());
+
+	  if (l == NULL)
+	    return NEEDS_FULL_ASSEMBLY;
+	  label_addrs.push_back ((mem_addr) l->addr);
+	  l->addr = 0;
+	}
+
+      drop_region_uses (img, r);
+      clear_region_memory (img, r);
+
+      if ((in = fmemopen ((void *) r.text.data (), r.text.size (), "r")) == NULL)
+	return NEEDS_FULL_ASSEMBLY;
+      initialize_scanner (img, in, base_name (fpath));
+      initialize_parser (img, fpath);
+      as.line_no = r.first_line;
+      restore_point (img, r.start);
+      while (!yyparse (img)) ;
+      finish_scanner (img);
+      fclose (in);
+
+      /* A local label the region failed to define again is not on the
+	 local list yet, but must still be flushed. */
+      for (j = 0; j < r.labels.size (); j ++)
+	{
+	  label *l = label_is_defined (img, (char *) r.labels[j].c_str ());
+
+	  if (l != NULL && !l->global_flag && l->addr == 0)
+	    {
+	      l->next_local = img.get_local_labels();
+	      img.set_local_labels(l);
+	    }
+	}
+
+      /* Once messages have been shown, keep going rather than assemble
+	 the whole file again and show them twice.  The result is not
+	 cached, so it need not match a full assembly exactly. */
+      if (as.diagnostic_count != 0)
+	errors = true;
+      if (errors)
+	continue;
+
+      save_point (img, end);
+      if (!same_point (end, r.end))
+	return NEEDS_FULL_ASSEMBLY;
+      for (j = 0; j < r.labels.size (); j ++)
+	{
+	  label *l = label_is_defined (img, (char *) r.labels[j].c_str ());
+
+	  if (l == NULL || (mem_addr) l->addr != label_addrs[j])
+	    return NEEDS_FULL_ASSEMBLY;
+	}
+    }
+
+  flush_local_labels (img, !errors);
+  end_of_assembly_file (img);
+  return errors ? REASSEMBLED_WITH_ERRORS : REASSEMBLED;
+}
@@ -0,0 +1,67 @@
+#ifndef REASSEMBLE_H
+#define REASSEMBLE_H
+
+#include <string>
+#include <vector>
+
+#include "mem_image.h"
+
+class MIPSImage;
+
+/* Incremental reassembly.  A program's source is split into regions
+   that each start at a line defining a label.  Assembling it records
+   where the assembler was at every region boundary, so that after an
+   edit only the regions that changed are parsed again, in place, into
+   a copy of the old program. */
+
+/* Where the assembler was between two lines. */
+
+typedef struct asm_point {
+	mem_addr text_pc;
+	mem_addr k_text_pc;
+	mem_addr data_pc;
+	mem_addr k_data_pc;
+	mem_addr gp_item_addr;
+	bool in_kernel;
+	bool auto_alignment;
+	bool text_dir;
+	bool data_dir;
+	bool noat_flag;
+} asm_point_t;
+
+typedef struct source_region {
+	int first_line;			/* 1-based */
+	int n_lines;
+	std::string text;
+	std::vector<std::string> labels; /* Defined on its first line */
+	asm_point_t start;
+	asm_point_t end;
+} source_region_t;
+
+/* A label local to the file, which is flushed from the symbol table
+   once the file is assembled but must be seen again by its regions. */
+
+typedef struct local_symbol {
+	std::string name;
+	mem_addr addr;
+	bool const_flag;
+} local_symbol_t;
+
+typedef struct program_regions {
+	std::vector<source_region_t> regions;
+	std::vector<local_symbol_t> locals;
+} program_regions_t;
+
+enum reassemble_result {
+	REASSEMBLED,			/* Only changed regions were parsed */
+	REASSEMBLED_WITH_ERRORS,	/* Ditto, but they reported problems */
+	NEEDS_FULL_ASSEMBLY		/* The edit moved something; start over */
+};
+
+bool assemble_regions (MIPSImage &img, const char *fpath, const std::string &source,
+		       program_regions_t &prog);
+reassemble_result reassemble_regions (MIPSImage &img, const char *fpath,
+				      const program_regions_t &old_prog,
+				      const std::string &source, program_regions_t &prog);
+
+#endif
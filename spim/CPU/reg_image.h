@@ -31,6 +31,7 @@ typedef struct regimage {
 	reg_word CCR[4][32], CPR[4][32];
 
 	int exception_occurred;
+	int exit_status = 0;		/* Value passed to the exit syscall */
 
 	bool in_kernel = false;			/* => data goes to kdata, not data */
 
@@ -62,6 +62,12 @@
 #include "parser_yacc.h"
 #include "syscall.h"
 #include "run.h"
+#include "profiler.h"
+#include "inst_mix.h"
+#include "cache_model.h"
+#include "branch_predictor.h"
+#include "pipeline_model.h"
+#include "exec_trace.h"
 
 bool force_break = false;	/* For the execution env. to force an execution break */
 
@@ -101,9 +107,11 @@ static int running_in_delay_slot = 0;
 
 #define BRANCH_INST(img, TEST, TARGET, NULLIFY)			\
 		{						\
-		  if (TEST)					\
+		  mem_addr target = (TARGET);			\
+		  bool taken = (TEST);				\
+		  PREDICT_BRANCH (img, img.reg_image().PC, target, taken); \
+		  if (taken)					\
 		    {						\
-		      mem_addr target = (TARGET);		\
 		      if (delayed_branches)			\
 			{					\
 			  /* +4 since jump in delay slot */	\
@@ -175,6 +183,19 @@ static int running_in_delay_slot = 0;
 
 
 
+/* Tell the models that count instructions that INST, at PC, has
+   executed.  Every way out of spim_step after an instruction runs comes
+   here, so they all count the same ones. */
+
+static void
+finish_step (MIPSImage &img, instruction *inst, mem_addr pc)
+{
+  COUNT_INST (img, inst, pc);
+  PROFILE_STEP (img, inst, pc);
+  PIPELINE_RETIRE (img, inst, pc);
+}
+
+
 /* Run the program stored in memory, starting at address PC for
    1 instruction. If flag DISPLAY is true, print
    each instruction before it executes. Return true if program's
@@ -184,16 +205,24 @@ bool
 spim_step (MIPSImage &img, bool display)
 {
   instruction *inst;
+  mem_addr pc = img.reg_image().PC;
   static reg_word *delayed_load_addr1 = NULL, delayed_load_value1;
   static reg_word *delayed_load_addr2 = NULL, delayed_load_value2;
+  /* A READ parked on the input queue runs again every cycle until its
+     input arrives, and only then is it a step: the models see it
+     fetched and issued on its first run and executed on its last. */
+  bool rerun = img.input_queue().waiting;
 
 	img.reg_image().R[0] = 0;		/* Maintain invariant value */
 
 	inst = read_mem_inst (img, img.reg_image().PC);
+	if (!rerun)
+	  CACHE_FETCH (img, pc);
 	if (img.reg_image().exception_occurred) /* In reading instruction */
 	{
 		img.reg_image().exception_occurred = 0;
 		handle_exception (img);
+		PROFILE_STEP (img, NULL, pc);
 		return true;
 	}
 	else if (inst == NULL)
@@ -216,6 +245,9 @@ spim_step (MIPSImage &img, bool display)
 	  test_assembly (inst);
 #endif
 
+	  if (!rerun)
+	    PIPELINE_ISSUE (img, inst, pc);
+
 	  DO_DELAYED_UPDATE ();
 
 	  switch (OPCODE (inst))
@@ -367,8 +399,13 @@ spim_step (MIPSImage &img, bool display)
 
 	    case Y_BREAK_OP:
 	      if (RD (inst) == 1)
-		/* Debugger breakpoint */
-		RAISE_EXCEPTION (img, ExcCode_Bp, return true)
+		{
+		  /* Debugger breakpoint */
+		  raise_exception (img, ExcCode_Bp);
+		  TRACE_STEP (img, pc);
+		  finish_step (img, inst, pc);
+		  return true;
+		}
 	      else
 		RAISE_EXCEPTION (img, ExcCode_Bp, break);
 
@@ -1034,7 +1071,12 @@ spim_step (MIPSImage &img, bool display)
 
 	    case Y_SYSCALL_OP:
 	      if (!do_syscall (img))
-		return false;
+		{
+		  /* The program exited, but the syscall was still a step. */
+		  TRACE_STEP (img, pc);
+		  finish_step (img, inst, pc);
+		  return false;
+		}
 	      break;
 
 	    case Y_TEQ_OP:
@@ -1560,6 +1602,9 @@ spim_step (MIPSImage &img, bool display)
 
 	  /* After instruction executes: */
 	  img.reg_image().PC += BYTES_PER_WORD;
+	  if (img.input_queue().waiting)
+	    return true;	/* Parked: nothing has happened yet */
+	  TRACE_STEP (img, pc);
 
 	  if (img.reg_image().exception_occurred)
 	    {
@@ -1568,6 +1613,8 @@ spim_step (MIPSImage &img, bool display)
 	      handle_exception (img);
 	    }
 
+	  finish_step (img, inst, pc);
+
   return true;
 }
 
@@ -1667,6 +1714,7 @@ raise_exception (MIPSImage &img, int excode)
     {
       /* Ignore interrupt exception when interrupts disabled.  */
       img.reg_image().exception_occurred = 1;
+      COUNT_EXCEPTION (img, excode);
 	  last_exception_addr = img.reg_image().PC;
 
       if (running_in_delay_slot)
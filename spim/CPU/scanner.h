@@ -34,31 +34,23 @@
 
 /* Exported functions (besides yylex): */
 
-void initialize_scanner (FILE *in_file, const char *in_file_name);
-void push_scanner (FILE *in_file);
-void pop_scanner ();
+void initialize_scanner (MIPSImage &img, FILE *in_file, const char *in_file_name);
+void finish_scanner (MIPSImage &img);
+void push_scanner (MIPSImage &img, FILE *in_file);
+void pop_scanner (MIPSImage &img);
 char* erroneous_line (MIPSImage &img);
-void scanner_start_line ();
+void scanner_start_line (MIPSImage &img);
 int register_name_to_number (char *name);
-char *source_line (MIPSImage &img);
-
-#define YY_DECL \
-		int yylex(MIPSImage& img)
-extern YY_DECL;
-
-int yylex_destroy(void);
-
-/* Exported Variables: */
-
-/* This flag tells the scanner to treat the next sequence of letters
-   etc as an identifier and not look it up as an opcode. It permits us
-   to use opcodes as symbols in most places.  However, because of the
-   LALR(1) lookahead, it does not work for labels. */
-
-extern int only_id;
+unsigned source_line (MIPSImage &img);
 
 typedef intptr_union yylval_t;
 #define YYSTYPE yylval_t
-extern YYSTYPE yylval;		/* Value of token from YYLEX */
 
-extern int line_no;		/* Line number in input file*/
+/* The scanner is reentrant: its state hangs off IMG's assembler, which
+   gets a scanner from initialize_scanner. */
+
+#define YY_DECL \
+		int yylex_r (YYSTYPE *yylval_param, MIPSImage& img, yyscan_t yyscanner)
+extern YY_DECL;
+
+int yylex (YYSTYPE *lvalp, MIPSImage& img);
@@ -0,0 +1,87 @@
+#include <string>
+
+#include "spim.h"
+#include "string-stream.h"
+#include "image.h"
+#include "source_table.h"
+
+
+/* Add line LINE_NO of FILE_NAME, whose text is the LEN characters at
+   TEXT, to IMG's source table and return its id. */
+
+unsigned
+intern_source_line (MIPSImage &img, const char *file_name, int line_no,
+		    const char *text, int len)
+{
+  source_table_t &tbl = img.source_table();
+  source_line_t line;
+
+  /* Lines nearly always come from the file of the previous one. */
+  if (tbl.last_file < 0 || tbl.files[tbl.last_file].name != file_name)
+    {
+      size_t i;
+
+      for (i = 0; i < tbl.files.size (); i ++)
+	if (tbl.files[i].name == file_name)
+	  break;
+      if (i == tbl.files.size ())
+	{
+	  tbl.files.push_back (source_file_t ());
+	  tbl.files.back ().name = file_name;
+	}
+      tbl.last_file = (int) i;
+    }
+
+  source_file_t &file = tbl.files[tbl.last_file];
+  line.file = tbl.last_file;
+  line.line_no = line_no;
+  line.offset = file.text.size ();
+  file.text.append (text, len);
+  file.text.push_back ('\0');
+  tbl.lines.push_back (line);
+  return ((unsigned) tbl.lines.size ());
+}
+
+
+/* Return the source line with id ID, or NULL if there is none. */
+
+const source_line_t *
+find_source_line (MIPSImage &img, unsigned id)
+{
+  source_table_t &tbl = img.source_table();
+
+  if (id == 0 || id > tbl.lines.size ())
+    return (NULL);
+  return (&tbl.lines[id - 1]);
+}
+
+
+/* Print the source line with id ID as "file:line: text". */
+
+void
+format_source_line (MIPSImage &img, str_stream *ss, unsigned id)
+{
+  const source_line_t *line = find_source_line (img, id);
+
+  if (line != NULL)
+    {
+      const source_file_t &file = img.source_table().files[line->file];
+
+      ss_printf (img, ss, "%s:%d: %s", file.name.c_str (), line->line_no,
+		 file.text.c_str () + line->offset);
+    }
+}
+
+
+std::string
+source_line_string (MIPSImage &img, unsigned id)
+{
+  const source_line_t *line = find_source_line (img, id);
+
+  if (line == NULL)
+    return ("");
+
+  const source_file_t &file = img.source_table().files[line->file];
+  return (file.name + ":" + std::to_string (line->line_no) + ": "
+	  + (file.text.c_str () + line->offset));
+}
@@ -0,0 +1,39 @@
+#ifndef SOURCE_TABLE_H
+#define SOURCE_TABLE_H
+
+#include <string>
+#include <vector>
+
+#include "string-stream.h"
+
+class MIPSImage;
+
+/* Where instructions came from.  Each source line that produced an
+   instruction is kept once, in a text buffer per file, and instructions
+   refer to it by a small id; "file:line: text" is only formatted when
+   someone displays it. */
+
+typedef struct source_file {
+	std::string name;
+	std::string text;		/* Its lines, each ending in '\0' */
+} source_file_t;
+
+typedef struct source_line_ref {
+	int file;			/* Index in FILES */
+	int line_no;
+	size_t offset;			/* Of the line in the file's TEXT */
+} source_line_t;
+
+typedef struct source_table {
+	std::vector<source_file_t> files;
+	std::vector<source_line_t> lines; /* Id - 1 */
+	int last_file = -1;		/* File of the last line added */
+} source_table_t;
+
+unsigned intern_source_line (MIPSImage &img, const char *file_name, int line_no,
+			     const char *text, int len);
+const source_line_t *find_source_line (MIPSImage &img, unsigned id);
+void format_source_line (MIPSImage &img, str_stream *ss, unsigned id);
+std::string source_line_string (MIPSImage &img, unsigned id);
+
+#endif
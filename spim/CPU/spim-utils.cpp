@@ -57,6 +57,7 @@
 #include "parser_yacc.h"
 #include "run.h"
 #include "sym-tbl.h"
+#include "kernel_image.h"
 
 bool bare_machine;        /* => simulate bare machine */
 bool delayed_branches;        /* => simulate delayed branches */
@@ -81,6 +82,8 @@ int exception_occurred;
 
 int initial_text_size = TEXT_SIZE;
 
+mem_addr initial_text_limit = TEXT_LIMIT;
+
 int initial_data_size = DATA_SIZE;
 
 mem_addr initial_data_limit = DATA_LIMIT;
@@ -91,16 +94,18 @@ mem_addr initial_stack_limit = STACK_LIMIT;
 
 int initial_k_text_size = K_TEXT_SIZE;
 
+mem_addr initial_k_text_limit = K_TEXT_LIMIT;
+
 int initial_k_data_size = K_DATA_SIZE;
 
 mem_addr initial_k_data_limit = K_DATA_LIMIT;
 
 
 
-/* Initialize or reinitialize the state of the machine. */
+/* Clear the machine's memory, registers, and symbols. */
 
-void
-initialize_world (MIPSImage &img, const char *exception_files, bool print_message)
+static void
+reset_world (MIPSImage &img)
 {
   img.reg_image().auto_alignment = 1;
   
@@ -108,36 +113,69 @@ initialize_world (MIPSImage &img, const char *exception_files, bool print_messag
   if (img.reg_image().FGR == NULL)
     img.reg_image().FPR = (double *) xmalloc (img, FPR_LENGTH * sizeof (double));
   /* Allocate the memory */
-  make_memory (img, initial_text_size,
+  make_memory (img, initial_text_size, initial_text_limit,
 	       initial_data_size, initial_data_limit,
 	       initial_stack_size, initial_stack_limit,
-	       initial_k_text_size,
+	       initial_k_text_size, initial_k_text_limit,
 	       initial_k_data_size, initial_k_data_limit);
   initialize_registers (img);
-  initialize_inst_tables ();
   initialize_symbol_table (img);
+  arena_release (img.arena());	/* Old program's instructions and labels */
+  img.source_table() = source_table_t ();
   k_text_begins_at_point (img, K_TEXT_BOT);
   k_data_begins_at_point (img, K_DATA_BOT);
   data_begins_at_point (img, DATA_BOT);
   text_begins_at_point (img, TEXT_BOT);
+}
+
+
+static void
+define_main (MIPSImage &img)
+{
+  label *l = label_is_defined (img, "main");
+
+  /* A captured program may already define it. */
+  if (!img.assembler().bare_machine && (l == NULL || !SYMBOL_IS_DEFINED (l)))
+    {
+      (void)make_label_global (img, "main"); /* In case .globl main forgotten */
+      (void)record_label (img, "main", 0, 0);
+    }
+}
+
+
+/* Initialize or reinitialize the state of the machine. */
+
+void
+initialize_world (MIPSImage &img, const char *exception_files, bool print_message)
+{
+  reset_world (img);
 
   if (exception_files != NULL)
     {
-      bool old_bare = bare_machine;
-      bool old_accept = accept_pseudo_insts;
+      assembler_t &as = img.assembler();
+      bool old_bare = as.bare_machine;
+      bool old_accept = as.accept_pseudo_insts;
       char *filename;
       char *files;
+      char *next;
 
-      /* Save machine state */
-      bare_machine = false;     /* Exception handler uses extended machine */
-      accept_pseudo_insts = true;
+      /* Save machine state.  Only this image's copy of the flags changes,
+         so other contexts can be initialized at the same time. */
+      as.bare_machine = false;     /* Exception handler uses extended machine */
+      as.accept_pseudo_insts = true;
 
-      /* strtok modifies the string, so we must back up the string prior to use. */
+      /* The names are split in place, so we must back up the string prior
+         to use.  (Not strtok, which keeps its position in a global.) */
       if ((files = strdup (exception_files)) == NULL)
          fatal_error (img, "Insufficient memory to complete.\n");
 
-      for (filename = strtok (files, ";"); filename != NULL; filename = strtok (NULL, ";"))
+      for (filename = files; filename != NULL; filename = next)
          {
+            if ((next = strchr (filename, ';')) != NULL)
+               *next++ = '\0';
+            if (*filename == '\0')
+               continue;
+
             if (!read_assembly_file (img, filename))
                fatal_error (img, "Cannot read exception handler: %s\n", filename);
 
@@ -148,21 +186,28 @@ initialize_world (MIPSImage &img, const char *exception_files, bool print_messag
       free (files);
 
       /* Restore machine state */
-      bare_machine = old_bare;
-      accept_pseudo_insts = old_accept;
-
-      if (!bare_machine)
-      {
-	(void)make_label_global (img, "main"); /* In case .globl main forgotten */
-	(void)record_label (img, "main", 0, 0);
-      }
+      as.bare_machine = old_bare;
+      as.accept_pseudo_insts = old_accept;
+
+      define_main (img);
     }
-  yylex_destroy();
-  initialize_scanner (stdin, "");
   delete_all_breakpoints (img); // bruh TODO: this function is meant to be contextual-based and then we have THIS here?!?!
 }
 
 
+/* Initialize the machine from a prebuilt exception handler or program,
+   instead of assembling it. */
+
+void
+initialize_world_from_kernel (MIPSImage &img, const kernel_image_t *kernel)
+{
+  reset_world (img);
+  install_kernel_image (img, kernel);
+  define_main (img);
+  delete_all_breakpoints (img);
+}
+
+
 void
 write_startup_message (MIPSImage &img)
 {
@@ -224,14 +269,14 @@ read_assembly_file (MIPSImage &img, const char *fpath)
       file_name = strrchr(fpath, '/');
       file_name = file_name == NULL ? fpath : file_name + 1;
     
-      yylex_destroy();
-      initialize_scanner (file, file_name);
-      initialize_parser (fpath);
+      initialize_scanner (img, file, file_name);
+      initialize_parser (img, fpath);
 
       while (!yyparse (img)) ;
 
+      finish_scanner (img);
       fclose (file);
-      flush_local_labels (img, !parse_error_occurred);
+      flush_local_labels (img, !img.assembler().parse_error_occurred);
       end_of_assembly_file (img);
       return true;
     }
@@ -435,8 +480,18 @@ cycle_result_t run_spim_cycle_multi_ctx(std::map<unsigned int, MIPSImage> &imgs,
 
     for (auto &[ctx_num, img] : imgs) {
         bool cont; // Determines if the given context program is finished
+        bool was_waiting = img.input_queue().waiting;
         step_program(img, false, cont_bkpt, &cont);
 
+        if (cont && img.output_limit_exceeded()) {
+            run_error(img, "Output limit exceeded\n");
+            cont = false;
+        }
+
+        if (img.input_queue().waiting && !was_waiting) {
+            result.input_wanted_ctxs.insert(ctx_num);
+        }
+
         if (!cont) {
             ctx_finished = true;
             result.finished_ctxs.insert(ctx_num);
@@ -718,29 +773,26 @@ std::string string_vformat(const std::string& format, va_list args) {
     return std::string( buf.get(), buf.get() + size - 1); // We don't want the '\0' inside
 }
 
-std::pair<char *, int> vformat_alloc(const char *format, va_list args) {
-    va_list args_copy;
-    va_copy(args_copy, args);
-    int size = vsnprintf(NULL, 0, format, args) + 1;
-    char *formatted_string = new char[size];
-    vsnprintf(formatted_string, size, format, args_copy);
-    va_end(args_copy);
-    return std::make_pair(formatted_string, size - 1);
-}
-
 /* Print an error message. */
 
 void error(MIPSImage &img, const char *fmt, ...) {
     va_list args;
     va_start(args, fmt);
-    std::ostream os(img.get_std_err_buf());
-    char *formatted_str;
-    int str_size;
-    std::tie(formatted_str, str_size) = vformat_alloc(fmt, args);
-    os.write(formatted_str, str_size);
-    delete[] formatted_str;
-    std::flush(os);
+    img.get_std_err_buf()->vprintf(fmt, args);
     va_end(args);
+    img.get_std_err_buf()->pubsync();
+}
+
+/* Print an error or warning about the program being assembled, and count
+   it: a program whose assembly printed messages is not cached. */
+
+void assembler_error(MIPSImage &img, const char *fmt, ...) {
+    va_list args;
+    img.assembler().diagnostic_count += 1;
+    va_start(args, fmt);
+    img.get_std_err_buf()->vprintf(fmt, args);
+    va_end(args);
+    img.get_std_err_buf()->pubsync();
 }
 
 /* Print the error message then exit. */
@@ -748,14 +800,9 @@ void error(MIPSImage &img, const char *fmt, ...) {
 void fatal_error(MIPSImage &img, const char *fmt, ...) {
     va_list args;
     va_start(args, fmt);
-    fmt = va_arg(args, char *);
-    std::ostream os(img.get_std_err_buf());
-    char *formatted_str;
-    int str_size;
-    std::tie(formatted_str, str_size) = vformat_alloc(fmt, args);
-    os.write(formatted_str, str_size);
-    delete[] formatted_str;
-    std::flush(os);
+    img.get_std_err_buf()->vprintf(fmt, args);
+    va_end(args);
+    img.get_std_err_buf()->pubsync();
     exit(-1);
 }
 
@@ -764,12 +811,7 @@ void fatal_error(MIPSImage &img, const char *fmt, ...) {
 void run_error(MIPSImage &img, const char *fmt, ...) {
     va_list args;
     va_start(args, fmt);
-    std::ostream os(img.get_std_err_buf());
-    char *formatted_str;
-    int str_size;
-    std::tie(formatted_str, str_size) = vformat_alloc(fmt, args);
-    os.write(formatted_str, str_size);
-    delete[] formatted_str;
+    img.get_std_err_buf()->vprintf(fmt, args);
     va_end(args);
 }
 
@@ -778,33 +820,41 @@ void run_error(MIPSImage &img, const char *fmt, ...) {
 void write_output(MIPSImage &img, port /* fp */, const char *fmt, ...) {
     va_list args;
     va_start(args, fmt);
-    std::ostream os(img.get_std_out_buf());
-    char *formatted_str;
-    int str_size;
-    std::tie(formatted_str, str_size) = vformat_alloc(fmt, args);
-    os.write(formatted_str, str_size);
-    delete[] formatted_str;
+    img.get_std_out_buf()->vprintf(fmt, args);
     va_end(args);
 }
 
-/* Simulate the semantics of fgets (not gets) on Unix file. */
+/* Fast paths for the print syscalls, which skip printf altogether. */
+
+void write_output_int(MIPSImage &img, int32 value) {
+    char digits[12];
+    char *p = digits + sizeof(digits);
+    uint32 magnitude = value < 0 ? 0u - (uint32) value : (uint32) value;
 
-void read_input(char *str, int str_size) {
-  char *ptr;
-  ptr = str;
-  while (1 < str_size) /* Reserve space for null */
-  {
-    char buf[1];
-    if (read((int) console_in.i, buf, 1) <= 0) /* Not in raw mode! */
-      break;
+    do {
+        *--p = (char) ('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude != 0);
+    if (value < 0) {
+        *--p = '-';
+    }
+    img.get_std_out_buf()->sputn(p, digits + sizeof(digits) - p);
+}
 
-    *ptr++ = buf[0];
-    str_size -= 1;
+void write_output_hex(MIPSImage &img, uint32 value) {
+    char digits[8];
+    char *p = digits + sizeof(digits);
 
-    if (buf[0] == '\n') break;
-  }
+    do {
+        *--p = "0123456789abcdef"[value & 0xf];
+        value >>= 4;
+    } while (value != 0);
+    img.get_std_out_buf()->sputn(p, digits + sizeof(digits) - p);
+}
 
-  if (0 < str_size) *ptr = '\0'; /* Null terminate input */
+void write_output_char(MIPSImage &img, char c) {
+    // sputn, not sputc, so that a newline is noticed
+    img.get_std_out_buf()->sputn(&c, 1);
 }
 
 int console_input_available() {
@@ -37,9 +37,11 @@
 #include <set>
 #include <map>
 #include <mutex>
+#include <utility>
 #include "image.h"
 #include "inst.h"
 #include "instruction.h"
+#include "kernel_image.h"
 
 
 /* Triple containing a string and two integers.	 Used in tables
@@ -68,12 +70,15 @@ extern bkpt *bkpts;
 typedef struct {
     std::set<unsigned int> finished_ctxs;
     std::map<unsigned int, mem_addr> bp_encountered_ctxs;
+    std::set<unsigned int> input_wanted_ctxs; // Parked on a read this cycle
 } cycle_result_t;
 
 /* Exported functions: */
 
 bool add_breakpoint (MIPSImage &img, mem_addr addr);
 bool delete_breakpoint (MIPSImage &img, mem_addr addr);
+std::pair<size_t, size_t> disassembled_range (MIPSImage &img, mem_addr from, mem_addr to);
+const std::vector<disasm_line_t> &disassembled_segment (MIPSImage &img, bool kernel);
 void format_data_segs (MIPSImage &img, str_stream *ss);
 void format_insts (MIPSImage &img, str_stream *ss, mem_addr from, mem_addr to);
 void format_mem (MIPSImage &img, str_stream *ss, mem_addr from, mem_addr to);
@@ -82,6 +87,8 @@ void initialize_registers (MIPSImage &img);
 void initialize_stack (MIPSImage &img, const char *command_line);
 void initialize_run_stack (MIPSImage &img, int argc, char **argv);
 void initialize_world (MIPSImage &img, const char *exception_file_name, bool print_message);
+void initialize_world_from_kernel (MIPSImage &img, const kernel_image_t *kernel);
+void invalidate_disassembly (MIPSImage &img, mem_addr addr);
 void list_breakpoints (MIPSImage &img);
 name_val_val *map_int_to_name_val_val (name_val_val tbl[], int tbl_len, int num);
 name_val_val *map_string_to_name_val_val (name_val_val tbl[], int tbl_len, char *id);
@@ -98,12 +98,25 @@
 #define TEXT_SIZE	(256*K)	/* 1/4 MB */
 #endif
 
+/* Maximum size of text segment.  Only a loaded executable grows it; the
+   assembler stops at the initial size. */
+
+#ifndef TEXT_LIMIT
+#define TEXT_LIMIT	(4*K*K)	/* 4 MB */
+#endif
+
 /* Initial size of k_text segment. */
 
 #ifndef K_TEXT_SIZE
 #define K_TEXT_SIZE	(64*K)	/* 64 KB */
 #endif
 
+/* Maximum size of k_text segment. */
+
+#ifndef K_TEXT_LIMIT
+#define K_TEXT_LIMIT	(K*K)	/* 1 MB */
+#endif
+
 /* The data segment must be larger than 64K since we immediate grab
    64K for the small data segment pointed to by $gp. The data segment is
    expanded by an sbrk system call. */
@@ -214,14 +227,17 @@ typedef union {int i; FILE* f;} port;
 
 /* Exported functions (from spim.c or xspim.c): */
 
+void assembler_error (MIPSImage &img, const char *fmt, ...);
 int console_input_available ();
 void error (MIPSImage &img, const char *fmt, ...);
 void fatal_error (MIPSImage &img, const char *fmt, ...);
 char get_console_char ();
 void put_console_char (char c);
-void read_input (char *str, int n);
 void run_error (MIPSImage &img, const char *fmt, ...);
 void write_output (MIPSImage &img, port, const char *fmt, ...);
+void write_output_int (MIPSImage &img, int32 value);
+void write_output_hex (MIPSImage &img, uint32 value);
+void write_output_char (MIPSImage &img, char c);
 
 
 /* Exported variables: */
@@ -239,11 +255,13 @@ extern int spim_return_value;     /* Value returned when spim exits */
 extern port message_out, console_out, console_in;
 extern bool mapped_io;		/* => activate memory-mapped IO */
 extern int initial_text_size;
+extern mem_addr initial_text_limit;
 extern int initial_data_size;
 extern mem_addr initial_data_limit;
 extern int initial_stack_size;
 extern mem_addr initial_stack_limit;
 extern int initial_k_text_size;
+extern mem_addr initial_k_text_limit;
 extern int initial_k_data_size;
 extern mem_addr initial_k_data_limit;
 
@@ -31,6 +31,8 @@
 */
 
 
+#include <algorithm>
+
 #include "label.h"
 #include "spim.h"
 #include "string-stream.h"
@@ -47,10 +49,11 @@
 
 /* Local functions: */
 
-static void get_hash (MIPSImage &img, char *name, int *slot_no, label **entry);
+static sym_entry *find_slot (sym_table_t &tbl, const char *name, unsigned hash);
+static sym_entry *intern_entry (MIPSImage &img, const char *name);
 static void resolve_a_label_sub (MIPSImage &img, label *sym, instruction *inst, mem_addr pc);
 
-
+
 
 /* Keep track of the memory location that a label represents.  If we
    see a reference to a label that is not yet defined, then record the
@@ -62,77 +65,110 @@ static void resolve_a_label_sub (MIPSImage &img, label *sym, instruction *inst,
 
 
 
-#define HASHBITS 30
-
-
-/* Initialize the symbol table by removing and freeing old entries. */
+/* Initialize the symbol table by removing old entries.  The names,
+   labels and their uses live in the image's arena, which frees them. */
 
 void
 initialize_symbol_table (MIPSImage &img)
 {
-  if (!img.get_label_hash_table())
-    return;
-  int i;
+  sym_table_t &tbl = img.symbol_table();
+
+  if (tbl.slots != NULL)
+    memclr (tbl.slots, tbl.size * sizeof (sym_entry));
+  tbl.n_names = 0;
+  tbl.n_labels = 0;
+  tbl.by_addr.clear ();
+  tbl.by_addr_sorted = true;
+  img.set_local_labels(NULL);
+}
 
-  for (i = 0; i < LABEL_HASH_TABLE_SIZE; i ++)
-  {
-    label *x, *n;
 
-    for (x = img.get_label_hash_table()[i]; x != NULL; x = n)
-    {
-      free (x->name);
-      label_use *next_use;
-      for (label_use *curr = x->uses; curr != NULL; curr = next_use) {
-        next_use = curr->next;
-        if (data_dir && curr->inst) {
-          free_inst(curr->inst);
-        }
-        free(curr);
-      }
-      n = x->next;
-      free (x);
-    }
-    img.get_label_hash_table() [i] = NULL;
-  }
+/* FNV-1a hash of NAME. */
 
-  img.set_local_labels(NULL);
+static inline unsigned
+name_hash (const char *name)
+{
+  unsigned h = 2166136261u;
+
+  for (; *name != '\0'; name ++)
+    h = (h ^ (unsigned char) *name) * 16777619u;
+  return h;
 }
 
 
+/* Return the slot in TBL that holds NAME, whose hash is HASH, or the
+   empty slot where it belongs.  The table must not be full. */
+
+static sym_entry *
+find_slot (sym_table_t &tbl, const char *name, unsigned hash)
+{
+  unsigned mask = tbl.size - 1;
+  unsigned i;
+
+  for (i = hash & mask; ; i = (i + 1) & mask)
+    {
+      sym_entry *e = &tbl.slots[i];
+
+      if (e->name == NULL
+	  || (e->hash == hash && (e->name == name || streq (e->name, name))))
+	return e;
+    }
+}
+
 
-/* Lookup for a label with the given NAME.  Set the SLOT_NO to be the hash
-   table bucket that contains (or would contain) the label's record.  If the
-   record is already in the table, set ENTRY to point to it.  Otherwise,
-   set ENTRY to be NULL. */
+/* Double the number of slots in the table (or allocate the first ones). */
 
 static void
-get_hash (MIPSImage &img, char *name, int *slot_no, label **entry)
+grow_table (MIPSImage &img)
 {
-  int hi;
+  sym_table_t &tbl = img.symbol_table();
+  sym_entry *old_slots = tbl.slots;
+  int old_size = tbl.size;
   int i;
-  label *lab;
-  int len;
 
-  /* Compute length of name in len.  */
-  for (len = 0; name[len]; len++) ;
+  tbl.size = (old_size == 0) ? SYM_TABLE_INITIAL_SIZE : 2 * old_size;
+  tbl.slots = (sym_entry *) zmalloc (img, tbl.size * sizeof (sym_entry));
+  for (i = 0; i < old_size; i ++)
+    if (old_slots[i].name != NULL)
+      *find_slot (tbl, old_slots[i].name, old_slots[i].hash) = old_slots[i];
+  if (old_slots != NULL)
+    free (old_slots);
+}
 
-  /* Compute hash code */
-  hi = len;
-  for (i = 0; i < len; i++)
-    hi = ((hi * 613) + (unsigned)(name[i]));
 
-  hi &= (1 << HASHBITS) - 1;
-  hi %= LABEL_HASH_TABLE_SIZE;
+/* Return the table entry for NAME, adding a copy of the name if it has
+   not been seen before. */
 
-  *slot_no = hi;
-  /* Search table for entry */
-  for (lab = img.get_label_hash_table()[hi]; lab; lab = lab->next)
-    if (streq (lab->name, name))
-      {
-	*entry = lab;		/* <-- return if found */
-	return;
-      }
-  *entry = NULL;
+static sym_entry *
+intern_entry (MIPSImage &img, const char *name)
+{
+  sym_table_t &tbl = img.symbol_table();
+  unsigned hash = name_hash (name);
+  sym_entry *e;
+
+  /* Keep the table at most 3/4 full so probe sequences stay short. */
+  if (4 * (tbl.n_names + 1) > 3 * tbl.size)
+    grow_table (img);
+
+  e = find_slot (tbl, name, hash);
+  if (e->name == NULL)
+    {
+      e->name = arena_str_copy (img, name);
+      e->hash = hash;
+      e->lab = NULL;
+      tbl.n_names += 1;
+    }
+  return e;
+}
+
+
+/* Return the image's copy of NAME, so that identifiers seen many times
+   share one string. */
+
+char *
+intern_name (MIPSImage &img, const char *name)
+{
+  return (char *) intern_entry (img, name)->name;
 }
 
 
@@ -142,12 +178,13 @@ get_hash (MIPSImage &img, char *name, int *slot_no, label **entry)
 label *
 label_is_defined (MIPSImage &img, char *name)
 {
-  int hi;
-  label *entry;
+  sym_table_t &tbl = img.symbol_table();
+  sym_entry *e;
 
-  get_hash (img, name, &hi, &entry);
-
-  return (entry);
+  if (tbl.size == 0)
+    return (NULL);
+  e = find_slot (tbl, name, name_hash (name));
+  return (e->name == NULL ? NULL : e->lab);
 }
 
 
@@ -157,25 +194,24 @@ label_is_defined (MIPSImage &img, char *name)
 label *
 lookup_label (MIPSImage &img, char *name)
 {
-  int hi;
-  label *entry, *lab;
-
-  get_hash (img, name, &hi, &entry);
+  sym_entry *e = intern_entry (img, name);
+  label *lab;
 
-  if (entry != NULL)
-    return (entry);
+  if (e->lab != NULL)
+    return (e->lab);
 
-  /* Not found, create one, add to chain */
-  lab = (label *) xmalloc (img, sizeof (label));
-  lab->name = str_copy (img, name);
+  /* Not found, create one */
+  lab = (label *) arena_alloc (img, sizeof (label));
+  lab->name = (char *) e->name;
   lab->addr = 0;
   lab->global_flag = 0;
   lab->const_flag = 0;
   lab->gp_flag = 0;
   lab->uses = NULL;
+  lab->next_local = NULL;
 
-  lab->next = img.get_label_hash_table()[hi];
-  img.get_label_hash_table()[hi] = lab;
+  e->lab = lab;
+  img.symbol_table().n_labels += 1;
   return lab;			/* <-- return if created */
 }
 
@@ -196,6 +232,8 @@ record_label (MIPSImage &img, char *name, mem_addr address, int resolve_uses)
 	  return (l);
 	}
       l->addr = address;
+      if (address != 0)
+	index_label_address (img, l);
     }
 
   if (resolve_uses)
@@ -229,9 +267,9 @@ make_label_global (MIPSImage &img, char *name)
 void
 record_inst_uses_symbol (MIPSImage &img, instruction *inst, label *sym)
 {
-  label_use *u = (label_use *) xmalloc (img, sizeof (label_use));
+  label_use *u = (label_use *) arena_alloc (img, sizeof (label_use));
 
-  if (data_dir)			/* Want to free up original instruction */
+  if (img.assembler().data_dir)			/* Want to free up original instruction */
     {
       u->inst = copy_inst (img, inst);
       u->addr = current_data_pc (img);
@@ -251,7 +289,7 @@ record_inst_uses_symbol (MIPSImage &img, instruction *inst, label *sym)
 void
 record_data_uses_symbol (MIPSImage &img, mem_addr location, label *sym)
 {
-  label_use *u = (label_use *) xmalloc (img, sizeof (label_use));
+  label_use *u = (label_use *) arena_alloc (img, sizeof (label_use));
 
   u->inst = NULL;
   u->addr = location;
@@ -275,10 +313,10 @@ resolve_label_uses (MIPSImage &img, label *sym)
       if (use->inst != NULL && use->addr >= DATA_BOT && use->addr < img.mem_image().stack_bot)
 	{
 	  set_mem_word (img, use->addr, inst_encode (img, use->inst));
-	  free_inst (use->inst);
+	  free_inst (img, use->inst);
 	}
       next_use = use->next;
-      free (use);
+      arena_free (img, use, sizeof (label_use));
     }
   sym->uses = NULL;
 }
@@ -292,7 +330,7 @@ resolve_a_label (MIPSImage &img, label *sym, instruction *inst)
   resolve_a_label_sub (img,
            sym,
 		       inst,
-		       (data_dir ? current_data_pc (img) : current_text_pc (img)));
+		       (img.assembler().data_dir ? current_data_pc (img) : current_text_pc (img)));
 }
 
 
@@ -307,6 +345,7 @@ resolve_a_label_sub (MIPSImage &img, label *sym, instruction *inst, mem_addr pc)
   else
     {
       /* Instruction: */
+      invalidate_disassembly (img, pc);
       if (EXPR (inst)->pc_relative)
 	EXPR (inst)->offset = 0 - pc; /* Instruction may have moved */
 
@@ -335,7 +374,7 @@ resolve_a_label_sub (MIPSImage &img, label *sym, instruction *inst, mem_addr pc)
 	      value = eval_imm_expr (img, EXPR (inst));
 		  if ((value & 0xf0000000) != (pc & 0xf0000000))
 		  {
-			  error (img, "Target of jump differs in high-order 4 bits from instruction pc 0x%x\n", pc);
+			  assembler_error (img, "Target of jump differs in high-order 4 bits from instruction pc 0x%x\n", pc);
 		  }
 		  /* Drop high four bits, since they come from the PC and the
 			 low two bits since instructions are on word boundaries. */
@@ -386,7 +425,7 @@ resolve_a_label_sub (MIPSImage &img, label *sym, instruction *inst, mem_addr pc)
 	  if ((value & ~field_mask) != (int32)0
               && (value & ~field_mask) != (int32)0xffff0000)
 	    {
-	      error (img, "Immediate value is too large for field: ");
+	      assembler_error (img, "Immediate value is too large for field: ");
 	      print_inst (img, pc);
 	    }
 	  if (opcode_is_jump (OPCODE (inst)))
@@ -396,8 +435,8 @@ resolve_a_label_sub (MIPSImage &img, label *sym, instruction *inst, mem_addr pc)
 	  SET_ENCODING (inst, inst_encode (img, inst));
 	}
       else
-	error (img, "Resolving undefined symbol: %s\n",
-	       (EXPR (inst)->symbol == NULL) ? "" : EXPR (inst)->symbol->name);
+	assembler_error (img, "Resolving undefined symbol: %s\n",
+			 (EXPR (inst)->symbol == NULL) ? "" : EXPR (inst)->symbol->name);
     }
 }
 
@@ -407,36 +446,109 @@ resolve_a_label_sub (MIPSImage &img, label *sym, instruction *inst, mem_addr pc)
 void
 flush_local_labels (MIPSImage &img, int issue_undef_warnings)
 {
+  sym_table_t &tbl = img.symbol_table();
   label *l;
 
   for (l = img.get_local_labels(); l != NULL; l = l->next_local)
     {
-      int hi;
-      label *entry, *lab, *p;
-
-      get_hash (img, l->name, &hi, &entry);
-
-      for (lab = img.get_label_hash_table()[hi], p = NULL;
-	   lab;
-	   p = lab, lab = lab->next)
-	if (lab == entry)
-	  {
-	    if (p == NULL)
-	      img.get_label_hash_table()[hi] = lab->next;
-	    else
-	      p->next = lab->next;
-	    if (issue_undef_warnings && entry->addr == 0 && !entry->const_flag)
-	      error (img, "Warning: local symbol %s was not defined\n",
-		     entry->name);
-	    /* Can't free label since IMM_EXPR's still reference it */
-        img.push_label_to_free_vector(lab);
-	    break;
-	  }
+      sym_entry *e = find_slot (tbl, l->name, name_hash (l->name));
+
+      if (e->lab == l)
+	{
+	  e->lab = NULL;
+	  tbl.n_labels -= 1;
+	  if (issue_undef_warnings && l->addr == 0 && !l->const_flag)
+	    assembler_error (img, "Warning: local symbol %s was not defined\n",
+			     l->name);
+	  /* Can't free label since IMM_EXPR's still reference it (it
+	     stays in the arena until the image is released) */
+	}
     }
   img.set_local_labels(NULL);
 }
 
 
+/* Add L, which was just given an address, to the address index. */
+
+void
+index_label_address (MIPSImage &img, label *l)
+{
+  sym_table_t &tbl = img.symbol_table();
+
+  tbl.by_addr.push_back (l);
+  tbl.by_addr_sorted = false;
+}
+
+
+static bool
+label_addr_less (const label *a, const label *b)
+{
+  return (mem_addr) a->addr < (mem_addr) b->addr;
+}
+
+
+static bool
+label_not_address (const label *l)
+{
+  return l->const_flag || l->addr == 0;
+}
+
+
+/* Sort the address index, dropping labels that are constants rather
+   than addresses. */
+
+static std::vector<label *> &
+sorted_labels (MIPSImage &img)
+{
+  sym_table_t &tbl = img.symbol_table();
+
+  if (!tbl.by_addr_sorted)
+    {
+      std::vector<label *> &v = tbl.by_addr;
+
+      v.erase (std::remove_if (v.begin (), v.end (), label_not_address), v.end ());
+      std::stable_sort (v.begin (), v.end (), label_addr_less);
+      tbl.by_addr_sorted = true;
+    }
+  return tbl.by_addr;
+}
+
+
+/* Return a label (local or global) at ADDR, or NULL if there is none. */
+
+label *
+find_label_at (MIPSImage &img, mem_addr addr)
+{
+  label *l = find_label_before (img, addr);
+
+  return (l != NULL && (mem_addr) l->addr == addr) ? l : NULL;
+}
+
+
+/* Return the label with the highest address not above ADDR (the function
+   or data item that ADDR is most likely in), or NULL if there is none.
+   Of several labels at one address, the first defined is returned. */
+
+label *
+find_label_before (MIPSImage &img, mem_addr addr)
+{
+  std::vector<label *> &v = sorted_labels (img);
+  label key = {};
+  std::vector<label *>::iterator it;
+
+  key.addr = addr;
+  it = std::upper_bound (v.begin (), v.end (), &key, label_addr_less);
+  if (it == v.begin ())
+    return (NULL);
+
+  /* Step back to the first of the labels at that address. */
+  --it;
+  while (it != v.begin () && (*(it - 1))->addr == (*it)->addr)
+    --it;
+  return (*it);
+}
+
+
 /* Return the address of SYMBOL or 0 if it is undefined. */
 
 mem_addr
@@ -459,8 +571,8 @@ print_symbols (MIPSImage &img)
   int i;
   label *l;
 
-  for (i = 0; i < LABEL_HASH_TABLE_SIZE; i ++)
-    for (l = img.get_label_hash_table()[i]; l != NULL; l = l->next)
+  for (i = 0; i < img.symbol_table().size; i ++)
+    if ((l = img.symbol_table().slots[i].lab) != NULL)
       write_output (img, message_out, "%s%s at 0x%08x\n",
 		    l->global_flag ? "g\t" : "\t", l->name, l->addr);
 }
@@ -474,8 +586,8 @@ print_undefined_symbols (MIPSImage &img)
   int i;
   label *l;
 
-  for (i = 0; i < LABEL_HASH_TABLE_SIZE; i ++)
-    for (l = img.get_label_hash_table()[i]; l != NULL; l = l->next)
+  for (i = 0; i < img.symbol_table().size; i ++)
+    if ((l = img.symbol_table().slots[i].lab) != NULL)
       if (l->addr == 0)
 	write_output (img, message_out, "%s\n", l->name);
 }
@@ -495,8 +607,8 @@ undefined_symbol_string (MIPSImage &img)
   int i;
   label *l;
 
-  for (i = 0; i < LABEL_HASH_TABLE_SIZE; i ++)
-    for (l = img.get_label_hash_table()[i]; l != NULL; l = l->next)
+  for (i = 0; i < img.symbol_table().size; i ++)
+    if ((l = img.symbol_table().slots[i].lab) != NULL)
       if (l->addr == 0)
       {
 	int name_length = (int)strlen(l->name);
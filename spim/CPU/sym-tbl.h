@@ -39,9 +39,13 @@
 
 /* Exported functions: */
 
+label *find_label_at (MIPSImage &img, mem_addr addr);
+label *find_label_before (MIPSImage &img, mem_addr addr);
 mem_addr find_symbol_address (MIPSImage &img, char *symbol);
 void flush_local_labels (MIPSImage &img, int issue_undef_warnings);
+void index_label_address (MIPSImage &img, label *l);
 void initialize_symbol_table (MIPSImage &img);
+char *intern_name (MIPSImage &img, const char *name);
 label *label_is_defined (MIPSImage &img, char *name);
 label *lookup_label (MIPSImage &img, char *name);
 label *make_label_global (MIPSImage &img, char *name);
@@ -38,6 +38,7 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <stdio.h>
+#include <string.h>
 #include <sys/types.h>
 
 #ifdef _WIN32
@@ -52,6 +53,8 @@
 #include "reg.h"
 #include "sym-tbl.h"
 #include "syscall.h"
+#include "input_queue.h"
+#include "vfs.h"
 
 
 #ifdef _WIN32
@@ -64,6 +67,7 @@
 */
 
 #include <stdio.h>
+#include <string.h>
 #include <stdlib.h>
 #include <crtdbg.h>
 
@@ -127,7 +131,7 @@ do_syscall (MIPSImage &img)
   switch (img.reg_image().R[REG_V0])
     {
     case PRINT_INT_SYSCALL:
-      write_output (img, console_out, "%d", img.reg_image().R[REG_A0]);
+      write_output_int (img, img.reg_image().R[REG_A0]);
       break;
 
     case PRINT_FLOAT_SYSCALL:
@@ -150,7 +154,11 @@ do_syscall (MIPSImage &img)
       {
 	static char str [256];
 
-	read_input (str, 256);
+	if (!read_input (img, str, 256))
+	  {
+	    park_for_input (img);
+	    break;
+	  }
 	img.reg_image().R[REG_RES] = atol (str);
 	break;
       }
@@ -159,7 +167,11 @@ do_syscall (MIPSImage &img)
       {
 	static char str [256];
 
-	read_input (str, 256);
+	if (!read_input (img, str, 256))
+	  {
+	    park_for_input (img);
+	    break;
+	  }
 	FPR_S (img.reg_image(), REG_FRES) = (float) atof (str);
 	break;
       }
@@ -168,15 +180,27 @@ do_syscall (MIPSImage &img)
       {
 	static char str [256];
 
-	read_input (str, 256);
+	if (!read_input (img, str, 256))
+	  {
+	    park_for_input (img);
+	    break;
+	  }
 	img.reg_image().FPR [REG_FRES] = atof (str);
 	break;
       }
 
     case READ_STRING_SYSCALL:
       {
-	read_input ( (char *) mem_reference (img, img.reg_image().R[REG_A0]), img.reg_image().R[REG_A1]);
+	char *str = (char *) mem_reference (img, img.reg_image().R[REG_A0]);
+
+	if (!read_input (img, str, img.reg_image().R[REG_A1]))
+	  {
+	    park_for_input (img);
+	    break;
+	  }
 	img.mem_image().data_modified = true;
+	if (img.reg_image().R[REG_A1] > 0)
+	  mark_mem_dirty (img, img.reg_image().R[REG_A0], strlen (str) + 1);
 	break;
       }
 
@@ -190,14 +214,18 @@ do_syscall (MIPSImage &img)
       }
 
     case PRINT_CHARACTER_SYSCALL:
-      write_output (img, console_out, "%c", img.reg_image().R[REG_A0]);
+      write_output_char (img, (char) img.reg_image().R[REG_A0]);
       break;
 
     case READ_CHARACTER_SYSCALL:
       {
 	static char str [2];
 
-	read_input (str, 2);
+	if (!read_input (img, str, 2))
+	  {
+	    park_for_input (img);
+	    break;
+	  }
 	if (*str == '\0') *str = '\n';      /* makes xspim = spim */
 	img.reg_image().R[REG_RES] = (long) str[0];
 	break;
@@ -205,59 +233,41 @@ do_syscall (MIPSImage &img)
 
     case EXIT_SYSCALL:
       spim_return_value = 0;
+      img.reg_image().exit_status = 0;
       return (0);
 
     case EXIT2_SYSCALL:
       spim_return_value = img.reg_image().R[REG_A0];	/* value passed to spim's exit() call */
+      img.reg_image().exit_status = img.reg_image().R[REG_A0];
       return (0);
 
     case OPEN_SYSCALL:
-      {
-#ifdef _WIN32
-        R[REG_RES] = _open((char*)mem_reference (img, R[REG_A0]), R[REG_A1], R[REG_A2]);
-#else
-	img.reg_image().R[REG_RES] = open((char*)mem_reference (img, img.reg_image().R[REG_A0]), img.reg_image().R[REG_A1], img.reg_image().R[REG_A2]);
-#endif
-	break;
-      }
+      img.reg_image().R[REG_RES] = vfs_open (img, (char *) mem_reference (img, img.reg_image().R[REG_A0]), img.reg_image().R[REG_A1]);
+      break;
 
     case READ_SYSCALL:
       {
-	/* Test if address is valid */
-	(void)mem_reference (img, img.reg_image().R[REG_A1] + img.reg_image().R[REG_A2] - 1);
-#ifdef _WIN32
-	img.reg_image().R[REG_RES] = _read(img.reg_image().R[REG_A0], mem_reference (img, img.reg_image().R[REG_A1]), img.reg_image().R[REG_A2]);
-#else
-	img.reg_image().R[REG_RES] = read(img.reg_image().R[REG_A0], mem_reference (img, img.reg_image().R[REG_A1]), img.reg_image().R[REG_A2]);
-#endif
-	img.mem_image().data_modified = true;
+	int n = vfs_read (img, img.reg_image().R[REG_A0], img.reg_image().R[REG_A1], img.reg_image().R[REG_A2]);
+
+	if (n == VFS_BLOCKED)
+	  {
+	    park_for_input (img);
+	    break;
+	  }
+	img.reg_image().R[REG_RES] = n;
 	break;
       }
 
     case WRITE_SYSCALL:
-      {
-	/* Test if address is valid */
-	(void)mem_reference (img, img.reg_image().R[REG_A1] + img.reg_image().R[REG_A2] - 1);
-#ifdef _WIN32
-	img.reg_image().R[REG_RES] = _write(img.reg_image().R[REG_A0], mem_reference (img, img.reg_image().R[REG_A1]), img.reg_image().R[REG_A2]);
-#else
-	img.reg_image().R[REG_RES] = write(img.reg_image().R[REG_A0], mem_reference (img, img.reg_image().R[REG_A1]), img.reg_image().R[REG_A2]);
-#endif
-	break;
-      }
+      img.reg_image().R[REG_RES] = vfs_write (img, img.reg_image().R[REG_A0], img.reg_image().R[REG_A1], img.reg_image().R[REG_A2]);
+      break;
 
     case CLOSE_SYSCALL:
-      {
-#ifdef _WIN32
-	img.reg_image().R[REG_RES] = _close(img.reg_image().R[REG_A0]);
-#else
-	img.reg_image().R[REG_RES] = close(img.reg_image().R[REG_A0]);
-#endif
-	break;
-      }
+      img.reg_image().R[REG_RES] = vfs_close (img, img.reg_image().R[REG_A0]);
+      break;
 
 case PRINT_HEX_SYSCALL:
-    write_output (img, console_out, "%x", img.reg_image().R[REG_A0]);
+    write_output_hex (img, img.reg_image().R[REG_A0]);
     break;
 
     default:
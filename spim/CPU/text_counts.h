@@ -0,0 +1,98 @@
+#ifndef TEXT_COUNTS_H
+#define TEXT_COUNTS_H
+
+#include <stdio.h>
+
+#include <map>
+#include <vector>
+
+#include "spim.h"
+#include "image.h"
+#include "sym-tbl.h"
+
+/* Counts that a model keeps for each instruction, in two vectors
+   indexed by word: MODEL.text for the text segment and MODEL.k_text
+   for the kernel's.  The cache and pipeline models attribute what they
+   measure to instructions this way, and report it summed by label. */
+
+
+/* The counts of the instruction at PC, or NULL if PC is not in a text
+   segment.  The vectors grow as the program runs, but never past the
+   end of their segment. */
+
+template <typename M>
+typename decltype (M::text)::value_type *
+text_counts_at (MIPSImage &img, M &model, mem_addr pc)
+{
+  typedef typename decltype (M::text)::value_type counts_t;
+  mem_image_t &mem = img.mem_image();
+  std::vector<counts_t> *seg;
+  size_t i, words;
+
+  if (K_TEXT_BOT <= pc && pc < mem.k_text_top)
+    {
+      seg = &model.k_text;
+      i = (pc - K_TEXT_BOT) >> 2;
+      words = (mem.k_text_top - K_TEXT_BOT) >> 2;
+    }
+  else if (TEXT_BOT <= pc && pc < mem.text_top)
+    {
+      seg = &model.text;
+      i = (pc - TEXT_BOT) >> 2;
+      words = (mem.text_top - TEXT_BOT) >> 2;
+    }
+  else
+    return NULL;
+
+  if (i >= seg->size ())
+    seg->resize (MIN (i + 1024, words), counts_t {});
+  return &(*seg)[i];
+}
+
+
+/* MODEL's counts summed over each labeled part of the program, in order
+   of address.  Code before the first label is summed by address.  Each
+   sum is an S that starts with just its name and address; USED (COUNTS)
+   says whether an instruction was counted at all, and ADD (SUM, COUNTS)
+   adds its counts in. */
+
+template <typename S, typename M, typename Used, typename Add>
+std::vector<S>
+text_counts_by_label (MIPSImage &img, const M &model, Used used, Add add)
+{
+  std::map<mem_addr, S> by_label;
+  std::vector<S> result;
+
+  auto add_segment = [&] (const decltype (M::text) &seg, mem_addr base) {
+    for (size_t i = 0; i < seg.size (); i ++)
+      {
+	if (!used (seg[i]))
+	  continue;
+
+	mem_addr pc = base + (mem_addr) i * BYTES_PER_WORD;
+	label *l = find_label_before (img, pc);
+	mem_addr addr = l != NULL ? l->addr : pc;
+	auto it = by_label.find (addr);
+
+	if (it == by_label.end ())
+	  {
+	    char buf[16];
+	    S sum {};
+
+	    snprintf (buf, sizeof (buf), "0x%08x", pc);
+	    sum.name = l != NULL ? l->name : buf;
+	    sum.addr = addr;
+	    it = by_label.emplace (addr, sum).first;
+	  }
+	add (it->second, seg[i]);
+      }
+  };
+  add_segment (model.text, TEXT_BOT);
+  add_segment (model.k_text, K_TEXT_BOT);
+
+  for (auto &[addr, sum] : by_label)
+    result.push_back (sum);
+  return result;
+}
+
+#endif
@@ -0,0 +1,206 @@
+#include <string.h>
+
+#include <string>
+
+#include "spim.h"
+#include "image.h"
+#include "mem.h"
+#include "input_queue.h"
+#include "vfs.h"
+
+
+static std::string
+normalize_path (const char *path)
+{
+  while (path[0] == '.' && path[1] == '/')
+    path += 2;
+  return path;
+}
+
+
+/* The N bytes of guest memory at ADDR, if they are all in the data,
+   stack, or kernel data segment, or NULL.  The text segments hold
+   decoded instructions, not bytes, so they are never a buffer. */
+
+static char *
+guest_range (MIPSImage &img, mem_addr addr, int n)
+{
+  mem_image_t &mem = img.mem_image ();
+  uint64_t end = (uint64_t) addr + n;
+
+  if (n <= 0)
+    return NULL;
+  if (addr >= DATA_BOT && end <= mem.data_top)
+    return addr - DATA_BOT + (char *) mem.data_seg;
+  else if (addr >= mem.stack_bot && end <= STACK_TOP)
+    return addr - mem.stack_bot + (char *) mem.stack_seg;
+  else if (addr >= K_DATA_BOT && end <= mem.k_data_top)
+    return addr - K_DATA_BOT + (char *) mem.k_data_seg;
+  else
+    return NULL;
+}
+
+
+static vfs_fd_t *
+find_fd (MIPSImage &img, int fd)
+{
+  vfs_t &vfs = img.vfs ();
+
+  if (fd < VFS_FIRST_FD || fd - VFS_FIRST_FD >= (int) vfs.fds.size ())
+    return NULL;
+  vfs_fd_t *f = &vfs.fds[fd - VFS_FIRST_FD];
+  return f->file == NULL ? NULL : f;
+}
+
+
+/* Create (or replace) file NAME with contents DATA. */
+
+void
+vfs_write_file (MIPSImage &img, const std::string &name, const std::string &data)
+{
+  vfs_file_t &file = img.vfs ().files[normalize_path (name.c_str ())];
+
+  file.data = data;
+  file.written = false;
+}
+
+
+const vfs_file_t *
+vfs_find_file (MIPSImage &img, const std::string &name)
+{
+  vfs_t &vfs = img.vfs ();
+  auto it = vfs.files.find (normalize_path (name.c_str ()));
+
+  return it == vfs.files.end () ? NULL : &it->second;
+}
+
+
+/* The syscalls, which return what their POSIX namesakes would, with -1
+   for any error. */
+
+int
+vfs_open (MIPSImage &img, const char *path, int flags)
+{
+  vfs_t &vfs = img.vfs ();
+  int access = flags & VFS_O_ACCMODE;
+  std::string name;
+  vfs_file_t *file;
+  size_t i;
+
+  if (path == NULL || access == VFS_O_ACCMODE)
+    return -1;
+  name = normalize_path (path);
+  if (name.empty ())
+    return -1;
+
+  auto it = vfs.files.find (name);
+  if (it != vfs.files.end ())
+    file = &it->second;
+  else if (flags & VFS_O_CREAT)
+    file = &vfs.files[name];
+  else
+    return -1;
+
+  if ((flags & VFS_O_TRUNC) && access != VFS_O_RDONLY)
+    {
+      file->data.clear ();
+      file->written = true;
+    }
+
+  /* Lowest free descriptor, as POSIX does. */
+  for (i = 0; i < vfs.fds.size (); i ++)
+    if (vfs.fds[i].file == NULL)
+      break;
+  if (i == vfs.fds.size ())
+    vfs.fds.push_back (vfs_fd_t ());
+  vfs.fds[i].file = file;
+  vfs.fds[i].pos = 0;
+  vfs.fds[i].flags = flags;
+  return (int) i + VFS_FIRST_FD;
+}
+
+
+/* Copy straight from the file's buffer into guest memory, and mark the
+   bytes it filled as written. */
+
+int
+vfs_read (MIPSImage &img, int fd, mem_addr buf, int n)
+{
+  char *dest;
+  int count;
+
+  if (n == 0)
+    return 0;
+  if ((dest = guest_range (img, buf, n)) == NULL)
+    return -1;
+
+  if (fd == 0)
+    {
+      if ((count = read_input_bytes (img, dest, n)) < 0)
+	return VFS_BLOCKED;
+    }
+  else
+    {
+      vfs_fd_t *f = find_fd (img, fd);
+      if (f == NULL || (f->flags & VFS_O_ACCMODE) == VFS_O_WRONLY)
+	return -1;
+
+      size_t left = f->pos < f->file->data.size () ? f->file->data.size () - f->pos : 0;
+      count = (int) MIN ((size_t) n, left);
+      memcpy (dest, f->file->data.data () + f->pos, count);
+      f->pos += count;
+    }
+
+  if (count > 0)
+    {
+      img.mem_image ().data_modified = true;
+      mark_mem_dirty (img, buf, count);
+    }
+  return count;
+}
+
+
+/* Copy straight from guest memory into the file's buffer. */
+
+int
+vfs_write (MIPSImage &img, int fd, mem_addr buf, int n)
+{
+  const char *src;
+
+  if (n == 0)
+    return 0;
+  if ((src = guest_range (img, buf, n)) == NULL)
+    return -1;
+
+  if (fd == 1 || fd == 2)
+    {
+      (fd == 1 ? img.get_std_out_buf () : img.get_std_err_buf ())->sputn (src, n);
+      return n;
+    }
+
+  vfs_fd_t *f = find_fd (img, fd);
+  if (f == NULL || (f->flags & VFS_O_ACCMODE) == VFS_O_RDONLY)
+    return -1;
+
+  std::string &data = f->file->data;
+  if (f->flags & VFS_O_APPEND)
+    f->pos = data.size ();
+  if (f->pos + n > data.size ())
+    data.resize (f->pos + n);
+  memcpy (&data[f->pos], src, n);
+  f->pos += n;
+  f->file->written = true;
+  return n;
+}
+
+
+int
+vfs_close (MIPSImage &img, int fd)
+{
+  vfs_fd_t *f = find_fd (img, fd);
+
+  if (f == NULL)
+    return (0 <= fd && fd < VFS_FIRST_FD) ? 0 : -1;
+  f->file = NULL;
+  return 0;
+}
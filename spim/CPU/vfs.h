@@ -0,0 +1,56 @@
+#ifndef VFS_H
+#define VFS_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "spim.h"
+
+class MIPSImage;
+
+/* A context's files.  The OPEN/READ/WRITE/CLOSE syscalls never touch
+   the host: files live in memory, are preloaded by the UI or a grading
+   harness, and whatever the program writes stays here to be collected
+   after the run.  Descriptors 0, 1 and 2 are the console (the input
+   queue, stdout and stderr).
+
+   OPEN takes the Linux flag values, which is what a program written for
+   spim on a Linux host already passes. */
+
+#define VFS_O_ACCMODE	0x3
+#define VFS_O_RDONLY	0x0
+#define VFS_O_WRONLY	0x1
+#define VFS_O_RDWR	0x2
+#define VFS_O_CREAT	0x40
+#define VFS_O_TRUNC	0x200
+#define VFS_O_APPEND	0x400
+
+#define VFS_FIRST_FD	3
+#define VFS_BLOCKED	(-2)	/* Read of fd 0 must wait for input */
+
+typedef struct vfs_file {
+	std::string data;
+	bool written = false;		/* By the program */
+} vfs_file_t;
+
+typedef struct vfs_fd {
+	vfs_file_t *file;		/* NULL if the descriptor is free */
+	size_t pos;
+	int flags;
+} vfs_fd_t;
+
+typedef struct vfs {
+	std::map<std::string, vfs_file_t> files; /* Nodes never move */
+	std::vector<vfs_fd_t> fds;	/* Descriptor - VFS_FIRST_FD */
+} vfs_t;
+
+void vfs_write_file (MIPSImage &img, const std::string &name, const std::string &data);
+const vfs_file_t *vfs_find_file (MIPSImage &img, const std::string &name);
+
+int vfs_open (MIPSImage &img, const char *path, int flags);
+int vfs_read (MIPSImage &img, int fd, mem_addr buf, int n);
+int vfs_write (MIPSImage &img, int fd, mem_addr buf, int n);
+int vfs_close (MIPSImage &img, int fd);
+
+#endif
@@ -58,6 +58,14 @@
 #include "CPU/scanner.h"
 #include "CPU/data.h"
 #include "CPU/version.h"
+#include "CPU/vfs.h"
+#include "CPU/profiler.h"
+#include "CPU/inst_mix.h"
+#include "CPU/cache_model.h"
+#include "CPU/branch_predictor.h"
+#include "CPU/pipeline_model.h"
+#include "CPU/exec_trace.h"
+#include "CPU/mem_heatmap.h"
 
 #include "worker.h"
 #include <iostream>
@@ -93,6 +101,7 @@ static std::thread simulator_thread;
 // - step()
 // - addBreakpoint()
 // - removeBreakpoint()
+// - provideInput() / closeInput()
 // - reset() - runs on first initalization, loads in the files
 // - setSpeed()
 //
@@ -101,6 +110,7 @@ static std::thread simulator_thread;
 //
 // - When a breakpoint occurred (Which context and at what PC)
 // - Has program exited? (which context exited and what is the status code?)
+// - A context is waiting for input (requestInput)
 /* int main() { */
 /*     /1* simulator_thread = std::move(std::thread(&start_simulator, 2, std::set<unsigned int>{0, 1})); *1/ */
 /*     /1* simulator_thread.detach(); *1/ */
@@ -173,6 +183,72 @@ int add_ctx_breakpoint(mem_addr addr, int ctx) {
   return add_breakpoint(ctx, addr);
 }
 
+// Console input for ctx's READ syscalls; see requestInput in execution.js
+int provideInput(int ctx, std::string text) {
+  return provide_input(ctx, text);
+}
+
+int closeInput(int ctx) {
+  return close_input(ctx);
+}
+
+// Files the program in ctx can open; they survive resets until cleared
+int preloadFile(int ctx, std::string name, std::string data) {
+  return preload_file(ctx, name, data);
+}
+
+void clearPreloadedFiles(int ctx) {
+  clear_preloaded_files(ctx);
+}
+
+// From the next reset, keep up to `bytes` of each stream's output for getCapturedOutput
+// instead of printing it (0 turns this off). stopWhenFull ends runaway programs
+void setOutputCapture(unsigned int bytes, bool stopWhenFull) {
+  set_output_capture(bytes, stopWhenFull);
+}
+
+// Start a fresh per-function profile of ctx, now and after every reset, or stop profiling it
+int setProfiling(int ctx, bool on) {
+  return set_profiling(ctx, on);
+}
+
+// Start counting ctx's instruction mix from zero, now and after every reset, or stop.
+// Returns 1 if the build has no counters
+int setInstructionMix(int ctx, bool on) {
+  return set_instruction_mix(ctx, on);
+}
+
+// Attach a cold cache hierarchy to ctx, e.g. "l1i:size=4K; l1d:size=4K,assoc=2; l2:size=32K,assoc=8",
+// now and after every reset, or remove it. Returns 1 if spec is malformed
+int setCacheModel(int ctx, bool on, std::string spec) {
+  return set_cache_model(ctx, on, spec);
+}
+
+// Attach a branch predictor to ctx, e.g. "gshare:bits=12,history=10", now and after every
+// reset, or remove it. Returns 1 if spec is malformed
+int setBranchPredictor(int ctx, bool on, std::string spec) {
+  return set_branch_predictor(ctx, on, spec);
+}
+
+// Estimate ctx's cycles on a 5-stage pipeline, e.g. with spec "forwarding=no,mult=4,div=32"
+// ("" for the defaults), now and after every reset, or stop. Returns 1 if spec is malformed
+int setPipelineModel(int ctx, bool on, std::string spec) {
+  return set_pipeline_model(ctx, on, spec);
+}
+
+// Count ctx's loads and stores in buckets of bucketSize bytes (a power of two from 4 to 64K,
+// e.g. 4096 for pages or 64 for cache lines), now and after every reset, or stop.
+// Returns 1 if bucketSize is not allowed
+int setMemoryHeatmap(int ctx, bool on, unsigned int bucketSize) {
+  return set_memory_heatmap(ctx, on, bucketSize);
+}
+
+// Record ctx's execution (see exec_trace.h) into a file, or into memory if path is "".
+// Returns 1 if the file cannot be written
+int startTrace(int ctx, std::string path) {
+  return start_trace(ctx, path);
+}
+
 #ifdef WASM
 
 /* EMSCRIPTEN_BINDINGS(readSimulationSnapshot) { function("run_entire_program", &run_entire_program); } */
@@ -203,6 +279,12 @@ int getStatus() {
     return get_simulator_status();
 }
 
+// View of the status block (see worker.h); read it with Atomics.load,
+// no need to lock the simulator.
+val getStatusBlock() {
+    return val(typed_memory_view(STATUS_BLOCK_WORDS, reinterpret_cast<int32_t *>(status_block)));
+}
+
 std::string getUserText(int ctx) {
   MIPSImage &img = ctxs.at(ctx); // will exception if ctx out of bounds
   ss_clear(&ss);
@@ -217,6 +299,30 @@ std::string getKernelText(int ctx) {
   return std::string(ss_to_string(img, &ss));
 }
 
+/* Disassembled instructions in addresses [from, to) as an array of
+   {address, encoding, mnemonic, operands, source, label} records, served
+   from the context's disassembly cache.  label names a label (local or
+   global) at that address, or is empty. */
+val getTextRecords(int ctx, mem_addr from, mem_addr to) {
+  MIPSImage &img = ctxs.at(ctx); // will exception if ctx out of bounds
+  const std::vector<disasm_line_t> &lines = disassembled_segment(img, from >= K_TEXT_BOT);
+  const auto [first, last] = disassembled_range(img, from, to);
+
+  val records = val::array();
+  for (size_t i = first; i < last; ++i) {
+    val record = val::object();
+    record.set("address", lines[i].addr);
+    record.set("encoding", lines[i].encoding);
+    record.set("mnemonic", lines[i].mnemonic);
+    record.set("operands", lines[i].operands);
+    record.set("source", lines[i].source);
+    label *l = find_label_at(img, lines[i].addr);
+    record.set("label", std::string(l != nullptr ? l->name : ""));
+    records.set(i - first, record);
+  }
+  return records;
+}
+
 val getStack(int ctx) {
   MIPSImage &img = ctxs.at(ctx); // will exception if ctx out of bounds
   return val(typed_memory_view(STACK_LIMIT / 16, (unsigned int *) img.memview_image().stack_seg));
@@ -229,6 +335,284 @@ val getKernelData(int ctx) {
   MIPSImage &img = ctxs.at(ctx); // will exception if ctx out of bounds
   return val(typed_memory_view(img.memview_image().k_data_top - K_DATA_BOT, (unsigned int *) img.memview_image().k_data_seg));
 }
+
+/* Only the part of the stack between $sp and STACK_TOP is in use, so hand
+   out a view over just those words (starting at the 16-byte line holding
+   $sp) instead of the whole segment. */
+val getStackWindow(int ctx) {
+  MIPSImage &img = ctxs.at(ctx); // will exception if ctx out of bounds
+  mem_addr base = img.regview_image().R[29] & ~0xf;
+  if (base < img.memview_image().stack_bot || base >= STACK_TOP)
+    base = img.memview_image().stack_bot;
+  unsigned int *start = (unsigned int *) img.memview_image().stack_seg + ((base - img.memview_image().stack_bot) >> 2);
+  return val(typed_memory_view((STACK_TOP - base) >> 2, start));
+}
+
+/* Ranges written since the last acknowledgeDirtyRanges() as
+   [version, data lo, data hi, kdata lo, kdata hi, stack lo, stack hi].
+   An empty range has lo >= hi. */
+val getDirtyRanges(int ctx) {
+  MIPSImage &img = ctxs.at(ctx); // will exception if ctx out of bounds
+  static unsigned int ranges[7];
+  ranges[0] = img.memview_image().dirty_version;
+  ranges[1] = img.memview_image().data_dirty.lo;
+  ranges[2] = img.memview_image().data_dirty.hi;
+  ranges[3] = img.memview_image().k_data_dirty.lo;
+  ranges[4] = img.memview_image().k_data_dirty.hi;
+  ranges[5] = img.memview_image().stack_dirty.lo;
+  ranges[6] = img.memview_image().stack_dirty.hi;
+
+  return val(typed_memory_view(7, ranges));
+}
+
+// Contents of a file in ctx's virtual filesystem, or null
+val getFile(int ctx, std::string name) {
+  MIPSImage &img = ctxs.at(ctx); // will exception if ctx out of bounds
+  const vfs_file_t *file = vfs_find_file(img, name);
+  return file == NULL ? val::null() : val(file->data);
+}
+
+// Names of the files the program in ctx wrote to
+val getWrittenFiles(int ctx) {
+  MIPSImage &img = ctxs.at(ctx); // will exception if ctx out of bounds
+  val names = val::array();
+  unsigned int n = 0;
+  for (auto &[name, file] : img.vfs().files) {
+    if (file.written) {
+      names.set(n++, name);
+    }
+  }
+  return names;
+}
+
+// What ctx has printed to stdout (or stderr), if output is being captured, or null
+val getCapturedOutput(int ctx, bool std_err) {
+  MIPSImage &img = ctxs.at(ctx); // will exception if ctx out of bounds
+  OutputCapture *capture = (std_err ? img.get_std_err_buf() : img.get_std_out_buf())->captured();
+  return capture == nullptr ? val::null() : val(capture->contents());
+}
+
+// Per-function profile of ctx as an array of {name, address, self, total, calls}, where self
+// and total are exclusive and inclusive instruction counts
+val getProfile(int ctx) {
+  MIPSImage &img = ctxs.at(ctx); // will exception if ctx out of bounds
+  val records = val::array();
+  unsigned int i = 0;
+  for (const profile_function_t &f : profile_functions(img)) {
+    val record = val::object();
+    record.set("name", f.name);
+    record.set("address", f.addr);
+    record.set("self", (double) f.self);
+    record.set("total", (double) f.total);
+    record.set("calls", (double) f.calls);
+    records.set(i++, record);
+  }
+  return records;
+}
+
+// The profile as collapsed stacks, for flame graph tools
+std::string getProfileCollapsed(int ctx) {
+  MIPSImage &img = ctxs.at(ctx); // will exception if ctx out of bounds
+  return profile_collapsed(img);
+}
+
+// The profile as an uncompressed pprof protobuf. The view is only valid until the next call,
+// so copy it (e.g. with slice()) before unlocking the simulator
+val getProfilePprof(int ctx) {
+  MIPSImage &img = ctxs.at(ctx); // will exception if ctx out of bounds
+  static std::string pprof;
+  pprof = profile_pprof(img);
+  return val(typed_memory_view(pprof.size(), (const unsigned char *) pprof.data()));
+}
+
+// Instruction mix of ctx: {classes: {alu, load, ...}, opcodes: {mnemonic: count},
+// exceptions: {ExcCode: count}}
+val getInstructionMix(int ctx) {
+  MIPSImage &img = ctxs.at(ctx); // will exception if ctx out of bounds
+  const inst_mix_t &mix = img.inst_mix();
+  val classes = val::object();
+  val opcodes = val::object();
+  val exceptions = val::object();
+
+  for (int i = 0; i < N_INST_CLASSES; ++i) {
+    classes.set(inst_class_name(i), (double) mix.by_class[i]);
+  }
+  for (const auto &[name, count] : inst_mix_by_opcode(img)) {
+    opcodes.set(name, (double) count);
+  }
+  for (int i = 0; i < N_EXC_CODES; ++i) {
+    if (mix.by_exception[i]) {
+      exceptions.set(i, (double) mix.by_exception[i]);
+    }
+  }
+
+  val result = val::object();
+  result.set("classes", classes);
+  result.set("opcodes", opcodes);
+  result.set("exceptions", exceptions);
+  return result;
+}
+
+static val cacheLevelStats(const cache_level_t &c) {
+  val stats = val::object();
+  stats.set("reads", (double) c.stats.reads);
+  stats.set("readMisses", (double) c.stats.read_misses);
+  stats.set("writes", (double) c.stats.writes);
+  stats.set("writeMisses", (double) c.stats.write_misses);
+  stats.set("writebacks", (double) c.stats.writebacks);
+  return stats;
+}
+
+// Cache statistics of ctx, or null if it has no cache model: {l1i, l1d, l2 (if modeled):
+// {reads, readMisses, writes, writeMisses, writebacks}, labels: array of {name, address,
+// fetches, fetchMisses, dataAccesses, dataMisses} counting L1 accesses by the code under each label}
+val getCacheStats(int ctx) {
+  MIPSImage &img = ctxs.at(ctx); // will exception if ctx out of bounds
+  cache_model_t *model = img.caches();
+  if (model == nullptr) {
+    return val::null();
+  }
+
+  val labels = val::array();
+  unsigned int i = 0;
+  for (const cache_label_stats_t &l : cache_label_stats(img)) {
+    val record = val::object();
+    record.set("name", l.name);
+    record.set("address", l.addr);
+    record.set("fetches", (double) l.counts.fetches);
+    record.set("fetchMisses", (double) l.counts.fetch_misses);
+    record.set("dataAccesses", (double) l.counts.data_accesses);
+    record.set("dataMisses", (double) l.counts.data_misses);
+    labels.set(i++, record);
+  }
+
+  val result = val::object();
+  result.set("l1i", cacheLevelStats(model->l1i));
+  result.set("l1d", cacheLevelStats(model->l1d));
+  if (model->l2.n_sets != 0) {
+    result.set("l2", cacheLevelStats(model->l2));
+  }
+  result.set("labels", labels);
+  return result;
+}
+
+// Branch prediction results of ctx, or null if it has no predictor: {predictor, predictions,
+// correct, sites: array of {name, address, executed, taken, correct}}
+val getBranchStats(int ctx) {
+  MIPSImage &img = ctxs.at(ctx); // will exception if ctx out of bounds
+  branch_predictor_t *bp = img.branch_predictor();
+  if (bp == nullptr) {
+    return val::null();
+  }
+
+  val sites = val::array();
+  unsigned int i = 0;
+  for (const bp_site_stats_t &site : bp_site_stats(img)) {
+    val record = val::object();
+    record.set("name", site.name);
+    record.set("address", site.addr);
+    record.set("executed", (double) site.counts.executed);
+    record.set("taken", (double) site.counts.taken);
+    record.set("correct", (double) site.counts.correct);
+    sites.set(i++, record);
+  }
+
+  val result = val::object();
+  result.set("predictor", std::string(bp_kind_name(bp->config.kind)));
+  result.set("predictions", (double) bp->predictions);
+  result.set("correct", (double) bp->correct);
+  result.set("sites", sites);
+  return result;
+}
+
+// Pipeline timing estimate of ctx, or null if it has no model: {cycles, instructions, cpi,
+// stalls: {loadUse, data, mulDiv, branch}, functions: array of {name, address, instructions,
+// cycles, cpi}}
+val getPipelineStats(int ctx) {
+  MIPSImage &img = ctxs.at(ctx); // will exception if ctx out of bounds
+  pipeline_t *pl = img.pipeline();
+  if (pl == nullptr) {
+    return val::null();
+  }
+
+  val functions = val::array();
+  unsigned int i = 0;
+  for (const pipeline_function_t &f : pipeline_functions(img)) {
+    val record = val::object();
+    record.set("name", f.name);
+    record.set("address", f.addr);
+    record.set("instructions", (double) f.instructions);
+    record.set("cycles", (double) f.cycles);
+    record.set("cpi", f.instructions ? (double) f.cycles / f.instructions : 0.0);
+    functions.set(i++, record);
+  }
+
+  val stalls = val::object();
+  stalls.set("loadUse", (double) pl->load_use_stalls);
+  stalls.set("data", (double) pl->data_stalls);
+  stalls.set("mulDiv", (double) pl->muldiv_stalls);
+  stalls.set("branch", (double) pl->branch_stalls);
+
+  uint64_t cycles = pipeline_cycles(*pl);
+  val result = val::object();
+  result.set("cycles", (double) cycles);
+  result.set("instructions", (double) pl->instructions);
+  result.set("cpi", pl->instructions ? (double) cycles / pl->instructions : 0.0);
+  result.set("stalls", stalls);
+  result.set("functions", functions);
+  return result;
+}
+
+// The trace recorded in memory so far for ctx, or null. Copy it before unlocking the simulator
+val getTrace(int ctx) {
+  MIPSImage &img = ctxs.at(ctx); // will exception if ctx out of bounds
+  exec_trace_t *t = img.tracer();
+  if (t == nullptr || t->file != nullptr) {
+    return val::null();
+  }
+  return val(typed_memory_view(t->data.size(), (const unsigned char *) t->data.data()));
+}
+
+// Stop recording ctx's execution. Returns the trace if it was recorded in memory, else null.
+// The view is only valid until the next call, so copy it (e.g. with slice())
+val stopTrace(int ctx) {
+  static std::string trace;
+  if (stop_trace(ctx, trace) != 0 || trace.empty()) {
+    return val::null();
+  }
+  return val(typed_memory_view(trace.size(), (const unsigned char *) trace.data()));
+}
+
+// Access counts of ctx's memory (see mem_heatmap.h), or null if it is not counting them:
+// {bucketSize, data, stack, kdata, special}, each segment being {address, step, reads, writes}.
+// reads[i] and writes[i] are for the bucket at address + i * step (step is negative for the
+// stack), and cover the whole segment. The views are only valid while the simulator is locked
+val getMemoryHeatmap(int ctx) {
+  MIPSImage &img = ctxs.at(ctx); // will exception if ctx out of bounds
+  mem_heatmap_t *heat = img.heatmap();
+  if (heat == nullptr) {
+    return val::null();
+  }
+
+  val result = val::object();
+  result.set("bucketSize", 1 << heat->shift);
+  for (int s = 0; s < HEAT_N_SEGMENTS; s++) {
+    heat_segment seg = (heat_segment) s;
+    val segment = val::object();
+    segment.set("address", heatmap_bucket_addr(*heat, seg, 0));
+    segment.set("step", seg == HEAT_STACK ? -(1 << heat->shift) : 1 << heat->shift);
+    segment.set("reads", val(typed_memory_view(heat->reads[s].size(), (const unsigned int *) heat->reads[s].data())));
+    segment.set("writes", val(typed_memory_view(heat->writes[s].size(), (const unsigned int *) heat->writes[s].data())));
+    result.set(heat_segment_name(seg), segment);
+  }
+  return result;
+}
+
+void acknowledgeDirtyRanges(int ctx) {
+  MIPSImage &img = ctxs.at(ctx); // will exception if ctx out of bounds
+  clear_mem_dirty(img);
+}
+
 val getGeneralRegVals(int ctx) {
   MIPSImage &img = ctxs.at(ctx); // will exception if ctx out of bounds
   return val(typed_memory_view(32, (unsigned int *) img.regview_image().R));
@@ -275,19 +659,49 @@ EMSCRIPTEN_BINDINGS(readSimulationSnapshot) {
     function("lockSimulator", &lockSimulator);
     function("getUserText", &getUserText);
     function("getKernelText", &getKernelText);
+    function("getTextRecords", &getTextRecords);
     function("getStack", &getStack);
     function("getUserData", &getUserData);
     function("getKernelData", &getKernelData);
+    function("getStackWindow", &getStackWindow);
+    function("getDirtyRanges", &getDirtyRanges);
+    function("getFile", &getFile);
+    function("getWrittenFiles", &getWrittenFiles);
+    function("getCapturedOutput", &getCapturedOutput);
+    function("getProfile", &getProfile);
+    function("getProfileCollapsed", &getProfileCollapsed);
+    function("getProfilePprof", &getProfilePprof);
+    function("getInstructionMix", &getInstructionMix);
+    function("getCacheStats", &getCacheStats);
+    function("getBranchStats", &getBranchStats);
+    function("getPipelineStats", &getPipelineStats);
+    function("getTrace", &getTrace);
+    function("getMemoryHeatmap", &getMemoryHeatmap);
     function("getGeneralRegVals", &getGeneralRegVals);
     function("getFloatRegVals", &getFloatRegVals);
     function("getDoubleRegVals", &getDoubleRegVals);
     function("getSpecialRegVals", &getSpecialRegVals);
     function("getStatus", &getStatus);
+    function("getStatusBlock", &getStatusBlock);
 }
 
 EMSCRIPTEN_BINDINGS(simulationControls) {
+    function("acknowledgeDirtyRanges", &acknowledgeDirtyRanges);
     function("deleteBreakpoint", &delete_ctx_breakpoint);
     function("addBreakpoint", &add_ctx_breakpoint);
+    function("provideInput", &provideInput);
+    function("closeInput", &closeInput);
+    function("preloadFile", &preloadFile);
+    function("clearPreloadedFiles", &clearPreloadedFiles);
+    function("setOutputCapture", &setOutputCapture);
+    function("setProfiling", &setProfiling);
+    function("setInstructionMix", &setInstructionMix);
+    function("setCacheModel", &setCacheModel);
+    function("setBranchPredictor", &setBranchPredictor);
+    function("setPipelineModel", &setPipelineModel);
+    function("setMemoryHeatmap", &setMemoryHeatmap);
+    function("startTrace", &startTrace);
+    function("stopTrace", &stopTrace);
     function("play", &play_simulation);
     function("pause", &pause_simulation);
     function("step", &step);
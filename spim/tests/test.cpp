@@ -0,0 +1,95 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+
+#include "spim.h"
+#include "image.h"
+#include "spim-utils.h"
+#include "program_cache.h"
+#include "kernel_image.h"
+#include "input_queue.h"
+#include "test.h"
+
+int test_failures = 0;
+
+
+std::string
+write_source (const char *name, const std::string &source)
+{
+  FILE *f = fopen (name, "w");
+
+  if (f == NULL)
+    return "";
+  fwrite (source.data (), 1, source.size (), f);
+  fclose (f);
+  return name;
+}
+
+
+bool
+load_source (MIPSImage &img, const std::string &source)
+{
+  static int n_sources = 0;
+  char name[64];
+
+  snprintf (name, sizeof (name), "test_source_%d.s", n_sources ++);
+  if (write_source (name, source).empty ()
+      || !load_program_cached (img, &default_kernel_image, name))
+    return false;
+  remove (name);
+  initialize_run_stack (img, 0, nullptr);
+  img.reg_image().PC = starting_address (img);
+  return true;
+}
+
+
+long
+run_program (MIPSImage &img, long max_steps)
+{
+  bool continuable = true;
+  long steps = 0;
+
+  while (continuable && steps < max_steps)
+    {
+      steps += 1;
+      if (step_program (img, false, false, &continuable))
+	break;			/* Breakpoint */
+      if (img.input_queue().waiting)
+	break;
+    }
+  return steps;
+}
+
+
+void
+run_parked (MIPSImage &img, const char *input, int parked_cycles)
+{
+  bool continuable;
+  int i;
+
+  run_program (img);
+  for (i = 0; i < parked_cycles && img.input_queue().waiting; i ++)
+    step_program (img, false, false, &continuable);
+  push_input (img, input, strlen (input));
+  run_program (img);
+}
+
+
+const char *const echo_int_program =
+  "	.globl main\n"
+  "main:	li $v0, 5\n"
+  "	syscall\n"
+  "	move $a0, $v0\n"
+  "	li $v0, 1\n"
+  "	syscall\n"
+  "	jr $ra\n";
+
+
+int
+test_result ()
+{
+  if (test_failures != 0)
+    fprintf (stderr, "%d check(s) failed\n", test_failures);
+  return test_failures != 0;
+}
@@ -0,0 +1,58 @@
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdio.h>
+
+#include <string>
+
+class MIPSImage;
+
+/* A tiny harness: each test program runs its checks from main and
+   returns test_result (). */
+
+extern int test_failures;
+
+#define CHECK(COND)							\
+  do {									\
+    if (!(COND))							\
+      {									\
+	fprintf (stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #COND); \
+	test_failures += 1;						\
+      }									\
+  } while (0)
+
+#define CHECK_EQ(A, B)							\
+  do {									\
+    long long a_ = (long long) (A), b_ = (long long) (B);		\
+    if (a_ != b_)							\
+      {									\
+	fprintf (stderr, "%s:%d: CHECK failed: %s == %s (%lld != %lld)\n", \
+		 __FILE__, __LINE__, #A, #B, a_, b_);			\
+	test_failures += 1;						\
+      }									\
+  } while (0)
+
+/* Write SOURCE to a file named NAME in the working directory and return
+   its path. */
+std::string write_source (const char *name, const std::string &source);
+
+/* Load SOURCE (a program, or the bytes of an ELF executable) on top of
+   the default exception handler into IMG and set it up to run from main,
+   as a reset does.  Return false if it cannot be loaded. */
+bool load_source (MIPSImage &img, const std::string &source);
+
+/* Step IMG until it exits, stops, or waits for input, at most MAX_STEPS
+   instructions.  Return the number of steps taken. */
+long run_program (MIPSImage &img, long max_steps = 1000000);
+
+/* Run IMG until it waits for input, step it PARKED_CYCLES more times
+   while it waits (as the simulator does a context parked on a read),
+   then give it INPUT and run it to the end. */
+void run_parked (MIPSImage &img, const char *input, int parked_cycles);
+
+/* A program that reads an integer and prints it. */
+extern const char *const echo_int_program;
+
+int test_result ();
+
+#endif
@@ -0,0 +1,87 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "spim.h"
+#include "image.h"
+#include "arena.h"
+#include "test.h"
+
+
+/* A small block that is freed is handed out again for the next request
+   of its size, and only for its size. */
+
+static void
+test_free_list_reuse ()
+{
+  MIPSImage img (0);
+  arena_t &a = img.arena();
+  void *p = arena_alloc (img, 20);
+  void *q = arena_alloc (img, 20);
+
+  CHECK (p != q);
+  arena_free (img, p, 20);
+  CHECK (arena_alloc (img, 40) != p);
+  /* 17 bytes take as many as 20 do. */
+  CHECK (arena_alloc (img, 17) == p);
+  CHECK (a.free_blocks[ARENA_ROUND (20) / ARENA_ALIGN - 1] == NULL);
+
+  /* Large blocks are not kept: they wait for arena_release. */
+  void *big = arena_alloc (img, 1024);
+  arena_free (img, big, 1024);
+  CHECK (arena_alloc (img, 1024) != big);
+}
+
+
+/* A request too large for a chunk gets one of its own, and the current
+   chunk keeps its free space. */
+
+static void
+test_large_block ()
+{
+  MIPSImage img (0);
+  arena_t &a = img.arena();
+  char *small = (char *) arena_alloc (img, 8);
+  char *next = a.next, *limit = a.limit;
+  char *huge = (char *) arena_alloc (img, 2 * ARENA_CHUNK_SIZE);
+
+  CHECK (small != NULL && huge != NULL);
+  memset (huge, 1, 2 * ARENA_CHUNK_SIZE);
+  CHECK (a.next == next && a.limit == limit);
+  CHECK ((char *) arena_alloc (img, 8) == next);
+}
+
+
+/* arena_release gives back every chunk and leaves an empty arena that
+   can be allocated from again. */
+
+static void
+test_release ()
+{
+  MIPSImage img (0);
+  arena_t &a = img.arena();
+  int i;
+
+  for (i = 0; i < 3 * ARENA_CHUNK_SIZE / 64; i ++)
+    arena_alloc (img, 64);
+  arena_free (img, arena_alloc (img, 16), 16);
+  CHECK (a.chunks != NULL && a.chunks->next != NULL);
+
+  arena_release (a);
+  CHECK (a.chunks == NULL && a.next == NULL && a.limit == NULL);
+  for (i = 0; i < ARENA_FREE_CLASSES; i ++)
+    CHECK (a.free_blocks[i] == NULL);
+
+  char *s = arena_str_copy (img, "main");
+  CHECK (strcmp (s, "main") == 0);
+  CHECK (a.chunks != NULL && a.chunks->next == NULL);
+}
+
+
+int
+main ()
+{
+  test_free_list_reuse ();
+  test_large_block ();
+  test_release ();
+  return test_result ();
+}
@@ -0,0 +1,68 @@
+#include <stdint.h>
+
+#include <string>
+
+#include "spim.h"
+#include "image.h"
+#include "sym-tbl.h"
+#include "branch_predictor.h"
+#include "test.h"
+
+
+/* Ten passes of an inner loop that branches back nine times and then
+   falls through.  The branch at `back' is executed 100 times. */
+
+static const char *const nested_loops =
+  "	.text\n"
+  "	.globl main\n"
+  "main:	li $t2, 10\n"
+  "outer:	li $t1, 10\n"
+  "inner:	addi $t1, $t1, -1\n"
+  "	.globl back\n"
+  "back:	bnez $t1, inner\n"
+  "	addi $t2, $t2, -1\n"
+  "	bnez $t2, outer\n"
+  "	jr $ra\n";
+
+
+/* How many times the predictor described by SPEC got the inner loop's
+   branch right. */
+
+static uint64_t
+inner_correct (const char *spec)
+{
+  MIPSImage img (0);
+  bp_config_t config;
+  std::string problem;
+  uint64_t correct = 0;
+
+  CHECK (load_source (img, nested_loops));
+  CHECK (bp_parse_config (spec, config, problem));
+  bp_attach (img, config);
+  run_program (img);
+
+  mem_addr back = find_symbol_address (img, (char *) "back");
+  for (const bp_site_stats_t &s : bp_site_stats (img))
+    if (s.addr == back)
+      {
+	CHECK_EQ (s.counts.executed, 100);
+	CHECK_EQ (s.counts.taken, 90);
+	correct = s.counts.correct;
+      }
+  return correct;
+}
+
+
+int
+main ()
+{
+  CHECK_EQ (inner_correct ("not-taken"), 10);
+  CHECK_EQ (inner_correct ("taken"), 90);
+  CHECK_EQ (inner_correct ("btfn"), 90);
+  /* Wrong on entering and leaving each pass. */
+  CHECK_EQ (inner_correct ("1bit"), 80);
+  /* Wrong on the very first branch and on leaving each pass: one exit
+     does not undo nine taken branches. */
+  CHECK_EQ (inner_correct ("2bit"), 89);
+  return test_result ();
+}
@@ -0,0 +1,150 @@
+#include <stdint.h>
+
+#include <string>
+
+#include "spim.h"
+#include "image.h"
+#include "input_queue.h"
+#include "sym-tbl.h"
+#include "cache_model.h"
+#include "test.h"
+
+
+static bool
+parses (const char *spec)
+{
+  cache_hierarchy_config_t config;
+  std::string problem;
+
+  return cache_parse_config (spec, config, problem);
+}
+
+
+/* Sizes that are zero or do not fit in 32 bits are errors, not a
+   cache that silently is not there. */
+
+static void
+test_parse ()
+{
+  CHECK (parses ("l1i:size=8K,assoc=2; l1d:size=1M,line=64; l2:size=64K,assoc=full"));
+  CHECK (!parses ("l1d:size=0"));
+  CHECK (!parses ("l1d:size=4096M"));
+  CHECK (!parses ("l1d:size=4194304K"));
+  CHECK (!parses ("l1d:size=99999999999999999999"));
+  CHECK (!parses ("l1d:size=-4K"));
+  CHECK (!parses ("l1d:line=0"));
+  CHECK (!parses ("l1d:assoc=0"));
+}
+
+
+/* Two passes over 64 words in 8 lines of a direct-mapped cache large
+   enough to hold them: the first pass misses once a line, the second
+   never. */
+
+static void
+test_sequential_scan ()
+{
+  MIPSImage img (0);
+  cache_hierarchy_config_t config;
+  std::string problem;
+  uint64_t accesses = 0, misses = 0;
+
+  CHECK (load_source (img,
+		      "	.data\n"
+		      "	.align 5\n"
+		      "array:	.space 256\n"
+		      "	.text\n"
+		      "	.globl main\n"
+		      "main:	li $t2, 2\n"
+		      "	.globl scan\n"
+		      "scan:	la $t0, array\n"
+		      "	li $t1, 64\n"
+		      "loop:	lw $t3, 0($t0)\n"
+		      "	addi $t0, $t0, 4\n"
+		      "	addi $t1, $t1, -1\n"
+		      "	bnez $t1, loop\n"
+		      "	addi $t2, $t2, -1\n"
+		      "	bnez $t2, scan\n"
+		      "	.globl done\n"
+		      "done:	jr $ra\n"));
+  CHECK (cache_parse_config ("l1d:size=1K,line=32,assoc=1", config, problem));
+  cache_attach (img, config);
+  run_program (img);
+
+  mem_addr scan = find_symbol_address (img, (char *) "scan");
+  mem_addr done = find_symbol_address (img, (char *) "done");
+  for (const cache_label_stats_t &s : cache_label_stats (img))
+    if (s.addr >= scan && s.addr < done)
+      {
+	accesses += s.counts.data_accesses;
+	misses += s.counts.data_misses;
+      }
+  CHECK_EQ (accesses, 128);
+  CHECK_EQ (misses, 8);
+}
+
+
+/* A context parked on a READ fetches the syscall again every cycle; the
+   model counts the fetch once, as if input had been there. */
+
+static uint64_t
+parked_fetches (int parked_cycles)
+{
+  MIPSImage img (0);
+  cache_hierarchy_config_t config;
+  std::string problem;
+  uint64_t fetches = 0;
+
+  img.capture_output (1 << 16, false);
+  CHECK (load_source (img, echo_int_program));
+  CHECK (cache_parse_config ("l1i:size=1K", config, problem));
+  cache_attach (img, config);
+  run_parked (img, "7\n", parked_cycles);
+  CHECK (!img.input_queue().waiting);
+  for (const cache_label_stats_t &s : cache_label_stats (img))
+    fetches += s.counts.fetches;
+  CHECK_EQ (fetches, img.caches()->l1i.stats.reads);
+  return fetches;
+}
+
+
+/* Fetching from outside the text segments, as a jump into the data
+   segment does, is not counted against an instruction. */
+
+static void
+test_fetch_outside_text ()
+{
+  MIPSImage img (0);
+  cache_hierarchy_config_t config;
+  std::string problem;
+
+  img.capture_output (1 << 16, false);
+  CHECK (load_source (img,
+		      "	.data\n"
+		      "	.globl buf\n"
+		      "buf:	.word 0\n"
+		      "	.text\n"
+		      "	.globl main\n"
+		      "main:	la $t0, buf\n"
+		      "	jr $t0\n"));
+  CHECK (cache_parse_config ("l1i:size=1K", config, problem));
+  cache_attach (img, config);
+  run_program (img, 100);
+
+  mem_image_t &mem = img.mem_image();
+  CHECK (img.caches()->l1i.stats.reads > 0);
+  CHECK (img.caches()->text.size () <= (mem.text_top - TEXT_BOT) / BYTES_PER_WORD);
+  CHECK (img.caches()->k_text.size () <= (mem.k_text_top - K_TEXT_BOT) / BYTES_PER_WORD);
+}
+
+
+int
+main ()
+{
+  test_parse ();
+  test_sequential_scan ();
+  test_fetch_outside_text ();
+  CHECK (parked_fetches (0) > 0);
+  CHECK_EQ (parked_fetches (10), parked_fetches (0));
+  return test_result ();
+}
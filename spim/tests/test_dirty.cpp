@@ -0,0 +1,132 @@
+#include <string.h>
+
+#include "spim.h"
+#include "image.h"
+#include "mem.h"
+#include "reg.h"
+#include "sym-tbl.h"
+#include "input_queue.h"
+#include "test.h"
+
+
+/* Stores and syscalls that fill memory extend their segment's dirty
+   range, and acknowledging the ranges empties them. */
+
+static void
+test_stores_and_syscalls ()
+{
+  MIPSImage img (0);
+  const char *input = "hi\n";
+
+  CHECK (load_source (img,
+		      "	.globl x\n"
+		      "	.globl buf\n"
+		      "	.data\n"
+		      "pad:	.space 16\n"
+		      "x:	.word 0\n"
+		      "buf:	.space 8\n"
+		      "	.text\n"
+		      "main:	la $t0, x\n"
+		      "	li $t1, 7\n"
+		      "	sw $t1, 0($t0)\n"
+		      "	sb $t1, -8($sp)\n"
+		      "	sw $t1, -16($sp)\n"
+		      "	la $a0, buf\n"
+		      "	li $a1, 8\n"
+		      "	li $v0, 8\n"
+		      "	syscall\n"
+		      "	jr $ra\n"));
+
+  mem_addr x = find_symbol_address (img, (char *) "x");
+  mem_addr buf = find_symbol_address (img, (char *) "buf");
+  mem_addr sp = img.reg_image().R[REG_SP];
+  unsigned version = img.mem_image().dirty_version;
+
+  push_input (img, input, strlen (input));
+  close_input (img);
+  clear_mem_dirty (img);
+  CHECK_EQ (img.mem_image().dirty_version, version + 1);
+  CHECK (img.mem_image().data_dirty.lo >= img.mem_image().data_dirty.hi);
+  CHECK (img.mem_image().stack_dirty.lo >= img.mem_image().stack_dirty.hi);
+
+  run_program (img);
+
+  CHECK_EQ (img.mem_image().data_dirty.lo, x);
+  CHECK_EQ (img.mem_image().data_dirty.hi, buf + 4); /* "hi\n" and its null */
+  CHECK_EQ (img.mem_image().stack_dirty.lo, sp - 16);
+  CHECK_EQ (img.mem_image().stack_dirty.hi, sp - 7);
+  CHECK (img.mem_image().k_data_dirty.lo >= img.mem_image().k_data_dirty.hi);
+
+  clear_mem_dirty (img);
+  CHECK (img.mem_image().data_dirty.lo >= img.mem_image().data_dirty.hi);
+  CHECK (img.mem_image().stack_dirty.lo >= img.mem_image().stack_dirty.hi);
+}
+
+
+/* Writes outside the data segments, or of no bytes, leave the ranges
+   alone. */
+
+static void
+test_mark_outside_segments ()
+{
+  MIPSImage img (0);
+
+  CHECK (load_source (img, "main:	jr $ra\n"));
+  clear_mem_dirty (img);
+  mark_mem_dirty (img, TEXT_BOT, 4);
+  mark_mem_dirty (img, DATA_BOT, 0);
+  CHECK (img.mem_image().data_dirty.lo >= img.mem_image().data_dirty.hi);
+  CHECK (img.mem_image().stack_dirty.lo >= img.mem_image().stack_dirty.hi);
+  CHECK (img.mem_image().k_data_dirty.lo >= img.mem_image().k_data_dirty.hi);
+
+  mark_mem_dirty (img, K_DATA_BOT + 8, 4);
+  CHECK_EQ (img.mem_image().k_data_dirty.lo, K_DATA_BOT + 8);
+  CHECK_EQ (img.mem_image().k_data_dirty.hi, K_DATA_BOT + 12);
+}
+
+
+/* A READ_STRING marks what it read, not the buffer size it was given,
+   and nothing past the end of a segment is ever dirty. */
+
+static void
+test_mark_clamped ()
+{
+  MIPSImage img (0);
+  const char *input = "abc\n";
+
+  CHECK (load_source (img,
+		      "	.globl buf\n"
+		      "	.data\n"
+		      "buf:	.space 8\n"
+		      "	.text\n"
+		      "main:	la $a0, buf\n"
+		      "	li $a1, 0x4000000\n"
+		      "	li $v0, 8\n"
+		      "	syscall\n"
+		      "	jr $ra\n"));
+
+  mem_addr buf = find_symbol_address (img, (char *) "buf");
+
+  push_input (img, input, strlen (input));
+  close_input (img);
+  clear_mem_dirty (img);
+  run_program (img);
+  CHECK_EQ (img.mem_image().data_dirty.lo, buf);
+  CHECK_EQ (img.mem_image().data_dirty.hi, buf + 5);
+
+  clear_mem_dirty (img);
+  mark_mem_dirty (img, img.mem_image().data_top - 4, 1 << 20);
+  CHECK_EQ (img.mem_image().data_dirty.hi, img.mem_image().data_top);
+  mark_mem_dirty (img, STACK_TOP - 8, 64);
+  CHECK_EQ (img.mem_image().stack_dirty.hi, STACK_TOP);
+}
+
+
+int
+main ()
+{
+  test_stores_and_syscalls ();
+  test_mark_outside_segments ();
+  test_mark_clamped ();
+  return test_result ();
+}
@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <string>
+#include <vector>
+
+#include "spim.h"
+#include "image.h"
+#include "inst.h"
+#include "mem.h"
+#include "spim-utils.h"
+#include "sym-tbl.h"
+#include "test.h"
+
+
+/* The line inst_to_string prints for the instruction at ADDR. */
+
+static std::string
+printed (MIPSImage &img, mem_addr addr)
+{
+  char *s = inst_to_string (img, addr);
+  std::string line (s);
+
+  free (s);
+  return line;
+}
+
+
+/* Each record says what inst_to_string prints for its instruction:
+   "[address]\tencoding  mnemonic operands", then the source line. */
+
+static void
+check_records (MIPSImage &img, bool kernel)
+{
+  const std::vector<disasm_line_t> &lines = disassembled_segment (img, kernel);
+
+  CHECK (!lines.empty ());
+  for (const disasm_line_t &line : lines)
+    {
+      char head[32];
+      std::string text = printed (img, line.addr);
+
+      snprintf (head, sizeof (head), "[0x%08x]\t0x%08x  ", line.addr, line.encoding);
+      std::string body = head + line.mnemonic + (line.operands.empty () ? "" : " " + line.operands);
+      CHECK (text.compare (0, body.size (), body) == 0);
+      if (!line.source.empty ())
+	CHECK (text.find ("; " + line.source) != std::string::npos);
+    }
+}
+
+
+static void
+test_records ()
+{
+  MIPSImage img (0);
+
+  CHECK (load_source (img,
+		      "	.text\n"
+		      "	.globl main\n"
+		      "main:	addi $t0, $zero, 5\n"
+		      "	.globl second\n"
+		      "second:	lw $t1, 4($sp)\n"
+		      "	beq $t0, $t1, main\n"
+		      "	jr $ra\n"));
+  check_records (img, false);
+  check_records (img, true);
+
+  /* A range holds the records of the addresses in it, in order. */
+  mem_addr main_addr = find_symbol_address (img, (char *) "main");
+  const std::vector<disasm_line_t> &lines = disassembled_segment (img, false);
+  const auto [first, last] = disassembled_range (img, main_addr, main_addr + 8);
+
+  CHECK_EQ (last - first, 2);
+  CHECK_EQ (lines[first].addr, main_addr);
+  CHECK_EQ (lines[first + 1].addr, main_addr + 4);
+  CHECK (lines[first].mnemonic == "addi");
+  CHECK (lines[first + 1].mnemonic == "lw");
+}
+
+
+/* Storing into the text segment drops the segment's records, and the
+   next query disassembles the new instruction. */
+
+static void
+test_invalidated_by_text_write ()
+{
+  MIPSImage img (0);
+
+  CHECK (load_source (img,
+		      "	.text\n"
+		      "	.globl main\n"
+		      "main:	addi $t0, $zero, 5\n"
+		      "	.globl second\n"
+		      "second:	lw $t1, 4($sp)\n"
+		      "	jr $ra\n"));
+
+  mem_addr second = find_symbol_address (img, (char *) "second");
+  mem_addr nop_encoding = 0;
+  const std::vector<disasm_line_t> &lines = disassembled_segment (img, false);
+  size_t kernel_lines = disassembled_segment (img, true).size ();
+
+  auto at = [&] (mem_addr addr) -> const disasm_line_t * {
+    for (const disasm_line_t &line : disassembled_segment (img, false))
+      if (line.addr == addr)
+	return &line;
+    return NULL;
+  };
+
+  CHECK (!lines.empty () && at (second) != NULL && at (second)->mnemonic == "lw");
+  set_mem_word (img, second, nop_encoding);
+  CHECK (!img.disassembly ().user_valid);
+  CHECK (img.disassembly ().kernel_valid);
+  CHECK (at (second) != NULL && at (second)->mnemonic == "nop");
+  CHECK_EQ (at (second)->encoding, nop_encoding);
+  check_records (img, false);
+  CHECK_EQ (disassembled_segment (img, true).size (), kernel_lines);
+}
+
+
+int
+main ()
+{
+  test_records ();
+  test_invalidated_by_text_write ();
+  return test_result ();
+}
@@ -0,0 +1,183 @@
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "spim.h"
+#include "image.h"
+#include "mem.h"
+#include "test.h"
+
+
+/* Build just enough of an ELF32 MIPS executable for the loader: the
+   file header, program headers, and each segment's bytes. */
+
+typedef struct elf_segment {
+  uint32_t vaddr;
+  uint32_t mem_size;
+  bool exec;
+  std::string bytes;
+  uint32_t off;			/* Where the bytes go; 0 to place them */
+  uint32_t file_size;		/* 0 to use the bytes' length */
+} elf_segment_t;
+
+static void
+put16 (std::string &f, size_t off, uint32_t v)
+{
+  f[off] = (char) v;
+  f[off + 1] = (char) (v >> 8);
+}
+
+static void
+put32 (std::string &f, size_t off, uint32_t v)
+{
+  put16 (f, off, v & 0xffff);
+  put16 (f, off + 2, v >> 16);
+}
+
+static std::string
+word_bytes (std::vector<uint32_t> words)
+{
+  std::string s (words.size () * 4, '\0');
+
+  for (size_t i = 0; i < words.size (); i ++)
+    put32 (s, i * 4, words[i]);
+  return s;
+}
+
+static std::string
+make_elf (uint32_t entry, const std::vector<elf_segment_t> &segs, uint32_t phoff = 52)
+{
+  std::string f (52 + 32 * segs.size (), '\0');
+
+  f.replace (0, 4, "\177ELF");
+  f[4] = 1;			/* ELFCLASS32 */
+  f[5] = 1;			/* ELFDATA2LSB */
+  f[6] = 1;
+  put16 (f, 16, 2);		/* ET_EXEC */
+  put16 (f, 18, 8);		/* EM_MIPS */
+  put32 (f, 24, entry);
+  put32 (f, 28, phoff);
+  put16 (f, 42, 32);
+  put16 (f, 44, segs.size ());
+  for (size_t i = 0; i < segs.size (); i ++)
+    {
+      size_t ph = 52 + 32 * i;
+      uint32_t off = segs[i].off != 0 ? segs[i].off : f.size ();
+
+      put32 (f, ph, 1);		/* PT_LOAD */
+      put32 (f, ph + 4, off);
+      put32 (f, ph + 8, segs[i].vaddr);
+      put32 (f, ph + 16, segs[i].file_size != 0 ? segs[i].file_size : segs[i].bytes.size ());
+      put32 (f, ph + 20, segs[i].mem_size);
+      put32 (f, ph + 24, segs[i].exec ? 5 : 6);
+      if (segs[i].off == 0)
+	f += segs[i].bytes;
+    }
+  return f;
+}
+
+/* ori $v0, $0, 10; syscall */
+static const std::string exit_code = word_bytes ({0x3402000a, 0x0000000c});
+
+
+static void
+test_loads_segments ()
+{
+  MIPSImage img (0);
+  mem_addr far = DATA_BOT + 0x100000;
+
+  CHECK (load_source (img, make_elf (TEXT_BOT, {
+	  {TEXT_BOT, 8, true, exit_code, 0, 0},
+	  {DATA_BOT, 8, false, "abcd", 0, 0},
+	  {far, 4, false, word_bytes ({0x12345678}), 0, 0}})));
+  CHECK_EQ (read_mem_word (img, DATA_BOT), 0x64636261);
+  CHECK_EQ (read_mem_word (img, DATA_BOT + 4), 0);
+  CHECK_EQ (read_mem_word (img, far), 0x12345678);
+  run_program (img);
+  CHECK_EQ (img.reg_image().R[2], 10);
+}
+
+
+/* Text past the text segment's initial end grows it, as data does the
+   data segment, and so does installing the cached copy of the program. */
+
+static void
+test_grows_text ()
+{
+  mem_addr far = TEXT_BOT + TEXT_SIZE + 0x10000;
+  /* Startup jumps there: j far */
+  std::string elf = make_elf (TEXT_BOT, {
+      {TEXT_BOT, 4, true, word_bytes ({0x08000000 | (far >> 2)}), 0, 0},
+      {far, 8, true, exit_code, 0, 0}});
+  int i;
+
+  for (i = 0; i < 2; i ++)
+    {
+      MIPSImage img (0);
+
+      CHECK (load_source (img, elf));
+      CHECK (img.mem_image().text_top >= far + 8);
+      CHECK (img.mem_image().text_top - TEXT_BOT <= (mem_addr) img.mem_image().text_size_limit);
+      run_program (img);
+      CHECK_EQ (img.reg_image().R[2], 10);
+    }
+}
+
+
+/* Each of these is rejected before anything is read past the end of the
+   file or any memory is allocated for it. */
+
+static void
+test_rejects (const std::string &elf, const char *message)
+{
+  MIPSImage img (0);
+  std::string err;
+
+  img.capture_output (1 << 16, false);
+  CHECK (!load_source (img, elf));
+  err = img.get_std_err_buf()->captured()->contents ();
+  if (err.find (message) == std::string::npos)
+    fprintf (stderr, "expected \"%s\", got: %s\n", message, err.c_str ());
+  CHECK (err.find (message) != std::string::npos);
+  CHECK (img.mem_image().data_top - DATA_BOT <= (mem_addr) img.mem_image().data_size_limit);
+  CHECK (STACK_TOP - img.mem_image().stack_bot <= (mem_addr) img.mem_image().stack_size_limit);
+  CHECK (img.mem_image().text_top - TEXT_BOT <= (mem_addr) img.mem_image().text_size_limit);
+}
+
+
+int
+main ()
+{
+  test_loads_segments ();
+  test_grows_text ();
+
+  /* Truncated: bytes past the end of the file, including offsets and
+     sizes whose 32-bit sum wraps. */
+  test_rejects (make_elf (TEXT_BOT, {{DATA_BOT, 64, false, "abcd", 0, 64}}), "truncated");
+  test_rejects (make_elf (TEXT_BOT, {{DATA_BOT, 64, false, "", 0xfffffff0, 0x20}}), "truncated");
+  test_rejects (make_elf (TEXT_BOT, {{DATA_BOT, 4, false, "abcd", 0, 0}}, 0xffffffe0), "truncated");
+
+  /* Overlapping */
+  test_rejects (make_elf (TEXT_BOT, {
+	{DATA_BOT, 16, false, "abcd", 0, 0},
+	{DATA_BOT + 8, 16, false, "abcd", 0, 0}}), "overlaps");
+  test_rejects (make_elf (TEXT_BOT, {
+	{TEXT_BOT, 8, true, exit_code, 0, 0},
+	{TEXT_BOT + 4, 4, true, exit_code.substr (0, 4), 0, 0}}), "overlaps");
+
+  /* Out of range: in the stack, past the data segment's limit, and
+     wrapping around the top of memory. */
+  test_rejects (make_elf (TEXT_BOT, {{0x7fff0000, 4, false, "abcd", 0, 0}}), "not in a data segment");
+  test_rejects (make_elf (TEXT_BOT, {{DATA_BOT, 0x7fffffff, false, "abcd", 0, 0}}), "not in a data segment");
+  test_rejects (make_elf (TEXT_BOT, {{0xfffffff0, 0x20, false, "abcd", 0, 0}}), "not in a data segment");
+  test_rejects (make_elf (TEXT_BOT, {{0xfffffff0, 0x20, true, word_bytes ({0, 0, 0, 0, 0, 0, 0, 0}), 0, 0}}),
+		"not in a text segment");
+  test_rejects (make_elf (TEXT_BOT, {{TEXT_BOT + TEXT_LIMIT - 4, 8, true, exit_code, 0, 0}}),
+		"not in a text segment");
+
+  /* Instructions are words: a partial one at the end is not dropped. */
+  test_rejects (make_elf (TEXT_BOT, {{TEXT_BOT, 8, true, exit_code.substr (0, 6), 0, 0}}),
+		"not whole words");
+  return test_result ();
+}
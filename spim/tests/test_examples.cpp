@@ -0,0 +1,86 @@
+#include <string.h>
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "spim.h"
+#include "image.h"
+#include "spim-utils.h"
+#include "program_cache.h"
+#include "kernel_image.h"
+#include "input_queue.h"
+#include "test.h"
+
+
+typedef struct example {
+  const char *file;
+  const char *input;
+  const char *expected;		/* Must appear in the program's output */
+} example_t;
+
+static const example_t examples[] = {
+  {"test_core.s", "", "Passed all tests"},
+  {"test_le.s", "", "Passed all tests"},
+  {"fibonacci.s", "10\n", "F_10 = 55\n"},
+  {"hello_world.s", "", "Hello World"},
+};
+
+#define N_EXAMPLES (sizeof (examples) / sizeof (examples[0]))
+
+
+static void
+assemble_example (const example_t &e, MIPSImage *img, bool *loaded)
+{
+  std::string path = std::string (EXAMPLES_DIR) + e.file;
+
+  img->capture_output (1 << 16, false);
+  *loaded = load_program_cached (*img, &default_kernel_image, path.c_str ());
+}
+
+
+/* The assembler keeps its state in the image, so the examples are
+   assembled on several threads at once, as contexts are on a reset, and
+   then run one after another, as the simulator thread runs them.
+   (test_core.s raises exceptions on purpose, so stderr is not checked.) */
+
+int
+main ()
+{
+  const size_t copies = 3;
+  std::vector<std::unique_ptr<MIPSImage>> imgs;
+  std::unique_ptr<bool[]> loaded (new bool[N_EXAMPLES * copies]);
+  std::vector<std::thread> threads;
+  size_t i;
+
+  for (i = 0; i < N_EXAMPLES * copies; i ++)
+    imgs.emplace_back (new MIPSImage ((int) i));
+  for (i = 0; i < imgs.size (); i ++)
+    threads.emplace_back (assemble_example, std::cref (examples[i % N_EXAMPLES]),
+			  imgs[i].get (), &loaded[i]);
+  for (auto &t : threads)
+    t.join ();
+
+  for (i = 0; i < imgs.size (); i ++)
+    {
+      const example_t &e = examples[i % N_EXAMPLES];
+      MIPSImage &img = *imgs[i];
+      std::string out;
+
+      CHECK (loaded[i]);
+      if (!loaded[i])
+	continue;
+      push_input (img, e.input, strlen (e.input));
+      close_input (img);
+      initialize_run_stack (img, 0, nullptr);
+      img.reg_image().PC = starting_address (img);
+      run_program (img, 10000000);
+
+      out = img.get_std_out_buf()->captured()->contents ();
+      if (out.find (e.expected) == std::string::npos)
+	fprintf (stderr, "%s printed:\n%s\n", e.file, out.c_str ());
+      CHECK (out.find (e.expected) != std::string::npos);
+    }
+  return test_result ();
+}
@@ -0,0 +1,133 @@
+#include <stdint.h>
+#include <string.h>
+
+#include <vector>
+
+#include "spim.h"
+#include "image.h"
+#include "reg.h"
+#include "input_queue.h"
+#include "sym-tbl.h"
+#include "mem_heatmap.h"
+#include "test.h"
+
+
+/* The bucket heatmap_hottest reports ADDR in, or NULL. */
+
+static const heat_bucket_t *
+bucket_holding (const std::vector<heat_bucket_t> &buckets, const mem_heatmap_t &heat,
+		heat_segment seg, mem_addr addr)
+{
+  for (const heat_bucket_t &b : buckets)
+    if (b.segment == seg && b.addr <= addr && addr - b.addr < (1u << heat.shift))
+      return &b;
+  return NULL;
+}
+
+
+/* Accesses land in the bucket their offset names, counting the stack
+   down from STACK_TOP, and heatmap_bucket_addr maps each bucket back to
+   the addresses it holds.  Accesses that grow the stack are counted in
+   the buckets the growth adds. */
+
+static void
+test_buckets ()
+{
+  MIPSImage img (0);
+
+  CHECK (load_source (img,
+		      "	.data\n"
+		      "	.globl buf\n"
+		      "buf:	.space 64\n"
+		      "	.text\n"
+		      "	.globl main\n"
+		      "main:	la $t0, buf\n"
+		      "	sw $t1, 20($t0)\n"
+		      "	lb $t3, 47($t0)\n"
+		      "	sw $t1, -8($sp)\n"
+		      "	sb $t1, 0($t2)\n"
+		      "	lw $t3, 0($t4)\n"
+		      "	jr $ra\n"));
+  CHECK (heatmap_enable (img, 16));
+
+  mem_heatmap_t &heat = *img.heatmap();
+  mem_addr buf = find_symbol_address (img, (char *) "buf");
+  mem_addr sp = img.reg_image().R[REG_SP];
+  mem_addr stack_bot = img.mem_image().stack_bot;
+  mem_addr grown_write = stack_bot - 4096 + 3;
+  mem_addr grown_read = stack_bot - 2 * (STACK_TOP - stack_bot);
+
+  CHECK_EQ (heat.reads[HEAT_STACK].size (), (STACK_TOP - stack_bot) / 16);
+  img.reg_image().R[10] = grown_write; /* $t2 */
+  img.reg_image().R[12] = grown_read; /* $t4 */
+  run_program (img);
+  CHECK (img.mem_image().stack_bot <= grown_read);
+  CHECK_EQ (heat.reads[HEAT_STACK].size (), (STACK_TOP - img.mem_image().stack_bot) / 16);
+
+  CHECK_EQ (heat.writes[HEAT_DATA][(buf + 20 - DATA_BOT) >> 4], 1);
+  CHECK_EQ (heat.reads[HEAT_DATA][(buf + 47 - DATA_BOT) >> 4], 1);
+  CHECK_EQ (heat.writes[HEAT_STACK][(STACK_TOP - 1 - (sp - 8)) >> 4], 1);
+  CHECK_EQ (heat.writes[HEAT_STACK][(STACK_TOP - 1 - grown_write) >> 4], 1);
+  CHECK_EQ (heat.reads[HEAT_STACK][(STACK_TOP - 1 - grown_read) >> 4], 1);
+
+  std::vector<heat_bucket_t> buckets = heatmap_hottest (img, 1000);
+  const heat_bucket_t *b;
+
+  CHECK ((b = bucket_holding (buckets, heat, HEAT_DATA, buf + 20)) != NULL && b->writes == 1);
+  CHECK ((b = bucket_holding (buckets, heat, HEAT_DATA, buf + 47)) != NULL && b->reads == 1);
+  CHECK ((b = bucket_holding (buckets, heat, HEAT_STACK, sp - 8)) != NULL && b->writes == 1);
+  CHECK ((b = bucket_holding (buckets, heat, HEAT_STACK, grown_write)) != NULL && b->writes == 1);
+  CHECK ((b = bucket_holding (buckets, heat, HEAT_STACK, grown_read)) != NULL && b->reads == 1);
+}
+
+
+/* A READ_STRING given a length far past the end of memory counts the
+   buckets of the string it stored, and a range written past the end of
+   a segment counts the buckets up to the end. */
+
+static void
+test_write_range_bounds ()
+{
+  MIPSImage img (0);
+  const char *input = "hello\n";
+
+  img.capture_output (1 << 16, false);
+  CHECK (load_source (img,
+		      "	.data\n"
+		      "	.globl buf\n"
+		      "buf:	.space 64\n"
+		      "	.text\n"
+		      "	.globl main\n"
+		      "main:	la $a0, buf\n"
+		      "	li $a1, 0x4000000\n"
+		      "	li $v0, 8\n"
+		      "	syscall\n"
+		      "	jr $ra\n"));
+  CHECK (heatmap_enable (img, 16));
+  push_input (img, input, strlen (input));
+  close_input (img);
+  run_program (img);
+
+  mem_heatmap_t &heat = *img.heatmap();
+  mem_addr buf = find_symbol_address (img, (char *) "buf");
+  mem_addr data_top = img.mem_image().data_top;
+  size_t buckets = heat.writes[HEAT_DATA].size ();
+
+  CHECK_EQ (heat.writes[HEAT_DATA][(buf - DATA_BOT) >> 4], 1);
+  heatmap_write_range (img, data_top - 4, 0x4000000);
+  heatmap_write_range (img, img.mem_image().k_data_top - 4, 0x4000000);
+  CHECK_EQ (heat.writes[HEAT_DATA].size (), buckets);
+  CHECK_EQ (heat.writes[HEAT_DATA][(data_top - 4 - DATA_BOT) >> 4], 1);
+}
+
+
+int
+main ()
+{
+  CHECK (heatmap_bucket_shift (3) < 0);
+  CHECK (heatmap_bucket_shift (128 * K) < 0);
+  CHECK_EQ (heatmap_bucket_shift (4096), 12);
+  test_buckets ();
+  test_write_range_bounds ();
+  return test_result ();
+}
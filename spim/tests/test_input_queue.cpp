@@ -0,0 +1,135 @@
+#include <string.h>
+
+#include <string>
+
+#include "spim.h"
+#include "image.h"
+#include "input_queue.h"
+#include "test.h"
+
+
+static void
+push (MIPSImage &img, const char *text)
+{
+  push_input (img, text, strlen (text));
+}
+
+
+/* read_input reads a line at a time, waits while only part of a line
+   has arrived, and returns the part left at the end of the input. */
+
+static void
+test_lines ()
+{
+  MIPSImage img (0);
+  char buf[16];
+
+  img.capture_output (1 << 16, false);
+  CHECK (!read_input (img, buf, sizeof (buf)));
+  CHECK (img.input_queue().waiting);
+
+  push (img, "one\ntw");
+  CHECK (read_input (img, buf, sizeof (buf)));
+  CHECK (strcmp (buf, "one\n") == 0);
+  CHECK (!img.input_queue().waiting);
+  CHECK (!read_input (img, buf, sizeof (buf)));
+  CHECK (img.input_queue().waiting);
+
+  push (img, "o\nthr");
+  CHECK (read_input (img, buf, sizeof (buf)));
+  CHECK (strcmp (buf, "two\n") == 0);
+
+  close_input (img);
+  CHECK (read_input (img, buf, sizeof (buf)));
+  CHECK (strcmp (buf, "thr") == 0);
+  CHECK (read_input (img, buf, sizeof (buf)));
+  CHECK (strcmp (buf, "") == 0);
+  CHECK (!img.input_queue().waiting);
+}
+
+
+/* A line longer than the buffer is read a buffer at a time, without
+   waiting for its end. */
+
+static void
+test_long_line ()
+{
+  MIPSImage img (0);
+  char buf[4];
+
+  push (img, "abcdefg");
+  CHECK (read_input (img, buf, sizeof (buf)));
+  CHECK (strcmp (buf, "abc") == 0);
+  CHECK (read_input (img, buf, sizeof (buf)));
+  CHECK (strcmp (buf, "def") == 0);
+  CHECK (!read_input (img, buf, sizeof (buf)));
+  push (img, "\n");
+  CHECK (read_input (img, buf, sizeof (buf)));
+  CHECK (strcmp (buf, "g\n") == 0);
+}
+
+
+/* read_input_bytes takes whatever is queued, -1 while nothing is, and
+   0 at the end of the input. */
+
+static void
+test_bytes ()
+{
+  MIPSImage img (0);
+  char buf[8];
+
+  img.capture_output (1 << 16, false);
+  CHECK_EQ (read_input_bytes (img, buf, sizeof (buf)), -1);
+  CHECK (img.input_queue().waiting);
+  push (img, "0123456789");
+  CHECK_EQ (read_input_bytes (img, buf, sizeof (buf)), 8);
+  CHECK (memcmp (buf, "01234567", 8) == 0);
+  CHECK_EQ (read_input_bytes (img, buf, sizeof (buf)), 2);
+  CHECK (memcmp (buf, "89", 2) == 0);
+  CHECK_EQ (read_input_bytes (img, buf, sizeof (buf)), -1);
+  close_input (img);
+  CHECK_EQ (read_input_bytes (img, buf, sizeof (buf)), 0);
+}
+
+
+/* Text that has been read is dropped as more arrives, and what is
+   unread is kept. */
+
+static void
+test_compaction ()
+{
+  MIPSImage img (0);
+  std::string line (100, 'x');
+  char buf[128];
+  int i;
+
+  line += "\n";
+  for (i = 0; i < 200; i ++)
+    {
+      push (img, line.c_str ());
+      push (img, line.c_str ());
+      CHECK (read_input (img, buf, sizeof (buf)));
+      CHECK (buf == line);
+    }
+  CHECK (img.input_queue().data.size () - img.input_queue().head == 200 * line.size ());
+  CHECK (img.input_queue().head <= 4096 + line.size ()
+	 || img.input_queue().head <= img.input_queue().data.size () / 2);
+  for (i = 0; i < 200; i ++)
+    {
+      CHECK (read_input (img, buf, sizeof (buf)));
+      CHECK (buf == line);
+    }
+  push (img, "y\n");
+  CHECK_EQ (img.input_queue().data.size (), 2);
+}
+
+
+int
+main ()
+{
+  test_lines ();
+  test_long_line ();
+  test_bytes ();
+  test_compaction ();
+  return test_result ();
+}
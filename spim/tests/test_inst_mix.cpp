@@ -0,0 +1,40 @@
+#include "spim.h"
+#include "image.h"
+#include "inst_mix.h"
+#include "test.h"
+
+
+/* Counts of a run of echo_int_program that waited PARKED_CYCLES cycles
+   for its input. */
+
+static inst_mix_t
+parked_read (int parked_cycles)
+{
+  MIPSImage img (0);
+
+  img.capture_output (1 << 16, false);
+  CHECK (load_source (img, echo_int_program));
+  inst_mix_enable (img, true);
+  run_parked (img, "7\n", parked_cycles);
+  return img.inst_mix();
+}
+
+
+/* A context parked on a READ re-runs the syscall every cycle until input
+   arrives, but it is counted once. */
+
+int
+main ()
+{
+  if (!inst_mix_available ())
+    return 77;			/* Not compiled in */
+
+  inst_mix_t parked = parked_read (10), unparked = parked_read (0);
+  int cls;
+
+  CHECK_EQ (unparked.by_class[CLASS_SYSCALL], 3);	/* READ_INT, PRINT_INT, exit */
+  for (cls = 0; cls < N_INST_CLASSES; cls ++)
+    CHECK_EQ (parked.by_class[cls], unparked.by_class[cls]);
+  CHECK (parked.by_opcode == unparked.by_opcode);
+  return test_result ();
+}
@@ -0,0 +1,120 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "spim.h"
+#include "image.h"
+#include "inst.h"
+#include "mem.h"
+#include "reg.h"
+#include "spim-utils.h"
+#include "sym-tbl.h"
+#include "kernel_image.h"
+#include "test.h"
+
+
+/* Both images hold the same words in [BOT, TOP), and their instructions
+   print the same, source lines included. */
+
+static void
+check_segment (MIPSImage &assembled, MIPSImage &installed, mem_addr bot, mem_addr top,
+	       bool text)
+{
+  mem_addr addr;
+
+  for (addr = bot; addr < top; addr += BYTES_PER_WORD)
+    {
+      CHECK_EQ (read_mem_word (installed, addr), read_mem_word (assembled, addr));
+      if (text)
+	{
+	  char *a = inst_to_string (assembled, addr);
+	  char *b = inst_to_string (installed, addr);
+
+	  CHECK (strcmp (a, b) == 0);
+	  free (a);
+	  free (b);
+	}
+    }
+}
+
+
+/* The addresses of the instructions and data words waiting for LAB. */
+
+static std::vector<mem_addr>
+uses_of (label *lab)
+{
+  std::vector<mem_addr> addrs;
+
+  for (label_use *u = lab->uses; u != NULL; u = u->next)
+    addrs.push_back (u->addr);
+  std::sort (addrs.begin (), addrs.end ());
+  return addrs;
+}
+
+
+/* Installing the prebuilt exception handler leaves an image as
+   assembling exceptions.s does: the same memory, the same labels, and
+   the same uses of main waiting for the program to define it. */
+
+int
+main ()
+{
+  MIPSImage assembled (0), installed (0);
+
+  initialize_world (assembled, EXCEPTIONS_FILE, false);
+  initialize_world_from_kernel (installed, &default_kernel_image);
+
+  mem_image_t &am = assembled.mem_image(), &im = installed.mem_image();
+  reg_image_t &ar = assembled.reg_image(), &ir = installed.reg_image();
+
+  CHECK_EQ (im.text_top, am.text_top);
+  CHECK_EQ (im.data_top, am.data_top);
+  CHECK_EQ (im.k_text_top, am.k_text_top);
+  CHECK_EQ (im.k_data_top, am.k_data_top);
+  check_segment (assembled, installed, TEXT_BOT, am.text_top, true);
+  check_segment (assembled, installed, K_TEXT_BOT, am.k_text_top, true);
+  check_segment (assembled, installed, DATA_BOT, am.data_top, false);
+  check_segment (assembled, installed, K_DATA_BOT, am.k_data_top, false);
+  CHECK_EQ (ir.next_text_pc, ar.next_text_pc);
+  CHECK_EQ (ir.next_k_text_pc, ar.next_k_text_pc);
+  CHECK_EQ (ir.next_data_pc, ar.next_data_pc);
+  CHECK_EQ (ir.next_k_data_pc, ar.next_k_data_pc);
+  CHECK_EQ (ir.next_gp_item_addr, ar.next_gp_item_addr);
+
+  sym_table_t &at = assembled.symbol_table();
+  int i;
+
+  CHECK (at.n_labels > 0);
+  CHECK_EQ (installed.symbol_table().n_labels, at.n_labels);
+  for (i = 0; i < at.size; i ++)
+    {
+      label *a = at.slots[i].lab, *b;
+
+      if (a == NULL)
+	continue;
+      b = label_is_defined (installed, a->name);
+      CHECK (b != NULL);
+      if (b == NULL)
+	continue;
+      CHECK_EQ (b->addr, a->addr);
+      CHECK_EQ (b->global_flag, a->global_flag);
+      CHECK_EQ (b->const_flag, a->const_flag);
+      CHECK_EQ (b->gp_flag, a->gp_flag);
+      CHECK (uses_of (b) == uses_of (a));
+    }
+
+  label *main_a = label_is_defined (assembled, (char *) "main");
+  label *main_b = label_is_defined (installed, (char *) "main");
+
+  CHECK (main_a != NULL && main_b != NULL);
+  if (main_a != NULL && main_b != NULL)
+    {
+      CHECK (!SYMBOL_IS_DEFINED (main_b));
+      CHECK (!uses_of (main_a).empty ());
+      CHECK (uses_of (main_b) == uses_of (main_a));
+    }
+  return test_result ();
+}
@@ -0,0 +1,169 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "spim.h"
+#include "image.h"
+#include "parser_yacc.h"
+#include "op_tables.h"
+#include "inst.h"
+#include "test.h"
+
+
+/* The entries of op.h, in order. */
+
+static const op_entry_t ops [] = {
+#undef OP
+#define OP(NAME, OPCODE, TYPE, A_OPCODE) {NAME, OPCODE, TYPE, (int32)A_OPCODE},
+#include "op.h"
+};
+
+#define N_OPS	(sizeof (ops) / sizeof (ops[0]))
+
+
+/* Every entry is found by its name and by its opcode, and names that
+   are not in op.h are not found. */
+
+static void
+test_lookup ()
+{
+  size_t i;
+
+  for (i = 0; i < N_OPS; i ++)
+    {
+      const op_entry_t *by_name = op_by_name (ops[i].name);
+      const op_entry_t *by_opcode = op_by_opcode (ops[i].opcode);
+
+      CHECK (by_name != NULL);
+      CHECK (by_opcode != NULL);
+      if (by_name == NULL || by_opcode == NULL)
+	{
+	  fprintf (stderr, "  entry %s\n", ops[i].name);
+	  continue;
+	}
+      CHECK (strcmp (by_name->name, ops[i].name) == 0);
+      CHECK_EQ (by_name->opcode, ops[i].opcode);
+      CHECK_EQ (by_name->type, ops[i].type);
+      CHECK_EQ (by_name->a_opcode, ops[i].a_opcode);
+      CHECK (by_opcode == by_name);
+    }
+
+  CHECK (op_by_name ("addd") == NULL);
+  CHECK (op_by_name ("") == NULL);
+  CHECK (op_by_name (".text2") == NULL);
+  CHECK (op_by_opcode (-1) == NULL);
+}
+
+
+/* The bits of WORD that select its instruction: the primary opcode and,
+   for some primary opcodes, the fields that continue it. */
+
+static uint32
+decoded_bits (uint32 word)
+{
+  switch (word & 0xfc000000)
+    {
+    case 0x00000000:		/* SPECIAL */
+    case 0x70000000:		/* SPECIAL2 */
+      return 0xfc00003f;
+    case 0x04000000:		/* REGIMM */
+      return 0xfc1f0000;
+    case 0x40000000:		/* COP0 */
+      return 0xffe0001f;
+    case 0x44000000:		/* COP1: BC1f/t, or fmt and funct */
+      return ((word & 0xff000000) == 0x45000000) ? 0xffe10000 : 0xffe0003f;
+    case 0x48000000:		/* COPz */
+    case 0x4c000000:
+      return 0xffe00000;
+    default:
+      return 0xfc000000;
+    }
+}
+
+
+/* The entry a decoder finds for WORD: the first whose encoding is the
+   bits of WORD that select an instruction, or NULL. */
+
+static const op_entry_t *
+expected_decode (uint32 word)
+{
+  uint32 key = word & decoded_bits (word);
+  size_t i;
+
+  for (i = 0; i < N_OPS; i ++)
+    if (ops[i].a_opcode != -1 && (uint32) ops[i].a_opcode == key)
+      return &ops[i];
+  return NULL;
+}
+
+
+/* Each entry's encoding (with every other field zero) decodes as the
+   selecting bits say, which is the entry itself unless it has fixed
+   bits the decoder does not look at.  inst_decode builds an instruction
+   that encodes back to the word. */
+
+static void
+test_decode ()
+{
+  MIPSImage img (0);
+  int round_trips = 0;
+  size_t i;
+
+  for (i = 0; i < N_OPS; i ++)
+    {
+      uint32 word = (uint32) ops[i].a_opcode;
+      const op_entry_t *expected = expected_decode (word);
+      const op_entry_t *d = op_decode (word);
+      instruction *inst;
+
+      if (ops[i].a_opcode == -1)
+	continue;
+      CHECK ((d == NULL) == (expected == NULL));
+      if (d == NULL || expected == NULL)
+	continue;
+      CHECK (strcmp (d->name, expected->name) == 0);
+
+      inst = inst_decode (img, word);
+      CHECK_EQ (OPCODE (inst), expected->opcode);
+      if ((word & ~decoded_bits (word)) == 0)
+	{
+	  CHECK_EQ ((uint32) inst_encode (img, inst), word);
+	  round_trips += 1;
+	}
+      free_inst (img, inst);
+    }
+  CHECK (round_trips > 250);
+
+  /* Words that are no instruction decode to nothing. */
+  CHECK (op_decode ((int32) 0xfc000000) == NULL);
+  CHECK (expected_decode (0xfc000000) == NULL);
+}
+
+
+/* Register names give their numbers; anything else is -1. */
+
+static void
+test_registers ()
+{
+  CHECK_EQ (register_by_name ("zero"), 0);
+  CHECK_EQ (register_by_name ("at"), 1);
+  CHECK_EQ (register_by_name ("t0"), 8);
+  CHECK_EQ (register_by_name ("k1"), 27);
+  CHECK_EQ (register_by_name ("kt1"), 27);
+  CHECK_EQ (register_by_name ("sp"), 29);
+  CHECK_EQ (register_by_name ("s8"), 30);
+  CHECK_EQ (register_by_name ("fp"), 30);
+  CHECK_EQ (register_by_name ("ra"), 31);
+  CHECK_EQ (register_by_name ("t10"), -1);
+  CHECK_EQ (register_by_name ("r"), -1);
+  CHECK_EQ (register_by_name (""), -1);
+}
+
+
+int
+main ()
+{
+  test_lookup ();
+  test_decode ();
+  test_registers ();
+  return test_result ();
+}
@@ -0,0 +1,98 @@
+#include <string>
+
+#include "spim.h"
+#include "image.h"
+#include "output_capture.h"
+#include "test.h"
+
+
+/* The ring keeps the last CAPACITY bytes across writes that wrap around
+   its end, and counts the rest as dropped. */
+
+static void
+test_wrap_around ()
+{
+  OutputCapture c (8);
+
+  c.write ("abcde", 5);
+  CHECK (c.contents () == "abcde");
+  CHECK_EQ (c.dropped (), 0);
+
+  c.write ("fghij", 5);
+  CHECK (c.contents (false) == "cdefghij");
+  CHECK_EQ (c.total (), 10);
+  CHECK_EQ (c.dropped (), 2);
+  CHECK (c.contents () == "[... 2 bytes dropped ...]\ncdefghij");
+
+  c.write ("kl", 2);
+  CHECK (c.contents (false) == "efghijkl");
+  c.write ("mnopqrs", 7);
+  CHECK (c.contents (false) == "lmnopqrs");
+  CHECK_EQ (c.dropped (), 11);
+
+  /* A write of the whole capacity or more replaces everything. */
+  c.write ("0123456789", 10);
+  CHECK (c.contents (false) == "23456789");
+  CHECK_EQ (c.total (), 29);
+  CHECK_EQ (c.dropped (), 21);
+  c.write ("ab", 2);
+  CHECK (c.contents (false) == "456789ab");
+}
+
+
+/* The callback sees every write whole, even what the ring drops. */
+
+static void
+test_callback ()
+{
+  OutputCapture c (4);
+  std::string seen;
+
+  c.set_callback ([&seen] (const char *s, std::size_t n) { seen.append (s, n); });
+  c.write ("hello", 5);
+  c.write (", world", 7);
+  CHECK (seen == "hello, world");
+  CHECK (c.contents (false) == "orld");
+}
+
+
+/* A program that prints more than a stop_when_full capture holds has
+   overrun it; one that prints less has not. */
+
+static void
+test_stop_when_full ()
+{
+  MIPSImage small (0), large (0);
+  const std::string program =
+    "	.globl main\n"
+    "main:	li $t0, 100\n"
+    "loop:	li $a0, 12345\n"
+    "	li $v0, 1\n"
+    "	syscall\n"
+    "	addi $t0, $t0, -1\n"
+    "	bnez $t0, loop\n"
+    "	jr $ra\n";
+
+  small.capture_output (64, true);
+  CHECK (load_source (small, program));
+  run_program (small);
+  CHECK (small.output_limit_exceeded ());
+  CHECK_EQ (small.get_std_out_buf()->captured()->total (), 500);
+  CHECK_EQ (small.get_std_out_buf()->captured()->dropped (), 500 - 64);
+
+  large.capture_output (1024, true);
+  CHECK (load_source (large, program));
+  run_program (large);
+  CHECK (!large.output_limit_exceeded ());
+  CHECK_EQ (large.get_std_out_buf()->captured()->dropped (), 0);
+}
+
+
+int
+main ()
+{
+  test_wrap_around ();
+  test_callback ();
+  test_stop_when_full ();
+  return test_result ();
+}
@@ -0,0 +1,118 @@
+#include <stdint.h>
+
+#include <string>
+
+#include "spim.h"
+#include "image.h"
+#include "input_queue.h"
+#include "pipeline_model.h"
+#include "test.h"
+
+
+/* Run SOURCE on a pipeline described by SPEC and return the model. */
+
+static pipeline_t
+run_on_pipeline (const std::string &source, const char *spec)
+{
+  MIPSImage img (0);
+  pipeline_config_t config;
+  std::string problem;
+
+  CHECK (load_source (img, source));
+  CHECK (pipeline_parse_config (spec, config, problem));
+  pipeline_attach (img, config);
+  run_program (img);
+  return *img.pipeline();
+}
+
+
+/* A loop of ten loads, each used by the next instruction or (with
+   SPACER) by the one after that. */
+
+static std::string
+load_use_loop (bool spacer)
+{
+  return std::string ("	.globl main\n"
+		      "main:	li $t2, 10\n"
+		      "loop:	lw $t0, 0($sp)\n")
+    + (spacer ? "	nop\n" : "")
+    + "	addu $t1, $t0, $t0\n"
+      "	addi $t2, $t2, -1\n"
+      "	bnez $t2, loop\n"
+      "	jr $ra\n";
+}
+
+
+/* With forwarding a use right after a load waits a cycle for MEM;
+   without, it waits two for WB.  One instruction in between hides the
+   forwarded load.  (The startup code's own stalls cancel out.) */
+
+static void
+test_load_use ()
+{
+  pipeline_t tight = run_on_pipeline (load_use_loop (false), "");
+  pipeline_t spaced = run_on_pipeline (load_use_loop (true), "");
+
+  CHECK_EQ (tight.load_use_stalls - spaced.load_use_stalls, 10);
+  CHECK_EQ (tight.data_stalls, spaced.data_stalls);
+
+  tight = run_on_pipeline (load_use_loop (false), "forwarding=no");
+  spaced = run_on_pipeline (load_use_loop (true), "forwarding=no");
+  CHECK_EQ (tight.load_use_stalls - spaced.load_use_stalls, 10);
+}
+
+
+/* A mult right after a mul waits for the unit, though it does not read
+   mul's result; mflo then waits for the mult. */
+
+static void
+test_muldiv_unit ()
+{
+  pipeline_t pl = run_on_pipeline ("	.globl main\n"
+				   "main:	mul $t0, $t1, $t2\n"
+				   "	mult $t3, $t4\n"
+				   "	mflo $t5\n"
+				   "	jr $ra\n",
+				   "mult=4");
+  pipeline_t base = run_on_pipeline ("	.globl main\n"
+				     "main:	jr $ra\n",
+				     "mult=4");
+
+  /* mult enters EX 4 cycles after mul, 3 later than it could have;
+     mflo enters EX 4 cycles after mult, 3 later again. */
+  CHECK_EQ (pl.muldiv_stalls - base.muldiv_stalls, 6);
+}
+
+
+/* A context parked on a READ issues the syscall again every cycle; the
+   model counts it once, as if input had been there. */
+
+static pipeline_t
+parked_read (int parked_cycles)
+{
+  MIPSImage img (0);
+  pipeline_config_t config;
+  std::string problem;
+
+  img.capture_output (1 << 16, false);
+  CHECK (load_source (img, echo_int_program));
+  CHECK (pipeline_parse_config ("", config, problem));
+  pipeline_attach (img, config);
+  run_parked (img, "7\n", parked_cycles);
+  CHECK (!img.input_queue().waiting);
+  return *img.pipeline();
+}
+
+
+int
+main ()
+{
+  test_load_use ();
+  test_muldiv_unit ();
+
+  pipeline_t prompt = parked_read (0), parked = parked_read (10);
+  CHECK (prompt.instructions > 0);
+  CHECK_EQ (parked.instructions, prompt.instructions);
+  CHECK_EQ (pipeline_cycles (parked), pipeline_cycles (prompt));
+  return test_result ();
+}
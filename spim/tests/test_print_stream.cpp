@@ -0,0 +1,114 @@
+#include <stdarg.h>
+
+#include <memory>
+#include <sstream>
+#include <string>
+
+#include "image_print_stream.h"
+#include "output_capture.h"
+#include "test.h"
+
+
+static void
+print (MIPSImagePrintStream &stream, const char *fmt, ...)
+{
+  va_list args;
+
+  va_start (args, fmt);
+  stream.vprintf (fmt, args);
+  va_end (args);
+}
+
+
+/* Writes longer than the buffer are posted a full buffer at a time, in
+   order; the rest stays in the buffer until a flush. */
+
+static void
+test_bulk_writes ()
+{
+  std::ostringstream sink;
+  MIPSImagePrintStream stream (0, sink, 8);
+  std::string text = "abcdefghijklmnopqrstu";
+
+  stream.sputn (text.data (), text.size ());
+  CHECK (sink.str () == text.substr (0, 16));
+  stream.pubsync ();
+  CHECK (sink.str () == text);
+
+  /* A character at a time: the one that does not fit goes out with the
+     full buffer. */
+  sink.str ("");
+  for (char c : text)
+    stream.sputc (c);
+  CHECK (sink.str () == text.substr (0, 18));
+  stream.pubsync ();
+  CHECK (sink.str () == text);
+}
+
+
+/* printf output goes into the buffer, and output longer than the whole
+   buffer still comes out after what was buffered before it. */
+
+static void
+test_vprintf ()
+{
+  std::ostringstream sink;
+  MIPSImagePrintStream stream (0, sink, 8);
+
+  print (stream, "%s", "ab");
+  print (stream, "%d-%d", 123, 456);
+  print (stream, "[%s]", "a string longer than the buffer");
+  stream.pubsync ();
+  CHECK (sink.str () == "ab123-456[a string longer than the buffer]");
+}
+
+
+/* A finished line is posted at once if nothing was posted lately, and
+   otherwise waits for a flush. */
+
+static void
+test_coalesced_lines ()
+{
+  std::ostringstream sink;
+  MIPSImagePrintStream stream (0, sink, 4096);
+
+  stream.sputn ("one\n", 4);
+  CHECK (sink.str () == "one\n");
+  stream.sputn ("two\n", 4);
+  stream.sputn ("three", 5);
+  CHECK (sink.str () == "one\n");
+  stream.pubsync ();
+  CHECK (sink.str () == "one\ntwo\nthree");
+}
+
+
+/* With a capture, output goes to it and not the sink, in order. */
+
+static void
+test_capture ()
+{
+  std::ostringstream sink;
+  MIPSImagePrintStream stream (0, sink, 8);
+
+  stream.sputn ("before ", 7);
+  stream.capture_to (std::unique_ptr<OutputCapture> (new OutputCapture (1024)));
+  CHECK (sink.str () == "before ");
+  stream.sputc ('x');
+  print (stream, "%d", 42);
+  stream.sputn (" and a long write", 17);
+  stream.sputc ('!');
+  CHECK (stream.captured () != nullptr);
+  CHECK (stream.captured ()->contents () == "x42 and a long write!");
+  CHECK (sink.str () == "before ");
+}
+
+
+int
+main ()
+{
+  test_bulk_writes ();
+  test_vprintf ();
+  test_coalesced_lines ();
+  test_capture ();
+  return test_result ();
+}
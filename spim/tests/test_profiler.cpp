@@ -0,0 +1,100 @@
+#include <stdint.h>
+
+#include <string>
+
+#include "spim.h"
+#include "image.h"
+#include "input_queue.h"
+#include "pipeline_model.h"
+#include "profiler.h"
+#include "test.h"
+
+
+static uint64_t
+total_self (MIPSImage &img)
+{
+  uint64_t total = 0;
+
+  for (const profile_node_t &node : img.profile().nodes)
+    total += node.self;
+  return total;
+}
+
+
+/* A context parked on a READ re-runs the syscall every cycle until input
+   arrives; the profile counts it once, as if input had been there. */
+
+static uint64_t
+parked_read (int parked_cycles)
+{
+  MIPSImage img (0);
+
+  img.capture_output (1 << 16, false);
+  CHECK (load_source (img, echo_int_program));
+  profile_enable (img, true);
+  run_parked (img, "7\n", parked_cycles);
+  CHECK (!img.input_queue().waiting);
+  CHECK_EQ (img.get_std_out_buf()->captured()->contents ().compare ("7"), 0);
+  return total_self (img);
+}
+
+
+/* An exception raised fetching an instruction enters the handler as
+   the profiler's callee, so its eret does not pop the function that
+   jumped to the bad address. */
+
+static void
+test_fetch_exception ()
+{
+  MIPSImage img (0);
+
+  img.capture_output (1 << 16, false);
+  CHECK (load_source (img,
+		      "	.globl main\n"
+		      "main:	jal f\n"
+		      "	jr $ra\n"
+		      "f:	li $t0, 0x00500000\n"
+		      "	jr $t0\n"));
+  profile_enable (img, true);
+  run_program (img, 500);
+  /* The handler returns past the bad address, which is bad too, so
+     this repeats: the root, main and f stay on the stack throughout. */
+  CHECK (img.profile().stack.size () >= 3);
+  CHECK_EQ (img.profile().lost_frames, 0);
+}
+
+
+/* The step that exits, or stops at a debugger breakpoint, is counted
+   like any other, by the profile and the pipeline alike. */
+
+static void
+test_last_step (const char *last)
+{
+  MIPSImage img (0);
+  pipeline_config_t config;
+  std::string problem;
+
+  CHECK (load_source (img,
+		      std::string ("	.globl main\n"
+				   "main:	li $t0, 1\n"
+				   "	li $v0, 10\n")
+		      + last));
+  CHECK (pipeline_parse_config ("", config, problem));
+  pipeline_attach (img, config);
+  profile_enable (img, true);
+  long steps = run_program (img);
+  CHECK_EQ (total_self (img), (uint64_t) steps);
+  CHECK_EQ (img.pipeline()->instructions, (uint64_t) steps);
+}
+
+
+int
+main ()
+{
+  CHECK (parked_read (0) > 0);
+  CHECK_EQ (parked_read (10), parked_read (0));
+  test_fetch_exception ();
+  test_last_step ("	syscall\n");
+  test_last_step ("	break 1\n");
+  return test_result ();
+}
@@ -0,0 +1,47 @@
+#include <string>
+
+#include "spim.h"
+#include "image.h"
+#include "test.h"
+
+
+static std::string
+load_errors (const std::string &source)
+{
+  MIPSImage img (0);
+
+  img.capture_output (1 << 16, false);
+  CHECK (load_source (img, source));
+  return img.get_std_err_buf()->captured()->contents ();
+}
+
+
+/* A program whose assembly printed anything, even a warning from
+   outside the parser, is not cached, so loading it again prints the
+   message again. */
+
+int
+main ()
+{
+  const std::string parser_warns = "main:	andi $t0, $t0, -1\n	jr $ra\n";
+  const std::string label_warns = "main:	j far\n	.ktext\nfar:	nop\n";
+  const std::string clean = "main:	andi $t0, $t0, 1\n	jr $ra\n";
+
+  CHECK (load_errors (parser_warns).find ("out of range") != std::string::npos);
+  CHECK (load_errors (parser_warns).find ("out of range") != std::string::npos);
+  CHECK (load_errors (label_warns).find ("high-order 4 bits") != std::string::npos);
+  CHECK (load_errors (label_warns).find ("high-order 4 bits") != std::string::npos);
+
+  CHECK (load_errors (clean).empty ());
+  CHECK (load_errors (clean).empty ());
+
+  /* Messages printed while the program runs are not the assembler's. */
+  MIPSImage img (0);
+
+  img.capture_output (1 << 16, false);
+  CHECK (load_source (img, clean));
+  CHECK_EQ (img.assembler().diagnostic_count, 0);
+  error (img, "Execution finished\n");
+  CHECK_EQ (img.assembler().diagnostic_count, 0);
+  return test_result ();
+}
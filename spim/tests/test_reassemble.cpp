@@ -0,0 +1,77 @@
+#include <string>
+
+#include "spim.h"
+#include "image.h"
+#include "reg.h"
+#include "spim-utils.h"
+#include "program_cache.h"
+#include "kernel_image.h"
+#include "sym-tbl.h"
+#include "test.h"
+
+
+/* Load PATH as a reset does, run it, and return $t0. */
+
+static reg_word
+run_file (const std::string &path, std::string *err)
+{
+  MIPSImage img (0);
+
+  img.capture_output (1 << 16, false);
+  CHECK (load_program_cached (img, &default_kernel_image, path.c_str ()));
+  initialize_run_stack (img, 0, nullptr);
+  img.reg_image().PC = starting_address (img);
+  run_program (img);
+
+  /* Local labels were flushed; globals were not. */
+  CHECK (label_is_defined (img, (char *) "loop") == NULL);
+  CHECK (label_is_defined (img, (char *) "done") == NULL);
+  CHECK (find_symbol_address (img, (char *) "main") != 0);
+  *err = img.get_std_err_buf()->captured()->contents ();
+  return img.reg_image().R[8];
+}
+
+
+static std::string
+program (const char *step, const char *loop_line)
+{
+  return std::string ("	.globl main\n"
+		      "main:	li $t0, 0\n"
+		      "	li $t1, 12\n")
+    + loop_line + "\n"
+    + "	addi $t0, $t0, " + step + "\n"
+    + "	blt $t0, $t1, loop\n"
+    + "done:	jr $ra\n";
+}
+
+
+/* Editing the region that defines a local label reassembles just that
+   region, with the label defined again, and flushes it afterwards. */
+
+int
+main ()
+{
+  const std::string path = "test_reassemble.s";
+  std::string err;
+
+  write_source (path.c_str (), program ("1", "loop:	nop"));
+  CHECK_EQ (run_file (path, &err), 12);
+  CHECK (err.empty ());
+
+  write_source (path.c_str (), program ("4", "loop:	nop"));
+  CHECK_EQ (run_file (path, &err), 12);
+  CHECK (err.empty ());
+
+  write_source (path.c_str (), program ("5", "loop:	nop"));
+  CHECK_EQ (run_file (path, &err), 15);
+  CHECK (err.empty ());
+
+  /* An edit that fails to parse is reported, and the label it no longer
+     defines is still flushed. */
+  write_source (path.c_str (), program ("5", "loop:	nop $t0"));
+  run_file (path, &err);
+  CHECK (!err.empty ());
+
+  remove (path.c_str ());
+  return test_result ();
+}
@@ -0,0 +1,97 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+#include "spim.h"
+#include "image.h"
+#include "string-stream.h"
+#include "inst.h"
+#include "mem.h"
+#include "sym-tbl.h"
+#include "source_table.h"
+#include "test.h"
+
+
+/* The line with id ID, as format_source_line prints it. */
+
+static std::string
+formatted (MIPSImage &img, unsigned id)
+{
+  str_stream ss;
+  char *s;
+
+  format_source_line (img, &ss, id);
+  s = ss_to_string (img, &ss);
+  std::string line (s);
+  free (s);
+  return line;
+}
+
+
+/* Lines are kept once per file, in the order they were added, and ids
+   count up from 1.  Only LEN characters of the text are kept. */
+
+static void
+test_lines ()
+{
+  MIPSImage img (0);
+  const char *text = "	addi $t0, $t0, 1  # and the rest";
+  unsigned a = intern_source_line (img, "a.s", 3, text, 17);
+  unsigned b = intern_source_line (img, "b.s", 1, "	nop", 4);
+  unsigned c = intern_source_line (img, "a.s", 4, "	jr $ra", 7);
+  source_table_t &tbl = img.source_table();
+
+  CHECK_EQ (a, 1);
+  CHECK_EQ (b, 2);
+  CHECK_EQ (c, 3);
+  CHECK_EQ (tbl.files.size (), 2);
+  CHECK (tbl.files[0].text == std::string ("	addi $t0, $t0, 1\0	jr $ra\0", 26));
+
+  CHECK (source_line_string (img, a) == "a.s:3: 	addi $t0, $t0, 1");
+  CHECK (source_line_string (img, b) == "b.s:1: 	nop");
+  CHECK (source_line_string (img, c) == "a.s:4: 	jr $ra");
+  CHECK (formatted (img, c) == source_line_string (img, c));
+
+  /* Id 0 is "no source", and ids past the last line are not lines. */
+  CHECK (find_source_line (img, 0) == NULL);
+  CHECK (find_source_line (img, 4) == NULL);
+  CHECK (source_line_string (img, 0).empty ());
+  CHECK (formatted (img, 4).empty ());
+  CHECK_EQ (find_source_line (img, b)->file, 1);
+  CHECK_EQ (find_source_line (img, c)->line_no, 4);
+}
+
+
+/* Assembled instructions refer to the lines they came from. */
+
+static void
+test_assembled ()
+{
+  MIPSImage img (0);
+
+  CHECK (load_source (img,
+		      "	.text\n"
+		      "	.globl main\n"
+		      "main:	addi $t0, $zero, 5\n"
+		      "	jr $ra\n"));
+
+  mem_addr main_addr = find_symbol_address (img, (char *) "main");
+  instruction *inst = read_mem_inst (img, main_addr);
+  std::string line;
+
+  CHECK (inst != NULL && SOURCE (inst) != 0);
+  if (inst == NULL)
+    return;
+  line = source_line_string (img, SOURCE (inst));
+  CHECK (line.find (":3: addi $t0, $zero, 5") != std::string::npos);
+}
+
+
+int
+main ()
+{
+  test_lines ();
+  test_assembled ();
+  return test_result ();
+}
@@ -0,0 +1,68 @@
+#include <stdint.h>
+
+#include <chrono>
+#include <set>
+#include <string>
+#include <thread>
+
+#include "worker.h"
+#include "test.h"
+
+
+/* A program that exits with STATUS after the same number of steps,
+   whatever STATUS is. */
+
+static std::string
+exit_program (int status)
+{
+  return "	.text\n"
+	 "	.globl main\n"
+	 "main:	li $t0, 1\n"
+	 "	li $a0, " + std::to_string (status) + "\n"
+	 "	li $v0, 17\n"
+	 "	syscall\n";
+}
+
+
+/* Run two contexts to the end through the worker, then read back each
+   context's PC, finished flag and exit status from its words of the
+   status block. */
+
+int
+main ()
+{
+  const int statuses[NUM_CONTEXTS] = {7, 9};
+  std::set<unsigned int> active;
+
+  for (unsigned int i = 0; i < NUM_CONTEXTS; i ++)
+    {
+      write_source (("input_" + std::to_string (i) + ".s").c_str (), exit_program (statuses[i]));
+      active.insert (i);
+    }
+  start_simulator (NUM_CONTEXTS, active);
+  CHECK_EQ (ctxs.size (), NUM_CONTEXTS);
+  CHECK_EQ (status_block[0].load (), RUN_STATE_STOPPED);
+  for (unsigned int i = 0; i < NUM_CONTEXTS; i ++)
+    {
+      CHECK_EQ (status_block[STATUS_CTX_BASE + 3 * i].load (), ctxs.at (i).regview_image().PC);
+      CHECK_EQ (status_block[STATUS_CTX_BASE + 3 * i + 1].load (), 0);
+    }
+
+  play_simulation ();
+  auto deadline = std::chrono::steady_clock::now () + std::chrono::seconds (30);
+  while (status_block[0].load () != RUN_STATE_FINISHED
+	 && std::chrono::steady_clock::now () < deadline)
+    std::this_thread::sleep_for (std::chrono::milliseconds (1));
+  shutdown ();
+
+  CHECK_EQ (status_block[0].load (), RUN_STATE_FINISHED);
+  CHECK (status_block[1].load () > 0);
+  CHECK_EQ (status_block[2].load (), 0);
+  for (unsigned int i = 0; i < NUM_CONTEXTS; i ++)
+    {
+      CHECK_EQ (status_block[STATUS_CTX_BASE + 3 * i].load (), ctxs.at (i).regview_image().PC);
+      CHECK_EQ (status_block[STATUS_CTX_BASE + 3 * i + 1].load (), 1);
+      CHECK_EQ (status_block[STATUS_CTX_BASE + 3 * i + 2].load (), statuses[i]);
+    }
+  return test_result ();
+}
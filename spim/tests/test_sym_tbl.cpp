@@ -0,0 +1,112 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "spim.h"
+#include "image.h"
+#include "sym-tbl.h"
+#include "test.h"
+
+
+/* Interning names keeps the table at most 3/4 full, doubling it when
+   the next name would pass that, and every name keeps its one copy. */
+
+static void
+test_growth ()
+{
+  MIPSImage img (0);
+  sym_table_t &tbl = img.symbol_table();
+  std::vector<char *> interned;
+  int grew = 0;
+  int i;
+
+  for (i = 0; i < 4 * SYM_TABLE_INITIAL_SIZE; i ++)
+    {
+      char name[32];
+      int size = tbl.size;
+      int n_names = tbl.n_names;
+
+      snprintf (name, sizeof (name), "name_%d", i);
+      interned.push_back (intern_name (img, name));
+      CHECK_EQ (tbl.n_names, n_names + 1);
+      CHECK (4 * tbl.n_names <= 3 * tbl.size);
+      CHECK_EQ (tbl.size & (tbl.size - 1), 0);
+      if (tbl.size != size)
+	{
+	  CHECK (size == 0 || tbl.size == 2 * size);
+	  CHECK (size == 0 || 4 * (n_names + 1) > 3 * size);
+	  grew += 1;
+	}
+    }
+  CHECK (grew >= 3);
+
+  /* The names moved to new slots, but are still found, as themselves. */
+  for (i = 0; i < (int) interned.size (); i ++)
+    {
+      char name[32];
+      int n_names = tbl.n_names;
+
+      snprintf (name, sizeof (name), "name_%d", i);
+      CHECK (intern_name (img, name) == interned[i]);
+      CHECK (strcmp (interned[i], name) == 0);
+      CHECK_EQ (tbl.n_names, n_names);
+    }
+}
+
+
+/* find_label_before finds the nearest label below an address, whichever
+   segment it is in, and the first of several at one address. */
+
+static void
+test_label_before ()
+{
+  MIPSImage img (0);
+
+  CHECK (load_source (img,
+		      "	.data\n"
+		      "	.globl d1\n"
+		      "d1:	.word 1, 2\n"
+		      "	.globl d2\n"
+		      "d2:\n"
+		      "	.globl d2_alias\n"
+		      "d2_alias: .word 3\n"
+		      "	.text\n"
+		      "	.globl main\n"
+		      "main:	nop\n"
+		      "	.globl last\n"
+		      "last:	jr $ra\n"));
+
+  mem_addr d1 = find_symbol_address (img, (char *) "d1");
+  mem_addr d2 = find_symbol_address (img, (char *) "d2");
+  mem_addr last = find_symbol_address (img, (char *) "last");
+  label *l;
+
+  CHECK ((l = find_label_before (img, d1 + 4)) != NULL && strcmp (l->name, "d1") == 0);
+  CHECK ((l = find_label_before (img, d2)) != NULL && strcmp (l->name, "d2") == 0);
+  CHECK ((l = find_label_before (img, d2 + 100)) != NULL && strcmp (l->name, "d2") == 0);
+  CHECK (find_label_at (img, d2 + 4) == NULL);
+
+  /* Below the data segment, the nearest label is the text's last. */
+  CHECK ((l = find_label_before (img, DATA_BOT - 4)) != NULL && strcmp (l->name, "last") == 0);
+  CHECK ((l = find_label_at (img, last)) != NULL && strcmp (l->name, "last") == 0);
+
+  /* The exception handler's labels, local ones too, are above both. */
+  mem_addr k_text_top = img.mem_image().k_text_top;
+
+  CHECK ((l = find_label_before (img, k_text_top - 4)) != NULL
+	 && (mem_addr) l->addr >= K_TEXT_BOT && (mem_addr) l->addr < k_text_top);
+  CHECK ((l = find_label_before (img, img.mem_image().k_data_top - 4)) != NULL
+	 && (mem_addr) l->addr >= K_DATA_BOT);
+  CHECK (find_label_before (img, 0) == NULL);
+}
+
+
+int
+main ()
+{
+  test_growth ();
+  test_label_before ();
+  return test_result ();
+}
@@ -0,0 +1,268 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "spim.h"
+#include "image.h"
+#include "mem.h"
+#include "spim-utils.h"
+#include "input_queue.h"
+#include "sym-tbl.h"
+#include "exec_trace.h"
+#include "test.h"
+
+
+/* Branches both ways, a call, stores of each size into the data
+   segment and the stack, HI/LO, and a syscall that fills a buffer. */
+
+static const char *const traced_program =
+  "	.data\n"
+  "	.globl buf\n"
+  "buf:	.space 16\n"
+  "	.text\n"
+  "	.globl main\n"
+  "main:	addi $sp, $sp, -8\n"
+  "	sw $ra, 4($sp)\n"
+  "	li $t0, 3\n"
+  "loop:	sb $t0, -1($sp)\n"
+  "	sh $t0, -4($sp)\n"
+  "	addi $t0, $t0, -1\n"
+  "	bnez $t0, loop\n"
+  "	jal f\n"
+  "	la $a0, buf\n"
+  "	li $a1, 16\n"
+  "	li $v0, 8\n"
+  "	syscall\n"
+  "	li $t1, -123456\n"
+  "	li $t2, 1000\n"
+  "	mult $t1, $t2\n"
+  "	la $t3, buf\n"
+  "	sw $t1, 12($t3)\n"
+  "	lw $ra, 4($sp)\n"
+  "	addi $sp, $sp, 8\n"
+  "	jr $ra\n"
+  "f:	li $v1, 0x7fffffff\n"
+  "	jr $ra\n";
+
+
+typedef struct expected_step {
+  mem_addr pc;
+  reg_word regs[TRACE_N_REGS];
+} expected_step_t;
+
+
+/* Run traced_program, tracing it into PATH (or memory if it is empty),
+   and note the PC and registers of every step.  Return the trace if it
+   was kept in memory. */
+
+static std::string
+record (MIPSImage &img, const char *path, std::vector<expected_step_t> &expected)
+{
+  const char *input = "hello\n";
+  bool continuable = true;
+
+  img.capture_output (1 << 16, false);
+  CHECK (load_source (img, traced_program));
+  push_input (img, input, strlen (input));
+  close_input (img);
+  CHECK (trace_start (img, path));
+  while (continuable)
+    {
+      expected_step_t e;
+      reg_image_t &reg = img.reg_image();
+
+      e.pc = reg.PC;
+      step_program (img, false, false, &continuable);
+      memcpy (e.regs, reg.R, R_LENGTH * sizeof (reg_word));
+      e.regs[TRACE_HI] = reg.HI;
+      e.regs[TRACE_LO] = reg.LO;
+      expected.push_back (e);
+    }
+  return trace_stop (img);
+}
+
+
+/* Reading a trace back gives the PC and general registers of every
+   step, and its stores rebuild what the program wrote to memory. */
+
+static void
+test_round_trip ()
+{
+  MIPSImage img (0);
+  std::vector<expected_step_t> expected;
+  std::string data = record (img, "", expected);
+  std::map<mem_addr, char> written;
+  trace_reader_t r;
+  trace_step_t step;
+  size_t n = 0;
+
+  CHECK (trace_open (r, data));
+  CHECK_EQ (r.ctx, 0);
+  while (trace_next (r, step))
+    {
+      if (n < expected.size ())
+	{
+	  const expected_step_t &e = expected[n];
+	  int i;
+
+	  CHECK_EQ (step.pc, e.pc);
+	  for (i = 0; i < R_LENGTH; i ++)
+	    CHECK_EQ (r.regs[i], e.regs[i]);
+	  CHECK_EQ (r.regs[TRACE_HI], e.regs[TRACE_HI]);
+	  CHECK_EQ (r.regs[TRACE_LO], e.regs[TRACE_LO]);
+	}
+      for (const trace_store_t &s : step.stores)
+	for (size_t i = 0; i < s.bytes.size (); i ++)
+	  written[s.addr + (mem_addr) i] = s.bytes[i];
+      n += 1;
+    }
+  CHECK (!r.error);
+  CHECK_EQ (n, expected.size ());
+  CHECK_EQ (r.steps, n);
+
+  /* buf's text, the word after it, $ra and the loop's bytes on the
+     stack. */
+  CHECK (written.size () >= 6 + 4 + 4 + 3);
+  for (const auto &[addr, byte] : written)
+    CHECK_EQ ((unsigned char) byte, (unsigned char) read_mem_byte (img, addr));
+}
+
+
+/* A trace written to a file is the one kept in memory. */
+
+static void
+test_file ()
+{
+  MIPSImage in_memory (0), in_file (0);
+  std::vector<expected_step_t> expected;
+  const char *path = "test_trace.trc";
+  std::string data = record (in_memory, "", expected);
+  std::string from_file;
+  char buf[4096];
+  size_t n;
+
+  CHECK (record (in_file, path, expected).empty ());
+  FILE *f = fopen (path, "rb");
+  CHECK (f != NULL);
+  if (f == NULL)
+    return;
+  while ((n = fread (buf, 1, sizeof (buf), f)) > 0)
+    from_file.append (buf, n);
+  fclose (f);
+  remove (path);
+  CHECK (from_file == data);
+}
+
+
+/* A trace that is not one, or that breaks off inside a step, is an
+   error; one that stops between steps just ends. */
+
+static void
+test_malformed ()
+{
+  MIPSImage img (0);
+  std::vector<expected_step_t> expected;
+  std::string data = record (img, "", expected);
+  std::string not_a_trace = "SPIMTRC0" + data.substr (8);
+  std::string bad_tag = data;
+  trace_reader_t r;
+  trace_step_t step;
+
+  CHECK (!trace_open (r, not_a_trace));
+
+  /* Stop reading after the first step, then end the trace there. */
+  CHECK (trace_open (r, data));
+  CHECK (trace_next (r, step));
+  std::string one_step = data.substr (0, r.pos);
+  std::string cut = data.substr (0, r.pos + 1);
+
+  CHECK (trace_open (r, one_step));
+  CHECK (trace_next (r, step));
+  CHECK (!trace_next (r, step));
+  CHECK (!r.error);
+
+  bad_tag[one_step.size ()] = (char) (TRACE_END | 1);
+  CHECK (trace_open (r, bad_tag));
+  CHECK (trace_next (r, step));
+  CHECK (!trace_next (r, step));
+  CHECK (r.error);
+
+  /* The second step's tag announces a change that is not there. */
+  if ((unsigned char) data[one_step.size ()] != 0)
+    {
+      CHECK (trace_open (r, cut));
+      CHECK (trace_next (r, step));
+      CHECK (!trace_next (r, step));
+      CHECK (r.error);
+    }
+}
+
+
+/* A READ_STRING given a length far past the end of memory records only
+   the string it stored, and a range written past the end of a segment
+   is recorded up to the end. */
+
+static void
+test_read_string_bounds ()
+{
+  MIPSImage img (0);
+  const char *input = "hello\n";
+
+  img.capture_output (1 << 16, false);
+  CHECK (load_source (img,
+		      "	.data\n"
+		      "	.globl buf\n"
+		      "buf:	.space 16\n"
+		      "	.text\n"
+		      "	.globl main\n"
+		      "main:	la $a0, buf\n"
+		      "	li $a1, 0x4000000\n"
+		      "	li $v0, 8\n"
+		      "	syscall\n"
+		      "	jr $ra\n"));
+  push_input (img, input, strlen (input));
+  close_input (img);
+  CHECK (trace_start (img, ""));
+  run_program (img);
+
+  mem_image_t &mem = img.mem_image();
+  mark_mem_dirty (img, mem.data_top - 4, 0x4000000);
+  CHECK_EQ (img.tracer()->stores.size (), 1);
+  CHECK_EQ (img.tracer()->stores[0].addr, mem.data_top - 4);
+  CHECK_EQ (img.tracer()->stores[0].bytes.size (), 4);
+
+  std::string data = trace_stop (img);
+  mem_addr buf = find_symbol_address (img, (char *) "buf");
+  trace_reader_t r;
+  trace_step_t step;
+  int strings = 0;
+
+  CHECK (trace_open (r, data));
+  while (trace_next (r, step))
+    for (const trace_store_t &st : step.stores)
+      {
+	CHECK (st.addr + st.bytes.size () <= mem.data_top || st.addr >= mem.stack_bot);
+	if (st.addr == buf)
+	  {
+	    CHECK (st.bytes == std::string ("hello\n", 7));
+	    strings += 1;
+	  }
+      }
+  CHECK (!r.error);
+  CHECK_EQ (strings, 1);
+}
+
+
+int
+main ()
+{
+  test_round_trip ();
+  test_file ();
+  test_malformed ();
+  test_read_string_bounds ();
+  return test_result ();
+}
@@ -0,0 +1,67 @@
+#include "spim.h"
+#include "image.h"
+#include "mem.h"
+#include "reg.h"
+#include "sym-tbl.h"
+#include "vfs.h"
+#include "test.h"
+
+
+/* READ copies a file into data memory and marks what it filled, but
+   refuses a buffer in the text segment, which holds decoded
+   instructions rather than bytes. */
+
+int
+main ()
+{
+  MIPSImage img (0);
+
+  CHECK (load_source (img,
+		      "	.globl buf\n"
+		      "	.data\n"
+		      "name:	.asciiz \"in.txt\"\n"
+		      "	.align 2\n"
+		      "buf:	.space 16\n"
+		      "	.text\n"
+		      "main:	la $a0, name\n"
+		      "	li $a1, 0\n"
+		      "	li $v0, 13\n"
+		      "	syscall\n"
+		      "	move $s0, $v0\n"
+		      "	move $a0, $s0\n"
+		      "	la $a1, buf\n"
+		      "	li $a2, 16\n"
+		      "	li $v0, 14\n"
+		      "	syscall\n"
+		      "	move $s1, $v0\n"
+		      "	move $a0, $s0\n"
+		      "	la $a1, main\n"
+		      "	li $a2, 4\n"
+		      "	li $v0, 14\n"
+		      "	syscall\n"
+		      "	move $s2, $v0\n"
+		      "	li $a1, 0x7ffffffe\n"
+		      "	li $v0, 14\n"
+		      "	syscall\n"
+		      "	move $s3, $v0\n"
+		      "	jr $ra\n"));
+  vfs_write_file (img, "in.txt", "abcdef");
+  clear_mem_dirty (img);
+
+  mem_addr buf = find_symbol_address (img, (char *) "buf");
+  mem_addr main_addr = find_symbol_address (img, (char *) "main");
+  instruction *first = read_mem_inst (img, main_addr);
+
+  run_program (img);
+  CHECK (img.reg_image().R[16] >= VFS_FIRST_FD);
+  CHECK_EQ (img.reg_image().R[17], 6);
+  CHECK_EQ (read_mem_word (img, buf), 0x64636261);
+  CHECK_EQ (img.mem_image().data_dirty.lo, buf);
+  CHECK_EQ (img.mem_image().data_dirty.hi, buf + 6);
+
+  /* Into the text segment, or across the top of the stack */
+  CHECK_EQ (img.reg_image().R[18], -1);
+  CHECK (read_mem_inst (img, main_addr) == first);
+  CHECK_EQ (img.reg_image().R[19], -1);
+  return test_result ();
+}
@@ -0,0 +1,75 @@
+#include <limits.h>
+#include <stdio.h>
+
+#include <string>
+
+#include "spim.h"
+#include "image.h"
+#include "test.h"
+
+
+/* What IMG has printed so far. */
+
+static std::string
+printed (MIPSImage &img)
+{
+  return img.get_std_out_buf()->captured()->contents ();
+}
+
+
+/* The print syscalls' fast paths print what printf would. */
+
+static void
+test_fast_paths ()
+{
+  const int32 ints[] = {0, 7, -7, 10, 1234567890, INT_MAX, INT_MIN};
+  const uint32 hexes[] = {0, 0xf, 0x10, 0xdeadbeef, 0xffffffff};
+  MIPSImage img (0);
+  std::string expected;
+  char buf[32];
+
+  img.capture_output (1 << 16, false);
+  for (int32 v : ints)
+    {
+      write_output_int (img, v);
+      write_output_char (img, ' ');
+      snprintf (buf, sizeof (buf), "%d ", v);
+      expected += buf;
+    }
+  for (uint32 v : hexes)
+    {
+      write_output_hex (img, v);
+      write_output_char (img, '\n');
+      snprintf (buf, sizeof (buf), "%x\n", v);
+      expected += buf;
+    }
+  CHECK (printed (img) == expected);
+}
+
+
+/* write_output and error() format in place, however long the output. */
+
+static void
+test_formatted ()
+{
+  MIPSImage img (0);
+  std::string long_arg (10000, 'x');
+
+  img.capture_output (1 << 16, false);
+  write_output (img, message_out, "%s=%d;", "a", 1);
+  write_output (img, message_out, "[%s]", long_arg.c_str ());
+  write_output (img, message_out, "%c", 'z');
+  CHECK (printed (img) == "a=1;[" + long_arg + "]z");
+
+  error (img, "%s %08x\n", "at", 0x1234);
+  CHECK (img.get_std_err_buf()->captured()->contents () == "at 00001234\n");
+}
+
+
+int
+main ()
+{
+  test_fast_paths ();
+  test_formatted ();
+  return test_result ();
+}
@@ -5,15 +5,55 @@
 #include <thread>
 #include <condition_variable>
 #include <utility>
+#include <vector>
 
-#include "CPU/scanner.h"
 #include "CPU/spim-utils.h"
+#include "CPU/program_cache.h"
 #include "CPU/spim.h"
+#include "CPU/input_queue.h"
+#include "CPU/vfs.h"
+#include "CPU/profiler.h"
+#include "CPU/inst_mix.h"
+#include "CPU/cache_model.h"
+#include "CPU/branch_predictor.h"
+#include "CPU/pipeline_model.h"
+#include "CPU/exec_trace.h"
+#include "CPU/mem_heatmap.h"
+
+#ifdef WASM
+#include "emscripten.h"
+#endif
 
 std::map<unsigned int, MIPSImage> ctxs;
 std::timed_mutex simulator_mtx; // Mutex for locking the simulator. Will be jointly used by main UI, message handler, and simulator thread
 bool simulator_ready = false;
+std::atomic<int32_t> status_block[STATUS_BLOCK_WORDS];
 static std::thread simulator_thread;
+static std::map<unsigned int, std::map<std::string, std::string>> preloaded_files; // Given to every new image of the ctx
+static size_t capture_capacity = 0; // Capture output of new images if nonzero (see OutputCapture)
+static bool capture_stops_when_full = false;
+
+// What a ctx counts. Given to every new image of the ctx, and to its current image as it changes
+struct Instrumentation {
+    bool profile = false;
+    bool inst_mix = false;
+    std::optional<cache_hierarchy_config_t> caches;
+    std::optional<bp_config_t> branch_predictor;
+    std::optional<pipeline_config_t> pipeline;
+    std::optional<uint32> heatmap_bucket_size;
+};
+
+enum InstrumentationPart : unsigned {
+    INSTRUMENT_PROFILE = 1 << 0,
+    INSTRUMENT_INST_MIX = 1 << 1,
+    INSTRUMENT_CACHES = 1 << 2,
+    INSTRUMENT_BRANCH_PREDICTOR = 1 << 3,
+    INSTRUMENT_PIPELINE = 1 << 4,
+    INSTRUMENT_HEATMAP = 1 << 5,
+    INSTRUMENT_ALL = (1 << 6) - 1
+};
+
+static std::map<unsigned int, Instrumentation> instrumentation;
 
 //  1 - Finished
 //  2 - Not running
@@ -35,10 +75,112 @@ static std::optional<unsigned long> steps_left = 0;
 static unsigned long cycle_delay_usec = 0; // no need to lock since there is 1 writer
 static std::mutex settings_mtx; // Mutex for external settings that can be changed during runtime
 static std::condition_variable steps_left_cv;
+static bool awaiting_input = false; // Every context is parked on a read; guarded by settings_mtx
 static unsigned long cycles_elapsed = 0;
 
 int simulate();
 
+static void publish_run_state(SimulatorRunState state) {
+    status_block[0].store(state, std::memory_order_release);
+}
+
+// Called with simulator_mtx held (or before the simulator thread starts)
+static void publish_status() {
+    status_block[1].store((int32_t) cycles_elapsed, std::memory_order_relaxed);
+    status_block[2].store((int32_t) ((unsigned long long) cycles_elapsed >> 32), std::memory_order_relaxed);
+    for (auto &[ctx_num, img] : ctxs) {
+        if (ctx_num < NUM_CONTEXTS) {
+            status_block[STATUS_CTX_BASE + 3 * ctx_num].store(img.regview_image().PC, std::memory_order_release);
+        }
+    }
+}
+
+// Called with simulator_mtx held
+static bool all_parked_for_input() {
+    if (ctxs.empty()) {
+        return false;
+    }
+    for (auto &[ctx_num, img] : ctxs) {
+        if (!img.input_queue().waiting) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Tell the UI that a context is parked on a read with nothing to read
+static void publish_input_wanted(unsigned int ctx_num) {
+#ifdef WASM
+    MAIN_THREAD_ASYNC_EM_ASM({
+        requestInput($0);
+    }, ctx_num);
+#else
+    fprintf(stderr, "Context %u is waiting for input\n", ctx_num);
+    fflush(stderr);
+#endif
+}
+
+static void publish_finished(unsigned int ctx_num) {
+    if (ctx_num < NUM_CONTEXTS) {
+        status_block[STATUS_CTX_BASE + 3 * ctx_num + 2].store(ctxs.at(ctx_num).regview_image().exit_status, std::memory_order_relaxed);
+        status_block[STATUS_CTX_BASE + 3 * ctx_num + 1].store(1, std::memory_order_release);
+    }
+}
+
+// Starts the given parts of inst afresh in img; a part that is off is removed
+static void instrument(MIPSImage &img, const Instrumentation &inst, unsigned parts) {
+    if (parts & INSTRUMENT_PROFILE) {
+        profile_enable(img, inst.profile);
+    }
+    if (parts & INSTRUMENT_INST_MIX) {
+        inst_mix_enable(img, inst.inst_mix);
+    }
+    if (parts & INSTRUMENT_CACHES) {
+        if (inst.caches) {
+            cache_attach(img, *inst.caches);
+        } else {
+            cache_detach(img);
+        }
+    }
+    if (parts & INSTRUMENT_BRANCH_PREDICTOR) {
+        if (inst.branch_predictor) {
+            bp_attach(img, *inst.branch_predictor);
+        } else {
+            bp_detach(img);
+        }
+    }
+    if (parts & INSTRUMENT_PIPELINE) {
+        if (inst.pipeline) {
+            pipeline_attach(img, *inst.pipeline);
+        } else {
+            pipeline_detach(img);
+        }
+    }
+    if (parts & INSTRUMENT_HEATMAP) {
+        if (inst.heatmap_bucket_size) {
+            heatmap_enable(img, *inst.heatmap_bucket_size);
+        } else {
+            heatmap_disable(img);
+        }
+    }
+}
+
+// Called by main thread. Applies change to ctx's instrumentation, which alters only the given
+// parts, and restarts those parts in ctx's current image. Returns 2 if ctx does not exist
+template <typename Change>
+static int set_instrumentation(int ctx, unsigned parts, Change change) {
+    std::lock_guard<std::timed_mutex> lock(simulator_mtx);
+    if (ctx < 0 || ctx >= NUM_CONTEXTS) {
+        return 2;
+    }
+    Instrumentation &inst = instrumentation[ctx];
+    change(inst);
+    if (auto search = ctxs.find(ctx); search != ctxs.end()) {
+        instrument(search->second, inst, parts);
+    }
+    return 0;
+}
+
 void start_simulator(unsigned int max_contexts, std::set<unsigned int> active_ctxs) {
     reset(max_contexts, active_ctxs);
 
@@ -72,29 +214,56 @@ void reset(unsigned int max_contexts, std::set<unsigned int> &active_ctxs) {
     
     ctxs.clear();
 
+    // The assembler keeps all of its state in the image, so each context
+    // is assembled on its own thread.
+    std::mutex ctxs_mtx;
+    std::vector<std::thread> assemblers;
     for (unsigned int i : active_ctxs) {
         if (i >= max_contexts) {
             continue;
         }
-        MIPSImage new_image(i);
-        initialize_world(new_image, DEFAULT_EXCEPTION_HANDLER, false);
-        initialize_run_stack(new_image, 0, nullptr);
-        char file_name[64];
-        sprintf(file_name, "./input_%d.s", i);
-        if (read_assembly_file(new_image, file_name)) { // check if the file exists
-            new_image.reg_image().PC = starting_address(new_image);
-            ctxs.emplace(i, std::move(new_image));
-        }
-        yylex_destroy();
+        assemblers.emplace_back([i, &ctxs_mtx] {
+            MIPSImage new_image(i);
+            char file_name[64];
+            sprintf(file_name, "./input_%d.s", i);
+            // Reuses the image from the last reset if the source is unchanged
+            if (load_program_cached(new_image, &default_kernel_image, file_name)) { // check if the file exists
+                if (auto files = preloaded_files.find(i); files != preloaded_files.end()) {
+                    for (auto &[name, data] : files->second) {
+                        vfs_write_file(new_image, name, data);
+                    }
+                }
+                if (capture_capacity) {
+                    new_image.capture_output(capture_capacity, capture_stops_when_full);
+                }
+                initialize_run_stack(new_image, 0, nullptr);
+                new_image.reg_image().PC = starting_address(new_image);
+                // Attached last, so that loading the program is not counted
+                if (auto inst = instrumentation.find(i); inst != instrumentation.end()) {
+                    instrument(new_image, inst->second, INSTRUMENT_ALL);
+                }
+                std::lock_guard<std::mutex> lock(ctxs_mtx);
+                ctxs.emplace(i, std::move(new_image));
+            }
+        });
+    }
+    for (auto &t : assemblers) {
+        t.join();
     }
     finished = false;
     steps_left = 0;
+    awaiting_input = false;
 
     if (cycles_elapsed) {
         fprintf(stderr, "The last program ran for %lu cycles!\n", cycles_elapsed);
         fflush(stderr);
     }
     cycles_elapsed = 0;
+    for (auto &word : status_block) {
+        word.store(0, std::memory_order_relaxed);
+    }
+    publish_status();
+    publish_run_state(RUN_STATE_STOPPED);
     simulator_ready = true;
 
     simulator_thread = std::thread(simulate);
@@ -147,6 +316,204 @@ bool add_breakpoint(int ctx, mem_addr addr) {
     return 2;
 }
 
+// Called by main thread
+//
+// Return codes:
+// 0 - Queued the input
+// 2 - ctx does not exist
+int provide_input(int ctx, const std::string &text) {
+    std::lock_guard<std::timed_mutex> lock(simulator_mtx);
+    auto search = ctxs.find(ctx);
+    if (search == ctxs.end()) {
+        return 2;
+    }
+    push_input(search->second, text.data(), text.size());
+
+    std::lock_guard<std::mutex> settings_lock(settings_mtx);
+    awaiting_input = false;
+    steps_left_cv.notify_all();
+    return 0;
+}
+
+// Called by main thread. Reads of ctx no longer wait once its queue is empty
+int close_input(int ctx) {
+    std::lock_guard<std::timed_mutex> lock(simulator_mtx);
+    auto search = ctxs.find(ctx);
+    if (search == ctxs.end()) {
+        return 2;
+    }
+    close_input(search->second);
+
+    std::lock_guard<std::mutex> settings_lock(settings_mtx);
+    awaiting_input = false;
+    steps_left_cv.notify_all();
+    return 0;
+}
+
+// Called by main thread. The file is also preloaded into ctx on every later reset
+//
+// Return codes:
+// 0 - Wrote the file
+// 2 - ctx does not exist
+int preload_file(int ctx, const std::string &name, const std::string &data) {
+    std::lock_guard<std::timed_mutex> lock(simulator_mtx);
+    if (ctx < 0 || ctx >= NUM_CONTEXTS) {
+        return 2;
+    }
+    preloaded_files[ctx][name] = data;
+    if (auto search = ctxs.find(ctx); search != ctxs.end()) {
+        vfs_write_file(search->second, name, data);
+    }
+    return 0;
+}
+
+// Called by main thread
+void clear_preloaded_files(int ctx) {
+    std::lock_guard<std::timed_mutex> lock(simulator_mtx);
+    preloaded_files.erase(ctx);
+}
+
+// Called by main thread. Starts a fresh profile of ctx, now and on every later reset, or stops
+//
+// Return codes:
+// 0 - Done
+// 2 - ctx does not exist
+int set_profiling(int ctx, bool on) {
+    return set_instrumentation(ctx, INSTRUMENT_PROFILE, [&](Instrumentation &inst) {
+        inst.profile = on;
+    });
+}
+
+// Called by main thread. Starts counting ctx's instruction mix from zero, now and on every
+// later reset, or stops
+//
+// Return codes:
+// 0 - Done
+// 1 - The simulator was built without INSTRUCTION_MIX
+// 2 - ctx does not exist
+int set_instruction_mix(int ctx, bool on) {
+    if (!inst_mix_available()) {
+        return 1;
+    }
+    return set_instrumentation(ctx, INSTRUMENT_INST_MIX, [&](Instrumentation &inst) {
+        inst.inst_mix = on;
+    });
+}
+
+// Called by main thread. Attaches a cold cache hierarchy described by spec (see
+// cache_parse_config) to ctx, now and on every later reset, or removes it if on is false
+//
+// Return codes:
+// 0 - Done
+// 1 - spec is malformed (the problem is printed to stderr)
+// 2 - ctx does not exist
+int set_cache_model(int ctx, bool on, const std::string &spec) {
+    cache_hierarchy_config_t config;
+    std::string problem;
+    if (on && !cache_parse_config(spec.c_str(), config, problem)) {
+        fprintf(stderr, "Bad cache model: %s\n", problem.c_str());
+        fflush(stderr);
+        return 1;
+    }
+    return set_instrumentation(ctx, INSTRUMENT_CACHES, [&](Instrumentation &inst) {
+        inst.caches = on ? std::optional(config) : std::nullopt;
+    });
+}
+
+// Called by main thread. Attaches a fresh branch predictor described by spec (see
+// bp_parse_config) to ctx, now and on every later reset, or removes it if on is false
+//
+// Return codes:
+// 0 - Done
+// 1 - spec is malformed (the problem is printed to stderr)
+// 2 - ctx does not exist
+int set_branch_predictor(int ctx, bool on, const std::string &spec) {
+    bp_config_t config;
+    std::string problem;
+    if (on && !bp_parse_config(spec.c_str(), config, problem)) {
+        fprintf(stderr, "Bad branch predictor: %s\n", problem.c_str());
+        fflush(stderr);
+        return 1;
+    }
+    return set_instrumentation(ctx, INSTRUMENT_BRANCH_PREDICTOR, [&](Instrumentation &inst) {
+        inst.branch_predictor = on ? std::optional(config) : std::nullopt;
+    });
+}
+
+// Called by main thread. Attaches an empty pipeline timing model described by spec (see
+// pipeline_parse_config) to ctx, now and on every later reset, or removes it if on is false
+//
+// Return codes:
+// 0 - Done
+// 1 - spec is malformed (the problem is printed to stderr)
+// 2 - ctx does not exist
+int set_pipeline_model(int ctx, bool on, const std::string &spec) {
+    pipeline_config_t config;
+    std::string problem;
+    if (on && !pipeline_parse_config(spec.c_str(), config, problem)) {
+        fprintf(stderr, "Bad pipeline model: %s\n", problem.c_str());
+        fflush(stderr);
+        return 1;
+    }
+    return set_instrumentation(ctx, INSTRUMENT_PIPELINE, [&](Instrumentation &inst) {
+        inst.pipeline = on ? std::optional(config) : std::nullopt;
+    });
+}
+
+// Called by main thread. Counts ctx's data accesses in buckets of bucket_size bytes (see
+// heatmap_enable), starting from zero now and on every later reset, or stops if on is false
+//
+// Return codes:
+// 0 - Done
+// 1 - bucket_size is not a power of two from 4 to 64K
+// 2 - ctx does not exist
+int set_memory_heatmap(int ctx, bool on, unsigned int bucket_size) {
+    if (on && heatmap_bucket_shift(bucket_size) < 0) {
+        fprintf(stderr, "Bad heatmap bucket size: %u\n", bucket_size);
+        fflush(stderr);
+        return 1;
+    }
+    return set_instrumentation(ctx, INSTRUMENT_HEATMAP, [&](Instrumentation &inst) {
+        inst.heatmap_bucket_size = on ? std::optional<uint32>(bucket_size) : std::nullopt;
+    });
+}
+
+// Called by main thread. Starts recording ctx's execution from where it is into the file at
+// path, or into memory if path is empty, in place of any trace being recorded
+//
+// Return codes:
+// 0 - Started
+// 1 - The file cannot be written
+// 2 - ctx does not exist
+int start_trace(int ctx, const std::string &path) {
+    std::lock_guard<std::timed_mutex> lock(simulator_mtx);
+    if (auto search = ctxs.find(ctx); search != ctxs.end()) {
+        trace_stop(search->second);
+        return trace_start(search->second, path.c_str()) ? 0 : 1;
+    }
+    return 2;
+}
+
+// Called by main thread. Stops recording ctx's execution; data is the trace if it was in memory
+//
+// Return codes:
+// 0 - Stopped
+// 2 - ctx does not exist
+int stop_trace(int ctx, std::string &data) {
+    std::lock_guard<std::timed_mutex> lock(simulator_mtx);
+    if (auto search = ctxs.find(ctx); search != ctxs.end()) {
+        data = trace_stop(search->second);
+        return 0;
+    }
+    return 2;
+}
+
+// Called by main thread. Takes effect at the next reset; a capacity of 0 prints output again
+void set_output_capture(size_t capacity, bool stop_when_full) {
+    capture_capacity = capacity;
+    capture_stops_when_full = stop_when_full;
+}
+
 // Called by main thread
 void set_speed(unsigned long delay_usec) {
     cycle_delay_usec = delay_usec;
@@ -166,10 +533,15 @@ int simulate() {
     while (true) {
         unsigned long delay_usec = cycle_delay_usec;
         bool continue_after_delay = false;
-        while (!finished && (steps_left.value_or(1) == 0 || (delay_usec && !continue_after_delay))) { // check if it should step again (if not set, continue)
+        while (!finished && (steps_left.value_or(1) == 0 || awaiting_input || (delay_usec && !continue_after_delay))) { // check if it should step again (if not set, continue)
             if (steps_left.value_or(1) == 0) {
                 status = SimulatorStatusCode::SIMULATOR_WAITING;
+                if (status_block[0].load(std::memory_order_relaxed) == RUN_STATE_RUNNING) {
+                    publish_run_state(RUN_STATE_STOPPED);
+                }
                 steps_left_cv.wait(ul);
+            } else if (awaiting_input) {
+                steps_left_cv.wait(ul); // Until provide_input or close_input
             } else {
                 steps_left_cv.wait_for(ul, std::chrono::microseconds(delay_usec));
             }
@@ -186,6 +558,7 @@ int simulate() {
         if (steps_left) {
             steps_left.value()--;
         }
+        publish_run_state(RUN_STATE_RUNNING);
 
         ul.unlock();
 
@@ -206,37 +579,49 @@ int simulate() {
             // some ctx finished
             
             result = run_spim_cycle_multi_ctx(ctxs, cont_bkpt);
+            for (auto &[ctx_num, img] : ctxs) {
+                img.flush_output_if_due();
+            }
             cycles_elapsed++;
+            publish_status();
+
+            // Decided before simulator_mtx is released, so input pushed after this wakes us
+            ul.lock();
+            awaiting_input = all_parked_for_input();
         }
 
-        ul.lock();
+        for (auto &ctx_num : result.input_wanted_ctxs) {
+            publish_input_wanted(ctx_num);
+        }
         status = SimulatorStatusCode::STEPPED_CYCLE;
         cont_bkpt = false;
 
         if (result.finished_ctxs.size()) {
             for (auto &ctx_num : result.finished_ctxs) {
                 error(ctxs.at(ctx_num), "Execution finished\n");
+                publish_finished(ctx_num);
             }
             finished = true;
             status = SimulatorStatusCode::FINISHED_RUNNING;
+            publish_run_state(RUN_STATE_FINISHED);
             break;
         } else if (result.bp_encountered_ctxs.size()) {
             cont_bkpt = true;
             steps_left = 0;
             status = SimulatorStatusCode::BREAKPOINT_ENCOUNTERED;
+            publish_run_state(RUN_STATE_BREAKPOINT);
             for (auto &[ctx_num, bkpt_addr] : result.bp_encountered_ctxs) {
                 error(ctxs.at(ctx_num), "Breakpoint encountered at 0x%08x\n", bkpt_addr);
             }
+            for (auto &[ctx_num, img] : ctxs) {
+                img.flush_output();
+            }
         }
     }
 
     // Flush all buffers
     for (auto &[ctx, img] : ctxs) {
-        std::ostream os_out(img.get_std_out_buf());
-        std::ostream os_err(img.get_std_err_buf());
-
-        os_out.flush();
-        os_err.flush();
+        img.flush_output();
     }
     fprintf(stderr, "Cycles elpased: %lu\n", cycles_elapsed);
     fflush(stderr);
@@ -1,10 +1,13 @@
 #ifndef WORKER_H
 #define WORKER_H
 
+#include <atomic>
+#include <cstdint>
 #include <mutex>
 #include <map>
 /* #include <memory> */
 #include <set>
+#include <string>
 #include "CPU/spim.h"
 #include "CPU/image.h"
 
@@ -12,6 +15,30 @@ extern std::map<unsigned int, MIPSImage> ctxs;
 extern std::timed_mutex simulator_mtx;
 extern bool simulator_ready;
 
+// Status block shared with the UI thread. The simulator thread updates it
+// with atomic stores, so it can be read (e.g. with Atomics.load from JS)
+// without taking simulator_mtx. Word layout:
+//
+// [0]                      run state (SimulatorRunState)
+// [1], [2]                 cycles elapsed (low, high 32 bits)
+// [STATUS_CTX_BASE + 3*i]  PC of context i
+//                 ... + 1  1 if context i has finished
+//                 ... + 2  exit status of context i
+enum SimulatorRunState {
+    RUN_STATE_STOPPED = 0,
+    RUN_STATE_RUNNING = 1,
+    RUN_STATE_BREAKPOINT = 2,
+    RUN_STATE_FINISHED = 3
+};
+
+#define STATUS_CTX_BASE 3
+#define STATUS_BLOCK_WORDS (STATUS_CTX_BASE + 3 * NUM_CONTEXTS)
+
+static_assert(sizeof(std::atomic<int32_t>) == sizeof(int32_t) && std::atomic<int32_t>::is_always_lock_free,
+              "status block words must be plain lock-free 32-bit integers");
+
+extern std::atomic<int32_t> status_block[STATUS_BLOCK_WORDS];
+
 // Starts the SPIM simulator with max_contexts
 //
 // The program may not use certain contexts as in certain
@@ -26,6 +53,19 @@ void play_simulation();
 void pause_simulation();
 bool add_breakpoint(int ctx, mem_addr addr);
 int delete_breakpoint(int ctx, mem_addr addr);  
+int provide_input(int ctx, const std::string &text);
+int close_input(int ctx);
+int preload_file(int ctx, const std::string &name, const std::string &data);
+void clear_preloaded_files(int ctx);
+void set_output_capture(size_t capacity, bool stop_when_full);
+int set_profiling(int ctx, bool on);
+int set_instruction_mix(int ctx, bool on);
+int set_cache_model(int ctx, bool on, const std::string &spec);
+int set_branch_predictor(int ctx, bool on, const std::string &spec);
+int set_pipeline_model(int ctx, bool on, const std::string &spec);
+int set_memory_heatmap(int ctx, bool on, unsigned int bucket_size);
+int start_trace(int ctx, const std::string &path);
+int stop_trace(int ctx, std::string &data);
 void set_speed(unsigned long delay_usec);
 int get_simulator_status();
 